@@ -63,6 +63,7 @@ float fMaxSubsceneArea;
 float fSampleMesh;
 float fBorderROI;
 bool bCrop2ROI;
+bool bStreamPointCloud;
 int nEstimateROI;
 int	nTowerMode;
 int nFusionMode;
@@ -71,9 +72,12 @@ float fEstimateScale;
 int nEstimateSegmentation;
 int thFilterPointCloud;
 int nExportNumViews;
+int nConvertDMAPSFormat;
 int nArchiveType;
 int nProcessPriority;
 unsigned nMaxThreads;
+String strImageCacheFolder;
+unsigned nImageCacheSize;
 String strConfigFileName;
 boost::program_options::variables_map vm;
 int indexPremiereImage;
@@ -137,12 +141,15 @@ bool Application::Initialize(size_t argc, LPCTSTR* argv)
 	unsigned nSubResolutionLevels;
 	unsigned nEstimationIters;
 	unsigned nEstimationGeometricIters;
+	unsigned nConcurrentImages;
 	unsigned nEstimateColors;
 	unsigned nEstimateNormals;
 	unsigned nFuseFilter;
 	unsigned nOptimize;
 	int nIgnoreMaskLabel;
 	bool bRemoveDmaps;
+	unsigned nDepthMapFormat;
+	bool bMapDmaps;
 	boost::program_options::options_description config("Densify options");
 	config.add_options()
 		("input-file,i", boost::program_options::value<std::string>(&OPT::strInputFileName), "input filename containing camera poses and image list")
@@ -160,6 +167,7 @@ bool Application::Initialize(size_t argc, LPCTSTR* argv)
 		("ignore-mask-label", boost::program_options::value(&nIgnoreMaskLabel)->default_value(-1), "label value to ignore in the image mask, stored in the MVS scene or next to each image with '.mask.png' extension (<0 - disabled)")
 		("iters", boost::program_options::value(&nEstimationIters)->default_value(numIters), "number of patch-match iterations")
 		("geometric-iters", boost::program_options::value(&nEstimationGeometricIters)->default_value(2), "number of geometric consistent patch-match iterations (0 - disabled)")
+		("concurrent-images", boost::program_options::value(&nConcurrentImages)->default_value(1), "number of depth-maps estimated concurrently, useful for low resolution images (0 - auto, 1 - disabled)")
 		("estimate-colors", boost::program_options::value(&nEstimateColors)->default_value(2), "estimate the colors for the dense point-cloud (0 - disabled, 1 - final, 2 - estimate)")
 		("estimate-normals", boost::program_options::value(&nEstimateNormals)->default_value(2), "estimate the normals for the dense point-cloud (0 - disabled, 1 - final, 2 - estimate)")
 		("estimate-scale", boost::program_options::value(&OPT::fEstimateScale)->default_value(0.f), "estimate the point-scale for the dense point-cloud (scale multiplier, 0 - disabled)")
@@ -175,6 +183,9 @@ bool Application::Initialize(size_t argc, LPCTSTR* argv)
 		("estimate-roi", boost::program_options::value(&OPT::nEstimateROI)->default_value(2), "estimate and set region-of-interest (0 - disabled, 1 - enabled, 2 - adaptive)")
 		("crop-to-roi", boost::program_options::value(&OPT::bCrop2ROI)->default_value(true), "crop scene using the region-of-interest")
 		("remove-dmaps", boost::program_options::value(&bRemoveDmaps)->default_value(false), "remove depth-maps after fusion")
+		("map-dmaps", boost::program_options::value(&bMapDmaps)->default_value(false), "map the depth-maps files in memory during fusion instead of reading them (raw format only)")
+		("stream-point-cloud", boost::program_options::value(&OPT::bStreamPointCloud)->default_value(false), "write the dense point-cloud to disk while fusing the depth-maps, instead of keeping it in memory (the project file will not contain it)")
+		("dmap-format", boost::program_options::value(&nDepthMapFormat)->default_value(0), "format used to store the depth-maps (0 - raw, 1 - tiled lossless, 2 - tiled compact)")
 		("tower-mode", boost::program_options::value(&OPT::nTowerMode)->default_value(4), "add a cylinder of points in the center of ROI; scene assume to be Z-up oriented (0 - disabled, 1 - replace, 2 - append, 3 - select neighbors, 4 - select neighbors & append, <0 - force tower mode)")
 		("normalize-coordinates", boost::program_options::value(&OPT::nNormalizeCoordinates)->default_value(0), "normalize scene coordinates and output the inverse transform to file (0 - disabled, 1 - center, 2 - center & scale)")
 		("indexPremiereImage", boost::program_options::value(&OPT::indexPremiereImage)->default_value(-1), "index de la premiere image traitee (-1 - disabled)")
@@ -182,6 +193,8 @@ bool Application::Initialize(size_t argc, LPCTSTR* argv)
         ("profondeurMaximale", boost::program_options::value(&OPT::profondeurMaximale)->default_value(-1.0), "profondeur maximale (-1 - disabled)")
         ("hauteurMaximale", boost::program_options::value(&OPT::hauteurMaximale)->default_value(-1.0), "hauteur maximale (-1 - disabled)")
         ("nbIterationsGeometrique", boost::program_options::value(&nEstimationGeometricIters)->default_value(2), "nb iterations géométrique (0 - disabled)")
+		("image-cache", boost::program_options::value<std::string>(&OPT::strImageCacheFolder), "folder used to cache the decoded and scaled images across runs (empty - disabled)")
+		("image-cache-size", boost::program_options::value(&OPT::nImageCacheSize)->default_value(0), "maximum size in MB of the image cache (0 - unlimited)")
 		;
 
 	// hidden options, allowed both on command line and
@@ -193,6 +206,7 @@ bool Application::Initialize(size_t argc, LPCTSTR* argv)
 		("import-roi-file", boost::program_options::value<std::string>(&OPT::strImportROIFileName), "ROI file name to be imported into the scene")
 		("crop-roi-file", boost::program_options::value<std::string>(&OPT::strCropROIFileName), "ROI file name to crop the scene keeping only the points inside ROI and the cameras seeing them")
 		("export-dmaps", boost::program_options::value<std::string>(&OPT::strExportDMAPSPathName), "path name where DMAPs depth-maps will be exported as PNG depth-maps (empty - disabled)")
+		("convert-dmaps", boost::program_options::value(&OPT::nConvertDMAPSFormat)->default_value(-1), "convert in-place the existing DMAPs depth-maps to the given format (-1 - disabled, 0 - raw, 1 - tiled lossless, 2 - tiled compact)")
 		("dense-config-file", boost::program_options::value<std::string>(&OPT::strDenseConfigFileName), "optional configuration file for the densifier (overwritten by the command line options)")
 		("export-depth-maps-name", boost::program_options::value<std::string>(&OPT::strExportDepthMapsName), "render given mesh and save the depth-map for every image to this file name base (empty - disabled)")
 		;
@@ -266,16 +280,21 @@ bool Application::Initialize(size_t argc, LPCTSTR* argv)
 	OPTDENSE::nMinViewsFuse = nMinViewsFuse;
 	OPTDENSE::nEstimationIters = nEstimationIters;
 	OPTDENSE::nEstimationGeometricIters = nEstimationGeometricIters;
+	OPTDENSE::nConcurrentImages = nConcurrentImages;
 	OPTDENSE::nEstimateColors = nEstimateColors;
 	OPTDENSE::nEstimateNormals = nEstimateNormals;
 	OPTDENSE::nFuseFilter = nFuseFilter;
 	OPTDENSE::nOptimize = nOptimize;
 	OPTDENSE::nIgnoreMaskLabel = nIgnoreMaskLabel;
 	OPTDENSE::bRemoveDmaps = bRemoveDmaps;
+	OPTDENSE::nDepthMapFormat = nDepthMapFormat;
+	OPTDENSE::bMapDmaps = bMapDmaps;
 	if (!bValidConfig && !OPT::strDenseConfigFileName.empty())
 		OPTDENSE::oConfig.Save(OPT::strDenseConfigFileName);
 
 	MVS::Initialize(APPNAME, OPT::nMaxThreads, OPT::nProcessPriority);
+	if (!OPT::strImageCacheFolder.empty())
+		ImageCache::Init(OPT::strImageCacheFolder, (size_t)OPT::nImageCacheSize*1024*1024);
 	return true;
 }
 
@@ -349,6 +368,25 @@ int main(int argc, LPCTSTR* argv)
 		}
 		return EXIT_SUCCESS;
 	}
+	if (OPT::nConvertDMAPSFormat >= 0 && scene.IsValid()) {
+		// convert existing depth-maps to the given format
+		TD_TIMER_START();
+		size_f_t sizeIn(0), sizeOut(0);
+		unsigned nConverted(0);
+		for (const Image& image: scene.images) {
+			const String fileName(ComposeDepthFilePath(image.ID, "dmap"));
+			if (!File::access(fileName))
+				continue;
+			sizeIn += File::getSize(fileName);
+			if (!ConvertDepthDataRaw(fileName, fileName, (unsigned)OPT::nConvertDMAPSFormat))
+				return EXIT_FAILURE;
+			sizeOut += File::getSize(fileName);
+			++nConverted;
+		}
+		VERBOSE("Depth-maps converted: %u depth-maps, %s to %s (%s)", nConverted,
+			Util::formatBytes(sizeIn).c_str(), Util::formatBytes(sizeOut).c_str(), TD_TIMER_GET_FMT().c_str());
+		return EXIT_SUCCESS;
+	}
 	if (!OPT::strPointCloudFileName.empty() && !scene.pointcloud.Load(MAKE_PATH_SAFE(OPT::strPointCloudFileName))) {
 		VERBOSE("error: cannot load point-cloud file");
 		return EXIT_FAILURE;
@@ -483,12 +521,21 @@ int main(int argc, LPCTSTR* argv)
 		if ((ARCHIVE_TYPE)OPT::nArchiveType == ARCHIVE_MVS)
 			sparsePointCloud = scene.pointcloud;
 		TD_TIMER_START();
-		if (!scene.DenseReconstruction(OPT::nFusionMode, OPT::bCrop2ROI, OPT::fBorderROI,OPT::indexPremiereImage,OPT::indexDerniereImage, OPT::profondeurMaximale, OPT::hauteurMaximale)) {
+		const String fileNameStreamPointCloud(OPT::bStreamPointCloud ? MAKE_PATH_SAFE(Util::getFileFullName(OPT::strOutputFileName))+_T(".ply") : String());
+		if (!scene.DenseReconstruction(OPT::nFusionMode, OPT::bCrop2ROI, OPT::fBorderROI,OPT::indexPremiereImage,OPT::indexDerniereImage, OPT::profondeurMaximale, OPT::hauteurMaximale, fileNameStreamPointCloud)) {
 			if (ABS(OPT::nFusionMode) != 1)
 				return EXIT_FAILURE;
 			VERBOSE("Depth-maps estimated (%s)", TD_TIMER_GET_FMT().c_str());
 			return EXIT_SUCCESS;
 		}
+		if (OPT::bStreamPointCloud) {
+			// the dense point-cloud was already written to disk, only the project is left to be saved
+			VERBOSE("Densifying point-cloud completed (%s)", TD_TIMER_GET_FMT().c_str());
+			if ((ARCHIVE_TYPE)OPT::nArchiveType == ARCHIVE_MVS)
+				scene.pointcloud.Swap(sparsePointCloud);
+			scene.Save(MAKE_PATH_SAFE(Util::getFileFullName(OPT::strOutputFileName))+_T(".mvs"), (ARCHIVE_TYPE)OPT::nArchiveType);
+			return EXIT_SUCCESS;
+		}
 		VERBOSE("Densifying point-cloud completed: %u points (%s)", scene.pointcloud.GetSize(), TD_TIMER_GET_FMT().c_str());
 	}
 	if (OPT::nEstimateSegmentation != 0 && !scene.pointcloud.IsEmpty() && !scene.images.empty() && !scene.images.front().maskName.empty()) {
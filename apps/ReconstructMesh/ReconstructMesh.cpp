@@ -31,6 +31,7 @@
 
 #include "../../libs/MVS/Common.h"
 #include "../../libs/MVS/Scene.h"
+#include "../../libs/MVS/MaxFlow.h"
 #include <boost/program_options.hpp>
 
 using namespace MVS;
@@ -60,6 +61,12 @@ String strImagePointsFileName;
 bool bMeshExport;
 float fDistInsert;
 bool bUseOnlyROI;
+unsigned nInsertThreads;
+bool bBenchmarkInsert;
+unsigned nMaxBlockPoints;
+float fBlockOverlap;
+unsigned nMaxFlowType;
+String strExportGraphFileName;
 bool bUseConstantWeight;
 bool bUseFreeSpaceSupport;
 float fThicknessFactor;
@@ -130,6 +137,12 @@ bool Application::Initialize(size_t argc, LPCTSTR* argv)
 		("output-file,o", boost::program_options::value<std::string>(&OPT::strOutputFileName), "output filename for storing the mesh")
 		("min-point-distance,d", boost::program_options::value(&OPT::fDistInsert)->default_value(1.5f), "minimum distance in pixels between the projection of two 3D points to consider them different while triangulating (0 - disabled)")
 		("integrate-only-roi", boost::program_options::value(&OPT::bUseOnlyROI)->default_value(false), "use only the points inside the ROI")
+		("insert-threads", boost::program_options::value(&OPT::nInsertThreads)->default_value(1), "number of threads used to decimate and insert the points in the Delaunay triangulation (0 - all available cores, 1 - sequential)")
+		("benchmark-insert", boost::program_options::value(&OPT::bBenchmarkInsert)->default_value(false), "benchmark the points insertion for an increasing number of threads before reconstructing the mesh")
+		("block-points", boost::program_options::value(&OPT::nMaxBlockPoints)->default_value(0), "reconstruct the mesh in blocks containing at most this number of points, in order to bound the memory used (0 - disabled)")
+		("block-overlap", boost::program_options::value(&OPT::fBlockOverlap)->default_value(0.1f), "ratio of the block size by which the blocks are enlarged to overlap their neighbors")
+		("max-flow", boost::program_options::value(&OPT::nMaxFlowType)->default_value(MAXFLOW_DEFAULT), "max-flow algorithm used by the graph-cut (0 - IBFS, 1 - Boykov-Kolmogorov, 2 - region-parallel, needing up to twice the memory of the others while building the final graph)")
+		("export-graph", boost::program_options::value<std::string>(&OPT::strExportGraphFileName), "file name where to save the graph-cut, to be replayed by the max-flow benchmark (optional)")
 		("constant-weight", boost::program_options::value(&OPT::bUseConstantWeight)->default_value(true), "considers all view weights 1 instead of the available weight")
 		("free-space-support,f", boost::program_options::value(&OPT::bUseFreeSpaceSupport)->default_value(false), "exploits the free-space support in order to reconstruct weakly-represented surfaces")
 		("thickness-factor", boost::program_options::value(&OPT::fThicknessFactor)->default_value(1.f), "multiplier adjusting the minimum thickness considered during visibility weighting")
@@ -209,11 +222,21 @@ bool Application::Initialize(size_t argc, LPCTSTR* argv)
 	Util::ensureValidPath(OPT::strImportROIFileName);
 	Util::ensureValidPath(OPT::strImagePointsFileName);
 	Util::ensureValidPath(OPT::strMeshFileName);
+	Util::ensureValidPath(OPT::strExportGraphFileName);
 	if (OPT::strPointCloudFileName.empty() && (ARCHIVE_TYPE)OPT::nArchiveType == ARCHIVE_MVS)
 		OPT::strPointCloudFileName = Util::getFileFullName(OPT::strInputFileName) + _T(".ply");
 	if (OPT::strOutputFileName.empty())
 		OPT::strOutputFileName = Util::getFileFullName(OPT::strInputFileName) + _T("_mesh.mvs");
 
+	if (!IsMaxFlowTypeAvailable(OPT::nMaxFlowType)) {
+		VERBOSE("warning: max-flow algorithm %u not available, using %s", OPT::nMaxFlowType, MaxFlowTypeName(MAXFLOW_DEFAULT));
+		OPT::nMaxFlowType = MAXFLOW_DEFAULT;
+	}
+	OPTMESH::nMaxFlowType = OPT::nMaxFlowType;
+	if (!OPT::strExportGraphFileName.empty())
+		OPTMESH::strExportGraphFileName = MAKE_PATH_SAFE(OPT::strExportGraphFileName);
+	OPTMESH::nInsertThreads = OPT::nInsertThreads;
+
 	MVS::Initialize(APPNAME, OPT::nMaxThreads, OPT::nProcessPriority);
 	return true;
 }
@@ -411,6 +434,9 @@ int main(int argc, LPCTSTR* argv)
 		if (OPT::strMeshFileName.empty() && scene.mesh.IsEmpty()) {
 			// reset image resolution to the original size and
 			// make sure the image neighbors are initialized before deleting the point-cloud
+			Scene::ImagePointsArr imagePoints;
+			if (!scene.ImagesHaveNeighbors() && scene.pointcloud.IsValid())
+				scene.ComputeImagePoints(imagePoints);
 			#ifdef RECMESH_USE_OPENMP
 			bool bAbort(false);
 			#pragma omp parallel for
@@ -439,17 +465,26 @@ int main(int argc, LPCTSTR* argv)
 				// select neighbor views
 				if (imageData.neighbors.empty()) {
 					IndexArr points;
-					scene.SelectNeighborViews(idxImage, points);
+					scene.SelectNeighborViews(idxImage, points, 3, 2, FD2R(12), 1, imagePoints.empty() ? NULL : &imagePoints[idxImage]);
 				}
 			}
+			imagePoints.Release();
 			#ifdef RECMESH_USE_OPENMP
 			if (bAbort)
 				return EXIT_FAILURE;
 			#endif
+			if (OPT::bBenchmarkInsert) {
+				// measure the scaling of the points insertion with the number of threads
+				scene.BenchmarkPointInsertion(OPT::fDistInsert, OPT::nMaxThreads);
+			}
 			// reconstruct a coarse mesh from the given point-cloud
 			TD_TIMER_START();
 			if (OPT::bUseConstantWeight)
 				scene.pointcloud.pointWeights.Release();
+			if (OPT::nMaxBlockPoints > 0) {
+				if (!scene.ReconstructMeshBlocks(OPT::nMaxBlockPoints, OPT::fBlockOverlap, OPT::fDistInsert, OPT::bUseFreeSpaceSupport, OPT::bUseOnlyROI, 4, OPT::fThicknessFactor, OPT::fQualityFactor))
+					return EXIT_FAILURE;
+			} else
 			if (!scene.ReconstructMesh(OPT::fDistInsert, OPT::bUseFreeSpaceSupport, OPT::bUseOnlyROI, 4, OPT::fThicknessFactor, OPT::fQualityFactor))
 				return EXIT_FAILURE;
 			VERBOSE("Mesh reconstruction completed: %u vertices, %u faces (%s)", scene.mesh.vertices.GetSize(), scene.mesh.faces.GetSize(), TD_TIMER_GET_FMT().c_str());
@@ -58,6 +58,7 @@ unsigned nEnsureEdgeSize;
 unsigned nScales;
 float fScaleStep;
 unsigned nReduceMemory;
+unsigned nMaxMemory;
 unsigned nAlternatePair;
 float fRegularityWeight;
 float fRatioRigidityElasticity;
@@ -67,6 +68,8 @@ float fGradientStep;
 unsigned nArchiveType;
 int nProcessPriority;
 unsigned nMaxThreads;
+String strImageCacheFolder;
+unsigned nImageCacheSize;
 String strExportType;
 String strConfigFileName;
 boost::program_options::variables_map vm;
@@ -133,6 +136,9 @@ bool Application::Initialize(size_t argc, LPCTSTR* argv)
 		("gradient-step", boost::program_options::value(&OPT::fGradientStep)->default_value(45.05f), "gradient step to be used instead (0 - auto)")
 		("planar-vertex-ratio", boost::program_options::value(&OPT::fPlanarVertexRatio)->default_value(0.f), "threshold used to remove vertices on planar patches (0 - disabled)")
 		("reduce-memory", boost::program_options::value(&OPT::nReduceMemory)->default_value(1), "recompute some data in order to reduce memory requirements")
+		("max-memory", boost::program_options::value(&OPT::nMaxMemory)->default_value(0), "maximum memory in MB used by the images data, loading them only when needed (0 - unlimited, all images kept in memory)")
+		("image-cache", boost::program_options::value<std::string>(&OPT::strImageCacheFolder), "folder used to cache the decoded and scaled images across runs (empty - disabled)")
+		("image-cache-size", boost::program_options::value(&OPT::nImageCacheSize)->default_value(0), "maximum size in MB of the image cache (0 - unlimited)")
 		;
 
 	boost::program_options::options_description cmdline_options;
@@ -188,6 +194,8 @@ bool Application::Initialize(size_t argc, LPCTSTR* argv)
 		OPT::strOutputFileName = Util::getFileFullName(OPT::strInputFileName) + _T("_refine.mvs");
 
 	MVS::Initialize(APPNAME, OPT::nMaxThreads, OPT::nProcessPriority);
+	if (!OPT::strImageCacheFolder.empty())
+		ImageCache::Init(OPT::strImageCacheFolder, (size_t)OPT::nImageCacheSize*1024*1024);
 	return true;
 }
 
@@ -248,7 +256,8 @@ int main(int argc, LPCTSTR* argv)
 						  OPT::fRatioRigidityElasticity,
 						  OPT::fGradientStep,
 						  OPT::fPlanarVertexRatio,
-						  OPT::nReduceMemory))
+						  OPT::nReduceMemory,
+						  OPT::nMaxMemory))
 		return EXIT_FAILURE;
 	VERBOSE("Mesh refinement completed: %u vertices, %u faces (%s)", scene.mesh.vertices.GetSize(), scene.mesh.faces.GetSize(), TD_TIMER_GET_FMT().c_str());
 
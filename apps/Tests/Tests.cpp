@@ -31,6 +31,7 @@
 
 #include "../../libs/MVS/Common.h"
 #include "../../libs/MVS/Scene.h"
+#include "../../libs/MVS/MaxFlow.h"
 
 using namespace MVS;
 
@@ -66,6 +67,26 @@ bool UnitTests()
 		VERBOSE("ERROR: TestRayTriangleIntersection<double> failed!");
 		return false;
 	}
+	if (!TestDepthEstimatorSamplePatch(100000)) {
+		VERBOSE("ERROR: TestDepthEstimatorSamplePatch failed!");
+		return false;
+	}
+	if (!TestDepthDataFormats(300, 200, 64)) {
+		VERBOSE("ERROR: TestDepthDataFormats failed!");
+		return false;
+	}
+	if (!TestPointCloudStream(10000)) {
+		VERBOSE("ERROR: TestPointCloudStream failed!");
+		return false;
+	}
+	if (!TestMaxFlow(64)) {
+		VERBOSE("ERROR: TestMaxFlow failed!");
+		return false;
+	}
+	if (!TestMeshRefineZNCC(160, 120)) {
+		VERBOSE("ERROR: TestMeshRefineZNCC failed!");
+		return false;
+	}
 	VERBOSE("All unit tests passed (%s)", TD_TIMER_GET_FMT().c_str());
 	return true;
 }
@@ -84,6 +105,10 @@ bool PipelineTest(bool verbose=false)
 		VERBOSE("ERROR: TestDataset failed loading the scene!");
 		return false;
 	}
+	if (!TestImageDecodeScaled(scene.images, 640)) {
+		VERBOSE("ERROR: TestDataset failed decoding scaled images!");
+		return false;
+	}
 	OPTDENSE::init();
 	OPTDENSE::bRemoveDmaps = true;
 	if (!scene.DenseReconstruction() || scene.pointcloud.GetSize() < 50000u) {
@@ -92,6 +117,10 @@ bool PipelineTest(bool verbose=false)
 	}
 	if (verbose)
 		scene.pointcloud.Save(MAKE_PATH("scene_dense.ply"));
+	if (!TestReconstructMeshBlocks(scene, scene.pointcloud.GetSize()/4, 0.2f)) {
+		VERBOSE("ERROR: TestDataset failed reconstructing a watertight mesh block-wise!");
+		return false;
+	}
 	if (!scene.ReconstructMesh() || scene.mesh.faces.size() < 25000u) {
 		VERBOSE("ERROR: TestDataset failed reconstructing the mesh!");
 		return false;
@@ -107,10 +136,32 @@ bool PipelineTest(bool verbose=false)
 	#ifdef _USE_OPENMP
 	TestMeshProjectionMT(scene.mesh, scene.images[1]);
 	#endif
+	const Mesh mesh(scene.mesh);
 	if (!scene.TextureMesh(0, 0) || !scene.mesh.HasTexture()) {
 		VERBOSE("ERROR: TestDataset failed texturing the mesh!");
 		return false;
 	}
+	{
+		// texture again the same mesh under a small memory budget, loading the images one by one,
+		// and check the texture is exactly the same as with all the images in memory
+		const Mesh meshTexture(scene.mesh);
+		scene.mesh = mesh;
+		if (!scene.TextureMesh(0, 0, 0, 0.f, 0.3f, true, true, 0, 3, Pixel8U(255,127,39), 0.5f, -1, 0, IIndexArr(), 1) || !scene.mesh.HasTexture()) {
+			VERBOSE("ERROR: TestDataset failed texturing the mesh under a memory budget!");
+			return false;
+		}
+		bool bSame(scene.mesh.texturesDiffuse.size() == meshTexture.texturesDiffuse.size());
+		for (Mesh::TexIndex i=0; bSame && i<meshTexture.texturesDiffuse.size(); ++i) {
+			const Image8U3& texture = meshTexture.texturesDiffuse[i];
+			const Image8U3& textureBudget = scene.mesh.texturesDiffuse[i];
+			bSame = texture.size() == textureBudget.size() &&
+				cv::norm(texture, textureBudget, cv::NORM_INF) == 0;
+		}
+		if (!bSame) {
+			VERBOSE("ERROR: TestDataset failed texturing the mesh the same under a memory budget!");
+			return false;
+		}
+	}
 	if (verbose)
 		scene.mesh.Save(MAKE_PATH("scene_dense_mesh_texture.ply"));
 	VERBOSE("All pipeline stages passed (%s)", TD_TIMER_GET_FMT().c_str());
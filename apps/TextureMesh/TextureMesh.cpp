@@ -68,7 +68,10 @@ unsigned nOrthoMapResolution;
 unsigned nArchiveType;
 int nProcessPriority;
 unsigned nMaxThreads;
+String strImageCacheFolder;
+unsigned nImageCacheSize;
 int nMaxTextureSize;
+unsigned nMaxMemory;
 String strExportType;
 String strConfigFileName;
 boost::program_options::variables_map vm;
@@ -136,6 +139,9 @@ bool Application::Initialize(size_t argc, LPCTSTR* argv)
 		("orthographic-image-resolution", boost::program_options::value(&OPT::nOrthoMapResolution)->default_value(0), "orthographic image resolution to be generated from the textured mesh - the mesh is expected to be already geo-referenced or at least properly oriented (0 - disabled)")
 		("ignore-mask-label", boost::program_options::value(&OPT::nIgnoreMaskLabel)->default_value(-1), "label value to ignore in the image mask, stored in the MVS scene or next to each image with '.mask.png' extension (-1 - auto estimate mask for lens distortion, -2 - disabled)")
 		("max-texture-size", boost::program_options::value(&OPT::nMaxTextureSize)->default_value(8192), "maximum texture size, split it in multiple textures of this size if needed (0 - unbounded)")
+		("max-memory", boost::program_options::value(&OPT::nMaxMemory)->default_value(0), "maximum memory in MB used by the images loaded at once, keeping only the regions needed for texturing, which are not bounded by it (0 - unlimited, all images kept in memory)")
+		("image-cache", boost::program_options::value<std::string>(&OPT::strImageCacheFolder), "folder used to cache the decoded and scaled images across runs (empty - disabled)")
+		("image-cache-size", boost::program_options::value(&OPT::nImageCacheSize)->default_value(0), "maximum size in MB of the image cache (0 - unlimited)")
 		;
 
 	// hidden options, allowed both on command line and
@@ -209,6 +215,8 @@ bool Application::Initialize(size_t argc, LPCTSTR* argv)
 		OPT::strOutputFileName = Util::getFileFullName(OPT::strInputFileName) + _T("_texture.mvs");
 
 	MVS::Initialize(APPNAME, OPT::nMaxThreads, OPT::nProcessPriority);
+	if (!OPT::strImageCacheFolder.empty())
+		ImageCache::Init(OPT::strImageCacheFolder, (size_t)OPT::nImageCacheSize*1024*1024);
 	return true;
 }
 
@@ -308,7 +316,7 @@ int main(int argc, LPCTSTR* argv)
 	TD_TIMER_START();
 	if (!scene.TextureMesh(OPT::nResolutionLevel, OPT::nMinResolution, OPT::minCommonCameras, OPT::fOutlierThreshold, OPT::fRatioDataSmoothness,
 						   OPT::bGlobalSeamLeveling, OPT::bLocalSeamLeveling, OPT::nTextureSizeMultiple, OPT::nRectPackingHeuristic, Pixel8U(OPT::nColEmpty),
-						   OPT::fSharpnessWeight, OPT::nIgnoreMaskLabel, OPT::nMaxTextureSize, views))
+						   OPT::fSharpnessWeight, OPT::nIgnoreMaskLabel, OPT::nMaxTextureSize, views, OPT::nMaxMemory))
 		return EXIT_FAILURE;
 	VERBOSE("Mesh texturing completed: %u vertices, %u faces (%s)", scene.mesh.vertices.GetSize(), scene.mesh.faces.GetSize(), TD_TIMER_GET_FMT().c_str());
 
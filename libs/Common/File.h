@@ -87,6 +87,8 @@
 #else
 #include <unistd.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #ifndef STATS
 #if defined(_ENVIRONMENT64) && !defined(__APPLE__)
 #define STATS stat64
@@ -709,6 +711,111 @@ private:
 typedef File* LPFILE;
 /*----------------------------------------------------------------*/
 
+
+// Maps a whole file in memory (read-only file, copy-on-write memory):
+// the pages are loaded on demand by the OS and any change to the memory
+// is private to this process, never written back to the file.
+class GENERAL_API MappedFile {
+public:
+	inline MappedFile() : pData(NULL), nSize(0) {}
+	inline MappedFile(LPCTSTR aFileName) : pData(NULL), nSize(0) { open(aFileName); }
+	~MappedFile() { close(); }
+
+	bool isOpen() const { return pData != NULL; }
+
+	// map the given file; return false if the file can not be mapped
+	bool open(LPCTSTR aFileName) {
+		close();
+		#ifdef _MSC_VER
+		const HANDLE hFile(::CreateFile(aFileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL));
+		if (hFile == INVALID_HANDLE_VALUE)
+			return false;
+		LARGE_INTEGER size;
+		if (::GetFileSizeEx(hFile, &size) && size.QuadPart > 0) {
+			const HANDLE hMapping(::CreateFileMapping(hFile, NULL, PAGE_WRITECOPY, 0, 0, NULL));
+			if (hMapping != NULL) {
+				pData = (uint8_t*)::MapViewOfFile(hMapping, FILE_MAP_COPY, 0, 0, 0);
+				::CloseHandle(hMapping);
+				if (pData != NULL)
+					nSize = (size_t)size.QuadPart;
+			}
+		}
+		::CloseHandle(hFile);
+		#else
+		const int fd(::open(aFileName, O_RDONLY));
+		if (fd < 0)
+			return false;
+		struct STATS buf;
+		if (FSTAT(fd, &buf) == 0 && buf.st_size > 0) {
+			void* const pMap(::mmap(NULL, (size_t)buf.st_size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0));
+			if (pMap != MAP_FAILED) {
+				pData = (uint8_t*)pMap;
+				nSize = (size_t)buf.st_size;
+			}
+		}
+		::close(fd);
+		#endif
+		return isOpen();
+	}
+	void close() {
+		if (!isOpen())
+			return;
+		#ifdef _MSC_VER
+		::UnmapViewOfFile(pData);
+		#else
+		::munmap(pData, nSize);
+		#endif
+		pData = NULL;
+		nSize = 0;
+	}
+
+	inline uint8_t* getData() const { return pData; }
+	inline size_t getSize() const { return nSize; }
+
+	// hint the OS to start loading the whole mapping in physical memory
+	void prefetch() const {
+		if (!isOpen())
+			return;
+		#ifndef _MSC_VER
+		::madvise(pData, nSize, MADV_WILLNEED);
+		#endif
+	}
+
+	// estimate how much of the mapping is currently loaded in physical memory (in bytes)
+	size_t getResidentSize() const {
+		if (!isOpen())
+			return 0;
+		#ifdef _MSC_VER
+		// no cheap way to query it, so assume it is fully resident
+		return nSize;
+		#else
+		const size_t nPageSize((size_t)::sysconf(_SC_PAGESIZE));
+		const size_t nPages((nSize+nPageSize-1)/nPageSize);
+		#ifdef __APPLE__
+		std::vector<char> residency(nPages);
+		#else
+		std::vector<unsigned char> residency(nPages);
+		#endif
+		if (::mincore(pData, nSize, residency.data()) != 0)
+			return nSize;
+		size_t nResidentPages(0);
+		for (const auto r: residency)
+			if (r & 1)
+				++nResidentPages;
+		return MINF(nResidentPages*nPageSize, nSize);
+		#endif
+	}
+
+protected:
+	uint8_t* pData;
+	size_t nSize;
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+};
+/*----------------------------------------------------------------*/
+
 } // namespace SEACAVE
 
 #endif // __SEACAVE_FILE_H__
\ No newline at end of file
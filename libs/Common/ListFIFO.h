@@ -69,6 +69,16 @@ public:
 		return leastUsed;
 	}
 
+	// remove the given key, if present
+	bool Remove(const T& key) {
+		const auto it = map.find(key);
+		if (it == map.end())
+			return false;
+		order.erase(it->second);
+		map.erase(it);
+		return true;
+	}
+
 	// return the least used key (from the back)
 	const T& Back() {
 		ASSERT(!IsEmpty());
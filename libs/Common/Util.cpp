@@ -574,6 +574,13 @@ void Util::LogMemoryInfo()
 	LOG(_T("\tPeakPagefileUsage %s"), SEACAVE::Util::formatBytes(pmc.PeakPagefileUsage).c_str());
 	LOG(_T("} ENDINFO"));
 }
+size_t Util::GetProcessMemory()
+{
+	PROCESS_MEMORY_COUNTERS pmc;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+		return 0;
+	return pmc.WorkingSetSize;
+}
 #else // _MSC_VER
 void Util::LogMemoryInfo()
 {
@@ -588,11 +595,27 @@ void Util::LogMemoryInfo()
 	}
 	LOG(_T("} ENDINFO"));
 }
+size_t Util::GetProcessMemory()
+{
+	std::ifstream proc("/proc/self/status");
+	if (!proc.is_open())
+		return 0;
+	String s;
+	while (std::getline(proc, s), !proc.fail()) {
+		if (s.substr(0, 6) == "VmRSS:")
+			return (size_t)String::FromString<uint64_t>(s.substr(6), 0)*1024;
+	}
+	return 0;
+}
 #endif // _MSC_VER
 #else // _PLATFORM_X86
 void Util::LogMemoryInfo()
 {
 }
+size_t Util::GetProcessMemory()
+{
+	return 0;
+}
 #endif // _PLATFORM_X86
 
 
@@ -710,6 +710,8 @@ public:
 
 	static void		LogBuild();
 	static void		LogMemoryInfo();
+	// get the memory currently used by this process (resident set size, in bytes; 0 if not available)
+	static size_t	GetProcessMemory();
 
 	struct MemoryInfo {
 		size_t totalPhysical;
@@ -92,6 +92,17 @@ HRESULT CImage::ReadHeader()
 } // ReadHeader
 /*----------------------------------------------------------------*/
 
+// hint the decoder, after reading the header, that the image is going to be down-scaled to the given size;
+// formats supporting it decode directly a smaller image, but at least as large as the given size;
+// return the size of the image decoded by ReadData() and true if it is smaller than the image size
+bool CImage::SetDecodeHint(Size& width, Size& height)
+{
+	width = m_width;
+	height = m_height;
+	return false;
+} // SetDecodeHint
+/*----------------------------------------------------------------*/
+
 HRESULT CImage::ReadData(void* pData, PIXELFORMAT dataFormat, Size nStride, Size lineWidth)
 {
 	// read data
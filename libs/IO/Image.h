@@ -70,6 +70,7 @@ public:
 	virtual void		Close();
 
 	virtual HRESULT		ReadHeader();
+	virtual bool		SetDecodeHint(Size& width, Size& height);
 	virtual HRESULT		ReadData(void*, PIXELFORMAT, Size nStride, Size lineWidth);
 
 	virtual HRESULT		WriteHeader(PIXELFORMAT, Size width, Size height, BYTE numLevels);
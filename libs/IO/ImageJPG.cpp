@@ -181,6 +181,34 @@ HRESULT CImageJPG::ReadHeader()
 } // ReadHeader
 /*----------------------------------------------------------------*/
 
+// use the DCT scaling of libjpeg to decode directly at 1/2, 1/4 or 1/8 of the image size,
+// choosing the smallest scale still at least as large as the requested size
+bool CImageJPG::SetDecodeHint(Size& width, Size& height)
+{
+	JpegState* state = (JpegState*)m_state;
+	if (state == NULL || m_width == 0 || m_height == 0 || width == 0 || height == 0)
+		return CImage::SetDecodeHint(width, height);
+	unsigned denom(1);
+	while (denom < 8 && (m_width+denom*2-1)/(denom*2) >= width && (m_height+denom*2-1)/(denom*2) >= height)
+		denom *= 2;
+	if (setjmp(state->jerr.setjmp_buffer) == 0) {
+		state->cinfo.scale_num = 1;
+		state->cinfo.scale_denom = denom;
+		jpeg_calc_output_dimensions(&state->cinfo);
+		m_dataWidth = width = state->cinfo.output_width;
+		m_dataHeight = height = state->cinfo.output_height;
+		m_lineWidth = m_dataWidth * m_stride;
+		return denom > 1;
+	}
+	// decode at full size
+	state->cinfo.scale_denom = 1;
+	m_dataWidth = width = m_width;
+	m_dataHeight = height = m_height;
+	m_lineWidth = m_dataWidth * m_stride;
+	return false;
+} // SetDecodeHint
+/*----------------------------------------------------------------*/
+
 HRESULT CImageJPG::ReadData(void* pData, PIXELFORMAT dataFormat, Size nStride, Size lineWidth)
 {
 	JpegState* state = (JpegState*)m_state;
@@ -199,16 +227,16 @@ HRESULT CImageJPG::ReadData(void* pData, PIXELFORMAT dataFormat, Size nStride, S
 				// read image directly to the data buffer
 				JSAMPLE* buffer[1] = {(JSAMPLE*)pData};
 				uint8_t*& data = (uint8_t*&)buffer[0];
-				for (Size j=0; j<m_height; ++j, data+=lineWidth)
+				for (Size j=0; j<m_dataHeight; ++j, data+=lineWidth)
 					jpeg_read_scanlines(cinfo, buffer, 1);
 			} else {
 				// read image to a buffer and convert it
 				JSAMPARRAY buffer = (*cinfo->mem->alloc_sarray)((j_common_ptr)cinfo, JPOOL_IMAGE, m_lineWidth, 1);
 				uint8_t* dst = (uint8_t*)pData;
 				uint8_t* src = (uint8_t*)buffer[0];
-				for (Size j=0; j<m_height; ++j, dst+=lineWidth) {
+				for (Size j=0; j<m_dataHeight; ++j, dst+=lineWidth) {
 					jpeg_read_scanlines(cinfo, buffer, 1);
-					if (!FilterFormat(dst, dataFormat, nStride, src, m_format, m_stride, m_width))
+					if (!FilterFormat(dst, dataFormat, nStride, src, m_format, m_stride, m_dataWidth))
 						return _FAIL;
 				}
 			}
@@ -30,6 +30,7 @@ public:
 	void		Close();
 
 	HRESULT		ReadHeader();
+	bool		SetDecodeHint(Size& width, Size& height);
 	HRESULT		ReadData(void*, PIXELFORMAT, Size nStride, Size lineWidth);
 	HRESULT		WriteHeader(PIXELFORMAT, Size width, Size height, BYTE numLevels);
 	HRESULT		WriteData(void*, PIXELFORMAT, Size nStride, Size lineWidth);
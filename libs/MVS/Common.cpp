@@ -35,6 +35,7 @@
 
 #include "Common.h"
 #include "Mesh.h"
+#include "Image.h"
 
 using namespace MVS;
 
@@ -64,7 +65,8 @@ void MVS::Initialize(LPCTSTR appname, unsigned nMaxThreads, int nProcessPriority
 
 void MVS::Finalize() {
 	#if TD_VERBOSE != TD_VERBOSE_OFF
-	// print memory statistics
+	// print image cache and memory statistics
+	ImageCache::PrintStatistics();
 	Util::LogMemoryInfo();
 	#endif
 
@@ -37,74 +37,151 @@ using namespace MVS;
 
 // S T R U C T S ///////////////////////////////////////////////////
 
-DMapCache::DMapCache(DepthDataArr& _arrDepthData, unsigned _loadFlags, size_t _max_memory_bytes)
+DMapCache::DMapCache(DepthDataArr& _arrDepthData, unsigned _loadFlags, size_t _max_memory_bytes, bool _bMapFiles)
 	:
-	loadFlags(_loadFlags), arrDepthData(_arrDepthData),
+	loadFlags(_loadFlags), bMapFiles(_bMapFiles), arrDepthData(_arrDepthData),
 	maxMemory(_max_memory_bytes), disabledMaxMemory(0), usedMemory(0),
-	skipMemoryCheckIdxImage(NO_ID), numImageRead(0)
+	imageMemory(_arrDepthData.size()),
+	imagePinned(_arrDepthData.size()),
+	imageLoading(_arrDepthData.size()), bStopPrefetch(false),
+	numImageRead(0), numImageHit(0), numImagePrefetch(0), numBytesRead(0)
 {
+	imageMemory.Memset(0);
+	imagePinned.Memset(0);
+	imageLoading.Memset(0);
+}
+DMapCache::~DMapCache() {
+	if (threadPrefetch.joinable()) {
+		{
+			std::lock_guard<std::mutex> guard(mutex);
+			bStopPrefetch = true;
+		}
+		conditionPrefetch.notify_one();
+		threadPrefetch.join();
+	}
 }
 
 void DMapCache::SetMaxMemory(size_t max_memory_bytes) {
+	std::lock_guard<std::mutex> guard(mutex);
 	maxMemory = max_memory_bytes;
-	ASSERT(skipMemoryCheckIdxImage == NO_ID);
 	Eject();
 }
 
-bool DMapCache::UseImage(IIndex idxImage) const {
-	ASSERT(idxImage < arrDepthData.size());
+void DMapCache::DisableMemoryCheck() {
+	std::lock_guard<std::mutex> guard(mutex);
+	disabledMaxMemory = maxMemory;
+	maxMemory = 0;
+}
+void DMapCache::EnableMemoryCheck() {
 	std::lock_guard<std::mutex> guard(mutex);
+	if (disabledMaxMemory) {
+		maxMemory = disabledMaxMemory;
+		disabledMaxMemory = 0;
+		Eject();
+	}
+}
+
+bool DMapCache::UseImage(IIndex idxImage, bool bPin) const {
+	ASSERT(idxImage < arrDepthData.size());
+	std::unique_lock<std::mutex> lock(mutex);
 	ASSERT(arrDepthData[idxImage].IsValid());
+	if (bPin)
+		imagePinned[idxImage] = true;
+	// wait if the image is just being loaded (ex. by the prefetch thread)
+	conditionLoaded.wait(lock, [&]() { return !imageLoading[idxImage]; });
 	if (!arrDepthData[idxImage].IsEmpty()) {
+		++numImageHit;
 		fifo.Put(idxImage);
+		if (arrDepthData[idxImage].IsMapped()) {
+			// the resident part of the mapped file grows as it is accessed
+			UpdateImageMemory(idxImage);
+			Eject();
+		}
 		return false;
 	}
-	mutex.unlock();
+	imageLoading[idxImage] = true;
+	lock.unlock();
 	const String fileName(ComposeDepthFilePath(arrDepthData[idxImage].GetView().GetID(), "dmap"));
 	while (!std::filesystem::is_regular_file(static_cast<const std::string&>(fileName)))
 		std::this_thread::sleep_for(std::chrono::milliseconds(100));
-	arrDepthData[idxImage].Load(fileName, loadFlags);
-	ASSERT(!arrDepthData[idxImage].IsEmpty());
-	mutex.lock();
+	LoadImage(idxImage, fileName);
+	lock.lock();
+	AddImage(idxImage);
 	++numImageRead;
-	usedMemory += arrDepthData[idxImage].GetMemorySize();
-	fifo.Put(idxImage);
 	Eject();
 	return true;
 }
 
+void DMapCache::UnpinImages() {
+	std::lock_guard<std::mutex> guard(mutex);
+	imagePinned.Memset(0);
+}
+
+// load asynchronously the given images (ordered by decreasing priority),
+// while they fit in the memory budget, replacing the previous plan;
+// the images already in cache are ignored
+void DMapCache::Prefetch(const IIndexArr& idxImages) {
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+		prefetchQueue.clear();
+		for (IIndex idxImage: idxImages)
+			if (arrDepthData[idxImage].IsValid() && arrDepthData[idxImage].IsEmpty() && !imageLoading[idxImage] && !imagePinned[idxImage])
+				prefetchQueue.push_back(idxImage);
+		if (prefetchQueue.empty())
+			return;
+	}
+	if (!threadPrefetch.joinable())
+		threadPrefetch = std::thread(&DMapCache::ThreadPrefetch, this);
+	conditionPrefetch.notify_one();
+}
+
+// cancel the pending prefetch requests and wait for the ongoing one to finish
+void DMapCache::StopPrefetch() {
+	std::unique_lock<std::mutex> lock(mutex);
+	prefetchQueue.clear();
+	conditionLoaded.wait(lock, [&]() { return std::find(imageLoading.begin(), imageLoading.end(), true) == imageLoading.end(); });
+}
+
 IIndexArr DMapCache::GetCachedImageIndices(bool ordered) const {
 	std::lock_guard<std::mutex> guard(mutex);
 	IIndexArr cachedImageIndices;
 	FOREACH(idxImage, arrDepthData)
-		if (!arrDepthData[idxImage].IsEmpty())
+		if (!imageLoading[idxImage] && !arrDepthData[idxImage].IsEmpty())
 			cachedImageIndices.push_back(idxImage);
 	if (ordered)
 		cachedImageIndices.Sort();
 	return cachedImageIndices;
 }
 
+bool DMapCache::IsEmpty() const {
+	std::lock_guard<std::mutex> guard(mutex);
+	return IsEmptyUnlocked();
+}
+
 bool DMapCache::IsImageCached(IIndex idxImage) const {
+	std::lock_guard<std::mutex> guard(mutex);
 	return fifo.Contains(idxImage);
 }
 
 void DMapCache::ClearCache() {
+	StopPrefetch();
 	std::lock_guard<std::mutex> guard(mutex);
-	skipMemoryCheckIdxImage = NO_ID;
-	while (!IsEmpty())
+	imagePinned.Memset(0);
+	while (!IsEmptyUnlocked())
 		EjectOldest();
 }
 
 size_t DMapCache::ComputeUsedMemory() const {
 	std::lock_guard<std::mutex> guard(mutex);
 	size_t computedUsedMemory = 0;
-	for (const auto& depthData : arrDepthData)
-		if (!depthData.IsEmpty())
-			computedUsedMemory += depthData.GetMemorySize();
+	FOREACH(idxImage, arrDepthData)
+		if (!imageLoading[idxImage] && !arrDepthData[idxImage].IsEmpty())
+			computedUsedMemory += imageMemory[idxImage];
 	ASSERT(computedUsedMemory == usedMemory);
 	return computedUsedMemory;
 }
 
+// eject images till the memory used fits the budget (called holding the lock)
 bool DMapCache::Eject() const {
 	if (maxMemory == 0)
 		return true;
@@ -115,14 +192,93 @@ bool DMapCache::Eject() const {
 	return true;
 }
 
+// eject the least recently used image that is not pinned (called holding the lock)
 bool DMapCache::EjectOldest() const {
-	ASSERT(!fifo.IsEmpty());
-	if (fifo.Back() == skipMemoryCheckIdxImage)
+	ASSERT(!IsEmptyUnlocked());
+	const std::list<IIndex>& cachedImages = fifo.GetCachedValues();
+	const auto it = std::find_if(cachedImages.rbegin(), cachedImages.rend(), [&](IIndex idxImage) { return !imagePinned[idxImage]; });
+	if (it == cachedImages.rend())
 		return false;
-	const IIndex idxImage = fifo.Pop();
-	usedMemory -= arrDepthData[idxImage].GetMemorySize();
+	const IIndex idxImage = *it;
+	fifo.Remove(idxImage);
+	usedMemory -= imageMemory[idxImage];
+	imageMemory[idxImage] = 0;
 	// release the depth-data; no need to save the depth-data to disk as it is already saved
 	arrDepthData[idxImage].Release();
 	return true;
 }
+
+// load the depth-data of the given image from disk (called without holding the lock)
+void DMapCache::LoadImage(IIndex idxImage, const String& fileName) const {
+	ASSERT(imageLoading[idxImage]);
+	if (bMapFiles)
+		arrDepthData[idxImage].Map(fileName, loadFlags);
+	else
+		arrDepthData[idxImage].Load(fileName, loadFlags);
+	ASSERT(!arrDepthData[idxImage].IsEmpty());
+}
+
+// register the just loaded image in cache (called holding the lock)
+void DMapCache::AddImage(IIndex idxImage) const {
+	ASSERT(imageLoading[idxImage]);
+	imageLoading[idxImage] = false;
+	imageMemory[idxImage] = arrDepthData[idxImage].GetMemorySize();
+	usedMemory += imageMemory[idxImage];
+	numBytesRead += imageMemory[idxImage];
+	fifo.Put(idxImage);
+	conditionLoaded.notify_all();
+}
+
+// estimate the memory needed by the given image once loaded
+size_t DMapCache::EstimateImageMemory(IIndex idxImage) const {
+	size_t bytesPerPixel(0);
+	if ((loadFlags & HeaderDepthDataRaw::HAS_DEPTH) != 0)
+		bytesPerPixel += sizeof(Depth);
+	if ((loadFlags & HeaderDepthDataRaw::HAS_NORMAL) != 0)
+		bytesPerPixel += sizeof(Normal);
+	if ((loadFlags & HeaderDepthDataRaw::HAS_CONF) != 0)
+		bytesPerPixel += sizeof(float);
+	if ((loadFlags & HeaderDepthDataRaw::HAS_VIEWS) != 0)
+		bytesPerPixel += sizeof(ViewsID);
+	return (size_t)arrDepthData[idxImage].size.area() * bytesPerPixel;
+}
+
+// load in background the images requested for prefetch,
+// stopping when the memory budget would be exceeded
+void DMapCache::ThreadPrefetch() {
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		conditionPrefetch.wait(lock, [&]() { return bStopPrefetch || !prefetchQueue.empty(); });
+		if (bStopPrefetch)
+			break;
+		const IIndex idxImage(prefetchQueue.front());
+		prefetchQueue.pop_front();
+		if (imageLoading[idxImage] || imagePinned[idxImage] || !arrDepthData[idxImage].IsEmpty())
+			continue;
+		if (maxMemory != 0 && usedMemory + EstimateImageMemory(idxImage) > maxMemory) {
+			// no more room; do not eject images to make room for the prefetched ones
+			prefetchQueue.clear();
+			continue;
+		}
+		const String fileName(ComposeDepthFilePath(arrDepthData[idxImage].GetView().GetID(), "dmap"));
+		if (!File::access(fileName))
+			continue;
+		imageLoading[idxImage] = true;
+		lock.unlock();
+		LoadImage(idxImage, fileName);
+		if (arrDepthData[idxImage].IsMapped())
+			arrDepthData[idxImage].mappedFile->prefetch();
+		lock.lock();
+		AddImage(idxImage);
+		++numImagePrefetch;
+	}
+}
+
+void DMapCache::UpdateImageMemory(IIndex idxImage) const {
+	const size_t memorySize(arrDepthData[idxImage].GetMemorySize());
+	if (memorySize > imageMemory[idxImage])
+		numBytesRead += memorySize - imageMemory[idxImage];
+	usedMemory = usedMemory - imageMemory[idxImage] + memorySize;
+	imageMemory[idxImage] = memorySize;
+}
 /*----------------------------------------------------------------*/
@@ -45,26 +45,37 @@
 namespace MVS {
 
 // Caches depth-maps to disk.
+// The depth-maps are either read in memory, or mapped directly from the files,
+// in which case the OS page cache acts as a second tier and the memory usage
+// is estimated as the size of the pages currently resident in physical memory.
+// The depth-maps about to be used can be prefetched by a background thread,
+// while the ones currently in use are pinned in the cache.
 class DMapCache {
 public:
-	explicit DMapCache(DepthDataArr& arrDepthData, unsigned loadFlags, size_t max_memory_bytes);
+	explicit DMapCache(DepthDataArr& arrDepthData, unsigned loadFlags, size_t max_memory_bytes, bool bMapFiles=false);
+	~DMapCache();
 
 	// check if the list is empty
-	bool IsEmpty() const { ASSERT((usedMemory == 0) == fifo.IsEmpty()); return fifo.IsEmpty(); }
+	bool IsEmpty() const;
 
 	// set the maximum memory usage (in bytes)
 	void SetMaxMemory(size_t max_memory_bytes = 0/*unlimited*/);
 
 	// enable/disable memory usage
-	void DisableMemoryCheck() { disabledMaxMemory = maxMemory; maxMemory = 0; }
-	void EnableMemoryCheck() { if (disabledMaxMemory) { maxMemory = disabledMaxMemory; disabledMaxMemory = 0; Eject(); } }
+	void DisableMemoryCheck();
+	void EnableMemoryCheck();
 
-	// skip memory check if this image index is to be ejected
-	void SkipMemoryCheckIdxImage(IIndex idxImage = NO_ID) { skipMemoryCheckIdxImage = idxImage; }
-
-	// ensure the depth-data is loaded and mark it as recently used:
+	// ensure the depth-data is loaded and mark it as recently used,
+	// optionally pinning it in cache till UnpinImages() is called:
 	// return true if the image was loaded from disk
-	bool UseImage(IIndex idxImage) const;
+	bool UseImage(IIndex idxImage, bool bPin=false) const;
+	// allow all pinned images to be ejected
+	void UnpinImages();
+
+	// load asynchronously the given images, in order, while they fit in the memory budget
+	void Prefetch(const IIndexArr& idxImages);
+	// cancel pending prefetch requests and wait for the ongoing one to finish
+	void StopPrefetch();
 
 	// get the image indices loaded in cache.
 	IIndexArr GetCachedImageIndices(bool ordered = false) const;
@@ -74,6 +85,12 @@ public:
 
 	// get the number of times images were read from disk
 	uint32_t GetNumImageReads() const { return numImageRead; }
+	// get the number of times images were found in cache
+	uint32_t GetNumImageHits() const { return numImageHit; }
+	// get the number of images loaded in advance by the prefetch thread
+	uint32_t GetNumImagePrefetches() const { return numImagePrefetch; }
+	// get the number of bytes read from disk (estimated for mapped files)
+	size_t GetNumBytesRead() const { return numBytesRead; }
 
 	// eject all images from the cache
 	void ClearCache();
@@ -83,21 +100,35 @@ public:
 	size_t ComputeUsedMemory() const;
 
 private:
+	// check if the list is empty (called holding the lock)
+	bool IsEmptyUnlocked() const { ASSERT(usedMemory == 0 || !fifo.IsEmpty()); return fifo.IsEmpty(); }
 	// eject the least recently used images if the cache size is above max-limit
 	bool Eject() const;
 	// eject the least recently used image
 	bool EjectOldest() const;
+	// update the memory used by the given mapped image
+	void UpdateImageMemory(IIndex idxImage) const;
+	// load the given image and add it to the cache
+	void LoadImage(IIndex idxImage, const String& fileName) const;
+	void AddImage(IIndex idxImage) const;
+	// estimate the memory used by the given image once loaded
+	size_t EstimateImageMemory(IIndex idxImage) const;
+	// background thread loading the prefetch requests
+	void ThreadPrefetch();
 
 private:
 	unsigned loadFlags;
+	bool bMapFiles;
 	DepthDataArr& arrDepthData;
 
 	// maximum and used memory (in bytes)
 	size_t maxMemory, disabledMaxMemory;
 	mutable size_t usedMemory;
+	// memory used by each cached image (in bytes)
+	mutable CLISTDEF0IDX(size_t,IIndex) imageMemory;
 
-	// index of the image to skip memory check
-	IIndex skipMemoryCheckIdxImage;
+	// mark images that can not be ejected (the ones currently in use)
+	mutable CLISTDEF0IDX(bool,IIndex) imagePinned;
 
 	// guard access to variables that are dynamically loaded from disk
 	mutable std::mutex mutex;
@@ -105,8 +136,21 @@ private:
 	// track which images are last accessed
 	mutable ListFIFO<IIndex> fifo;
 
-	// number of times images were read from disk (debug only)
+	// mark images being loaded (waited on using conditionLoaded)
+	mutable CLISTDEF0IDX(bool,IIndex) imageLoading;
+	mutable std::condition_variable conditionLoaded;
+
+	// images to be loaded in advance, and the thread loading them
+	std::deque<IIndex> prefetchQueue;
+	std::condition_variable conditionPrefetch;
+	std::thread threadPrefetch;
+	bool bStopPrefetch;
+
+	// number of times images were read from disk or found in cache, and the bytes read
 	mutable uint32_t numImageRead;
+	mutable uint32_t numImageHit;
+	uint32_t numImagePrefetch;
+	mutable size_t numBytesRead;
 };
 /*----------------------------------------------------------------*/
 
@@ -41,6 +41,10 @@
 #include <CGAL/Simple_cartesian.h>
 #include <CGAL/property_map.h>
 #include <CGAL/pca_estimate_normals.h>
+#ifdef _USE_SSE
+// SIMD: patch sampling
+#include <immintrin.h>
+#endif
 
 using namespace MVS;
 
@@ -52,6 +56,16 @@ using namespace MVS;
 #define DEPTHMAP_USE_OPENMP
 #endif
 
+#ifdef _USE_SSE
+// enable AVX code generation only for the functions using it;
+// the AVX code path is selected at run-time only if supported by the CPU
+#if defined(__GNUC__) && !defined(__AVX__)
+#define DENSE_TARGET_AVX __attribute__((target("avx")))
+#else
+#define DENSE_TARGET_AVX
+#endif
+#endif
+
 #define DEFVAR_OPTDENSE_string(name, title, desc, ...)  DEFVAR_string(OPTDENSE, name, title, desc, __VA_ARGS__)
 #define DEFVAR_OPTDENSE_bool(name, title, desc, ...)    DEFVAR_bool(OPTDENSE, name, title, desc, __VA_ARGS__)
 #define DEFVAR_OPTDENSE_int32(name, title, desc, ...)   DEFVAR_int32(OPTDENSE, name, title, desc, __VA_ARGS__)
@@ -79,6 +93,8 @@ DEFVAR_OPTDENSE_uint32(nMinViews, "Min Views", "minimum number of agreeing views
 MDEFVAR_OPTDENSE_uint32(nMaxViews, "Max Views", "maximum number of neighbor images used to compute the depth-map for the reference image", "12")
 DEFVAR_OPTDENSE_uint32(nMinViewsFuse, "Min Views Fuse", "minimum number of images that agrees with an estimate during fusion in order to consider it inlier", "2")
 MDEFVAR_OPTDENSE_uint32(nMaxViewsFuse, "Max Views Fuse", "maximum number of neighbor depth-maps used during fusion", "32")
+MDEFVAR_OPTDENSE_uint32(nFusePrefetch, "Fuse Prefetch", "number of depth-maps to be fused next loaded in advance, together with their neighbors, during fusion (0 - disabled)", "2")
+MDEFVAR_OPTDENSE_bool(bFuseParallel, "Fuse Parallel", "fuse concurrently bands of rows of each depth-map (faster, but the points order is not deterministic)", "0")
 DEFVAR_OPTDENSE_uint32(nMinViewsFilter, "Min Views Filter", "minimum number of images that agrees with an estimate in order to consider it inlier", "1")
 MDEFVAR_OPTDENSE_uint32(nMinViewsFilterAdjust, "Min Views Filter Adjust", "minimum number of images that agrees with an estimate in order to consider it inlier (0 - disabled)", "1")
 MDEFVAR_OPTDENSE_uint32(nMinViewsTrustPoint, "Min Views Trust Point", "min-number of views so that the point is considered for approximating the depth-maps (<2 - random initialization)", "2")
@@ -90,6 +106,8 @@ MDEFVAR_OPTDENSE_uint32(nPointInsideROI, "Point Inside ROI", "consider a point s
 MDEFVAR_OPTDENSE_bool(bAddCorners, "Add Corners", "add support points at image corners with nearest neighbor disparities", "0")
 MDEFVAR_OPTDENSE_bool(bInitSparse, "Init Sparse", "init depth-map only with the sparse points (no interpolation)", "1")
 MDEFVAR_OPTDENSE_bool(bRemoveDmaps, "Remove Dmaps", "remove depth-maps after fusion", "0")
+MDEFVAR_OPTDENSE_bool(bMapDmaps, "Map Dmaps", "map the depth-maps files in memory during fusion instead of reading them (raw format only)", "0")
+MDEFVAR_OPTDENSE_uint32(nDepthMapFormat, "Depth Map Format", "format used to store the depth-maps (0 - raw, 1 - tiled lossless, 2 - tiled compact)", "0")
 MDEFVAR_OPTDENSE_float(fViewMinScore, "View Min Score", "Min score to consider a neighbor images (0 - disabled)", "2.0")
 MDEFVAR_OPTDENSE_float(fViewMinScoreRatio, "View Min Score Ratio", "Min score ratio to consider a neighbor images", "0.03")
 MDEFVAR_OPTDENSE_float(fMinArea, "Min Area", "Min shared area for accepting the depth triangulation", "0.05")
@@ -113,6 +131,7 @@ MDEFVAR_OPTDENSE_uint32(nEstimateNormals, "Estimate Normals", "should we estimat
 MDEFVAR_OPTDENSE_float(fNCCThresholdKeep, "NCC Threshold Keep", "Maximum 1-NCC score accepted for a match", "0.9", "0.5")
 DEFVAR_OPTDENSE_uint32(nEstimationIters, "Estimation Iters", "Number of patch-match iterations", "3")
 DEFVAR_OPTDENSE_uint32(nEstimationGeometricIters, "Estimation Geometric Iters", "Number of geometric consistent patch-match iterations (0 - disabled)", "2")
+MDEFVAR_OPTDENSE_uint32(nConcurrentImages, "Concurrent Images", "Number of depth-maps estimated concurrently, useful for low resolution images (0 - auto, 1 - disabled)", "1")
 MDEFVAR_OPTDENSE_float(fEstimationGeometricWeight, "Estimation Geometric Weight", "pairwise geometric consistency cost weight", "0.1")
 MDEFVAR_OPTDENSE_uint32(nRandomIters, "Random Iters", "Number of iterations for random assignment per pixel", "6")
 MDEFVAR_OPTDENSE_uint32(nRandomMaxScale, "Random Max Scale", "Maximum number of iterations to skip during random assignment", "2")
@@ -137,6 +156,8 @@ DepthData::DepthData(const DepthData& srcDepthData) :
 	depthMap(srcDepthData.depthMap),
 	normalMap(srcDepthData.normalMap),
 	confMap(srcDepthData.confMap),
+	viewsMap(srcDepthData.viewsMap),
+	mappedFile(srcDepthData.mappedFile),
 	dMin(srcDepthData.dMin),
 	dMax(srcDepthData.dMax),
 	size(srcDepthData.size),
@@ -242,6 +263,14 @@ void DepthData::ApplyIgnoreMask(const BitMatrix& mask)
 /*----------------------------------------------------------------*/
 
 
+namespace {
+bool ImportDepthDataHeader(File& f, const String& fileName, String& imageFileName,
+	IIndexArr& IDs, cv::Size& imageSize,
+	KMatrix& K, RMatrix& R, CMatrix& C,
+	Depth& dMin, Depth& dMax,
+	HeaderDepthDataRaw& header);
+} // namespace
+
 bool DepthData::Save(const String& fileName) const
 {
 	ASSERT(IsValid() && !depthMap.empty() && !confMap.empty());
@@ -251,7 +280,9 @@ bool DepthData::Save(const String& fileName) const
 		for (const ViewData& image: images)
 			IDs.push_back(image.GetID());
 		const ViewData& image0 = GetView();
-		if (!ExportDepthDataRaw(fileNameTmp, image0.pImageData->name, IDs, depthMap.size(), image0.camera.K, image0.camera.R, image0.camera.C, dMin, dMax, depthMap, normalMap, confMap, viewsMap))
+		if (!(OPTDENSE::nDepthMapFormat == 0 ?
+			ExportDepthDataRaw(fileNameTmp, image0.pImageData->name, IDs, depthMap.size(), image0.camera.K, image0.camera.R, image0.camera.C, dMin, dMax, depthMap, normalMap, confMap, viewsMap) :
+			ExportDepthDataTiled(fileNameTmp, image0.pImageData->name, IDs, depthMap.size(), image0.camera.K, image0.camera.R, image0.camera.C, dMin, dMax, depthMap, normalMap, confMap, viewsMap, OPTDENSE::nDepthMapFormat > 1)))
 			return false;
 	}
 	if (!File::renameFile(fileNameTmp, fileName)) {
@@ -275,6 +306,62 @@ bool DepthData::Load(const String& fileName, unsigned flags)
 	ASSERT(depthMap.size() == size);
 	return true;
 }
+// map the depth-data file in memory instead of reading it:
+// the maps point directly to the file pages, which are loaded on demand by the OS
+// and are copy-on-write, so any change to the maps is not saved to the file;
+// if the file can not be mapped (ex. tiled format), it is loaded instead
+bool DepthData::Map(const String& fileName, unsigned flags)
+{
+	String imageFileName;
+	IIndexArr IDs;
+	cv::Size imageSize;
+	Camera camera;
+	HeaderDepthDataRaw header;
+	size_f_t offset; {
+		File f(fileName, File::READ, File::OPEN);
+		if (!f.isOpen()) {
+			DEBUG("error: opening file '%s' for reading depth-data", fileName.c_str());
+			return false;
+		}
+		if (!ImportDepthDataHeader(f, fileName, imageFileName, IDs, imageSize, camera.K, camera.R, camera.C, dMin, dMax, header))
+			return false;
+		offset = f.getPos();
+	}
+	// the maps can be used in place only if stored raw and properly aligned
+	if (header.name != HeaderDepthDataRaw::HeaderDepthDataRawName() || (offset % sizeof(float)) != 0)
+		return Load(fileName, flags);
+	std::shared_ptr<MappedFile> mapping(std::make_shared<MappedFile>(fileName));
+	const cv::Size sizeMap((int)header.depthWidth, (int)header.depthHeight);
+	const size_t area((size_t)sizeMap.area());
+	const size_t sizeData(area*(sizeof(float)+
+		((header.type & HeaderDepthDataRaw::HAS_NORMAL) != 0 ? sizeof(float)*3 : 0)+
+		((header.type & HeaderDepthDataRaw::HAS_CONF) != 0 ? sizeof(float) : 0)+
+		((header.type & HeaderDepthDataRaw::HAS_VIEWS) != 0 ? sizeof(uint8_t)*4 : 0)));
+	if (!mapping->isOpen() || mapping->getSize() < offset+sizeData)
+		return Load(fileName, flags);
+	uint8_t* data(mapping->getData()+offset);
+	if ((flags & HeaderDepthDataRaw::HAS_DEPTH) != 0)
+		depthMap = DepthMap(sizeMap, reinterpret_cast<Depth*>(data));
+	data += area*sizeof(float);
+	if ((header.type & HeaderDepthDataRaw::HAS_NORMAL) != 0) {
+		if ((flags & HeaderDepthDataRaw::HAS_NORMAL) != 0)
+			normalMap = NormalMap(sizeMap, reinterpret_cast<Normal*>(data));
+		data += area*sizeof(float)*3;
+	}
+	if ((header.type & HeaderDepthDataRaw::HAS_CONF) != 0) {
+		if ((flags & HeaderDepthDataRaw::HAS_CONF) != 0)
+			confMap = ConfidenceMap(sizeMap, reinterpret_cast<float*>(data));
+		data += area*sizeof(float);
+	}
+	if ((header.type & HeaderDepthDataRaw::HAS_VIEWS) != 0) {
+		if ((flags & HeaderDepthDataRaw::HAS_VIEWS) != 0)
+			viewsMap = ViewsMap(sizeMap, reinterpret_cast<ViewsID*>(data));
+	}
+	mappedFile = std::move(mapping);
+	ASSERT(!IDs.empty() && (!IsValid() || IDs.front() == GetView().GetID()));
+	ASSERT(depthMap.size() == size);
+	return true;
+}
 /*----------------------------------------------------------------*/
 
 
@@ -302,11 +389,14 @@ unsigned DepthData::DecRef()
 /*----------------------------------------------------------------*/
 
 
-// Compute the memory size occupied by the depth-data images (in bytes)
+// Compute the memory size occupied by the depth-data images (in bytes);
+// for mapped depth-data, only the pages currently in physical memory are counted
 size_t MVS::DepthData::GetMemorySize() const
 {
 	if (IsEmpty())
 		return 0;
+	if (IsMapped())
+		return mappedFile->getResidentSize();
 	size_t nBytes = depthMap.memory_size();
 	if (!normalMap.empty())
 		nBytes += normalMap.memory_size();
@@ -407,10 +497,14 @@ DepthEstimator::DepthEstimator(
 	neighborsClose(0,4),
 	#endif
 	scores(_depthData0.images.size()-1),
+	scoresGeometric(_depthData0.images.size()-1),
+	scoresBound(_depthData0.images.size()-1),
+	viewsOrder(_depthData0.images.size()-1),
 	depthMap0(_depthData0.depthMap), normalMap0(_depthData0.normalMap), confMap0(_depthData0.confMap),
 	#if DENSE_NCC == DENSE_NCC_WEIGHTED
 	weightMap0(_weightMap0),
 	#endif
+	thConfKeep(OPTDENSE::fNCCThresholdKeep),
 	nIteration(nIter),
 	images(_depthData0.images.begin()+1, _depthData0.images.end()), image0(_depthData0.images[0]),
 	#if DENSE_NCC != DENSE_NCC_WEIGHTED
@@ -492,64 +586,161 @@ bool DepthEstimator::FillPixelPatch()
 	return true;
 }
 
-// compute pixel's NCC score in the given target image
-float DepthEstimator::ScorePixelImage(const DepthData::ViewData& image1, Depth depth, const Normal& normal)
+namespace {
+// texel coordinates (in patch steps) relative to the top-left texel of the patch,
+// padded with the bottom-right texel up to a multiple of the SIMD vector size
+struct PatchTexelOffsets {
+	ALIGN(32) float x[DepthEstimator::nTexelsSIMD];
+	ALIGN(32) float y[DepthEstimator::nTexelsSIMD];
+	PatchTexelOffsets() {
+		for (int n=0; n<DepthEstimator::nTexelsSIMD; ++n) {
+			const int t(MINF(n, (int)DepthEstimator::nTexels-1));
+			x[n] = float(t%DepthEstimator::nTexelsSide);
+			y[n] = float(t/DepthEstimator::nTexelsSide);
+		}
+	}
+};
+const PatchTexelOffsets patchTexelOffsets;
+
+// sample the patch texels in the given image, all known to be inside the image;
+// X is the projection of the top-left texel, and dX and dY the projection increments
+// between two neighbor texels on the same row and column
+inline void SamplePatchTexels(const Image32F& image, const Point3f& X, const Point3f& dX, const Point3f& dY, float* texels)
 {
-	// center a patch of given size on the segment and fetch the pixel values in the target image
-	Matrix3x3f H(ComputeHomographyMatrix(image1, depth, normal));
+	for (int n=0; n<DepthEstimator::nTexels; ++n) {
+		const float ox(patchTexelOffsets.x[n]), oy(patchTexelOffsets.y[n]);
+		const Point2f pt(Point3f(X.x+(ox*dX.x+oy*dY.x), X.y+(ox*dX.y+oy*dY.y), X.z+(ox*dX.z+oy*dY.z)));
+		texels[n] = image.sample(pt);
+	}
+}
+#ifdef _USE_SSE
+// same as above, projecting and interpolating 4 texels at once
+inline void SamplePatchTexelsSSE(const Image32F& image, const Point3f& X, const Point3f& dX, const Point3f& dY, float* texels)
+{
+	const __m128 bx(_mm_set1_ps(X.x)), by(_mm_set1_ps(X.y)), bz(_mm_set1_ps(X.z));
+	const __m128 dxx(_mm_set1_ps(dX.x)), dxy(_mm_set1_ps(dX.y)), dxz(_mm_set1_ps(dX.z));
+	const __m128 dyx(_mm_set1_ps(dY.x)), dyy(_mm_set1_ps(dY.y)), dyz(_mm_set1_ps(dY.z));
+	const __m128 one(_mm_set1_ps(1.f));
+	ALIGN(16) int lx[4], ly[4];
+	ALIGN(16) float v00[4], v01[4], v10[4], v11[4];
+	for (int n=0; n<DepthEstimator::nTexels; n+=4) {
+		// project the texels
+		const __m128 ox(_mm_load_ps(patchTexelOffsets.x+n)), oy(_mm_load_ps(patchTexelOffsets.y+n));
+		const __m128 z(_mm_add_ps(bz, _mm_add_ps(_mm_mul_ps(ox, dxz), _mm_mul_ps(oy, dyz))));
+		const __m128 px(_mm_div_ps(_mm_add_ps(bx, _mm_add_ps(_mm_mul_ps(ox, dxx), _mm_mul_ps(oy, dyx))), z));
+		const __m128 py(_mm_div_ps(_mm_add_ps(by, _mm_add_ps(_mm_mul_ps(ox, dxy), _mm_mul_ps(oy, dyy))), z));
+		// fetch the four neighbor pixels of each texel
+		const __m128i ix(_mm_cvttps_epi32(px)), iy(_mm_cvttps_epi32(py));
+		_mm_store_si128((__m128i*)lx, ix);
+		_mm_store_si128((__m128i*)ly, iy);
+		for (int k=0; k<4; ++k) {
+			const float* const p0(image.ptr<float>(ly[k])+lx[k]);
+			const float* const p1(image.ptr<float>(ly[k]+1)+lx[k]);
+			v00[k] = p0[0]; v01[k] = p0[1];
+			v10[k] = p1[0]; v11[k] = p1[1];
+		}
+		// bilinear interpolation
+		const __m128 x(_mm_sub_ps(px, _mm_cvtepi32_ps(ix))), x1(_mm_sub_ps(one, x));
+		const __m128 y(_mm_sub_ps(py, _mm_cvtepi32_ps(iy))), y1(_mm_sub_ps(one, y));
+		_mm_storeu_ps(texels+n, _mm_add_ps(
+			_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(v00), x1), _mm_mul_ps(_mm_load_ps(v01), x)), y1),
+			_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(v10), x1), _mm_mul_ps(_mm_load_ps(v11), x)), y)));
+	}
+}
+// same as above, projecting and interpolating 8 texels at once
+DENSE_TARGET_AVX void SamplePatchTexelsAVX(const Image32F& image, const Point3f& X, const Point3f& dX, const Point3f& dY, float* texels)
+{
+	const __m256 bx(_mm256_set1_ps(X.x)), by(_mm256_set1_ps(X.y)), bz(_mm256_set1_ps(X.z));
+	const __m256 dxx(_mm256_set1_ps(dX.x)), dxy(_mm256_set1_ps(dX.y)), dxz(_mm256_set1_ps(dX.z));
+	const __m256 dyx(_mm256_set1_ps(dY.x)), dyy(_mm256_set1_ps(dY.y)), dyz(_mm256_set1_ps(dY.z));
+	const __m256 one(_mm256_set1_ps(1.f));
+	ALIGN(32) int lx[8], ly[8];
+	ALIGN(32) float v00[8], v01[8], v10[8], v11[8];
+	for (int n=0; n<DepthEstimator::nTexels; n+=8) {
+		// project the texels
+		const __m256 ox(_mm256_load_ps(patchTexelOffsets.x+n)), oy(_mm256_load_ps(patchTexelOffsets.y+n));
+		const __m256 z(_mm256_add_ps(bz, _mm256_add_ps(_mm256_mul_ps(ox, dxz), _mm256_mul_ps(oy, dyz))));
+		const __m256 px(_mm256_div_ps(_mm256_add_ps(bx, _mm256_add_ps(_mm256_mul_ps(ox, dxx), _mm256_mul_ps(oy, dyx))), z));
+		const __m256 py(_mm256_div_ps(_mm256_add_ps(by, _mm256_add_ps(_mm256_mul_ps(ox, dxy), _mm256_mul_ps(oy, dyy))), z));
+		// fetch the four neighbor pixels of each texel
+		const __m256i ix(_mm256_cvttps_epi32(px)), iy(_mm256_cvttps_epi32(py));
+		_mm256_store_si256((__m256i*)lx, ix);
+		_mm256_store_si256((__m256i*)ly, iy);
+		for (int k=0; k<8; ++k) {
+			const float* const p0(image.ptr<float>(ly[k])+lx[k]);
+			const float* const p1(image.ptr<float>(ly[k]+1)+lx[k]);
+			v00[k] = p0[0]; v01[k] = p0[1];
+			v10[k] = p1[0]; v11[k] = p1[1];
+		}
+		// bilinear interpolation
+		const __m256 x(_mm256_sub_ps(px, _mm256_cvtepi32_ps(ix))), x1(_mm256_sub_ps(one, x));
+		const __m256 y(_mm256_sub_ps(py, _mm256_cvtepi32_ps(iy))), y1(_mm256_sub_ps(one, y));
+		_mm256_storeu_ps(texels+n, _mm256_add_ps(
+			_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_load_ps(v00), x1), _mm256_mul_ps(_mm256_load_ps(v01), x)), y1),
+			_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_load_ps(v10), x1), _mm256_mul_ps(_mm256_load_ps(v11), x)), y)));
+	}
+}
+#endif
+} // namespace
+
+// fetch the patch pixel values in the target image warped by the given homography;
+// the texels buffer must be able to store nTexelsSIMD values;
+// the patch is inside the image if all its corners are: the homography maps the patch
+// to a convex quadrilateral as long as all corners are in front of the camera,
+// so in this case the bounds are checked only once and the texels are sampled using SIMD,
+// otherwise each texel is checked separately
+bool DepthEstimator::SamplePatch(const Image32F& image, const Matrix3x3f& H, const ImageRef& x0, float* texels)
+{
+	Point3f X;
+	ProjectVertex_3x3_2_3(H.val, Point2f(float(x0.x-nSizeHalfWindow),float(x0.y-nSizeHalfWindow)).ptr(), X.ptr());
+	const Point3f dX(H[0]*float(nSizeStep), H[3]*float(nSizeStep), H[6]*float(nSizeStep));
+	const Point3f dY(H[1]*float(nSizeStep), H[4]*float(nSizeStep), H[7]*float(nSizeStep));
+	const float side(float(nTexelsSide-1));
+	const Point3f corners[4] = {X, X+dX*side, X+dY*side, X+(dX+dY)*side};
+	for (const Point3f& corner: corners)
+		if (corner.z <= 0)
+			return SamplePatchChecked(image, H, x0, texels);
+	for (const Point3f& corner: corners)
+		if (!image.isInsideWithBorder<float,1>(Point2f(corner)))
+			return false;
+	#ifdef _USE_SSE
+	if (SIMD_ENABLED.isSet(Util::AVX))
+		SamplePatchTexelsAVX(image, X, dX, dY, texels);
+	else if (SIMD_ENABLED.isSet(Util::SSE))
+		SamplePatchTexelsSSE(image, X, dX, dY, texels);
+	else
+	#endif
+	SamplePatchTexels(image, X, dX, dY, texels);
+	return true;
+}
+// same as above, but checking each texel separately
+bool DepthEstimator::SamplePatchChecked(const Image32F& image, const Matrix3x3f& H0, const ImageRef& x0, float* texels)
+{
+	Matrix3x3f H(H0);
 	Point3f X;
 	ProjectVertex_3x3_2_3(H.val, Point2f(float(x0.x-nSizeHalfWindow),float(x0.y-nSizeHalfWindow)).ptr(), X.ptr());
 	Point3f baseX(X);
 	H *= float(nSizeStep);
 	int n(0);
-	float sum(0);
-	#if DENSE_NCC != DENSE_NCC_DEFAULT
-	float sumSq(0), num(0);
-	#endif
-	#if DENSE_NCC == DENSE_NCC_WEIGHTED
-	const Weight& w = weightMap0[x0.y*image0.image.width()+x0.x];
-	#endif
 	for (int i=-nSizeHalfWindow; i<=nSizeHalfWindow; i+=nSizeStep) {
 		for (int j=-nSizeHalfWindow; j<=nSizeHalfWindow; j+=nSizeStep) {
 			const Point2f pt(X);
-			if (!image1.image.isInsideWithBorder<float,1>(pt))
-				return thRobust;
-			const float v(image1.image.sample(pt));
-			#if DENSE_NCC == DENSE_NCC_FAST
-			sum += v;
-			sumSq += SQUARE(v);
-			num += texels0(n++)*v;
-			#elif DENSE_NCC == DENSE_NCC_WEIGHTED
-			const Weight::Pixel& pw = w.weights[n++];
-			const float vw(v*pw.weight);
-			sum += vw;
-			sumSq += v*vw;
-			num += v*pw.tempWeight;
-			#else
-			sum += texels1(n++)=v;
-			#endif
+			if (!image.isInsideWithBorder<float,1>(pt))
+				return false;
+			texels[n++] = image.sample(pt);
 			X.x += H[0]; X.y += H[3]; X.z += H[6];
 		}
 		baseX.x += H[1]; baseX.y += H[4]; baseX.z += H[7];
 		X = baseX;
 	}
 	ASSERT(n == nTexels);
-	// score similarity of the reference and target texture patches
-	#if DENSE_NCC == DENSE_NCC_FAST
-	const float normSq1(sumSq-SQUARE(sum/nSizeWindow));
-	#elif DENSE_NCC == DENSE_NCC_WEIGHTED
-	const float normSq1(sumSq-SQUARE(sum)/w.sumWeights);
-	#else
-	const float normSq1(normSqDelta<float,float,nTexels>(texels1.data(), sum/(float)nTexels));
-	#endif
-	const float nrmSq(normSq0*normSq1);
-	if (nrmSq <=1e-16f)
-		return thRobust;
-	#if DENSE_NCC == DENSE_NCC_DEFAULT
-	const float num(texels0.dot(texels1));
-	#endif
-	const float ncc(CLAMP(num/SQRT(nrmSq), -1.f, 1.f));
-	float score(1.f-ncc);
+	return true;
+}
+
+// compute the score terms of the given estimate that do not depend on the view
+DepthEstimator::ScoreTerms DepthEstimator::ComputeScoreTerms(Depth depth, const Normal& normal) const
+{
+	ScoreTerms terms{1.f, 0.f, 0.f};
 	#if DENSE_SMOOTHNESS != DENSE_SMOOTHNESS_NA
 	// encourage smoothness
 	for (const NeighborEstimate& neighbor: neighborsClose) {
@@ -560,48 +751,132 @@ float DepthEstimator::ScorePixelImage(const DepthData::ViewData& image1, Depth d
 		const float factorDepth(DENSE_EXP(SQUARE((depth-neighbor.depth)/depth) * smoothSigmaDepth));
 		#endif
 		const float factorNormal(DENSE_EXP(SQUARE(ACOS(ComputeAngle(normal.ptr(), neighbor.normal.ptr()))) * smoothSigmaNormal));
-		score *= (1.f - smoothBonusDepth * factorDepth) * (1.f - smoothBonusNormal * factorNormal);
+		terms.smoothness *= (1.f - smoothBonusDepth * factorDepth) * (1.f - smoothBonusNormal * factorNormal);
 	}
 	#endif
-	if (!image1.depthMap.empty()) {
-		ASSERT(OPTDENSE::fEstimationGeometricWeight > 0);
-		float consistency(4.f);
-		const Point3f X1(image1.Tl*Point3f(float(X0.x)*depth,float(X0.y)*depth,depth)+image1.Tm); // Kj * Rj * (Ri.t() * X + Ci - Cj)
-		if (X1.z > 0) {
-			const Point2f x1(X1);
-			if (image1.depthMap.isInsideWithBorder<float,1>(x1)) {
-				Depth depth1;
-				if (image1.depthMap.sample(depth1, x1, [&X1](Depth d) { return IsDepthSimilar(X1.z, d, 0.03f); })) {
-					const Point2f xb(image1.Tr*Point3f(x1.x*depth1,x1.y*depth1,depth1)+image1.Tn); // Ki * Ri * (Rj.t() * Kj-1 * X + Cj - Ci)
-					const float dist(norm(Point2f(float(x0.x)-xb.x, float(x0.y)-xb.y)));
-					consistency = MINF(SQRT(dist*(dist+2.f)), consistency);
-				}
-			}
-		}
-		score += OPTDENSE::fEstimationGeometricWeight * consistency;
-	}
 	// apply depth prior weight based on patch textureless
 	if (!lowResDepthMap.empty()) {
 		const Depth d0 = lowResDepthMap(x0);
 		if (d0 > 0) {
 			const float deltaDepth(MINF(DepthSimilarity(d0, depth), 0.5f));
 			const float smoothSigmaDepth(-1.f / (1.f * 0.02f)); // 0.12: patch texture variance below 0.02 (0.12^2) is considered texture-less
-			const float factorDeltaDepth(DENSE_EXP(normSq0 * smoothSigmaDepth));
-			score = (1.f-factorDeltaDepth)*score + factorDeltaDepth*deltaDepth;
+			terms.priorWeight = DENSE_EXP(normSq0 * smoothSigmaDepth);
+			terms.priorScore = terms.priorWeight*deltaDepth;
+		}
+	}
+	return terms;
+}
+
+// compute pixel's geometric consistency score in the given target image
+float DepthEstimator::ScorePixelGeometric(const DepthData::ViewData& image1, Depth depth) const
+{
+	if (image1.depthMap.empty())
+		return 0.f;
+	ASSERT(OPTDENSE::fEstimationGeometricWeight > 0);
+	float consistency(4.f);
+	const Point3f X1(image1.Tl*Point3f(float(X0.x)*depth,float(X0.y)*depth,depth)+image1.Tm); // Kj * Rj * (Ri.t() * X + Ci - Cj)
+	if (X1.z > 0) {
+		const Point2f x1(X1);
+		if (image1.depthMap.isInsideWithBorder<float,1>(x1)) {
+			Depth depth1;
+			if (image1.depthMap.sample(depth1, x1, [&X1](Depth d) { return IsDepthSimilar(X1.z, d, 0.03f); })) {
+				const Point2f xb(image1.Tr*Point3f(x1.x*depth1,x1.y*depth1,depth1)+image1.Tn); // Ki * Ri * (Rj.t() * Kj-1 * X + Cj - Ci)
+				const float dist(norm(Point2f(float(x0.x)-xb.x, float(x0.y)-xb.y)));
+				consistency = MINF(SQRT(dist*(dist+2.f)), consistency);
+			}
 		}
 	}
+	return OPTDENSE::fEstimationGeometricWeight * consistency;
+}
+
+// compute pixel's NCC score in the given target image
+float DepthEstimator::ScorePixelImage(const DepthData::ViewData& image1, Depth depth, const Normal& normal, const ScoreTerms& terms, float scoreGeometric)
+{
+	// center a patch of given size on the segment and fetch the pixel values in the target image
+	ALIGN(32) float texels[nTexelsSIMD];
+	if (!SamplePatch(image1.image, ComputeHomographyMatrix(image1, depth, normal), x0, texels))
+		return thRobust;
+	float sum(0);
+	#if DENSE_NCC != DENSE_NCC_DEFAULT
+	float sumSq(0), num(0);
+	#endif
+	#if DENSE_NCC == DENSE_NCC_WEIGHTED
+	const Weight& w = weightMap0[x0.y*image0.image.width()+x0.x];
+	#endif
+	for (int n=0; n<nTexels; ++n) {
+		const float v(texels[n]);
+		#if DENSE_NCC == DENSE_NCC_FAST
+		sum += v;
+		sumSq += SQUARE(v);
+		num += texels0(n)*v;
+		#elif DENSE_NCC == DENSE_NCC_WEIGHTED
+		const Weight::Pixel& pw = w.weights[n];
+		const float vw(v*pw.weight);
+		sum += vw;
+		sumSq += v*vw;
+		num += v*pw.tempWeight;
+		#else
+		sum += texels1(n)=v;
+		#endif
+	}
+	// score similarity of the reference and target texture patches
+	#if DENSE_NCC == DENSE_NCC_FAST
+	const float normSq1(sumSq-SQUARE(sum/nSizeWindow));
+	#elif DENSE_NCC == DENSE_NCC_WEIGHTED
+	const float normSq1(sumSq-SQUARE(sum)/w.sumWeights);
+	#else
+	const float normSq1(normSqDelta<float,float,nTexels>(texels1.data(), sum/(float)nTexels));
+	#endif
+	const float nrmSq(normSq0*normSq1);
+	if (nrmSq <=1e-16f)
+		return thRobust;
+	#if DENSE_NCC == DENSE_NCC_DEFAULT
+	const float num(texels0.dot(texels1));
+	#endif
+	const float ncc(CLAMP(num/SQRT(nrmSq), -1.f, 1.f));
+	const float score(ComposeScore(1.f-ncc, terms, scoreGeometric));
 	ASSERT(ISFINITE(score));
-	return MIN(2.f, score);
+	return score;
 }
 
-// compute pixel's NCC score
-float DepthEstimator::ScorePixel(Depth depth, const Normal& normal)
+// compute pixel's NCC score;
+// all aggregation methods return a score not smaller than the smallest score in any view,
+// and the view scores are bounded from below by the cheap to compute score terms
+// (the geometric consistency and depth prior), so if the given score threshold can not be beaten
+// the estimate is rejected without scoring the remaining views, returning a score not smaller than the threshold
+float DepthEstimator::ScorePixel(Depth depth, const Normal& normal, float thScore)
 {
 	ASSERT(depth > 0 && normal.dot(Cast<float>(X0)) <= 0);
-	// compute score for this pixel as seen in each view
 	ASSERT(scores.size() == images.size());
-	FOREACH(idxView, images)
-		scores[idxView] = ScorePixelImage(images[idxView], depth, normal);
+	// compute the score terms shared by all views and the score lower bound in each view
+	const ScoreTerms terms(ComputeScoreTerms(depth, normal));
+	float maxBound(0);
+	FOREACH(idxView, images) {
+		scoresGeometric[idxView] = ScorePixelGeometric(images[idxView], depth);
+		scoresBound[idxView] = MINF(ComposeScore(0.f, terms, scoresGeometric[idxView]), thRobust);
+		if (maxBound < scoresBound[idxView])
+			maxBound = scoresBound[idxView];
+		viewsOrder[idxView] = idxView;
+	}
+	if (thScore < FLT_MAX && maxBound > 0) {
+		// score first the views with the smallest lower bound,
+		// and stop as soon as the estimate can not beat the given score
+		std::sort(viewsOrder.begin(), viewsOrder.end(), [this](IIndex i, IIndex j) { return scoresBound[i] < scoresBound[j]; });
+		float minScore(FLT_MAX);
+		for (IIndex idxView: viewsOrder) {
+			const float bound(MINF(minScore, scoresBound[idxView]));
+			if (bound >= thScore)
+				return bound;
+			const float score(ScorePixelImage(images[idxView], depth, normal, terms, scoresGeometric[idxView]));
+			scores[idxView] = score;
+			if (minScore > score)
+				minScore = score;
+		}
+	} else {
+		// compute score for this pixel as seen in each view
+		FOREACH(idxView, images)
+			scores[idxView] = ScorePixelImage(images[idxView], depth, normal, terms, scoresGeometric[idxView]);
+	}
 	#if DENSE_AGGNCC == DENSE_AGGNCC_NTH
 	// set score as the nth element
 	return scores.GetNth(idxScore);
@@ -736,7 +1011,7 @@ void DepthEstimator::ProcessPixel(IDX idx)
 	for (NeighborData& neighbor: neighbors) {
 		const ImageRef& nx = neighbor.x;
 	#endif
-		if (confMap0(nx) >= OPTDENSE::fNCCThresholdKeep)
+		if (confMap0(nx) >= thConfKeep)
 			continue;
 		#if DENSE_SMOOTHNESS != DENSE_SMOOTHNESS_NA
 		NeighborEstimate neighbor = neighborsClose[n];
@@ -747,7 +1022,7 @@ void DepthEstimator::ProcessPixel(IDX idx)
 		#if DENSE_SMOOTHNESS == DENSE_SMOOTHNESS_PLANE
 		InitPlane(neighbor.depth, neighbor.normal);
 		#endif
-		const float nconf(ScorePixel(neighbor.depth, neighbor.normal));
+		const float nconf(ScorePixel(neighbor.depth, neighbor.normal, conf));
 		ASSERT(nconf >= 0 && nconf <= 2);
 		if (conf > nconf) {
 			conf = nconf;
@@ -770,7 +1045,7 @@ void DepthEstimator::ProcessPixel(IDX idx)
 		for (unsigned iter=0; iter<OPTDENSE::nRandomIters; ++iter) {
 			const Depth ndepth(RandomDepth(dMinSqr, dMaxSqr));
 			const Normal nnormal(RandomNormal(viewDir));
-			const float nconf(ScorePixel(ndepth, nnormal));
+			const float nconf(ScorePixel(ndepth, nnormal, conf));
 			ASSERT(nconf >= 0);
 			if (conf > nconf) {
 				conf = nconf;
@@ -798,7 +1073,7 @@ void DepthEstimator::ProcessPixel(IDX idx)
 		#if DENSE_SMOOTHNESS == DENSE_SMOOTHNESS_PLANE
 		InitPlane(ndepth, nnormal);
 		#endif
-		const float nconf(ScorePixel(ndepth, nnormal));
+		const float nconf(ScorePixel(ndepth, nnormal, conf));
 		ASSERT(nconf >= 0);
 		if (conf > nconf) {
 			conf = nconf;
@@ -823,7 +1098,7 @@ void DepthEstimator::ProcessPixel(IDX idx)
 		float nconf(confMap0(nx));
 		const unsigned nidxScaleRange(DecodeScoreScale(nconf));
 		ASSERT(nconf >= 0 && nconf <= 2);
-		if (nconf >= OPTDENSE::fNCCThresholdKeep)
+		if (nconf >= thConfKeep)
 			continue;
 		if (prevCost <= nconf)
 			continue;
@@ -858,7 +1133,7 @@ void DepthEstimator::ProcessPixel(IDX idx)
 		#if DENSE_SMOOTHNESS == DENSE_SMOOTHNESS_PLANE
 		InitPlane(ndepth, nnormal);
 		#endif
-		const float nconf(ScorePixel(ndepth, nnormal));
+		const float nconf(ScorePixel(ndepth, nnormal, conf));
 		ASSERT(nconf >= 0);
 		if (conf > nconf) {
 			conf = nconf;
@@ -2022,27 +2297,27 @@ bool MVS::ExportPointCloud(const String& fileName, const Image& imageData, const
 /*----------------------------------------------------------------*/
 
 //  - IDs are the reference view ID and neighbor view IDs used to estimate the depth-map (global ID)
-bool MVS::ExportDepthDataRaw(const String& fileName, const String& imageFileName,
+namespace {
+// read/write the given number of elements from/to the file
+template <typename TYPE>
+inline bool WriteData(File& f, const TYPE* data, size_t count) {
+	return f.write(data, sizeof(TYPE)*count) == sizeof(TYPE)*count;
+}
+template <typename TYPE>
+inline bool ReadData(File& f, TYPE* data, size_t count) {
+	return f.read(data, sizeof(TYPE)*count) == sizeof(TYPE)*count;
+}
+
+// write the header and the data common to all depth-data file formats
+bool ExportDepthDataHeader(File& f, uint16_t name, const String& fileName, const String& imageFileName,
 	const IIndexArr& IDs, const cv::Size& imageSize,
 	const KMatrix& K, const RMatrix& R, const CMatrix& C,
 	Depth dMin, Depth dMax,
-	const DepthMap& depthMap, const NormalMap& normalMap, const ConfidenceMap& confMap, const ViewsMap& viewsMap)
+	const DepthMap& depthMap, const NormalMap& normalMap, const ConfidenceMap& confMap, const ViewsMap& viewsMap,
+	HeaderDepthDataRaw& header)
 {
-	ASSERT(!IDs.empty() && IDs.size() < 256);
-	ASSERT(!depthMap.empty());
-	ASSERT(confMap.empty() || depthMap.size() == confMap.size());
-	ASSERT(viewsMap.empty() || depthMap.size() == viewsMap.size());
-	ASSERT(depthMap.width() <= imageSize.width && depthMap.height() <= imageSize.height);
-
-	std::unique_ptr<FILE, decltype(&fclose)> f(fopen(fileName, "wb"), &fclose);
-	if (!f) {
-		DEBUG("error: opening file '%s' for writing depth-data", fileName.c_str());
-		return false;
-	}
-
 	// write header
-	HeaderDepthDataRaw header;
-	header.name = HeaderDepthDataRaw::HeaderDepthDataRawName();
+	header.name = name;
 	header.type = HeaderDepthDataRaw::HAS_DEPTH;
 	header.imageWidth = (uint32_t)imageSize.width;
 	header.imageHeight = (uint32_t)imageSize.height;
@@ -2056,64 +2331,37 @@ bool MVS::ExportDepthDataRaw(const String& fileName, const String& imageFileName
 		header.type |= HeaderDepthDataRaw::HAS_CONF;
 	if (!viewsMap.empty())
 		header.type |= HeaderDepthDataRaw::HAS_VIEWS;
-	fwrite(&header, sizeof(HeaderDepthDataRaw), 1, f.get());
+	if (!WriteData(f, &header, 1))
+		return false;
 
 	// write image file name
 	STATIC_ASSERT(sizeof(String::value_type) == sizeof(char));
 	const String FileName(MAKE_PATH_REL(Util::getFullPath(Util::getFilePath(fileName)), Util::getFullPath(imageFileName)));
 	const uint16_t nFileNameSize((uint16_t)FileName.length());
-	fwrite(&nFileNameSize, sizeof(uint16_t), 1, f.get());
-	fwrite(FileName.c_str(), sizeof(char), nFileNameSize, f.get());
+	if (!WriteData(f, &nFileNameSize, 1) || !WriteData(f, FileName.c_str(), nFileNameSize))
+		return false;
 
 	// write neighbor IDs
 	STATIC_ASSERT(sizeof(uint32_t) == sizeof(IIndex));
 	const uint32_t nIDs(IDs.size());
-	fwrite(&nIDs, sizeof(IIndex), 1, f.get());
-	fwrite(IDs.data(), sizeof(IIndex), nIDs, f.get());
+	if (!WriteData(f, &nIDs, 1) || !WriteData(f, IDs.data(), nIDs))
+		return false;
 
 	// write pose
 	STATIC_ASSERT(sizeof(double) == sizeof(REAL));
-	fwrite(K.val, sizeof(REAL), 9, f.get());
-	fwrite(R.val, sizeof(REAL), 9, f.get());
-	fwrite(C.ptr(), sizeof(REAL), 3, f.get());
-
-	// write depth-map
-	if (fwrite(depthMap.getData(), sizeof(float), depthMap.area(), f.get()) != static_cast<size_t>(depthMap.area())) {
-		DEBUG("error: writing depth-data to file '%s'", fileName.c_str());
-		return false;
-	}
-
-	// write normal-map
-	if ((header.type & HeaderDepthDataRaw::HAS_NORMAL) != 0)
-		fwrite(normalMap.getData(), sizeof(float)*3, normalMap.area(), f.get());
-
-	// write confidence-map
-	if ((header.type & HeaderDepthDataRaw::HAS_CONF) != 0)
-		fwrite(confMap.getData(), sizeof(float), confMap.area(), f.get());
-
-	// write views-map
-	if ((header.type & HeaderDepthDataRaw::HAS_VIEWS) != 0)
-		fwrite(viewsMap.getData(), sizeof(uint8_t)*4, viewsMap.area(), f.get());
-
-	return ferror(f.get()) == 0;
-} // ExportDepthDataRaw
+	return WriteData(f, K.val, 9) && WriteData(f, R.val, 9) && WriteData(f, C.ptr(), 3);
+}
 
-bool MVS::ImportDepthDataRaw(const String& fileName, String& imageFileName,
+// read the header and the data common to all depth-data file formats
+bool ImportDepthDataHeader(File& f, const String& fileName, String& imageFileName,
 	IIndexArr& IDs, cv::Size& imageSize,
 	KMatrix& K, RMatrix& R, CMatrix& C,
 	Depth& dMin, Depth& dMax,
-	DepthMap& depthMap, NormalMap& normalMap, ConfidenceMap& confMap, ViewsMap& viewsMap, unsigned flags)
+	HeaderDepthDataRaw& header)
 {
-	std::unique_ptr<FILE, decltype(&fclose)> f(fopen(fileName, "rb"), &fclose);
-	if (!f) {
-		DEBUG("error: opening file '%s' for reading depth-data", fileName.c_str());
-		return false;
-	}
-
 	// read header
-	HeaderDepthDataRaw header;
-	if (fread(&header, sizeof(HeaderDepthDataRaw), 1, f.get()) != 1 ||
-		header.name != HeaderDepthDataRaw::HeaderDepthDataRawName() ||
+	if (!ReadData(f, &header, 1) ||
+		(header.name != HeaderDepthDataRaw::HeaderDepthDataRawName() && header.name != HeaderDepthDataTiled::HeaderDepthDataTiledName()) ||
 		(header.type & HeaderDepthDataRaw::HAS_DEPTH) == 0 ||
 		header.depthWidth <= 0 || header.depthHeight <= 0 ||
 		header.imageWidth < header.depthWidth || header.imageHeight < header.depthHeight)
@@ -2125,46 +2373,455 @@ bool MVS::ImportDepthDataRaw(const String& fileName, String& imageFileName,
 	// read image file name
 	STATIC_ASSERT(sizeof(String::value_type) == sizeof(char));
 	uint16_t nFileNameSize;
-	fread(&nFileNameSize, sizeof(uint16_t), 1, f.get());
+	if (!ReadData(f, &nFileNameSize, 1))
+		return false;
 	imageFileName.resize(nFileNameSize);
-	fread(imageFileName.data(), sizeof(char), nFileNameSize, f.get());
+	if (!ReadData(f, imageFileName.data(), nFileNameSize))
+		return false;
 
 	// read neighbor IDs
 	STATIC_ASSERT(sizeof(uint32_t) == sizeof(IIndex));
 	uint32_t nIDs;
-	fread(&nIDs, sizeof(IIndex), 1, f.get());
+	if (!ReadData(f, &nIDs, 1))
+		return false;
 	ASSERT(nIDs > 0 && nIDs < 256);
 	IDs.resize(nIDs);
-	fread(IDs.data(), sizeof(IIndex), nIDs, f.get());
+	if (!ReadData(f, IDs.data(), nIDs))
+		return false;
 
 	// read pose
 	STATIC_ASSERT(sizeof(double) == sizeof(REAL));
-	fread(K.val, sizeof(REAL), 9, f.get());
-	fread(R.val, sizeof(REAL), 9, f.get());
-	fread(C.ptr(), sizeof(REAL), 3, f.get());
+	if (!ReadData(f, K.val, 9) || !ReadData(f, R.val, 9) || !ReadData(f, C.ptr(), 3))
+		return false;
 
-	// read depth-map
 	dMin = header.dMin;
 	dMax = header.dMax;
 	imageSize.width = header.imageWidth;
 	imageSize.height = header.imageHeight;
+	return true;
+}
+
+
+// encode/decode the depth-map values for the tiled format
+struct DepthDataTileCodec {
+	HeaderDepthDataTiled header;
+	float logDepthMin, depthScale; // log-space depth quantization
+	float confScale; // confidence quantization
+
+	void Init() {
+		logDepthMin = header.depthMin > 0 ? LOGN(header.depthMin) : 0.f;
+		const float logDepthRange(header.depthMax > header.depthMin ? LOGN(header.depthMax)-logDepthMin : 0.f);
+		depthScale = logDepthRange > 0 ? 65534.f/logDepthRange : 0.f;
+		confScale = header.confMax > 0 ? 255.f/header.confMax : 0.f;
+	}
+
+	inline uint16_t EncodeDepth(Depth depth) const {
+		if (depth <= 0)
+			return 0;
+		return (uint16_t)(1+CLAMP(ROUND2INT((LOGN(depth)-logDepthMin)*depthScale), 0, 65534));
+	}
+	inline Depth DecodeDepth(uint16_t q) const {
+		if (q == 0)
+			return Depth(0);
+		return depthScale > 0 ? EXP(logDepthMin+float(q-1)/depthScale) : header.depthMin;
+	}
+
+	// octahedral normal encoding
+	static inline void EncodeNormal(const Normal& normal, uint16_t* q) {
+		const float l1(ABS(normal.x)+ABS(normal.y)+ABS(normal.z));
+		if (l1 <= 0) {
+			q[0] = q[1] = 0;
+			return;
+		}
+		float u(normal.x/l1), v(normal.y/l1);
+		if (normal.z < 0) {
+			const float w((1.f-ABS(v))*(u >= 0 ? 1.f : -1.f));
+			v = (1.f-ABS(u))*(v >= 0 ? 1.f : -1.f);
+			u = w;
+		}
+		q[0] = (uint16_t)(1+CLAMP(ROUND2INT((u+1.f)*32767.f), 0, 65534));
+		q[1] = (uint16_t)(1+CLAMP(ROUND2INT((v+1.f)*32767.f), 0, 65534));
+	}
+	static inline Normal DecodeNormal(const uint16_t* q) {
+		if (q[0] == 0)
+			return Normal::ZERO;
+		Normal normal(float(q[0]-1)/32767.f-1.f, float(q[1]-1)/32767.f-1.f, 0.f);
+		normal.z = 1.f-ABS(normal.x)-ABS(normal.y);
+		if (normal.z < 0) {
+			const float x((1.f-ABS(normal.y))*(normal.x >= 0 ? 1.f : -1.f));
+			normal.y = (1.f-ABS(normal.x))*(normal.y >= 0 ? 1.f : -1.f);
+			normal.x = x;
+		}
+		return normalized(normal);
+	}
+
+	inline uint8_t EncodeConf(float conf) const {
+		return (uint8_t)CLAMP(ROUND2INT(conf*confScale), 0, 255);
+	}
+	inline float DecodeConf(uint8_t q) const {
+		return confScale > 0 ? float(q)/confScale : 0.f;
+	}
+
+	// view the given float map region as an 8-bit 4-channel image (lossless encoding)
+	template <typename TYPE>
+	static inline cv::Mat AsBytes(const cv::Mat_<TYPE>& map, const cv::Rect& rect) {
+		const cv::Mat_<TYPE> tile(map(rect));
+		return cv::Mat(tile.rows, tile.cols*(int)sizeof(TYPE)/4, CV_8UC4, tile.data, tile.step);
+	}
+
+	// encode the given region of the map in a PNG image
+	bool EncodeTile(int idxMap, const DepthMap& depthMap, const NormalMap& normalMap, const ConfidenceMap& confMap, const ViewsMap& viewsMap,
+		const cv::Rect& rect, std::vector<uchar>& buffer) const
+	{
+		cv::Mat tile;
+		switch (idxMap) {
+		case 0:
+			if (header.encoding == HeaderDepthDataTiled::LOSSLESS) {
+				tile = AsBytes(depthMap, rect);
+			} else {
+				Image16U tileQ(rect.size());
+				for (int r=0; r<rect.height; ++r)
+					for (int c=0; c<rect.width; ++c)
+						tileQ(r,c) = EncodeDepth(depthMap(rect.y+r,rect.x+c));
+				tile = tileQ;
+			}
+			break;
+		case 1:
+			if (header.encoding == HeaderDepthDataTiled::LOSSLESS) {
+				tile = AsBytes(normalMap, rect);
+			} else {
+				Image16U tileQ(rect.height, rect.width*2);
+				for (int r=0; r<rect.height; ++r)
+					for (int c=0; c<rect.width; ++c)
+						EncodeNormal(normalMap(rect.y+r,rect.x+c), tileQ.ptr(r)+c*2);
+				tile = tileQ;
+			}
+			break;
+		case 2:
+			if (header.encoding == HeaderDepthDataTiled::LOSSLESS) {
+				tile = AsBytes(confMap, rect);
+			} else {
+				Image8U tileQ(rect.size());
+				for (int r=0; r<rect.height; ++r)
+					for (int c=0; c<rect.width; ++c)
+						tileQ(r,c) = EncodeConf(confMap(rect.y+r,rect.x+c));
+				tile = tileQ;
+			}
+			break;
+		default:
+			tile = AsBytes(viewsMap, rect);
+		}
+		return cv::imencode(".png", tile, buffer, {cv::IMWRITE_PNG_COMPRESSION, 3});
+	}
+
+	// decode the given PNG image in the given region of the map
+	bool DecodeTile(int idxMap, DepthMap& depthMap, NormalMap& normalMap, ConfidenceMap& confMap, ViewsMap& viewsMap,
+		const cv::Rect& rect, const std::vector<uchar>& buffer) const
+	{
+		const cv::Mat tile(cv::imdecode(buffer, cv::IMREAD_UNCHANGED));
+		if (tile.rows != rect.height)
+			return false;
+		switch (idxMap) {
+		case 0:
+			if (header.encoding == HeaderDepthDataTiled::LOSSLESS) {
+				cv::Mat dst(AsBytes(depthMap, rect));
+				if (tile.size() != dst.size() || tile.type() != dst.type())
+					return false;
+				tile.copyTo(dst);
+			} else {
+				if (tile.cols != rect.width || tile.type() != CV_16UC1)
+					return false;
+				for (int r=0; r<rect.height; ++r)
+					for (int c=0; c<rect.width; ++c)
+						depthMap(rect.y+r,rect.x+c) = DecodeDepth(tile.at<uint16_t>(r,c));
+			}
+			break;
+		case 1:
+			if (header.encoding == HeaderDepthDataTiled::LOSSLESS) {
+				cv::Mat dst(AsBytes(normalMap, rect));
+				if (tile.size() != dst.size() || tile.type() != dst.type())
+					return false;
+				tile.copyTo(dst);
+			} else {
+				if (tile.cols != rect.width*2 || tile.type() != CV_16UC1)
+					return false;
+				for (int r=0; r<rect.height; ++r)
+					for (int c=0; c<rect.width; ++c)
+						normalMap(rect.y+r,rect.x+c) = DecodeNormal(tile.ptr<uint16_t>(r)+c*2);
+			}
+			break;
+		case 2:
+			if (header.encoding == HeaderDepthDataTiled::LOSSLESS) {
+				cv::Mat dst(AsBytes(confMap, rect));
+				if (tile.size() != dst.size() || tile.type() != dst.type())
+					return false;
+				tile.copyTo(dst);
+			} else {
+				if (tile.cols != rect.width || tile.type() != CV_8UC1)
+					return false;
+				for (int r=0; r<rect.height; ++r)
+					for (int c=0; c<rect.width; ++c)
+						confMap(rect.y+r,rect.x+c) = DecodeConf(tile.at<uint8_t>(r,c));
+			}
+			break;
+		default: {
+			cv::Mat dst(AsBytes(viewsMap, rect));
+			if (tile.size() != dst.size() || tile.type() != dst.type())
+				return false;
+			tile.copyTo(dst); }
+		}
+		return true;
+	}
+};
+} // namespace
+
+bool MVS::ExportDepthDataRaw(const String& fileName, const String& imageFileName,
+	const IIndexArr& IDs, const cv::Size& imageSize,
+	const KMatrix& K, const RMatrix& R, const CMatrix& C,
+	Depth dMin, Depth dMax,
+	const DepthMap& depthMap, const NormalMap& normalMap, const ConfidenceMap& confMap, const ViewsMap& viewsMap)
+{
+	ASSERT(!IDs.empty() && IDs.size() < 256);
+	ASSERT(!depthMap.empty());
+	ASSERT(confMap.empty() || depthMap.size() == confMap.size());
+	ASSERT(viewsMap.empty() || depthMap.size() == viewsMap.size());
+	ASSERT(depthMap.width() <= imageSize.width && depthMap.height() <= imageSize.height);
+
+	File f(fileName, File::WRITE, File::CREATE | File::TRUNCATE);
+	if (!f.isOpen()) {
+		DEBUG("error: opening file '%s' for writing depth-data", fileName.c_str());
+		return false;
+	}
+
+	// write header
+	HeaderDepthDataRaw header;
+	if (!ExportDepthDataHeader(f, HeaderDepthDataRaw::HeaderDepthDataRawName(), fileName, imageFileName,
+		IDs, imageSize, K, R, C, dMin, dMax, depthMap, normalMap, confMap, viewsMap, header) ||
+
+		// write depth-map
+		!WriteData(f, depthMap.getData(), depthMap.area()) ||
+
+		// write normal-map
+		((header.type & HeaderDepthDataRaw::HAS_NORMAL) != 0 && !WriteData(f, normalMap.getData(), normalMap.area())) ||
+
+		// write confidence-map
+		((header.type & HeaderDepthDataRaw::HAS_CONF) != 0 && !WriteData(f, confMap.getData(), confMap.area())) ||
+
+		// write views-map
+		((header.type & HeaderDepthDataRaw::HAS_VIEWS) != 0 && !WriteData(f, viewsMap.getData(), viewsMap.area())))
+	{
+		DEBUG("error: writing depth-data to file '%s'", fileName.c_str());
+		return false;
+	}
+	return true;
+} // ExportDepthDataRaw
+
+// same as above, but storing the maps split in compressed tiles;
+// if compact, the depth, normal and confidence values are quantized (bounded-loss),
+// otherwise they are stored lossless
+bool MVS::ExportDepthDataTiled(const String& fileName, const String& imageFileName,
+	const IIndexArr& IDs, const cv::Size& imageSize,
+	const KMatrix& K, const RMatrix& R, const CMatrix& C,
+	Depth dMin, Depth dMax,
+	const DepthMap& depthMap, const NormalMap& normalMap, const ConfidenceMap& confMap, const ViewsMap& viewsMap,
+	bool bCompact, unsigned tileSize)
+{
+	ASSERT(!IDs.empty() && IDs.size() < 256);
+	ASSERT(!depthMap.empty());
+	ASSERT(normalMap.empty() || depthMap.size() == normalMap.size());
+	ASSERT(confMap.empty() || depthMap.size() == confMap.size());
+	ASSERT(viewsMap.empty() || depthMap.size() == viewsMap.size());
+	ASSERT(depthMap.width() <= imageSize.width && depthMap.height() <= imageSize.height);
+	ASSERT(tileSize > 0 && tileSize < 65536);
+
+	File f(fileName, File::WRITE, File::CREATE | File::TRUNCATE);
+	if (!f.isOpen()) {
+		DEBUG("error: opening file '%s' for writing depth-data", fileName.c_str());
+		return false;
+	}
+
+	// write header
+	HeaderDepthDataRaw header;
+	if (!ExportDepthDataHeader(f, HeaderDepthDataTiled::HeaderDepthDataTiledName(), fileName, imageFileName,
+		IDs, imageSize, K, R, C, dMin, dMax, depthMap, normalMap, confMap, viewsMap, header))
+	{
+		DEBUG("error: writing depth-data to file '%s'", fileName.c_str());
+		return false;
+	}
+
+	// write tiles header
+	DepthDataTileCodec codec;
+	codec.header.tileSize = (uint16_t)tileSize;
+	if (bCompact) {
+		codec.header.encoding = HeaderDepthDataTiled::COMPACT;
+		codec.header.depthMin = FLT_MAX;
+		for (const Depth depth: depthMap) {
+			if (depth <= 0)
+				continue;
+			if (codec.header.depthMin > depth)
+				codec.header.depthMin = depth;
+			if (codec.header.depthMax < depth)
+				codec.header.depthMax = depth;
+		}
+		if (codec.header.depthMin > codec.header.depthMax)
+			codec.header.depthMin = codec.header.depthMax = 0;
+		for (const float conf: confMap)
+			if (codec.header.confMax < conf)
+				codec.header.confMax = conf;
+	}
+	codec.Init();
+	if (!WriteData(f, &codec.header, 1)) {
+		DEBUG("error: writing depth-data to file '%s'", fileName.c_str());
+		return false;
+	}
+
+	// reserve the tiles index
+	const int numTilesX((depthMap.cols+(int)tileSize-1)/(int)tileSize);
+	const int numTilesY((depthMap.rows+(int)tileSize-1)/(int)tileSize);
+	const int numTiles(numTilesX*numTilesY);
+	const unsigned numMaps(1u+
+		((header.type & HeaderDepthDataRaw::HAS_NORMAL) != 0 ? 1u : 0u)+
+		((header.type & HeaderDepthDataRaw::HAS_CONF) != 0 ? 1u : 0u)+
+		((header.type & HeaderDepthDataRaw::HAS_VIEWS) != 0 ? 1u : 0u));
+	CLISTDEF0(HeaderDepthDataTiled::Tile) tiles(numMaps*numTiles);
+	tiles.Memset(0);
+	const size_f_t posTiles(f.getPos());
+	if (!WriteData(f, tiles.data(), tiles.size())) {
+		DEBUG("error: writing depth-data to file '%s'", fileName.c_str());
+		return false;
+	}
+
+	// write the compressed tiles of each map
+	std::vector<uchar> buffer;
+	HeaderDepthDataTiled::Tile* pTile(tiles.data());
+	for (int idxMap=0; idxMap<4; ++idxMap) {
+		if ((header.type & (1<<idxMap)) == 0)
+			continue;
+		for (int ty=0; ty<numTilesY; ++ty) {
+			for (int tx=0; tx<numTilesX; ++tx) {
+				const cv::Rect rect(cv::Rect(tx*(int)tileSize, ty*(int)tileSize, (int)tileSize, (int)tileSize) & cv::Rect(cv::Point(0,0), depthMap.size()));
+				if (!codec.EncodeTile(idxMap, depthMap, normalMap, confMap, viewsMap, rect, buffer)) {
+					DEBUG("error: compressing depth-data for file '%s'", fileName.c_str());
+					return false;
+				}
+				pTile->offset = (uint64_t)f.getPos();
+				pTile->size = (uint32_t)buffer.size();
+				++pTile;
+				if (!WriteData(f, buffer.data(), buffer.size())) {
+					DEBUG("error: writing depth-data to file '%s'", fileName.c_str());
+					return false;
+				}
+			}
+		}
+	}
+	ASSERT(pTile == tiles.end());
+
+	// write the tiles index
+	if (!f.setPos(posTiles) || !WriteData(f, tiles.data(), tiles.size())) {
+		DEBUG("error: writing depth-data to file '%s'", fileName.c_str());
+		return false;
+	}
+	return true;
+} // ExportDepthDataTiled
+
+// import depth-data stored in the raw or tiled formats;
+// flags select what maps to load (see HeaderDepthDataRaw)
+bool MVS::ImportDepthDataRaw(const String& fileName, String& imageFileName,
+	IIndexArr& IDs, cv::Size& imageSize,
+	KMatrix& K, RMatrix& R, CMatrix& C,
+	Depth& dMin, Depth& dMax,
+	DepthMap& depthMap, NormalMap& normalMap, ConfidenceMap& confMap, ViewsMap& viewsMap, unsigned flags)
+{
+	File f(fileName, File::READ, File::OPEN);
+	if (!f.isOpen()) {
+		DEBUG("error: opening file '%s' for reading depth-data", fileName.c_str());
+		return false;
+	}
+
+	// read header
+	HeaderDepthDataRaw header;
+	if (!ImportDepthDataHeader(f, fileName, imageFileName, IDs, imageSize, K, R, C, dMin, dMax, header))
+		return false;
+
+	if (header.name == HeaderDepthDataTiled::HeaderDepthDataTiledName()) {
+		// read tiles header and index
+		DepthDataTileCodec codec;
+		if (!ReadData(f, &codec.header, 1) ||
+			codec.header.version > HeaderDepthDataTiled::VERSION || codec.header.tileSize == 0)
+		{
+			DEBUG("error: invalid depth-data file '%s'", fileName.c_str());
+			return false;
+		}
+		codec.Init();
+		const int tileSize(codec.header.tileSize);
+		const int numTilesX(((int)header.depthWidth+tileSize-1)/tileSize);
+		const int numTilesY(((int)header.depthHeight+tileSize-1)/tileSize);
+		const int numTiles(numTilesX*numTilesY);
+		const unsigned numMaps(1u+
+			((header.type & HeaderDepthDataRaw::HAS_NORMAL) != 0 ? 1u : 0u)+
+			((header.type & HeaderDepthDataRaw::HAS_CONF) != 0 ? 1u : 0u)+
+			((header.type & HeaderDepthDataRaw::HAS_VIEWS) != 0 ? 1u : 0u));
+		CLISTDEF0(HeaderDepthDataTiled::Tile) tiles(numMaps*numTiles);
+		if (!ReadData(f, tiles.data(), tiles.size())) {
+			DEBUG("error: reading depth-data from file '%s'", fileName.c_str());
+			return false;
+		}
+		// read the tiles of each requested map
+		const cv::Rect rectMap(0, 0, (int)header.depthWidth, (int)header.depthHeight);
+		std::vector<uchar> buffer;
+		const HeaderDepthDataTiled::Tile* pTiles(tiles.data());
+		for (int idxMap=0; idxMap<4; ++idxMap) {
+			if ((header.type & (1<<idxMap)) == 0)
+				continue;
+			if ((flags & (1<<idxMap)) != 0) {
+				switch (idxMap) {
+				case 0: depthMap.create(rectMap.size()); break;
+				case 1: normalMap.create(rectMap.size()); break;
+				case 2: confMap.create(rectMap.size()); break;
+				default: viewsMap.create(rectMap.size());
+				}
+				for (int ty=0; ty<numTilesY; ++ty) {
+					for (int tx=0; tx<numTilesX; ++tx) {
+						const HeaderDepthDataTiled::Tile& tile = pTiles[ty*numTilesX+tx];
+						buffer.resize(tile.size);
+						if (!f.setPos((size_f_t)tile.offset) ||
+							!ReadData(f, buffer.data(), tile.size) ||
+							!codec.DecodeTile(idxMap, depthMap, normalMap, confMap, viewsMap,
+								cv::Rect(tx*tileSize, ty*tileSize, tileSize, tileSize) & rectMap, buffer))
+						{
+							DEBUG("error: reading depth-data from file '%s'", fileName.c_str());
+							return false;
+						}
+					}
+				}
+			}
+			pTiles += numTiles;
+		}
+		return true;
+	}
+
+	const size_f_t area((size_f_t)header.depthWidth*header.depthHeight);
+	// read depth-map
 	if ((flags & HeaderDepthDataRaw::HAS_DEPTH) != 0) {
 		depthMap.create(header.depthHeight, header.depthWidth);
-		if (fread(depthMap.getData(), sizeof(float), depthMap.area(), f.get()) != static_cast<size_t>(depthMap.area())) {
+		if (!ReadData(f, depthMap.getData(), depthMap.area())) {
 			DEBUG("error: reading depth-data from file '%s'", fileName.c_str());
 			return false;
 		}
 	} else {
-		fseek(f.get(), sizeof(float)*header.depthWidth*header.depthHeight, SEEK_CUR);
+		f.movePos(sizeof(float)*area);
 	}
 
 	// read normal-map
 	if ((header.type & HeaderDepthDataRaw::HAS_NORMAL) != 0) {
 		if ((flags & HeaderDepthDataRaw::HAS_NORMAL) != 0) {
 			normalMap.create(header.depthHeight, header.depthWidth);
-			fread(normalMap.getData(), sizeof(float)*3, normalMap.area(), f.get());
+			if (!ReadData(f, normalMap.getData(), normalMap.area())) {
+				DEBUG("error: reading depth-data from file '%s'", fileName.c_str());
+				return false;
+			}
 		} else {
-			fseek(f.get(), sizeof(float)*3*header.depthWidth*header.depthHeight, SEEK_CUR);
+			f.movePos(sizeof(float)*3*area);
 		}
 	}
 
@@ -2172,9 +2829,12 @@ bool MVS::ImportDepthDataRaw(const String& fileName, String& imageFileName,
 	if ((header.type & HeaderDepthDataRaw::HAS_CONF) != 0) {
 		if ((flags & HeaderDepthDataRaw::HAS_CONF) != 0) {
 			confMap.create(header.depthHeight, header.depthWidth);
-			fread(confMap.getData(), sizeof(float), confMap.area(), f.get());
+			if (!ReadData(f, confMap.getData(), confMap.area())) {
+				DEBUG("error: reading depth-data from file '%s'", fileName.c_str());
+				return false;
+			}
 		} else {
-			fseek(f.get(), sizeof(float)*header.depthWidth*header.depthHeight, SEEK_CUR);
+			f.movePos(sizeof(float)*area);
 		}
 	}
 
@@ -2182,12 +2842,48 @@ bool MVS::ImportDepthDataRaw(const String& fileName, String& imageFileName,
 	if ((header.type & HeaderDepthDataRaw::HAS_VIEWS) != 0) {
 		if ((flags & HeaderDepthDataRaw::HAS_VIEWS) != 0) {
 			viewsMap.create(header.depthHeight, header.depthWidth);
-			fread(viewsMap.getData(), sizeof(uint8_t)*4, viewsMap.area(), f.get());
+			if (!ReadData(f, viewsMap.getData(), viewsMap.area())) {
+				DEBUG("error: reading depth-data from file '%s'", fileName.c_str());
+				return false;
+			}
 		}
 	}
-
-	return ferror(f.get()) == 0;
+	return true;
 } // ImportDepthDataRaw
+
+// convert the given depth-data file to the given format:
+// 0 - raw, 1 - tiled lossless, 2 - tiled compact
+// (the input and output files can be the same)
+bool MVS::ConvertDepthDataRaw(const String& fileNameIn, const String& fileNameOut, unsigned format)
+{
+	String imageFileName;
+	IIndexArr IDs;
+	cv::Size imageSize;
+	Camera camera;
+	Depth dMin, dMax;
+	DepthMap depthMap;
+	NormalMap normalMap;
+	ConfidenceMap confMap;
+	ViewsMap viewsMap;
+	if (!ImportDepthDataRaw(fileNameIn, imageFileName, IDs, imageSize, camera.K, camera.R, camera.C, dMin, dMax, depthMap, normalMap, confMap, viewsMap))
+		return false;
+	// the image file name is stored relative to the depth-data file
+	imageFileName = MAKE_PATH_FULL(Util::getFullPath(Util::getFilePath(fileNameIn)), imageFileName);
+	const String fileNameTmp(fileNameOut+".tmp");
+	if (!(format == 0 ?
+		ExportDepthDataRaw(fileNameTmp, imageFileName, IDs, imageSize, camera.K, camera.R, camera.C, dMin, dMax, depthMap, normalMap, confMap, viewsMap) :
+		ExportDepthDataTiled(fileNameTmp, imageFileName, IDs, imageSize, camera.K, camera.R, camera.C, dMin, dMax, depthMap, normalMap, confMap, viewsMap, format > 1)))
+	{
+		File::deleteFile(fileNameTmp);
+		return false;
+	}
+	if (!File::renameFile(fileNameTmp, fileNameOut)) {
+		DEBUG_EXTRA("error: can not access dmap file '%s'", fileNameOut.c_str());
+		File::deleteFile(fileNameTmp);
+		return false;
+	}
+	return true;
+} // ConvertDepthDataRaw
 /*----------------------------------------------------------------*/
 
 
@@ -2309,3 +3005,196 @@ void MVS::CompareNormalMaps(const NormalMap& normalMap, const NormalMap& normalM
 	);
 }
 /*----------------------------------------------------------------*/
+
+
+// test the patch sampling used to score the depth estimates:
+// compare the texels sampled by checking only the patch corners (and using SIMD if available)
+// with the ones sampled by checking each texel, and the NCC scores computed from them, and report the speedup;
+// the two methods compute the texel positions with different float rounding, so they may disagree
+// on the patch being inside the image only if a texel lies on the image border (within the rounding error)
+bool MVS::TestDepthEstimatorSamplePatch(unsigned iters)
+{
+	typedef DepthEstimator DE;
+	Image32F image(480, 640);
+	cv::randu(image, cv::Scalar(0.f), cv::Scalar(1.f));
+	SEACAVE::Random rnd;
+	struct Sample {
+		Matrix3x3f H;
+		ImageRef x0;
+	};
+	CLISTDEF0(Sample) samples(iters);
+	for (Sample& sample: samples) {
+		// random homography close to a similarity transform
+		const float scale(rnd.randomRange(0.7f, 1.4f)), angle(rnd.randomRange(-FD2R(30.f), FD2R(30.f)));
+		sample.H = Matrix3x3f(
+			scale*COS(angle), -scale*SIN(angle), rnd.randomRange(-20.f, 20.f),
+			scale*SIN(angle),  scale*COS(angle), rnd.randomRange(-20.f, 20.f),
+			rnd.randomRange(-2e-4f, 2e-4f), rnd.randomRange(-2e-4f, 2e-4f), 1.f);
+		sample.x0 = ImageRef(rnd.randomRange(0, image.width()-1), rnd.randomRange(0, image.height()-1));
+	}
+	// check if any texel of the patch, projected in double precision, lies on the border of the valid image region
+	const auto IsPatchOnBorder = [&image](const Sample& sample) {
+		const double thBorder(1e-2); // well above the float rounding error of the texel positions
+		const Matrix3x3 H(sample.H);
+		for (int i=-DE::nSizeHalfWindow; i<=DE::nSizeHalfWindow; i+=DE::nSizeStep) {
+			for (int j=-DE::nSizeHalfWindow; j<=DE::nSizeHalfWindow; j+=DE::nSizeStep) {
+				const Point3 X(H*Point3(double(sample.x0.x+j), double(sample.x0.y+i), 1.0));
+				if (X.z <= 0)
+					continue;
+				const double x(X.x/X.z), y(X.y/X.z);
+				if (MINF(MINF(ABS(x-1), ABS(x-(image.width()-2))), MINF(ABS(y-1), ABS(y-(image.height()-2)))) < thBorder)
+					return true;
+			}
+		}
+		return false;
+	};
+	// NCC score of the sampled texels against a random reference patch, as computed by the estimator
+	DE::TexelVec texels0;
+	for (int n=0; n<DE::nTexels; ++n)
+		texels0(n) = rnd.randomRange(0.f, 1.f);
+	texels0.array() -= texels0.mean();
+	const float normSq0(texels0.squaredNorm());
+	const auto ScoreTexels = [&texels0, normSq0](const float* texels) {
+		const Eigen::Map<const DE::TexelVec> texels1(texels);
+		const float normSq1((texels1.array()-texels1.mean()).matrix().squaredNorm());
+		return 1.f-CLAMP(texels0.dot(texels1)/SQRT(normSq0*normSq1), -1.f, 1.f);
+	};
+	ALIGN(32) float texels[DE::nTexelsSIMD], texelsChecked[DE::nTexelsSIMD];
+	unsigned numInside(0), numBorderMismatches(0);
+	float maxScoreDiff(0);
+	for (const Sample& sample: samples) {
+		const bool bInside(DE::SamplePatch(image, sample.H, sample.x0, texels));
+		if (bInside != DE::SamplePatchChecked(image, sample.H, sample.x0, texelsChecked)) {
+			if (!IsPatchOnBorder(sample)) {
+				VERBOSE("error: patch sampling disagreement inside the image at %d,%d", sample.x0.x, sample.x0.y);
+				return false;
+			}
+			++numBorderMismatches;
+			continue;
+		}
+		if (!bInside)
+			continue;
+		++numInside;
+		for (int n=0; n<DE::nTexels; ++n)
+			if (ABS(texels[n]-texelsChecked[n]) > 1e-3f)
+				return false;
+		// the NCC of the reference patch with the normalized texels can change at most
+		// by twice the texels difference relative to the texels norm (plus the float rounding)
+		const Eigen::Map<const DE::TexelVec> texels1(texels), texels1Checked(texelsChecked);
+		const float normDiff((texels1-texels1Checked).norm());
+		const float norm1(SQRT((texels1Checked.array()-texels1Checked.mean()).matrix().squaredNorm()));
+		const float scoreDiff(ABS(ScoreTexels(texels)-ScoreTexels(texelsChecked)));
+		if (scoreDiff > 2.f*normDiff/norm1+1e-5f) {
+			VERBOSE("error: patch sampling score difference %g at %d,%d", scoreDiff, sample.x0.x, sample.x0.y);
+			return false;
+		}
+		if (maxScoreDiff < scoreDiff)
+			maxScoreDiff = scoreDiff;
+	}
+	// measure the speed of the two methods
+	float sum(0);
+	const Timer::SysType t0(Timer::GetSysTime());
+	for (const Sample& sample: samples)
+		if (DE::SamplePatchChecked(image, sample.H, sample.x0, texelsChecked))
+			sum += texelsChecked[0];
+	const Timer::SysType t1(Timer::GetSysTime());
+	for (const Sample& sample: samples)
+		if (DE::SamplePatch(image, sample.H, sample.x0, texels))
+			sum += texels[0];
+	const Timer::SysType t2(Timer::GetSysTime());
+	VERBOSE("Patch sampling: %u patches inside, %u border disagreements, %g max score difference (%s SIMD), %.3fms checked vs %.3fms fast (x%.2f speedup) [%g]",
+		numInside, numBorderMismatches, maxScoreDiff, SIMD_ENABLED.isSet(Util::AVX) ? "AVX" : SIMD_ENABLED.isSet(Util::SSE) ? "SSE" : "no",
+		Timer::SysTime2TimeMs(t1-t0), Timer::SysTime2TimeMs(t2-t1),
+		double(t1-t0)/MAXF(double(t2-t1), 1.0), sum);
+	return true;
+}
+/*----------------------------------------------------------------*/
+
+
+// test the depth-data file formats: save a random depth-data in each format and load it back,
+// checking the raw and tiled lossless formats are exact and the tiled compact format is within its quantization bounds
+bool MVS::TestDepthDataFormats(int width, int height, unsigned tileSize)
+{
+	SEACAVE::Random rnd;
+	const Depth dMin(0.5f), dMax(50.f);
+	DepthMap depthMap(height, width);
+	NormalMap normalMap(height, width);
+	ConfidenceMap confMap(height, width);
+	ViewsMap viewsMap(height, width);
+	for (int r=0; r<height; ++r) {
+		for (int c=0; c<width; ++c) {
+			// leave some pixels invalid
+			if (rnd.randomRange(0, 9) == 0) {
+				depthMap(r,c) = 0;
+				normalMap(r,c) = Normal::ZERO;
+				confMap(r,c) = 0;
+				viewsMap(r,c) = ViewsID(0,0,0,0);
+				continue;
+			}
+			depthMap(r,c) = rnd.randomRange(dMin, dMax);
+			normalMap(r,c) = normalized(Normal(rnd.randomRange(-1.f, 1.f), rnd.randomRange(-1.f, 1.f), rnd.randomRange(-1.f, 1.f)+0.01f));
+			confMap(r,c) = rnd.randomRange(0.f, 1.f);
+			viewsMap(r,c) = ViewsID((uint8_t)rnd.randomRange(0, 255), (uint8_t)rnd.randomRange(0, 255), (uint8_t)rnd.randomRange(0, 255), 0);
+		}
+	}
+	IIndexArr IDs;
+	IDs.push_back(3); IDs.push_back(1); IDs.push_back(7);
+	const cv::Size imageSize(width*2, height*2);
+	const KMatrix K(KMatrix::IDENTITY);
+	const RMatrix R(RMatrix::IDENTITY);
+	const CMatrix C(1, 2, 3);
+	const String fileName(MAKE_PATH("test_depthdata.dmap"));
+	const String imageFileName(MAKE_PATH("test_depthdata.jpg"));
+	bool bRet(true);
+	for (unsigned format=0; format<3 && bRet; ++format) {
+		bRet = format == 0 ?
+			ExportDepthDataRaw(fileName, imageFileName, IDs, imageSize, K, R, C, dMin, dMax, depthMap, normalMap, confMap, viewsMap) :
+			ExportDepthDataTiled(fileName, imageFileName, IDs, imageSize, K, R, C, dMin, dMax, depthMap, normalMap, confMap, viewsMap, format > 1, tileSize);
+		// load all maps, and only some of them
+		for (unsigned flags: {15u, (unsigned)(HeaderDepthDataRaw::HAS_DEPTH|HeaderDepthDataRaw::HAS_CONF)}) {
+			if (!bRet)
+				break;
+			String _imageFileName;
+			IIndexArr _IDs;
+			cv::Size _imageSize;
+			KMatrix _K; RMatrix _R; CMatrix _C;
+			Depth _dMin, _dMax;
+			DepthMap _depthMap;
+			NormalMap _normalMap;
+			ConfidenceMap _confMap;
+			ViewsMap _viewsMap;
+			if (!ImportDepthDataRaw(fileName, _imageFileName, _IDs, _imageSize, _K, _R, _C, _dMin, _dMax, _depthMap, _normalMap, _confMap, _viewsMap, flags) ||
+				_IDs.size() != IDs.size() || !std::equal(IDs.begin(), IDs.end(), _IDs.begin()) ||
+				_imageSize != imageSize || _dMin != dMin || _dMax != dMax || _C != C ||
+				_depthMap.size() != depthMap.size() || _confMap.size() != confMap.size() ||
+				((flags & HeaderDepthDataRaw::HAS_NORMAL) != 0 ? _normalMap.size() != normalMap.size() : !_normalMap.empty()) ||
+				((flags & HeaderDepthDataRaw::HAS_VIEWS) != 0 ? _viewsMap.size() != viewsMap.size() : !_viewsMap.empty()))
+			{
+				bRet = false;
+				break;
+			}
+			// compact encoding error bounds: half quantization step
+			const float maxDepthRatio(format > 1 ? EXP(0.5f*LOGN(dMax/dMin)/65534.f)*1.0001f : 1.f);
+			const float maxNormalError(format > 1 ? 1e-3f : 0.f);
+			const float maxConfError(format > 1 ? 0.5f/255.f+1e-6f : 0.f);
+			for (int r=0; r<height && bRet; ++r) {
+				for (int c=0; c<width; ++c) {
+					const Depth depth(depthMap(r,c)), _depth(_depthMap(r,c));
+					if ((depth == 0) != (_depth == 0) || (depth > 0 && MAXF(depth/_depth, _depth/depth) > maxDepthRatio) ||
+						ABS(confMap(r,c)-_confMap(r,c)) > maxConfError ||
+						(!_normalMap.empty() && depth > 0 && norm(normalMap(r,c)-_normalMap(r,c)) > maxNormalError) ||
+						(!_viewsMap.empty() && viewsMap(r,c) != _viewsMap(r,c)))
+					{
+						bRet = false;
+						break;
+					}
+				}
+			}
+		}
+		if (!bRet)
+			VERBOSE("error: depth-data format %u round-trip failed", format);
+	}
+	File::deleteFile(fileName);
+	return bRet;
+}
+/*----------------------------------------------------------------*/
@@ -104,6 +104,8 @@ extern unsigned nMinViews;
 extern unsigned nMaxViews;
 extern unsigned nMinViewsFuse;
 extern unsigned nMaxViewsFuse;
+extern unsigned nFusePrefetch;
+extern bool bFuseParallel;
 extern unsigned nMinViewsFilter;
 extern unsigned nMinViewsFilterAdjust;
 extern unsigned nMinViewsTrustPoint;
@@ -115,6 +117,8 @@ extern unsigned nPointInsideROI;
 extern bool bAddCorners;
 extern bool bInitSparse;
 extern bool bRemoveDmaps;
+extern bool bMapDmaps;
+extern unsigned nDepthMapFormat;
 extern float fViewMinScore;
 extern float fViewMinScoreRatio;
 extern float fMinArea;
@@ -138,6 +142,7 @@ extern unsigned nEstimateNormals;
 extern float fNCCThresholdKeep;
 extern unsigned nEstimationIters;
 extern unsigned nEstimationGeometricIters;
+extern unsigned nConcurrentImages;
 extern float fEstimationGeometricWeight;
 extern unsigned nRandomIters;
 extern unsigned nRandomMaxScale;
@@ -224,6 +229,7 @@ struct MVS_API DepthData {
 	NormalMap normalMap; // normal-map in camera space
 	ConfidenceMap confMap; // confidence-map
 	ViewsMap viewsMap; // view-IDs map (indexing images vector starting after first view)
+	std::shared_ptr<MappedFile> mappedFile; // depth-data file the maps point to, if mapped in memory
 	float dMin, dMax; // global depth range for this image
 	cv::Size size; // image size used to estimate this depth-map
 	unsigned references; // how many times this depth-map is referenced (on 0 can be safely unloaded)
@@ -243,6 +249,7 @@ struct MVS_API DepthData {
 		normalMap.release();
 		confMap.release();
 		viewsMap.release();
+		mappedFile.reset();
 	}
 
 	inline bool IsValid() const {
@@ -251,6 +258,9 @@ struct MVS_API DepthData {
 	inline bool IsEmpty() const {
 		return depthMap.empty();
 	}
+	inline bool IsMapped() const {
+		return mappedFile != nullptr;
+	}
 
 	const ViewData& GetView() const { return images.front(); }
 	const Camera& GetCamera() const { return GetView().camera; }
@@ -262,6 +272,7 @@ struct MVS_API DepthData {
 
 	bool Save(const String& fileName) const;
 	bool Load(const String& fileName, unsigned flags=15);
+	bool Map(const String& fileName, unsigned flags=15);
 
 	unsigned GetRef();
 	unsigned IncRef(const String& fileName);
@@ -292,7 +303,9 @@ struct MVS_API DepthEstimator {
 	enum { nSizeWindow = nSizeHalfWindow*2+1 };
 	enum { nSizeStep = 2 };
 	enum { TexelChannels = 1 };
-	enum { nTexels = SQUARE((nSizeHalfWindow*2+nSizeStep)/nSizeStep)*TexelChannels };
+	enum { nTexelsSide = (nSizeHalfWindow*2+nSizeStep)/nSizeStep };
+	enum { nTexels = SQUARE(nTexelsSide)*TexelChannels };
+	enum { nTexelsSIMD = (nTexels+7)&~7 }; // number of texels padded to a multiple of the widest SIMD vector
 
 	enum ENDIRECTION {
 		LT2RB = 0,
@@ -324,6 +337,12 @@ struct MVS_API DepthEstimator {
 		Normal normal;
 	};
 	#endif
+	// score terms of a depth estimate that do not depend on the view
+	struct ScoreTerms {
+		float smoothness; // factor encouraging smoothness with the neighbor estimates
+		float priorWeight; // weight of the depth prior
+		float priorScore; // weighted score of the depth prior
+	};
 
 	#if DENSE_NCC == DENSE_NCC_WEIGHTED
 	typedef WeightedPatchFix<nTexels> Weight;
@@ -355,6 +374,9 @@ struct MVS_API DepthEstimator {
 	#else
 	Eigen::VectorXf scores;
 	#endif
+	FloatArr scoresGeometric; // geometric consistency score in each view
+	FloatArr scoresBound; // lower bound of the score in each view
+	IIndexArr viewsOrder; // order in which the views are scored
 	#if DENSE_SMOOTHNESS == DENSE_SMOOTHNESS_PLANE
 	Planef plane; // plane defined by current depth and normal estimate
 	#endif
@@ -365,6 +387,7 @@ struct MVS_API DepthEstimator {
 	WeightMap& weightMap0;
 	#endif
 	DepthMap lowResDepthMap;
+	float thConfKeep; // maximum score accepted for an estimate
 
 	const unsigned nIteration; // current PatchMatch iteration
 	const DepthData::ViewDataArr images; // neighbor images used
@@ -392,8 +415,12 @@ struct MVS_API DepthEstimator {
 
 	bool PreparePixelPatch(const ImageRef&);
 	bool FillPixelPatch();
-	float ScorePixelImage(const DepthData::ViewData& image1, Depth, const Normal&);
-	float ScorePixel(Depth, const Normal&);
+	static bool SamplePatch(const Image32F& image, const Matrix3x3f& H, const ImageRef& x0, float* texels);
+	static bool SamplePatchChecked(const Image32F& image, const Matrix3x3f& H, const ImageRef& x0, float* texels);
+	ScoreTerms ComputeScoreTerms(Depth, const Normal&) const;
+	float ScorePixelGeometric(const DepthData::ViewData& image1, Depth) const;
+	float ScorePixelImage(const DepthData::ViewData& image1, Depth, const Normal&, const ScoreTerms&, float scoreGeometric);
+	float ScorePixel(Depth, const Normal&, float thScore=FLT_MAX);
 	void ProcessPixel(IDX idx);
 	Depth InterpolatePixel(const ImageRef&, Depth, const Normal&) const;
 	#if DENSE_SMOOTHNESS == DENSE_SMOOTHNESS_PLANE
@@ -403,6 +430,12 @@ struct MVS_API DepthEstimator {
 	PixelEstimate PerturbEstimate(const PixelEstimate&, float perturbation);
 	#endif
 
+	// combine the patch similarity score with the other score terms;
+	// the result is non-decreasing with the similarity score
+	static inline float ComposeScore(float score, const ScoreTerms& terms, float scoreGeometric) {
+		return MINF(2.f, (1.f-terms.priorWeight)*(score*terms.smoothness+scoreGeometric)+terms.priorScore);
+	}
+
 	#if DENSE_NCC != DENSE_NCC_WEIGHTED
 	inline float GetImage0Sum(const ImageRef& p) const {
 		const ImageRef p0(p.x-nSizeHalfWindow, p.y-nSizeHalfWindow);
@@ -535,9 +568,19 @@ MVS_API bool ImportDepthDataRaw(const String&, String& imageFileName,
 	KMatrix&, RMatrix&, CMatrix&,
 	Depth& dMin, Depth& dMax,
 	DepthMap&, NormalMap&, ConfidenceMap&, ViewsMap&, unsigned flags=15);
+MVS_API bool ExportDepthDataTiled(const String&, const String& imageFileName,
+	const IIndexArr&, const cv::Size& imageSize,
+	const KMatrix&, const RMatrix&, const CMatrix&,
+	Depth dMin, Depth dMax,
+	const DepthMap&, const NormalMap&, const ConfidenceMap&, const ViewsMap&,
+	bool bCompact=true, unsigned tileSize=256);
+MVS_API bool ConvertDepthDataRaw(const String& fileNameIn, const String& fileNameOut, unsigned format);
 
 MVS_API void CompareDepthMaps(const DepthMap& depthMap, const DepthMap& depthMapGT, uint32_t idxImage, float threshold=0.01f);
 MVS_API void CompareNormalMaps(const NormalMap& normalMap, const NormalMap& normalMapGT, uint32_t idxImage);
+
+MVS_API bool TestDepthEstimatorSamplePatch(unsigned iters);
+MVS_API bool TestDepthDataFormats(int width, int height, unsigned tileSize);
 /*----------------------------------------------------------------*/
 
 } // namespace MVS
@@ -40,6 +40,225 @@ using namespace MVS;
 
 // S T R U C T S ///////////////////////////////////////////////////
 
+String ImageCache::path;
+size_t ImageCache::maxSize(0);
+size_t ImageCache::currentSize(0);
+volatile int32_t ImageCache::nHits(0);
+volatile int32_t ImageCache::nMisses(0);
+volatile int32_t ImageCache::nStores(0);
+CriticalSection ImageCache::cs;
+
+namespace ImageCacheInternal {
+// header of a cached image entry, followed by the raw pixel data
+struct EntryHeader {
+	enum { MAGIC = 0x4D434943 }; // "CICM"
+	uint32_t magic;
+	int32_t type;
+	int32_t originalWidth, originalHeight;
+	int32_t rows, cols;
+};
+
+// FNV-1a hash
+inline uint64_t HashFNV1a(const void* data, size_t size, uint64_t hash=0xcbf29ce484222325ull) {
+	const uint8_t* p((const uint8_t*)data);
+	for (const uint8_t* const pEnd = p+size; p != pEnd; ++p)
+		hash = (hash ^ *p) * 0x100000001b3ull;
+	return hash;
+}
+
+// compute a fingerprint of the file content by hashing the entire file (and its size);
+// hashing only some blocks misses edits that keep the size and touch only the middle of the file
+// (ex. a retouched region of a JPEG image), while keying by path and modification time
+// would invalidate the cache when the images are copied or moved and would miss rewrites within the timestamp resolution;
+// reading the file is still much cheaper than decoding the image
+bool FingerprintFile(const String& fileName, uint64_t& hash) {
+	enum { BLOCK_SIZE = 1024*1024 };
+	File f(fileName, File::READ, File::OPEN);
+	if (!f.isOpen())
+		return false;
+	const size_f_t size(f.getSize());
+	if (size == SIZE_NA)
+		return false;
+	hash = HashFNV1a(&size, sizeof(size_f_t));
+	std::vector<uint8_t> buffer(BLOCK_SIZE);
+	for (size_f_t pos=0; pos<size; ) {
+		const size_t len((size_t)MINF(size-pos, (size_f_t)BLOCK_SIZE));
+		if (f.read(buffer.data(), len) != len)
+			return false;
+		hash = HashFNV1a(buffer.data(), len, hash);
+		pos += len;
+	}
+	return true;
+}
+} // namespace ImageCacheInternal
+
+// enable the cache using the given folder;
+// maxSize is the max size in bytes of the cache (0 - unlimited)
+bool ImageCache::Init(const String& folder, size_t _maxSize)
+{
+	Lock l(cs);
+	path = folder;
+	if (path.empty())
+		return false;
+	Util::ensureValidFolderPath(path);
+	Util::ensureFolder(path);
+	if (!File::isFolder(path)) {
+		VERBOSE("error: can not create image cache folder '%s'", path.c_str());
+		path.clear();
+		return false;
+	}
+	maxSize = _maxSize;
+	currentSize = 0;
+	std::error_code ec;
+	for (const auto& entry: std::filesystem::directory_iterator(static_cast<const std::string&>(path), ec))
+		if (entry.is_regular_file(ec) && entry.path().extension() == ".img")
+			currentSize += (size_t)entry.file_size(ec);
+	if (maxSize > 0 && currentSize > maxSize)
+		Trim();
+	DEBUG_EXTRA("Image cache enabled at '%s' (%s used)", path.c_str(), Util::formatBytes((int64_t)currentSize).c_str());
+	return true;
+} // Init
+/*----------------------------------------------------------------*/
+
+// compose the cache entry file name corresponding to the given image and level;
+// return an empty string if the image file can not be read
+String ImageCache::GetEntryFileName(const String& fileName, unsigned nMaxResolution, int type)
+{
+	uint64_t hash;
+	if (!ImageCacheInternal::FingerprintFile(fileName, hash))
+		return String();
+	return path + String::FormatString("%016llx_%u_%d.img", (unsigned long long)hash, nMaxResolution, type);
+} // GetEntryFileName
+/*----------------------------------------------------------------*/
+
+// load the image of the given type and level from the cache, if present
+bool ImageCache::Load(const String& fileName, unsigned nMaxResolution, cv::Mat& image, int type, cv::Size& originalSize)
+{
+	if (!IsEnabled())
+		return false;
+	const String entryFileName(GetEntryFileName(fileName, nMaxResolution, type));
+	if (entryFileName.empty())
+		return false;
+	File f(entryFileName, File::READ, File::OPEN);
+	if (!f.isOpen()) {
+		Thread::safeInc(nMisses);
+		return false;
+	}
+	ImageCacheInternal::EntryHeader header;
+	if (f.read(&header, sizeof(header)) != sizeof(header) ||
+		header.magic != ImageCacheInternal::EntryHeader::MAGIC || header.type != type ||
+		header.rows <= 0 || header.cols <= 0) {
+		Thread::safeInc(nMisses);
+		return false;
+	}
+	cv::Mat cached(header.rows, header.cols, type);
+	const size_t size(cached.total()*cached.elemSize());
+	if (f.read(cached.data, size) != size) {
+		Thread::safeInc(nMisses);
+		return false;
+	}
+	f.close();
+	// mark the entry as recently used
+	std::error_code ec;
+	std::filesystem::last_write_time(static_cast<const std::string&>(entryFileName), std::filesystem::file_time_type::clock::now(), ec);
+	image = cached;
+	originalSize = cv::Size(header.originalWidth, header.originalHeight);
+	Thread::safeInc(nHits);
+	return true;
+} // Load
+/*----------------------------------------------------------------*/
+
+// store the given image level in the cache;
+// the entry is written to a temporary file first and renamed,
+// so that concurrent readers never see a partial entry
+bool ImageCache::Save(const String& fileName, unsigned nMaxResolution, const cv::Mat& image, const cv::Size& originalSize)
+{
+	if (!IsEnabled() || image.empty())
+		return false;
+	const String entryFileName(GetEntryFileName(fileName, nMaxResolution, image.type()));
+	if (entryFileName.empty())
+		return false;
+	const int32_t idxStore(Thread::safeInc(nStores));
+	const String tmpFileName(entryFileName + String::FormatString(".%d.tmp", idxStore));
+	{
+		File f(tmpFileName, File::WRITE, File::CREATE | File::TRUNCATE);
+		if (!f.isOpen())
+			return false;
+		ImageCacheInternal::EntryHeader header;
+		header.magic = ImageCacheInternal::EntryHeader::MAGIC;
+		header.type = image.type();
+		header.originalWidth = originalSize.width;
+		header.originalHeight = originalSize.height;
+		header.rows = image.rows;
+		header.cols = image.cols;
+		bool bValid(f.write(&header, sizeof(header)) == sizeof(header));
+		const size_t rowSize(image.cols*image.elemSize());
+		for (int r=0; bValid && r<image.rows; ++r)
+			bValid = (f.write(image.ptr(r), rowSize) == rowSize);
+		f.close();
+		if (!bValid || !File::renameFile(tmpFileName, entryFileName)) {
+			File::deleteFile(tmpFileName);
+			return false;
+		}
+	}
+	Lock l(cs);
+	currentSize += sizeof(ImageCacheInternal::EntryHeader) + image.total()*image.elemSize();
+	if (maxSize > 0 && currentSize > maxSize)
+		Trim();
+	return true;
+} // Save
+/*----------------------------------------------------------------*/
+
+// remove the least recently used entries till the cache size
+// drops under 90% of the limit (to avoid trimming at each store);
+// the cache critical section must be locked
+void ImageCache::Trim()
+{
+	struct Entry {
+		std::filesystem::path path;
+		std::filesystem::file_time_type time;
+		size_t size;
+		bool operator < (const Entry& rhs) const { return time < rhs.time; }
+	};
+	std::vector<Entry> entries;
+	currentSize = 0;
+	std::error_code ec;
+	for (const auto& entry: std::filesystem::directory_iterator(static_cast<const std::string&>(path), ec)) {
+		if (!entry.is_regular_file(ec) || entry.path().extension() != ".img")
+			continue;
+		entries.push_back({entry.path(), entry.last_write_time(ec), (size_t)entry.file_size(ec)});
+		currentSize += entries.back().size;
+	}
+	const size_t targetSize(maxSize*9/10);
+	if (currentSize <= targetSize)
+		return;
+	std::sort(entries.begin(), entries.end());
+	size_t nRemoved(0);
+	for (const Entry& entry: entries) {
+		if (currentSize <= targetSize)
+			break;
+		if (std::filesystem::remove(entry.path, ec)) {
+			currentSize -= entry.size;
+			++nRemoved;
+		}
+	}
+	DEBUG_ULTIMATE("Image cache trimmed: %u entries removed (%s used)", (unsigned)nRemoved, Util::formatBytes((int64_t)currentSize).c_str());
+} // Trim
+/*----------------------------------------------------------------*/
+
+// log the cache usage statistics
+void ImageCache::PrintStatistics()
+{
+	if (!IsEnabled())
+		return;
+	VERBOSE("Image cache: %d hits, %d misses, %d stores (%s used of %s)",
+		nHits, nMisses, nStores,
+		Util::formatBytes((int64_t)currentSize).c_str(),
+		maxSize > 0 ? Util::formatBytes((int64_t)maxSize).c_str() : "unlimited");
+} // PrintStatistics
+/*----------------------------------------------------------------*/
+
+
 IMAGEPTR Image::OpenImage(const String& fileName)
 {
 	#if 0
@@ -65,22 +284,34 @@ IMAGEPTR Image::ReadImageHeader(const String& fileName)
 } // ReadImageHeader
 /*----------------------------------------------------------------*/
 
-IMAGEPTR Image::ReadImage(const String& fileName, Image8U3& image)
+IMAGEPTR Image::ReadImage(const String& fileName, Image8U3& image, unsigned nMaxResolution)
 {
 	IMAGEPTR pImage(OpenImage(fileName));
-	if (pImage != NULL && !ReadImage(pImage, image))
+	if (pImage != NULL && !ReadImage(pImage, image, nMaxResolution))
 		pImage.Release();
 	return pImage;
 } // ReadImage
 /*----------------------------------------------------------------*/
 
-bool Image::ReadImage(IMAGEPTR pImage, Image8U3& image)
+// read the image data;
+// if a max resolution is given, the image is going to be down-scaled to it,
+// so the image data is decoded directly at a reduced size if the image format supports it
+// (the image size is still the original one, the pixels still need to be resized)
+bool Image::ReadImage(IMAGEPTR pImage, Image8U3& image, unsigned nMaxResolution)
 {
 	if (FAILED(pImage->ReadHeader())) {
 		LOG("error: failed loading image header");
 		return false;
 	}
-	image.create(pImage->GetHeight(), pImage->GetWidth());
+	CImage::Size dataWidth(pImage->GetWidth()), dataHeight(pImage->GetHeight());
+	if (nMaxResolution > 0 && MAXF(dataWidth, dataHeight) > nMaxResolution) {
+		const REAL scale(dataWidth > dataHeight ? (REAL)nMaxResolution/dataWidth : (REAL)nMaxResolution/dataHeight);
+		const cv::Size scaledSize(Image8U::computeResize(cv::Size(dataWidth, dataHeight), scale));
+		dataWidth = (CImage::Size)scaledSize.width;
+		dataHeight = (CImage::Size)scaledSize.height;
+		pImage->SetDecodeHint(dataWidth, dataHeight);
+	}
+	image.create(dataHeight, dataWidth);
 	if (FAILED(pImage->ReadData(image.data, PF_R8G8B8, 3, (CImage::Size)image.step))) {
 		LOG("error: failed loading image data");
 		return false;
@@ -93,6 +324,9 @@ bool Image::ReadImage(IMAGEPTR pImage, Image8U3& image)
 bool Image::LoadImage(const String& fileName, unsigned nMaxResolution)
 {
 	name = fileName;
+	// try first the image cache
+	if (LoadCachedImage(nMaxResolution))
+		return true;
 	// open image file
 	IMAGEPTR pImage(OpenImage(fileName));
 	if (pImage == NULL) {
@@ -100,12 +334,13 @@ bool Image::LoadImage(const String& fileName, unsigned nMaxResolution)
 		return false;
 	}
 	// create and fill image data
-	if (!ReadImage(pImage, image)) {
+	if (!ReadImage(pImage, image, nMaxResolution)) {
 		LOG("error: failed loading image '%s'", name.c_str());
 		return false;
 	}
 	// resize image if needed
-	scale = ResizeImage(nMaxResolution);
+	scale = ResizeImage(cv::Size(pImage->GetWidth(), pImage->GetHeight()), nMaxResolution);
+	ImageCache::Save(name, nMaxResolution, image, cv::Size(pImage->GetWidth(), pImage->GetHeight()));
 	return true;
 } // LoadImage
 /*----------------------------------------------------------------*/
@@ -113,20 +348,29 @@ bool Image::LoadImage(const String& fileName, unsigned nMaxResolution)
 // open the stored image file name and read again the image data
 bool Image::ReloadImage(unsigned nMaxResolution, bool bLoadPixels)
 {
-	IMAGEPTR pImage(bLoadPixels ? ReadImage(name, image) : ReadImageHeader(name));
+	if (bLoadPixels && LoadCachedImage(nMaxResolution))
+		return true;
+	IMAGEPTR pImage(bLoadPixels ? ReadImage(name, image, nMaxResolution) : ReadImageHeader(name));
 	if (pImage == NULL) {
 		LOG("error: failed reloading image '%s'", name.c_str());
 		return false;
 	}
-	if (!bLoadPixels) {
-		// init image size
-		width = pImage->GetWidth();
-		height = pImage->GetHeight();
-	}
 	// resize image if needed
-	scale = ResizeImage(nMaxResolution);
+	scale = ResizeImage(cv::Size(pImage->GetWidth(), pImage->GetHeight()), nMaxResolution);
+	if (bLoadPixels)
+		ImageCache::Save(name, nMaxResolution, image, cv::Size(pImage->GetWidth(), pImage->GetHeight()));
 	return true;
 } // ReloadImage
+
+// load the image data at the given max resolution from the image cache, if enabled and present
+bool Image::LoadCachedImage(unsigned nMaxResolution)
+{
+	cv::Size originalSize;
+	if (!ImageCache::Load(name, nMaxResolution, image, CV_8UC3, originalSize))
+		return false;
+	scale = ResizeImage(originalSize, nMaxResolution);
+	return true;
+} // LoadCachedImage
 /*----------------------------------------------------------------*/
 
 // free the image data
@@ -144,14 +388,23 @@ float Image::ResizeImage(unsigned nMaxResolution)
 		width = image.width();
 		height = image.height();
 	}
-	if (nMaxResolution == 0 || MAXF(width,height) <= nMaxResolution)
-		return 1.f;
-	const REAL scale(width > height ? (REAL)nMaxResolution/width : (REAL)nMaxResolution/height);
-	const cv::Size scaledSize(Image8U::computeResize(GetSize(), scale));
-	width = (uint32_t)scaledSize.width;
-	height = (uint32_t)scaledSize.height;
-	if (!image.empty())
-		cv::resize(image, image, scaledSize, 0, 0, cv::INTER_AREA);
+	return ResizeImage(GetSize(), nMaxResolution);
+}
+// resize the image data, possibly decoded already at a reduced size,
+// to the size corresponding to the max resolution of the given original image size
+float Image::ResizeImage(const cv::Size& originalSize, unsigned nMaxResolution)
+{
+	width = (uint32_t)originalSize.width;
+	height = (uint32_t)originalSize.height;
+	REAL scale(1);
+	if (nMaxResolution > 0 && MAXF(width,height) > nMaxResolution) {
+		scale = (width > height ? (REAL)nMaxResolution/width : (REAL)nMaxResolution/height);
+		const cv::Size scaledSize(Image8U::computeResize(originalSize, scale));
+		width = (uint32_t)scaledSize.width;
+		height = (uint32_t)scaledSize.height;
+	}
+	if (!image.empty() && image.size() != GetSize())
+		cv::resize(image, image, GetSize(), 0, 0, cv::INTER_AREA);
 	return static_cast<float>(scale);
 } // ResizeImage
 /*----------------------------------------------------------------*/
@@ -434,3 +687,50 @@ bool Image::Depth2Disparity(const Matrix4x4& Q, const Point2f& u, float d, float
 	return true;
 }
 /*----------------------------------------------------------------*/
+
+
+// compare loading the images at the given resolution by decoding them at full size and resizing,
+// with decoding them directly at a reduced size, reporting the time and the decoded pixels memory of each
+bool MVS::TestImageDecodeScaled(const ImageArr& images, unsigned nMaxResolution)
+{
+	Timer::SysType timeFull(0), timeScaled(0);
+	size_t memFull(0), memScaled(0);
+	unsigned numImages(0);
+	double maxMeanDiff(0);
+	for (const Image& imageData: images) {
+		if (!imageData.IsValid())
+			continue;
+		Image imageFull, imageScaled;
+		imageFull.name = imageScaled.name = imageData.name;
+		Timer::SysType timeStart(Timer::GetSysTime());
+		IMAGEPTR pImage(Image::ReadImage(imageFull.name, imageFull.image));
+		if (pImage == NULL)
+			return false;
+		memFull += imageFull.image.area()*3;
+		imageFull.ResizeImage(nMaxResolution);
+		timeFull += Timer::GetSysTime()-timeStart;
+		timeStart = Timer::GetSysTime();
+		if (!imageScaled.ReloadImage(nMaxResolution))
+			return false;
+		memScaled += imageScaled.image.area()*3;
+		timeScaled += Timer::GetSysTime()-timeStart;
+		// both images should have the same size and very similar pixels
+		if (imageFull.GetSize() != imageScaled.GetSize() || imageFull.image.size() != imageScaled.image.size()) {
+			VERBOSE("error: image '%s' decoded scaled has size %dx%d instead of %dx%d", imageData.name.c_str(),
+				imageScaled.image.width(), imageScaled.image.height(), imageFull.image.width(), imageFull.image.height());
+			return false;
+		}
+		cv::Mat diff;
+		cv::absdiff(imageFull.image, imageScaled.image, diff);
+		const cv::Scalar meanDiff(cv::mean(diff));
+		maxMeanDiff = MAXF(maxMeanDiff, (meanDiff[0]+meanDiff[1]+meanDiff[2])/3);
+		++numImages;
+	}
+	VERBOSE("Image decoding at %u resolution for %u images: full %s (%s pixels), scaled %s (%s pixels), %.2f max mean difference",
+		nMaxResolution, numImages,
+		Util::formatTime((int64_t)Timer::SysTime2TimeMs(timeFull)).c_str(), Util::formatBytes(memFull).c_str(),
+		Util::formatTime((int64_t)Timer::SysTime2TimeMs(timeScaled)).c_str(), Util::formatBytes(memScaled).c_str(),
+		maxMeanDiff);
+	return maxMeanDiff < 4;
+}
+/*----------------------------------------------------------------*/
@@ -51,6 +51,36 @@ typedef _INTERFACE_NAMESPACE::Interface::Image::ViewScore ViewScore;
 typedef MVS_API CLISTDEF0IDX(ViewScore, IIndex) ViewScoreArr;
 /*----------------------------------------------------------------*/
 
+// content-addressed on-disk cache of the decoded and scaled image levels,
+// shared across the pipeline stages (and runs) to avoid decoding the same
+// image at the same resolution again; the entries are keyed by a fingerprint
+// of the source file content plus the max resolution and pixel type,
+// and the least recently used ones are removed to keep the cache under the size limit
+class MVS_API ImageCache
+{
+public:
+	static bool Init(const String& folder, size_t maxSize=0);
+	static bool IsEnabled() { return !path.empty(); }
+
+	static bool Load(const String& fileName, unsigned nMaxResolution, cv::Mat& image, int type, cv::Size& originalSize);
+	static bool Save(const String& fileName, unsigned nMaxResolution, const cv::Mat& image, const cv::Size& originalSize);
+
+	static void PrintStatistics();
+
+protected:
+	static String GetEntryFileName(const String& fileName, unsigned nMaxResolution, int type);
+	static void Trim();
+
+protected:
+	static String path; // cache folder (empty if disabled)
+	static size_t maxSize; // max size in bytes of the cache folder (0 - unlimited)
+	static size_t currentSize; // estimated size in bytes of the cache folder
+	static volatile int32_t nHits, nMisses, nStores;
+	static CriticalSection cs;
+};
+/*----------------------------------------------------------------*/
+
+
 // a view instance seeing the scene
 class MVS_API Image
 {
@@ -80,12 +110,14 @@ public:
 	// read image data from the file
 	static IMAGEPTR OpenImage(const String& fileName);
 	static IMAGEPTR ReadImageHeader(const String& fileName);
-	static IMAGEPTR ReadImage(const String& fileName, Image8U3& image);
-	static bool ReadImage(IMAGEPTR pImage, Image8U3& image);
+	static IMAGEPTR ReadImage(const String& fileName, Image8U3& image, unsigned nMaxResolution=0);
+	static bool ReadImage(IMAGEPTR pImage, Image8U3& image, unsigned nMaxResolution=0);
 	bool LoadImage(const String& fileName, unsigned nMaxResolution=0);
 	bool ReloadImage(unsigned nMaxResolution=0, bool bLoadPixels=true);
+	bool LoadCachedImage(unsigned nMaxResolution);
 	void ReleaseImage();
 	float ResizeImage(unsigned nMaxResolution=0);
+	float ResizeImage(const cv::Size& originalSize, unsigned nMaxResolution);
 	unsigned RecomputeMaxResolution(unsigned& level, unsigned minImageSize, unsigned maxImageSize=INT_MAX) const;
 
 	Image GetImage(const PlatformArr& platforms, double scale, bool bUseImage=true) const;
@@ -143,6 +175,9 @@ public:
 typedef MVS_API CLISTDEF2IDX(Image,IIndex) ImageArr;
 /*----------------------------------------------------------------*/
 
+MVS_API bool TestImageDecodeScaled(const ImageArr& images, unsigned nMaxResolution);
+/*----------------------------------------------------------------*/
+
 } // namespace MVS
 
 #endif // _MVS_VIEW_H_
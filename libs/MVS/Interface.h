@@ -792,6 +792,41 @@ struct HeaderDepthDataRaw {
 };
 /*----------------------------------------------------------------*/
 
+// interface used to export/import MVS depth-map data split in compressed tiles;
+// see MVS::ExportDepthDataTiled() and MVS::ImportDepthDataRaw() for usage example:
+//  - the file starts with the same data as the raw format, up to and including the pose,
+//    with the difference that the name in HeaderDepthDataRaw is HeaderDepthDataTiledName()
+//  - followed by this header
+//  - followed by the tiles index: for each map present (in the order depth, normal, confidence, views)
+//    and each tile (in row-major order) the position in the file and size of the compressed tile
+//  - followed by the tiles, each compressed as a PNG image, with the values encoded as:
+//     - LOSSLESS: the float values of depth, normal and confidence maps bit-copied in 8-bit 4-channel images
+//     - COMPACT: depth quantized to 16-bit in log-space between depthMin and depthMax (0 - invalid),
+//       normal octahedral-encoded to 2x16-bit (0 - invalid), confidence quantized to 8-bit between 0 and confMax
+//  - the views-map is always stored lossless
+struct HeaderDepthDataTiled {
+	enum { VERSION = 1 };
+	enum ENCODING {
+		LOSSLESS = 0,
+		COMPACT = 1,
+	};
+	struct Tile {
+		uint64_t offset; // position of the compressed tile from the beginning of the file
+		uint32_t size; // size of the compressed tile
+		uint32_t reserved;
+	};
+	uint16_t version; // file format version
+	uint16_t tileSize; // tile width and height in pixels
+	uint8_t encoding; // how the values are encoded
+	uint8_t padding[3]; // reserve
+	float depthMin, depthMax; // depth range used for quantization
+	float confMax; // confidence range used for quantization
+	// tiles index: Tile tiles[numMaps][numTilesY][numTilesX]
+	inline HeaderDepthDataTiled() : version(VERSION), tileSize(0), encoding(LOSSLESS), padding{0,0,0}, depthMin(0), depthMax(0), confMax(0) {}
+	static uint16_t HeaderDepthDataTiledName() { return *reinterpret_cast<const uint16_t*>("DT"); }
+};
+/*----------------------------------------------------------------*/
+
 } // namespace _INTERFACE_NAMESPACE
 
 #endif // _INTERFACE_MVS_H_
@@ -0,0 +1,233 @@
+/*
+* MaxFlow.cpp
+*
+* Copyright (c) 2014-2015 SEACAVE
+*
+* Author(s):
+*
+*      cDc <cdc.seacave@gmail.com>
+*
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Affero General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Affero General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*
+* Additional Terms:
+*
+*      You are required to preserve legal notices and author attributions in
+*      that material or in the Appropriate Legal Notices displayed by works
+*      containing it.
+*/
+
+
+#include "Common.h"
+#include "MaxFlow.h"
+
+using namespace MVS;
+
+
+// D E F I N E S ///////////////////////////////////////////////////
+
+
+// S T R U C T S ///////////////////////////////////////////////////
+
+namespace MVS {
+namespace OPTMESH {
+unsigned nMaxFlowType(MAXFLOW_DEFAULT);
+String strExportGraphFileName;
+unsigned nInsertThreads(1);
+} // namespace OPTMESH
+} // namespace MVS
+
+LPCSTR MVS::MaxFlowTypeName(unsigned type)
+{
+	switch (type) {
+	case MAXFLOW_IBFS: return "IBFS";
+	case MAXFLOW_BK: return "Boykov-Kolmogorov";
+	case MAXFLOW_REGIONS: return "region-parallel";
+	}
+	return "unknown";
+}
+bool MVS::IsMaxFlowTypeAvailable(unsigned type)
+{
+	switch (type) {
+	#ifdef MVS_MAXFLOW_IBFS
+	case MAXFLOW_IBFS:
+	#endif
+	case MAXFLOW_BK:
+	case MAXFLOW_REGIONS:
+		return true;
+	}
+	return false;
+}
+/*----------------------------------------------------------------*/
+
+
+namespace {
+// same node and capacity types as the graph built by the mesh reconstruction
+typedef uint32_t node_t;
+typedef float value_t;
+typedef MaxFlowGraph<node_t,value_t> graph_t;
+
+// replay the recorded graph on the max-flow solver of type MAXFLOW and log the statistics;
+// the labels of the first run are used as reference to validate the following ones
+template <typename MAXFLOW>
+void BenchmarkMaxFlowType(const graph_t& graph, unsigned type, unsigned nRepeats, std::vector<bool>& refLabels)
+{
+	for (unsigned r=0; r<nRepeats; ++r) {
+		const size_t memStart(Util::GetProcessMemory());
+		const Timer::SysType timeStart(Timer::GetSysTime());
+		Timer::Type timeBuild, timeSolve;
+		size_t memBuild, memSolve;
+		value_t flow;
+		std::vector<bool> labels(graph.GetNumNodes());
+		{
+			MAXFLOW maxflow(graph.GetNumNodes(), graph.GetNumEdges());
+			graph.Build(maxflow);
+			const Timer::SysType timeBuilt(Timer::GetSysTime());
+			timeBuild = Timer::SysTime2TimeMs(timeBuilt-timeStart);
+			memBuild = Util::GetProcessMemory();
+			flow = maxflow.ComputeMaxFlow();
+			timeSolve = Timer::SysTime2TimeMs(Timer::GetSysTime()-timeBuilt);
+			memSolve = Util::GetProcessMemory();
+			for (size_t n=0; n<labels.size(); ++n)
+				labels[n] = maxflow.IsNodeOnSrcSide((node_t)n);
+		}
+		size_t numDiffLabels(0);
+		if (refLabels.empty())
+			refLabels.swap(labels);
+		else
+			for (size_t n=0; n<labels.size(); ++n)
+				if (labels[n] != refLabels[n])
+					++numDiffLabels;
+		VERBOSE("Max-flow benchmark %s (run %u): build %s, solve %s, memory %s (peak %s), flow %g, %u nodes labeled differently",
+			MaxFlowTypeName(type), r+1,
+			Util::formatTime((int64_t)timeBuild).c_str(), Util::formatTime((int64_t)timeSolve).c_str(),
+			Util::formatBytes((int64_t)(memBuild > memStart ? memBuild-memStart : 0)).c_str(),
+			Util::formatBytes((int64_t)(MAXF(memBuild, memSolve) > memStart ? MAXF(memBuild, memSolve)-memStart : 0)).c_str(),
+			flow, numDiffLabels);
+	}
+}
+} // unnamed namespace
+
+// load a graph saved by the mesh reconstruction (see OPTMESH::strExportGraphFileName)
+// and replay it on each of the available max-flow algorithms, or only on the given one if type >= 0;
+// the reported memory is the increase of the process resident memory after building the graph,
+// and the peak the maximum increase measured after building and after solving it
+bool MVS::BenchmarkMaxFlow(const String& fileName, int type, unsigned nRepeats)
+{
+	TD_TIMER_STARTD();
+	graph_t graph;
+	if (!graph.Load(fileName)) {
+		VERBOSE("error: failed loading graph '%s'", fileName.c_str());
+		return false;
+	}
+	DEBUG_EXTRA("Graph loaded: %u nodes, %u edges (%s)", graph.GetNumNodes(), graph.GetNumEdges(), TD_TIMER_GET_FMT().c_str());
+	std::vector<bool> refLabels;
+	for (unsigned t=0; t<MAXFLOW_NUM; ++t) {
+		if (type >= 0 && (unsigned)type != t)
+			continue;
+		if (!IsMaxFlowTypeAvailable(t)) {
+			VERBOSE("Max-flow benchmark %s: not available", MaxFlowTypeName(t));
+			continue;
+		}
+		switch (t) {
+		#ifdef MVS_MAXFLOW_IBFS
+		case MAXFLOW_IBFS:
+			BenchmarkMaxFlowType< MaxFlowIBFS<node_t,value_t> >(graph, t, nRepeats, refLabels);
+			break;
+		#endif
+		case MAXFLOW_BK:
+			BenchmarkMaxFlowType< MaxFlowBK<node_t,value_t> >(graph, t, nRepeats, refLabels);
+			break;
+		case MAXFLOW_REGIONS:
+			BenchmarkMaxFlowType< MaxFlowRegions<node_t,value_t> >(graph, t, nRepeats, refLabels);
+			break;
+		}
+	}
+	return true;
+} // BenchmarkMaxFlow
+/*----------------------------------------------------------------*/
+
+
+// solve a random graph on a 3D grid of the given size with each of the available max-flow algorithms,
+// checking that the flows agree (up to the float precision) and that the labels of each define a cut
+// of the same value as the flow (the labels can differ where the minimum cut is not unique)
+bool MVS::TestMaxFlow(unsigned size)
+{
+	typedef graph_t::Node Node;
+	typedef graph_t::Edge Edge;
+	SEACAVE::Random rnd;
+	const size_t numNodes((size_t)size*size*size);
+	std::vector<Node> nodes(numNodes);
+	std::vector<Edge> edges;
+	edges.reserve(numNodes*3);
+	for (size_t n=0; n<numNodes; ++n) {
+		nodes[n].source = rnd.randomRange(0.f, 1.f);
+		nodes[n].sink = rnd.randomRange(0.f, 1.f);
+		// link each node to the next one on each axis
+		const size_t x(n%size), y((n/size)%size), z(n/((size_t)size*size));
+		if (x+1 < size)
+			edges.emplace_back(Edge{(node_t)n, (node_t)(n+1), rnd.randomRange(0.f, 2.f), rnd.randomRange(0.f, 2.f)});
+		if (y+1 < size)
+			edges.emplace_back(Edge{(node_t)n, (node_t)(n+size), rnd.randomRange(0.f, 2.f), rnd.randomRange(0.f, 2.f)});
+		if (z+1 < size)
+			edges.emplace_back(Edge{(node_t)n, (node_t)(n+(size_t)size*size), rnd.randomRange(0.f, 2.f), rnd.randomRange(0.f, 2.f)});
+	}
+	const auto CutValue = [&](const std::vector<bool>& labels) {
+		double cut(0);
+		for (size_t n=0; n<numNodes; ++n)
+			cut += labels[n] ? nodes[n].sink : nodes[n].source;
+		for (const Edge& e: edges) {
+			if (labels[e.n1] && !labels[e.n2])
+				cut += e.capacity;
+			else if (!labels[e.n1] && labels[e.n2])
+				cut += e.reverseCapacity;
+		}
+		return cut;
+	};
+	const auto BuildGraph = [&](auto& graph) {
+		for (size_t n=0; n<numNodes; ++n)
+			graph.AddNode((node_t)n, nodes[n].source, nodes[n].sink);
+		for (const Edge& e: edges)
+			graph.AddEdge(e.n1, e.n2, e.capacity, e.reverseCapacity);
+	};
+	double refFlow(-1);
+	for (unsigned t=0; t<MAXFLOW_NUM; ++t) {
+		if (!IsMaxFlowTypeAvailable(t))
+			continue;
+		std::vector<bool> labels;
+		double flow;
+		if (t == MAXFLOW_REGIONS) {
+			// force the regions, so that they are solved even if only one thread is available
+			MaxFlowRegions<node_t,value_t> graph(numNodes, edges.size(), 4);
+			BuildGraph(graph);
+			flow = graph.ComputeMaxFlow();
+			labels.resize(numNodes);
+			for (size_t n=0; n<numNodes; ++n)
+				labels[n] = graph.IsNodeOnSrcSide((node_t)n);
+		} else {
+			flow = ComputeMaxFlow<node_t,value_t>(t, numNodes, edges.size(), BuildGraph, labels);
+		}
+		const double cut(CutValue(labels));
+		const double th(1e-3*MAXF(flow, 1.0));
+		if (ABS(cut-flow) > th || (refFlow >= 0 && ABS(flow-refFlow) > th)) {
+			VERBOSE("error: max-flow %s: flow %g, cut %g, reference flow %g", MaxFlowTypeName(t), flow, cut, refFlow);
+			return false;
+		}
+		if (refFlow < 0)
+			refFlow = flow;
+	}
+	return true;
+} // TestMaxFlow
+/*----------------------------------------------------------------*/
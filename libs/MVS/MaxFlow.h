@@ -0,0 +1,518 @@
+/*
+* MaxFlow.h
+*
+* Copyright (c) 2014-2015 SEACAVE
+*
+* Author(s):
+*
+*      cDc <cdc.seacave@gmail.com>
+*
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Affero General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Affero General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*
+* Additional Terms:
+*
+*      You are required to preserve legal notices and author attributions in
+*      that material or in the Appropriate Legal Notices displayed by works
+*      containing it.
+*/
+
+#ifndef _MVS_MAXFLOW_H_
+#define _MVS_MAXFLOW_H_
+
+
+// I N C L U D E S /////////////////////////////////////////////////
+
+#include <boost/graph/graph_traits.hpp>
+#include <boost/graph/one_bit_color_map.hpp>
+#include <boost/property_map/property_map.hpp>
+#include <boost/graph/adjacency_list.hpp>
+#include <boost/graph/boykov_kolmogorov_max_flow.hpp>
+
+
+// D E F I N E S ///////////////////////////////////////////////////
+
+// uncomment to enable IBFS algorithm for max-flow
+// (faster, but not clear license policy)
+#define MVS_MAXFLOW_IBFS
+
+#ifdef MVS_MAXFLOW_IBFS
+#include "../Math/IBFS/IBFS.h"
+#endif
+
+
+// S T R U C T S ///////////////////////////////////////////////////
+
+namespace MVS {
+
+// max-flow algorithms available for solving the graph-cut
+enum MAXFLOW_TYPE {
+	MAXFLOW_IBFS = 0, // Incremental Breadth-First Search (only if MVS_MAXFLOW_IBFS is defined)
+	MAXFLOW_BK,       // Boykov-Kolmogorov (boost implementation)
+	MAXFLOW_REGIONS,  // region-parallel: max-flow on regions in parallel, followed by a global pass on the residual graph
+	                  // (the recorded graph is kept till the final solver is built, about doubling the peak memory)
+	MAXFLOW_NUM,
+	#ifdef MVS_MAXFLOW_IBFS
+	MAXFLOW_DEFAULT = MAXFLOW_IBFS
+	#else
+	MAXFLOW_DEFAULT = MAXFLOW_BK
+	#endif
+};
+MVS_API LPCSTR MaxFlowTypeName(unsigned type);
+MVS_API bool IsMaxFlowTypeAvailable(unsigned type);
+
+namespace OPTMESH {
+// configuration variables
+extern unsigned nMaxFlowType; // max-flow algorithm used by the mesh reconstruction graph-cut (see MAXFLOW_TYPE)
+extern String strExportGraphFileName; // if not empty, the graph-cut built by the mesh reconstruction is saved to this file
+extern unsigned nInsertThreads; // number of threads used to decimate and insert the points in the Delaunay triangulation (0 - all cores)
+} // namespace OPTMESH
+/*----------------------------------------------------------------*/
+
+
+#ifdef MVS_MAXFLOW_IBFS
+template <typename NType, typename VType>
+class MaxFlowIBFS
+{
+public:
+	// Type-Definitions
+	typedef NType node_type;
+	typedef VType value_type;
+	typedef IBFS::IBFSGraph graph_type;
+
+public:
+	// the number of edges must be exactly the number of edges added later
+	// (by default two per node, as in the graph of the Delaunay cells)
+	MaxFlowIBFS(size_t numNodes, size_t numEdges=0) {
+		graph.initSize((int)numNodes, (int)(numEdges ? numEdges : numNodes*2));
+	}
+
+	inline void AddNode(node_type n, value_type source, value_type sink) {
+		ASSERT(ISFINITE(source) && source >= 0 && ISFINITE(sink) && sink >= 0);
+		graph.addNode((int)n, source, sink);
+	}
+
+	inline void AddEdge(node_type n1, node_type n2, value_type capacity, value_type reverseCapacity) {
+		ASSERT(ISFINITE(capacity) && capacity >= 0 && ISFINITE(reverseCapacity) && reverseCapacity >= 0);
+		graph.addEdge((int)n1, (int)n2, capacity, reverseCapacity);
+	}
+
+	value_type ComputeMaxFlow() {
+		graph.initGraph();
+		return graph.computeMaxFlow();
+	}
+
+	inline bool IsNodeOnSrcSide(node_type n) const {
+		return graph.isNodeOnSrcSide((int)n);
+	}
+
+	// residual capacities of the terminal edges of the given node after computing the max-flow
+	inline void GetTerminalResiduals(node_type n, value_type& source, value_type& sink) const {
+		graph.getNodeResiduals((int)n, source, sink);
+	}
+	// residual capacities in both directions of the edge between the given nodes after computing the max-flow
+	inline void GetEdgeResiduals(node_type n1, node_type n2, value_type& capacity, value_type& reverseCapacity) const {
+		if (!graph.getEdgeResiduals((int)n1, (int)n2, capacity, reverseCapacity))
+			ASSERT("missing edge" == NULL);
+	}
+
+protected:
+	graph_type graph;
+};
+/*----------------------------------------------------------------*/
+#endif
+
+
+template <typename NType, typename VType>
+class MaxFlowBK
+{
+public:
+	// Type-Definitions
+	typedef NType node_type;
+	typedef VType value_type;
+	typedef boost::vecS out_edge_list_t;
+	typedef boost::vecS vertex_list_t;
+	typedef boost::adjacency_list_traits<out_edge_list_t, vertex_list_t, boost::directedS> graph_traits;
+	typedef typename graph_traits::edge_descriptor edge_descriptor;
+	typedef typename graph_traits::vertex_descriptor vertex_descriptor;
+	typedef typename graph_traits::vertices_size_type vertex_size_type;
+	struct Edge {
+		value_type capacity;
+		value_type residual;
+		edge_descriptor reverse;
+	};
+	typedef boost::adjacency_list<out_edge_list_t, vertex_list_t, boost::directedS, size_t, Edge> graph_type;
+	typedef typename boost::graph_traits<graph_type>::edge_iterator edge_iterator;
+	typedef typename boost::graph_traits<graph_type>::out_edge_iterator out_edge_iterator;
+
+public:
+	MaxFlowBK(size_t numNodes, size_t /*numEdges*/=0) : graph(numNodes+2), S(node_type(numNodes)), T(node_type(numNodes+1)) {}
+
+	void AddNode(node_type n, value_type source, value_type sink) {
+		ASSERT(ISFINITE(source) && source >= 0 && ISFINITE(sink) && sink >= 0);
+		if (source > 0) {
+			edge_descriptor e(boost::add_edge(S, n, graph).first);
+			edge_descriptor er(boost::add_edge(n, S, graph).first);
+			graph[e].capacity = source;
+			graph[e].reverse = er;
+			graph[er].reverse = e;
+		}
+		if (sink > 0) {
+			edge_descriptor e(boost::add_edge(n, T, graph).first);
+			edge_descriptor er(boost::add_edge(T, n, graph).first);
+			graph[e].capacity = sink;
+			graph[e].reverse = er;
+			graph[er].reverse = e;
+		}
+	}
+
+	void AddEdge(node_type n1, node_type n2, value_type capacity, value_type reverseCapacity) {
+		ASSERT(ISFINITE(capacity) && capacity >= 0 && ISFINITE(reverseCapacity) && reverseCapacity >= 0);
+		edge_descriptor e(boost::add_edge(n1, n2, graph).first);
+		edge_descriptor er(boost::add_edge(n2, n1, graph).first);
+		graph[e].capacity = capacity;
+		graph[er].capacity = reverseCapacity;
+		graph[e].reverse = er;
+		graph[er].reverse = e;
+	}
+
+	value_type ComputeMaxFlow() {
+		vertex_size_type n_verts(boost::num_vertices(graph));
+		color.resize(n_verts);
+		std::vector<edge_descriptor> pred(n_verts);
+		std::vector<vertex_size_type> dist(n_verts);
+		return boost::boykov_kolmogorov_max_flow(graph,
+			boost::get(&Edge::capacity, graph),
+			boost::get(&Edge::residual, graph),
+			boost::get(&Edge::reverse, graph),
+			&pred[0],
+			&color[0],
+			&dist[0],
+			boost::get(boost::vertex_index, graph),
+			S, T
+		);
+	}
+
+	inline bool IsNodeOnSrcSide(node_type n) const {
+		return (color[n] != boost::white_color);
+	}
+
+	// residual capacities of the terminal edges of the given node after computing the max-flow
+	void GetTerminalResiduals(node_type n, value_type& source, value_type& sink) const {
+		source = sink = value_type(0);
+		out_edge_iterator ei, eie;
+		for (boost::tie(ei, eie) = boost::out_edges(n, graph); ei != eie; ++ei) {
+			const node_type m((node_type)boost::target(*ei, graph));
+			if (m == S)
+				source = graph[graph[*ei].reverse].residual;
+			else if (m == T)
+				sink = graph[*ei].residual;
+		}
+	}
+	// residual capacities in both directions of the edge between the given nodes after computing the max-flow
+	void GetEdgeResiduals(node_type n1, node_type n2, value_type& capacity, value_type& reverseCapacity) const {
+		out_edge_iterator ei, eie;
+		for (boost::tie(ei, eie) = boost::out_edges(n1, graph); ei != eie; ++ei) {
+			if ((node_type)boost::target(*ei, graph) == n2) {
+				capacity = graph[*ei].residual;
+				reverseCapacity = graph[graph[*ei].reverse].residual;
+				return;
+			}
+		}
+		ASSERT("missing edge" == NULL);
+	}
+
+protected:
+	graph_type graph;
+	std::vector<boost::default_color_type> color;
+	const node_type S;
+	const node_type T;
+};
+/*----------------------------------------------------------------*/
+
+
+// graph recorder exposing the same interface as the max-flow solvers:
+// stores the terminal capacities of each node and the edges in the order they are added,
+// so that the graph can be saved to disk and replayed later on any of the max-flow algorithms
+// (the nodes are replayed first, followed by the edges in their original order)
+template <typename NType, typename VType>
+class MaxFlowGraph
+{
+public:
+	// Type-Definitions
+	typedef NType node_type;
+	typedef VType value_type;
+	struct Node {
+		value_type source;
+		value_type sink;
+	};
+	struct Edge {
+		node_type n1, n2;
+		value_type capacity;
+		value_type reverseCapacity;
+	};
+	struct Header {
+		enum { MAGIC = 0x5246474D /*MGFR*/, VERSION = 1 };
+		uint32_t magic;
+		uint32_t version;
+		uint32_t nodeTypeSize;
+		uint32_t valueTypeSize;
+		uint64_t numNodes;
+		uint64_t numEdges;
+	};
+
+public:
+	MaxFlowGraph(size_t numNodes=0, size_t numEdges=0) : nodes(numNodes, Node{value_type(0), value_type(0)}) {
+		edges.reserve(numEdges ? numEdges : numNodes*2);
+	}
+
+	inline void AddNode(node_type n, value_type source, value_type sink) {
+		ASSERT(ISFINITE(source) && source >= 0 && ISFINITE(sink) && sink >= 0);
+		nodes[n] = Node{source, sink};
+	}
+
+	inline void AddEdge(node_type n1, node_type n2, value_type capacity, value_type reverseCapacity) {
+		ASSERT(ISFINITE(capacity) && capacity >= 0 && ISFINITE(reverseCapacity) && reverseCapacity >= 0);
+		edges.emplace_back(Edge{n1, n2, capacity, reverseCapacity});
+	}
+
+	inline size_t GetNumNodes() const { return nodes.size(); }
+	inline size_t GetNumEdges() const { return edges.size(); }
+
+	// add the recorded nodes and edges to the given max-flow solver
+	template <typename MAXFLOW>
+	void Build(MAXFLOW& graph) const {
+		for (size_t n=0; n<nodes.size(); ++n)
+			graph.AddNode((typename MAXFLOW::node_type)n, nodes[n].source, nodes[n].sink);
+		for (const Edge& e: edges)
+			graph.AddEdge(e.n1, e.n2, e.capacity, e.reverseCapacity);
+	}
+
+	bool Save(const String& fileName) const {
+		File f(fileName, File::WRITE, File::CREATE | File::TRUNCATE);
+		if (!f.isOpen())
+			return false;
+		Header header;
+		header.magic = Header::MAGIC;
+		header.version = Header::VERSION;
+		header.nodeTypeSize = sizeof(node_type);
+		header.valueTypeSize = sizeof(value_type);
+		header.numNodes = nodes.size();
+		header.numEdges = edges.size();
+		return
+			f.write(&header, sizeof(Header)) == sizeof(Header) &&
+			f.write(nodes.data(), sizeof(Node)*nodes.size()) == sizeof(Node)*nodes.size() &&
+			f.write(edges.data(), sizeof(Edge)*edges.size()) == sizeof(Edge)*edges.size();
+	}
+	bool Load(const String& fileName) {
+		File f(fileName, File::READ, File::OPEN);
+		if (!f.isOpen())
+			return false;
+		Header header;
+		if (f.read(&header, sizeof(Header)) != sizeof(Header) ||
+			header.magic != Header::MAGIC || header.version != Header::VERSION ||
+			header.nodeTypeSize != sizeof(node_type) || header.valueTypeSize != sizeof(value_type))
+			return false;
+		nodes.resize((size_t)header.numNodes);
+		edges.resize((size_t)header.numEdges);
+		return
+			f.read(nodes.data(), sizeof(Node)*nodes.size()) == sizeof(Node)*nodes.size() &&
+			f.read(edges.data(), sizeof(Edge)*edges.size()) == sizeof(Edge)*edges.size();
+	}
+
+protected:
+	std::vector<Node> nodes;
+	std::vector<Edge> edges;
+};
+/*----------------------------------------------------------------*/
+
+
+// region-parallel max-flow: the nodes are split in regions of consecutive indices
+// (spatially coherent if the nodes are numbered so, like the Delaunay cells), the flow that can be
+// routed inside each region is computed in parallel, and the remaining flow is found by solving
+// the residual graph of the entire graph (all using the fastest sequential algorithm available);
+// the flow routed inside the regions is a valid flow of the entire graph, so the max-flow
+// (and the minimum cut value) is the same as the one computed directly, only the work
+// left to the sequential pass shrinks; several parallel passes are done, each shifting the regions
+// by a fraction of their size, in order to route also the flow crossing the previous region borders
+template <typename NType, typename VType>
+class MaxFlowRegions : public MaxFlowGraph<NType,VType>
+{
+public:
+	// Type-Definitions
+	typedef MaxFlowGraph<NType,VType> Base;
+	typedef typename Base::node_type node_type;
+	typedef typename Base::value_type value_type;
+	typedef typename Base::Node Node;
+	typedef typename Base::Edge Edge;
+	#ifdef MVS_MAXFLOW_IBFS
+	typedef MaxFlowIBFS<NType,VType> graph_type;
+	#else
+	typedef MaxFlowBK<NType,VType> graph_type;
+	#endif
+
+	enum { minRegionNodes = 64*1024 }; // regions smaller than this are not worth solving separately
+
+public:
+	MaxFlowRegions(size_t numNodes, size_t numEdges=0, unsigned _numRegions=0, unsigned _numPasses=2)
+		: Base(numNodes, numEdges), numRegions(_numRegions), numPasses(_numPasses) {}
+
+	value_type ComputeMaxFlow() {
+		std::vector<Node>& nodes(Base::nodes);
+		std::vector<Edge>& edges(Base::edges);
+		const size_t numNodes(nodes.size());
+		#ifdef _USE_OPENMP
+		const size_t numThreads((size_t)omp_get_max_threads());
+		#else
+		const size_t numThreads(1);
+		#endif
+		// an explicit number of regions is used even if only one thread is available
+		const size_t regions(numRegions ? MINF((size_t)numRegions, numNodes) : MINF(numThreads*2, numNodes/minRegionNodes));
+		value_type flow(0);
+		if (regions > 1 && (numRegions || numThreads > 1)) {
+			// sort the edges by the first node, so that the edges starting in a region are contiguous
+			const auto compareEdges = [](const Edge& a, const Edge& b) { return a.n1 < b.n1; };
+			if (!std::is_sorted(edges.cbegin(), edges.cend(), compareEdges))
+				std::sort(edges.begin(), edges.end(), compareEdges);
+			const size_t regionSize((numNodes+regions-1)/regions);
+			for (unsigned p=0; p<numPasses; ++p) {
+				// region r contains the nodes in [(r-1)*regionSize+offset, r*regionSize+offset)
+				const size_t offset(regionSize*p/numPasses);
+				const size_t numSlots((numNodes-1+regionSize-offset)/regionSize+1);
+				std::vector<value_type> regionFlows(numSlots, value_type(0));
+				#ifdef _USE_OPENMP
+				#pragma omp parallel for schedule(dynamic)
+				for (int_t r=0; r<(int_t)numSlots; ++r) {
+				#else
+				for (size_t r=0; r<numSlots; ++r) {
+				#endif
+					const node_type nBegin((node_type)(r*regionSize+offset > regionSize ? r*regionSize+offset-regionSize : 0));
+					const node_type nEnd((node_type)MINF(r*regionSize+offset, numNodes));
+					if (nBegin >= nEnd)
+						continue;
+					regionFlows[r] = ComputeRegionMaxFlow(nBegin, nEnd);
+				}
+				for (value_type regionFlow: regionFlows)
+					flow += regionFlow;
+			}
+		}
+		// solve the remaining residual graph;
+		// the recorded graph is released as soon as its nodes and edges are added to the solver,
+		// but the edges still coexist with the solver for a while, see MAXFLOW_REGIONS
+		graph.reset(new graph_type(numNodes, edges.size()));
+		for (size_t n=0; n<numNodes; ++n)
+			graph->AddNode((node_type)n, nodes[n].source, nodes[n].sink);
+		std::vector<Node>().swap(nodes);
+		for (const Edge& e: edges)
+			graph->AddEdge(e.n1, e.n2, e.capacity, e.reverseCapacity);
+		std::vector<Edge>().swap(edges);
+		return flow + graph->ComputeMaxFlow();
+	}
+
+	inline bool IsNodeOnSrcSide(node_type n) const {
+		return graph->IsNodeOnSrcSide(n);
+	}
+
+protected:
+	// compute the max-flow routed only through the edges inside the given region,
+	// and replace the capacities of the region with the residual ones
+	value_type ComputeRegionMaxFlow(node_type nBegin, node_type nEnd) {
+		std::vector<Node>& nodes(Base::nodes);
+		std::vector<Edge>& edges(Base::edges);
+		const auto compareEdgeNode = [](const Edge& e, node_type n) { return e.n1 < n; };
+		const auto edgeBegin(std::lower_bound(edges.begin(), edges.end(), nBegin, compareEdgeNode));
+		const auto edgeEnd(std::lower_bound(edgeBegin, edges.end(), nEnd, compareEdgeNode));
+		const auto isInside = [nBegin, nEnd](node_type n) { return n >= nBegin && n < nEnd; };
+		size_t numEdges(0);
+		for (auto e=edgeBegin; e!=edgeEnd; ++e)
+			if (isInside(e->n2))
+				++numEdges;
+		if (numEdges == 0)
+			return value_type(0);
+		graph_type regionGraph(nEnd-nBegin, numEdges);
+		for (node_type n=nBegin; n<nEnd; ++n) {
+			const Node& node(nodes[n]);
+			regionGraph.AddNode(n-nBegin, node.source, node.sink);
+		}
+		for (auto e=edgeBegin; e!=edgeEnd; ++e)
+			if (isInside(e->n2))
+				regionGraph.AddEdge(e->n1-nBegin, e->n2-nBegin, e->capacity, e->reverseCapacity);
+		const value_type flow(regionGraph.ComputeMaxFlow());
+		for (node_type n=nBegin; n<nEnd; ++n) {
+			Node& node(nodes[n]);
+			regionGraph.GetTerminalResiduals(n-nBegin, node.source, node.sink);
+		}
+		for (auto e=edgeBegin; e!=edgeEnd; ++e)
+			if (isInside(e->n2))
+				regionGraph.GetEdgeResiduals(e->n1-nBegin, e->n2-nBegin, e->capacity, e->reverseCapacity);
+		return flow;
+	}
+
+protected:
+	const unsigned numRegions; // number of regions the nodes are split in (0 - twice the number of threads)
+	const unsigned numPasses; // number of parallel passes over shifted regions
+	std::unique_ptr<graph_type> graph; // sequential solver of the final residual graph
+};
+/*----------------------------------------------------------------*/
+
+
+// build the graph using the given functor on the max-flow solver of type MAXFLOW,
+// solve it and store for each node if it is on the source side;
+// the number of edges must be exactly the number of edges added by the functor (see MaxFlowIBFS);
+// the solver is released before returning, keeping only the labels
+template <typename MAXFLOW, typename BUILDER>
+typename MAXFLOW::value_type ComputeMaxFlow(size_t numNodes, size_t numEdges, BUILDER&& build, std::vector<bool>& labels)
+{
+	MAXFLOW graph(numNodes, numEdges);
+	build(graph);
+	const typename MAXFLOW::value_type flow(graph.ComputeMaxFlow());
+	labels.resize(numNodes);
+	for (size_t n=0; n<numNodes; ++n)
+		labels[n] = graph.IsNodeOnSrcSide((typename MAXFLOW::node_type)n);
+	return flow;
+}
+// same as above, selecting the max-flow algorithm at run-time
+template <typename NType, typename VType, typename BUILDER>
+VType ComputeMaxFlow(unsigned type, size_t numNodes, size_t numEdges, BUILDER&& build, std::vector<bool>& labels)
+{
+	switch (type) {
+	#ifdef MVS_MAXFLOW_IBFS
+	case MAXFLOW_IBFS:
+		return ComputeMaxFlow< MaxFlowIBFS<NType,VType> >(numNodes, numEdges, std::forward<BUILDER>(build), labels);
+	#endif
+	case MAXFLOW_BK:
+		return ComputeMaxFlow< MaxFlowBK<NType,VType> >(numNodes, numEdges, std::forward<BUILDER>(build), labels);
+	case MAXFLOW_REGIONS:
+		return ComputeMaxFlow< MaxFlowRegions<NType,VType> >(numNodes, numEdges, std::forward<BUILDER>(build), labels);
+	}
+	ASSERT("unknown max-flow type" == NULL);
+	return ComputeMaxFlow<NType,VType>(MAXFLOW_DEFAULT, numNodes, numEdges, std::forward<BUILDER>(build), labels);
+}
+/*----------------------------------------------------------------*/
+
+
+// load a graph saved by the mesh reconstruction and replay it on each of the available
+// max-flow algorithms (or only on the given one), logging for each the time needed
+// to build and to solve the graph, the memory used and the flow value
+MVS_API bool BenchmarkMaxFlow(const String& fileName, int type=-1, unsigned nRepeats=1);
+
+// solve a random graph on a 3D grid of the given size with each of the available max-flow algorithms,
+// checking that the flows agree and that the labels of each define a cut of the same value
+MVS_API bool TestMaxFlow(unsigned size);
+/*----------------------------------------------------------------*/
+
+} // namespace MVS
+
+#endif // _MVS_MAXFLOW_H_
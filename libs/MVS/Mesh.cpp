@@ -3549,6 +3549,70 @@ void Mesh::CloseHoleQuality(VertexIdxArr& verts)
 		verts.RemoveAtMove(idxV);
 	}
 }
+
+// close the holes bounded by a loop of at most nMaxEdges edges (all if 0);
+// if any regions are given, only the holes with at least one vertex inside a region are closed
+// (the loops passing more than once through the same vertex are skipped);
+// returns the number of holes closed
+unsigned Mesh::CloseHoles(unsigned nMaxEdges, const std::vector<Box>& regions)
+{
+	if (vertexFaces.size() != vertices.size())
+		ListIncidentFaces();
+	// link each border vertex to the next one along the hole loop,
+	// walking the border edges opposite to the orientation of their face
+	std::unordered_map<VIndex,VIndex> mapNextVertex;
+	std::unordered_set<VIndex> setAmbiguousVertices;
+	FaceIdxArr adjFaces;
+	for (const Face& face: faces) {
+		for (int v=0; v<3; ++v) {
+			const VIndex a(face[v]), b(face[(v+1)%3]);
+			adjFaces.Empty();
+			GetAdjVertexFaces(a, b, adjFaces);
+			if (adjFaces.size() != 1)
+				continue;
+			if (!mapNextVertex.emplace(b, a).second)
+				setAmbiguousVertices.emplace(b);
+		}
+	}
+	// extract the loops and close the ones selected
+	const auto IsInsideRegions = [&](VIndex idxV) {
+		for (const Box& region: regions)
+			if (region.Intersects(vertices[idxV]))
+				return true;
+		return false;
+	};
+	unsigned numHoles(0);
+	std::unordered_set<VIndex> setVisitedVertices;
+	VertexIdxArr vertsLoop;
+	for (const auto& link: mapNextVertex) {
+		if (setVisitedVertices.count(link.first))
+			continue;
+		vertsLoop.Empty();
+		bool bValid(true);
+		VIndex idxV(link.first);
+		do {
+			if (!setVisitedVertices.emplace(idxV).second || setAmbiguousVertices.count(idxV)) {
+				bValid = false;
+				break;
+			}
+			vertsLoop.emplace_back(idxV);
+			const auto itNext(mapNextVertex.find(idxV));
+			if (itNext == mapNextVertex.end()) {
+				bValid = false;
+				break;
+			}
+			idxV = itNext->second;
+		} while (idxV != link.first);
+		if (!bValid || vertsLoop.size() < 3 || (nMaxEdges && vertsLoop.size() > nMaxEdges))
+			continue;
+		if (!regions.empty() && std::none_of(vertsLoop.begin(), vertsLoop.end(), IsInsideRegions))
+			continue;
+		CloseHoleQuality(vertsLoop);
+		++numHoles;
+	}
+	DEBUG_ULTIMATE("Closed %u holes (%u border vertices)", numHoles, mapNextVertex.size());
+	return numHoles;
+} // CloseHoles
 /*----------------------------------------------------------------*/
 
 
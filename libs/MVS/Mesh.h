@@ -190,6 +190,7 @@ public:
 	void Decimate(VertexIdxArr& verticesRemove);
 	void CloseHole(VertexIdxArr& vertsLoop);
 	void CloseHoleQuality(VertexIdxArr& vertsLoop);
+	unsigned CloseHoles(unsigned nMaxEdges, const std::vector<Box>& regions=std::vector<Box>());
 	FIndex RemoveDegenerateFaces(Type thArea=1e-10f);
 	FIndex RemoveDegenerateFaces(unsigned maxIterations, Type thArea=1e-10f);
 	void RemoveFacesOutside(const OBB3f&);
@@ -323,6 +323,21 @@ bool PointCloud::Load(const String& fileName)
 	ASSERT(!fileName.empty());
 	Release();
 
+	// fast path for the binary files having the layout written by PointCloudStreamWriter:
+	// read them in chunks directly into the reserved arrays
+	{
+		PointCloudStreamReader reader;
+		if (reader.Open(fileName)) {
+			if (!reader.ReadAll(*this) || points.empty()) {
+				Release();
+				DEBUG_EXTRA("error: invalid point-cloud");
+				return false;
+			}
+			DEBUG_EXTRA("Point-cloud '%s' loaded: %u points (%s)", Util::getFileNameExt(fileName).c_str(), points.size(), TD_TIMER_GET_FMT().c_str());
+			return true;
+		}
+	}
+
 	// open PLY file and read header
 	using namespace PointCloudInternal;
 	PLY ply;
@@ -707,4 +722,357 @@ void PointCloud::PrintStatistics(const Image* pImages, const OBB3f* pObb) const
 		strColors.c_str()
 	);
 } // PrintStatistics
-/*----------------------------------------------------------------*/
\ No newline at end of file
+/*----------------------------------------------------------------*/
+
+
+// layout of the streamed point-cloud PLY files:
+// binary little-endian, only vertices, with the properties in the same order as in PointCloud::Save()
+namespace PointCloudInternal {
+namespace StreamPLY {
+	// number of digits used to store the number of vertices in the header,
+	// large enough to be updated in place once all points are written
+	enum { NUM_DIGITS = 20 };
+	static const char* propsPoint[] = {"property float x", "property float y", "property float z"};
+	static const char* propsColor[] = {"property uchar red", "property uchar green", "property uchar blue"};
+	static const char* propsNormal[] = {"property float nx", "property float ny", "property float nz"};
+	static const char* propsViews[] = {"property list uchar uint view_indices", "property list uchar float view_weights"};
+
+	template <typename TYPE>
+	inline void Put(CLISTDEF0(uint8_t)& buffer, const TYPE& val) {
+		buffer.Join(reinterpret_cast<const uint8_t*>(&val), sizeof(TYPE));
+	}
+	template <typename TYPE>
+	inline TYPE Get(const uint8_t*& data) {
+		TYPE val;
+		memcpy(&val, data, sizeof(TYPE));
+		data += sizeof(TYPE);
+		return val;
+	}
+} // namespace StreamPLY
+} // namespace PointCloudInternal
+
+bool PointCloudStreamWriter::Open(const String& fileName, bool _bColors, bool _bNormals, bool _bViews)
+{
+	using namespace PointCloudInternal;
+	ASSERT(!fileName.empty());
+	Close();
+	Util::ensureFolder(fileName);
+	file.open(fileName, File::WRITE, File::CREATE | File::TRUNCATE);
+	if (!file.isOpen()) {
+		DEBUG_EXTRA("error: can not create point-cloud file '%s'", fileName.c_str());
+		return false;
+	}
+	bColors = _bColors;
+	bNormals = _bNormals;
+	bViews = _bViews;
+	numPoints = 0;
+	// write the header, with a place-holder for the number of points
+	String header("ply\nformat binary_little_endian 1.0\nelement vertex ");
+	posNumPoints = header.length();
+	header += String((size_t)StreamPLY::NUM_DIGITS, '0') + "\n";
+	const auto AddProps = [&header](const char** props, size_t numProps) {
+		for (size_t p=0; p<numProps; ++p)
+			header += String(props[p]) + "\n";
+	};
+	AddProps(StreamPLY::propsPoint, 3);
+	if (bColors)
+		AddProps(StreamPLY::propsColor, 3);
+	if (bNormals)
+		AddProps(StreamPLY::propsNormal, 3);
+	if (bViews)
+		AddProps(StreamPLY::propsViews, 2);
+	header += "end_header\n";
+	return file.write(header.c_str(), header.length()) == header.length();
+}
+
+// append the given points to the file
+bool PointCloudStreamWriter::Write(const PointCloud& chunk)
+{
+	using namespace PointCloudInternal;
+	ASSERT(IsOpen());
+	ASSERT(!bColors || chunk.colors.size() == chunk.points.size());
+	ASSERT(!bNormals || chunk.normals.size() == chunk.points.size());
+	ASSERT(!bViews || (chunk.pointViews.size() == chunk.points.size() && chunk.pointWeights.size() == chunk.points.size()));
+	buffer.clear();
+	FOREACH(i, chunk.points) {
+		const PointCloud::Point& X = chunk.points[i];
+		if (pROI && !pROI->Intersects(X))
+			continue;
+		StreamPLY::Put(buffer, X);
+		if (bColors)
+			StreamPLY::Put(buffer, chunk.colors[i]);
+		if (bNormals)
+			StreamPLY::Put(buffer, chunk.normals[i]);
+		if (bViews) {
+			const PointCloud::ViewArr& views = chunk.pointViews[i];
+			const PointCloud::WeightArr& weights = chunk.pointWeights[i];
+			ASSERT(views.size() == weights.size() && views.size() < 256);
+			StreamPLY::Put(buffer, (uint8_t)views.size());
+			buffer.Join(reinterpret_cast<const uint8_t*>(views.data()), views.size()*sizeof(PointCloud::View));
+			StreamPLY::Put(buffer, (uint8_t)weights.size());
+			buffer.Join(reinterpret_cast<const uint8_t*>(weights.data()), weights.size()*sizeof(PointCloud::Weight));
+		}
+		++numPoints;
+	}
+	return buffer.empty() || file.write(buffer.data(), buffer.size()) == buffer.size();
+}
+
+// update the number of points in the header and close the file
+bool PointCloudStreamWriter::Close()
+{
+	using namespace PointCloudInternal;
+	if (!IsOpen())
+		return true;
+	const String strNumPoints(String::FormatString("%0*zu", (int)StreamPLY::NUM_DIGITS, numPoints));
+	const bool bRet(file.setPos(posNumPoints) && file.write(strNumPoints.c_str(), strNumPoints.length()) == strNumPoints.length());
+	file.close();
+	buffer.Release();
+	return bRet;
+}
+/*----------------------------------------------------------------*/
+
+
+bool PointCloudStreamReader::Open(const String& fileName)
+{
+	using namespace PointCloudInternal;
+	file.open(fileName, File::READ, File::OPEN);
+	if (!file.isOpen())
+		return false;
+	numPoints = numPointsRead = 0;
+	bTruncated = false;
+	buffer.clear();
+	bufferPos = 0;
+	// read the header lines and check they match the layout written by PointCloudStreamWriter
+	const auto ReadLine = [this](String& line) -> bool {
+		line.clear();
+		char c;
+		while (file.read(&c, 1) == 1) {
+			if (c == '\n')
+				return true;
+			line += c;
+		}
+		return false;
+	};
+	String line;
+	if (!ReadLine(line) || line != "ply" || !ReadLine(line) || line != "format binary_little_endian 1.0" ||
+		!ReadLine(line) || line.compare(0, 15, "element vertex ") != 0) {
+		file.close();
+		return false;
+	}
+	numPoints = (size_t)strtoull(line.c_str()+15, NULL, 10);
+	std::vector<String> props;
+	while (true) {
+		if (!ReadLine(line)) {
+			file.close();
+			return false;
+		}
+		if (line == "end_header")
+			break;
+		props.emplace_back(line);
+	}
+	const auto HasProps = [&props](size_t& idx, const char** names, size_t numNames) -> bool {
+		if (idx+numNames > props.size())
+			return false;
+		for (size_t p=0; p<numNames; ++p)
+			if (props[idx+p] != names[p])
+				return false;
+		idx += numNames;
+		return true;
+	};
+	size_t idxProp(0);
+	if (!HasProps(idxProp, StreamPLY::propsPoint, 3)) {
+		file.close();
+		return false;
+	}
+	bColors = HasProps(idxProp, StreamPLY::propsColor, 3);
+	bNormals = HasProps(idxProp, StreamPLY::propsNormal, 3);
+	bViews = HasProps(idxProp, StreamPLY::propsViews, 2);
+	if (idxProp != props.size()) {
+		file.close();
+		return false;
+	}
+	return true;
+}
+
+// make sure at least the given number of bytes are available in the buffer (if not at the end of the file)
+bool PointCloudStreamReader::Fill(size_t size)
+{
+	if (buffer.size()-bufferPos >= size)
+		return true;
+	// move the remaining bytes to the beginning and read more
+	const size_t remaining(buffer.size()-bufferPos);
+	memmove(buffer.data(), buffer.data()+bufferPos, remaining);
+	bufferPos = 0;
+	const size_t capacity(MAXF(size, size_t(4*1024*1024)));
+	buffer.resize((IDX)capacity);
+	const size_t numRead(file.read(buffer.data()+remaining, capacity-remaining));
+	buffer.resize((IDX)(remaining+(numRead == STREAM_ERROR ? 0 : numRead)));
+	return buffer.size() >= size;
+}
+
+PointCloud::Index PointCloudStreamReader::Read(PointCloud& pointcloud, PointCloud::Index maxPoints)
+{
+	using namespace PointCloudInternal;
+	ASSERT(IsOpen());
+	const size_t sizeFixed(sizeof(PointCloud::Point) + (bColors ? sizeof(PointCloud::Color) : 0) + (bNormals ? sizeof(PointCloud::Normal) : 0));
+	const size_t sizeMinViews(bViews ? 2 : 0);
+	const size_t sizeMaxViews(bViews ? 2*(1+255*sizeof(uint32_t)) : 0);
+	PointCloud::Index numRead(0);
+	while (numRead < maxPoints && numPointsRead < numPoints) {
+		if (!Fill(sizeFixed+sizeMaxViews) && !Fill(sizeFixed+sizeMinViews)) {
+			bTruncated = true;
+			break;
+		}
+		const uint8_t* data(buffer.data()+bufferPos);
+		const uint8_t* const dataEnd(buffer.data()+buffer.size());
+		// make sure the entire record is available before storing any of it,
+		// so that a truncated file does not leave the point-cloud arrays with different sizes
+		uint8_t numViews(0), numWeights(0);
+		if (bViews) {
+			const uint8_t* dataViews(data+sizeFixed);
+			numViews = *dataViews;
+			const uint8_t* dataWeights(dataViews+1+numViews*sizeof(PointCloud::View));
+			if (dataWeights+1 > dataEnd) {
+				bTruncated = true;
+				break;
+			}
+			numWeights = *dataWeights;
+			if (dataWeights+1+numWeights*sizeof(PointCloud::Weight) > dataEnd) {
+				bTruncated = true;
+				break;
+			}
+		}
+		pointcloud.points.emplace_back(StreamPLY::Get<PointCloud::Point>(data));
+		if (bColors)
+			pointcloud.colors.emplace_back(StreamPLY::Get<PointCloud::Color>(data));
+		if (bNormals)
+			pointcloud.normals.emplace_back(StreamPLY::Get<PointCloud::Normal>(data));
+		if (bViews) {
+			ASSERT(numViews == *data);
+			++data;
+			PointCloud::ViewArr& views = pointcloud.pointViews.emplace_back();
+			views.resize(numViews);
+			memcpy(views.data(), data, numViews*sizeof(PointCloud::View));
+			data += numViews*sizeof(PointCloud::View);
+			ASSERT(numWeights == *data);
+			++data;
+			PointCloud::WeightArr& weights = pointcloud.pointWeights.emplace_back();
+			weights.resize(numWeights);
+			memcpy(weights.data(), data, numWeights*sizeof(PointCloud::Weight));
+			data += numWeights*sizeof(PointCloud::Weight);
+		}
+		bufferPos = data-buffer.data();
+		++numPointsRead;
+		++numRead;
+	}
+	if (bTruncated)
+		DEBUG("error: point-cloud stream truncated after %u points (%u expected)", numPointsRead, numPoints);
+	return numRead;
+}
+
+bool PointCloudStreamReader::ReadAll(PointCloud& pointcloud, PointCloud::Index chunkPoints)
+{
+	ASSERT(IsOpen());
+	// reserve exactly the needed memory, avoiding the peak of growing the arrays
+	const size_t numPointsTotal(pointcloud.points.size()+numPoints-numPointsRead);
+	pointcloud.points.reserve((PointCloud::Index)numPointsTotal);
+	if (bColors)
+		pointcloud.colors.reserve((PointCloud::Index)numPointsTotal);
+	if (bNormals)
+		pointcloud.normals.reserve((PointCloud::Index)numPointsTotal);
+	if (bViews) {
+		pointcloud.pointViews.reserve((PointCloud::Index)numPointsTotal);
+		pointcloud.pointWeights.reserve((PointCloud::Index)numPointsTotal);
+	}
+	while (Read(pointcloud, chunkPoints) > 0) {}
+	file.close();
+	return numPointsRead == numPoints;
+}
+/*----------------------------------------------------------------*/
+
+
+// test writing a random point-cloud in chunks by PointCloudStreamWriter and reading it back by PointCloudStreamReader,
+// including a file truncated in the middle of the last point, that should be dropped
+bool MVS::TestPointCloudStream(unsigned numPoints)
+{
+	SEACAVE::Random rnd;
+	PointCloud pointcloud;
+	pointcloud.points.resize(numPoints);
+	pointcloud.colors.resize(numPoints);
+	pointcloud.normals.resize(numPoints);
+	pointcloud.pointViews.resize(numPoints);
+	pointcloud.pointWeights.resize(numPoints);
+	for (unsigned i=0; i<numPoints; ++i) {
+		pointcloud.points[i] = PointCloud::Point(rnd.randomRange(-10.f, 10.f), rnd.randomRange(-10.f, 10.f), rnd.randomRange(-10.f, 10.f));
+		pointcloud.colors[i] = PointCloud::Color((uint8_t)rnd.randomRange(0, 255), (uint8_t)rnd.randomRange(0, 255), (uint8_t)rnd.randomRange(0, 255));
+		pointcloud.normals[i] = normalized(PointCloud::Normal(rnd.randomRange(-1.f, 1.f), rnd.randomRange(-1.f, 1.f), 2.f));
+		const unsigned numViews(rnd.randomRange(1u, 8u));
+		for (unsigned v=0; v<numViews; ++v) {
+			pointcloud.pointViews[i].emplace_back(v*3+i%3);
+			pointcloud.pointWeights[i].emplace_back(rnd.randomRange(0.f, 1.f));
+		}
+	}
+	// write the point-cloud in chunks
+	const String fileName(MAKE_PATH("test_pointcloud_stream.ply"));
+	{
+		PointCloudStreamWriter writer;
+		if (!writer.Open(fileName, true, true, true))
+			return false;
+		PointCloud chunk;
+		for (unsigned i=0; i<numPoints; ++i) {
+			chunk.points.emplace_back(pointcloud.points[i]);
+			chunk.colors.emplace_back(pointcloud.colors[i]);
+			chunk.normals.emplace_back(pointcloud.normals[i]);
+			chunk.pointViews.emplace_back(pointcloud.pointViews[i]);
+			chunk.pointWeights.emplace_back(pointcloud.pointWeights[i]);
+			if (chunk.points.size() == 1000 || i+1 == numPoints) {
+				if (!writer.Write(chunk))
+					return false;
+				chunk.Release();
+			}
+		}
+		if (!writer.Close() || writer.GetNumPoints() != numPoints)
+			return false;
+	}
+	// read it back in chunks and compare
+	const auto ReadCompare = [&](unsigned numPointsExpected, bool bTruncated) -> bool {
+		PointCloudStreamReader reader;
+		if (!reader.Open(fileName) || reader.GetNumPoints() != numPoints)
+			return false;
+		PointCloud pointcloudRead;
+		if (reader.ReadAll(pointcloudRead, 777) == bTruncated || reader.IsTruncated() != bTruncated)
+			return false;
+		if (pointcloudRead.points.size() != numPointsExpected ||
+			pointcloudRead.colors.size() != numPointsExpected ||
+			pointcloudRead.normals.size() != numPointsExpected ||
+			pointcloudRead.pointViews.size() != numPointsExpected ||
+			pointcloudRead.pointWeights.size() != numPointsExpected)
+			return false;
+		for (unsigned i=0; i<numPointsExpected; ++i) {
+			if (pointcloudRead.points[i] != pointcloud.points[i] ||
+				pointcloudRead.colors[i] != pointcloud.colors[i] ||
+				pointcloudRead.normals[i] != pointcloud.normals[i] ||
+				pointcloudRead.pointViews[i].size() != pointcloud.pointViews[i].size() ||
+				pointcloudRead.pointWeights[i].size() != pointcloud.pointWeights[i].size())
+				return false;
+			FOREACH(v, pointcloud.pointViews[i])
+				if (pointcloudRead.pointViews[i][v] != pointcloud.pointViews[i][v] ||
+					pointcloudRead.pointWeights[i][v] != pointcloud.pointWeights[i][v])
+					return false;
+		}
+		return true;
+	};
+	bool bRet(ReadCompare(numPoints, false));
+	if (bRet) {
+		// cut the file in the middle of the views of the last point
+		File file(fileName, File::WRITE, File::OPEN);
+		bRet = file.isOpen() && file.setSize(file.getSize()-(sizeof(PointCloud::Weight)*pointcloud.pointWeights.back().size()+2));
+		file.close();
+		bRet = bRet && ReadCompare(numPoints-1, true);
+	}
+	File::deleteFile(fileName);
+	if (!bRet)
+		VERBOSE("error: point-cloud stream round-trip failed");
+	return bRet;
+}
+/*----------------------------------------------------------------*/
@@ -128,6 +128,71 @@ public:
 /*----------------------------------------------------------------*/
 
 
+// Writes a dense point-cloud to a binary PLY file incrementally, chunk by chunk,
+// so that only the points not yet written need to be kept in memory;
+// the resulting file can be loaded by PointCloud::Load() or chunk by chunk by PointCloudStreamReader
+class MVS_API PointCloudStreamWriter
+{
+public:
+	PointCloudStreamWriter() : numPoints(0), posNumPoints(0), bColors(false), bNormals(false), bViews(false), pROI(NULL) {}
+	~PointCloudStreamWriter() { Close(); }
+
+	bool Open(const String& fileName, bool bColors, bool bNormals, bool bViews);
+	bool Write(const PointCloud& chunk);
+	bool Close();
+
+	// skip the points outside the given region (the region must outlive the writer)
+	void SetROI(const OBB3f* _pROI) { pROI = _pROI; }
+
+	inline bool IsOpen() const { return file.isOpen(); }
+	inline size_t GetNumPoints() const { return numPoints; }
+
+protected:
+	File file;
+	size_t numPoints;
+	size_f_t posNumPoints; // file position of the number of points in the header
+	bool bColors, bNormals, bViews;
+	const OBB3f* pROI;
+	CLISTDEF0(uint8_t) buffer;
+};
+/*----------------------------------------------------------------*/
+
+// Reads a point-cloud written by PointCloudStreamWriter chunk by chunk
+class MVS_API PointCloudStreamReader
+{
+public:
+	PointCloudStreamReader() : numPoints(0), numPointsRead(0), bColors(false), bNormals(false), bViews(false), bTruncated(false), bufferPos(0) {}
+
+	bool Open(const String& fileName);
+	// read at most the given number of points into the given point-cloud (appended);
+	// return the number of points read (0 - finished or error);
+	// a truncated last point is not stored and marks the stream as truncated
+	PointCloud::Index Read(PointCloud& pointcloud, PointCloud::Index maxPoints);
+	// read all the remaining points into the given point-cloud
+	bool ReadAll(PointCloud& pointcloud, PointCloud::Index chunkPoints=1024*1024);
+
+	inline bool IsOpen() const { return file.isOpen(); }
+	inline size_t GetNumPoints() const { return numPoints; }
+	inline size_t GetNumPointsRead() const { return numPointsRead; }
+	inline bool IsTruncated() const { return bTruncated; }
+
+protected:
+	bool Fill(size_t size);
+
+protected:
+	File file;
+	size_t numPoints, numPointsRead;
+	bool bColors, bNormals, bViews;
+	bool bTruncated; // the file ended before all the points in the header were read
+	CLISTDEF0(uint8_t) buffer;
+	size_t bufferPos;
+};
+/*----------------------------------------------------------------*/
+
+MVS_API bool TestPointCloudStream(unsigned numPoints);
+/*----------------------------------------------------------------*/
+
+
 struct IndexDist {
 	IDX idx;
 	REAL dist;
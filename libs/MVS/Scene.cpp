@@ -672,6 +672,9 @@ void Scene::SampleMeshWithVisibility(unsigned maxResolution)
 	pointcloud.Release();
 	pointcloud.points.resize(mesh.vertices.size());
 	pointcloud.pointViews.resize(mesh.vertices.size());
+	// collect first the vertices visible in each image (image to points index),
+	// and invert it into the views of each point after, in order to avoid locking
+	ImagePointsArr imagePoints(images.size());
 	#ifdef SCENE_USE_OPENMP
 	#pragma omp parallel for
 	for (int64_t _ID=0; _ID<images.size(); ++_ID) {
@@ -680,6 +683,7 @@ void Scene::SampleMeshWithVisibility(unsigned maxResolution)
 	FOREACH(ID, images) {
 	#endif
 		const Image& imageData = images[ID];
+		IndexArr& visibleVertices = imagePoints[ID];
 		unsigned level(0);
 		const unsigned nMaxResolution(Image8U::computeMaxResolution(imageData.width, imageData.height, level, 0, maxResolution));
 		const REAL scale(imageData.width > imageData.height ? (REAL)nMaxResolution/imageData.width : (REAL)nMaxResolution/imageData.height);
@@ -692,21 +696,22 @@ void Scene::SampleMeshWithVisibility(unsigned maxResolution)
 			if (xz.z <= 0)
 				continue;
 			const Point2f x(xz.x, xz.y);
-			if (depthMap.isInsideWithBorder<float,1>(x) && xz.z * thFrontDepth < depthMap(ROUND2INT(x))) {
-				#ifdef SCENE_USE_OPENMP
-				#pragma omp critical
-				#endif
-				pointcloud.pointViews[idxVertex].emplace_back(ID);
-			}
+			if (depthMap.isInsideWithBorder<float,1>(x) && xz.z * thFrontDepth < depthMap(ROUND2INT(x)))
+				visibleVertices.emplace_back((uint32_t)idxVertex);
 		}
 	}
+	// images are traversed in order, so the views of each point are already sorted
+	FOREACH(ID, imagePoints)
+		for (uint32_t idxVertex: imagePoints[ID])
+			pointcloud.pointViews[idxVertex].emplace_back(ID);
+	imagePoints.Release();
 	RFOREACH(idx, pointcloud.points) {
 		if (pointcloud.pointViews[idx].size() < 2) {
 			pointcloud.RemovePoint(idx);
 			continue;
 		}
 		pointcloud.points[idx] = mesh.vertices[(Mesh::VIndex)idx];
-		pointcloud.pointViews[idx].Sort();
+		ASSERT(pointcloud.pointViews[idx].IsSorted());
 	}
 } // SampleMeshWithVisibility
 /*----------------------------------------------------------------*/
@@ -772,20 +777,28 @@ bool Scene::ExportMeshToDepthMaps(const String& baseName)
 
 
 // create a virtual point-cloud to be used to initialize the neighbor view
-// from image pair points at the intersection of the viewing directions
-bool Scene::EstimateNeighborViewsPointCloud(unsigned maxResolution)
+// from image pair points at the intersection of the viewing directions;
+// only the image pairs whose frusta can overlap are evaluated:
+// the frusta are bounded at the typical scene depth and registered in a uniform grid,
+// and the pairs sharing a cell are pruned by the angle between their viewing directions
+//  - maxPointsPair: maximum number of points generated for each image of a pair
+bool Scene::EstimateNeighborViewsPointCloud(unsigned maxResolution, unsigned maxPointsPair)
 {
+	TD_TIMER_STARTD();
 	constexpr Depth minPercentDepthPerturb(0.3f);
 	constexpr Depth maxPercentDepthPerturb(1.3f);
+	const REAL cosMaxAngle(COS(FD2R(REAL(100)))); // max angle between the viewing directions of a pair
+	// cap the number of points generated for each pair by reducing the grid resolution
+	const unsigned gridResolution(MAXF(MINF(maxResolution, (unsigned)FLOOR2INT(SQRT((float)maxPointsPair))), 1u));
 	const auto ProjectGridToImage = [&](IIndex idI, IIndex idJ, Depth depth) {
 		const Depth minDepthPerturb(depth * minPercentDepthPerturb);
 		const Depth maxDepthPerturb(depth * maxPercentDepthPerturb);
 		const Image& imageData = images[idI];
 		const Image& imageData2 = images[idJ];
-		const float stepW((float)imageData.width / maxResolution);
-		const float stepH((float)imageData.height / maxResolution);
-		for (unsigned r = 0; r < maxResolution; ++r) {
-			for (unsigned c = 0; c < maxResolution; ++c) {
+		const float stepW((float)imageData.width / gridResolution);
+		const float stepH((float)imageData.height / gridResolution);
+		for (unsigned r = 0; r < gridResolution; ++r) {
+			for (unsigned c = 0; c < gridResolution; ++c) {
 				const Point2f x(c*stepW + stepW/2, r*stepH + stepH/2);
 				const Depth depthPerturb(randomRange(minDepthPerturb, maxDepthPerturb));
 				const Point3 X(imageData.camera.TransformPointI2W(Point3(x.x, x.y, depthPerturb)));
@@ -800,39 +813,186 @@ bool Scene::EstimateNeighborViewsPointCloud(unsigned maxResolution)
 			}
 		}
 	};
-	pointcloud.Release();
-	FOREACH(i, images) {
+	// estimate the depth at the intersection of the viewing directions of the given pair (0 if none)
+	const auto EstimatePairDepths = [&](IIndex i, IIndex j, Depth& depth, Depth& depth2) -> bool {
 		const Image& imageData = images[i];
-		if (!imageData.IsValid())
-			continue;
-		FOREACH(j, images) {
-			if (i == j)
-				continue;
-			const Image& imageData2 = images[j];
-			Point3 X;
-			TriangulatePoint3D(
-				imageData.camera.K, imageData2.camera.K,
-				imageData.camera.R, imageData2.camera.R,
-				imageData.camera.C, imageData2.camera.C,
-				Point2::ZERO, Point2::ZERO, X);
-			const Depth depth((Depth)imageData.camera.PointDepth(X));
-			const Depth depth2((Depth)imageData2.camera.PointDepth(X));
-			if (depth <= 0 || depth2 <= 0)
-				continue;
-			ProjectGridToImage(i, j, depth);
-			ProjectGridToImage(j, i, depth2);
+		const Image& imageData2 = images[j];
+		Point3 X;
+		TriangulatePoint3D(
+			imageData.camera.K, imageData2.camera.K,
+			imageData.camera.R, imageData2.camera.R,
+			imageData.camera.C, imageData2.camera.C,
+			Point2::ZERO, Point2::ZERO, X);
+		depth = (Depth)imageData.camera.PointDepth(X);
+		depth2 = (Depth)imageData2.camera.PointDepth(X);
+		return depth > 0 && depth2 > 0;
+	};
+	pointcloud.Release();
+	IIndexArr validIDs;
+	FOREACH(i, images)
+		if (images[i].IsValid())
+			validIDs.emplace_back(i);
+	if (validIDs.size() < 2)
+		return false;
+
+	// estimate the typical scene depth from a sample of image pairs
+	// and use it to bound the frusta of all images
+	Depth maxDepth(0);
+	{
+		FloatArr depths;
+		const unsigned numSamples(MINF(1024u, (unsigned)(validIDs.size()*(validIDs.size()-1)/2)));
+		for (unsigned s=0; s<numSamples*4 && depths.size()<numSamples; ++s) {
+			const IIndex i(validIDs[randomRange(0u, validIDs.size()-1)]);
+			const IIndex j(validIDs[randomRange(0u, validIDs.size()-1)]);
+			Depth depth, depth2;
+			if (i != j && EstimatePairDepths(i, j, depth, depth2)) {
+				depths.emplace_back(depth);
+				depths.emplace_back(depth2);
+			}
+		}
+		if (!depths.empty())
+			maxDepth = depths.GetMedian()*4*maxPercentDepthPerturb;
+	}
+
+	// collect the candidate image pairs whose bounded frusta overlap
+	typedef std::pair<IIndex,IIndex> ImagePair;
+	std::vector<ImagePair> pairs;
+	if (maxDepth > 0) {
+		struct Frustum {
+			AABB3d box;
+			Point3 dir;
+		};
+		CLISTDEF0IDX(Frustum,IIndex) frusta(validIDs.size());
+		CLISTDEF0IDX(REAL,IIndex) frustumSizes(validIDs.size());
+		FOREACH(f, frusta) {
+			const Camera& camera = images[validIDs[f]].camera;
+			const Image& imageData = images[validIDs[f]];
+			const Point3 corners[5] = {
+				camera.C,
+				camera.TransformPointI2W(Point3(0, 0, maxDepth)),
+				camera.TransformPointI2W(Point3(imageData.width, 0, maxDepth)),
+				camera.TransformPointI2W(Point3(0, imageData.height, maxDepth)),
+				camera.TransformPointI2W(Point3(imageData.width, imageData.height, maxDepth))
+			};
+			Frustum& frustum = frusta[f];
+			frustum.box.Set(corners, 5);
+			frustum.dir = camera.Direction();
+			frustumSizes[f] = frustum.box.GetSize().maxCoeff();
+		}
+		const REAL cellSize(frustumSizes.GetMedian());
+		// register the frusta in a uniform grid with cells as large as the typical frustum,
+		// so that most frusta overlap at most 8 cells
+		const auto CellKey = [](int x, int y, int z) -> uint64_t {
+			return (uint64_t(uint32_t(x) & 0x1FFFFF) << 42) | (uint64_t(uint32_t(y) & 0x1FFFFF) << 21) | uint64_t(uint32_t(z) & 0x1FFFFF);
+		};
+		const auto CellRange = [cellSize](const AABB3d& box, int idxMin[3], int idxMax[3]) {
+			for (int a=0; a<3; ++a) {
+				idxMin[a] = FLOOR2INT(box.ptMin[a]/cellSize);
+				idxMax[a] = FLOOR2INT(box.ptMax[a]/cellSize);
+			}
+		};
+		std::unordered_map<uint64_t, IIndexArr> grid;
+		FOREACH(f, frusta) {
+			int idxMin[3], idxMax[3];
+			CellRange(frusta[f].box, idxMin, idxMax);
+			for (int x=idxMin[0]; x<=idxMax[0]; ++x)
+				for (int y=idxMin[1]; y<=idxMax[1]; ++y)
+					for (int z=idxMin[2]; z<=idxMax[2]; ++z)
+						grid[CellKey(x, y, z)].emplace_back(f);
+		}
+		// for each frustum, check the frusta sharing a cell and having a compatible viewing direction
+		// (only the angle between the viewing directions is used to prune,
+		// as binning the directions would also drop pairs well within the maximum angle)
+		IIndexArr lastVisited(frusta.size());
+		lastVisited.MemsetValue(NO_ID);
+		FOREACH(f, frusta) {
+			const Frustum& frustum = frusta[f];
+			int idxMin[3], idxMax[3];
+			CellRange(frustum.box, idxMin, idxMax);
+			for (int x=idxMin[0]; x<=idxMax[0]; ++x) for (int y=idxMin[1]; y<=idxMax[1]; ++y) for (int z=idxMin[2]; z<=idxMax[2]; ++z) {
+				const auto it(grid.find(CellKey(x, y, z)));
+				if (it == grid.end())
+					continue;
+				for (const IIndex g: it->second) {
+					if (g <= f || lastVisited[g] == f)
+						continue;
+					lastVisited[g] = f;
+					const Frustum& frustum2 = frusta[g];
+					if (frustum.dir.dot(frustum2.dir) < cosMaxAngle || !frustum.box.Intersects(frustum2.box))
+						continue;
+					pairs.emplace_back(validIDs[f], validIDs[g]);
+				}
+			}
 		}
+	} else {
+		// no scene depth estimate, evaluate all pairs
+		FOREACH(i, validIDs)
+			for (IIndex j=i+1; j<validIDs.size(); ++j)
+				pairs.emplace_back(validIDs[i], validIDs[j]);
 	}
+
+	// generate the points of each candidate pair
+	for (const ImagePair& pair: pairs) {
+		Depth depth, depth2;
+		if (!EstimatePairDepths(pair.first, pair.second, depth, depth2))
+			continue;
+		ProjectGridToImage(pair.first, pair.second, depth);
+		ProjectGridToImage(pair.second, pair.first, depth2);
+	}
+	DEBUG_EXTRA("Virtual point-cloud estimated from %u image pairs (out of %u): %u points (%s)",
+		pairs.size(), validIDs.size()*(validIDs.size()-1)/2, pointcloud.points.size(), TD_TIMER_GET_FMT().c_str());
 	return true;
 } // EstimateNeighborViewsPointCloud
 /*----------------------------------------------------------------*/
 
+// build the image to points inverted index of the point-cloud,
+// so that the points seen by an image can be found without scanning the entire point-cloud
+void Scene::ComputeImagePoints(ImagePointsArr& imagePoints) const
+{
+	TD_TIMER_STARTD();
+	imagePoints.Release();
+	imagePoints.resize(images.size());
+	// count the points seen by each image
+	CLISTDEF0IDX(int32_t,IIndex) counts;
+	counts.resize(images.size());
+	counts.Memset(0);
+	const int64_t nPoints((int64_t)pointcloud.pointViews.size());
+	#ifdef SCENE_USE_OPENMP
+	#pragma omp parallel for
+	#endif
+	for (int64_t i=0; i<nPoints; ++i)
+		for (const PointCloud::View view: pointcloud.pointViews[(PointCloud::Index)i])
+			Thread::safeInc((volatile int32_t&)counts[view]);
+	size_t nPointViews(0);
+	FOREACH(ID, imagePoints) {
+		imagePoints[ID].resize((IndexArr::IDX)counts[ID]);
+		nPointViews += counts[ID];
+	}
+	// fill in the point indices
+	counts.Memset(0);
+	#ifdef SCENE_USE_OPENMP
+	#pragma omp parallel for
+	#endif
+	for (int64_t i=0; i<nPoints; ++i)
+		for (const PointCloud::View view: pointcloud.pointViews[(PointCloud::Index)i])
+			imagePoints[view][Thread::safeInc((volatile int32_t&)counts[view])-1] = (uint32_t)i;
+	// the points were added concurrently, so sort them
+	#ifdef SCENE_USE_OPENMP
+	#pragma omp parallel for schedule(dynamic)
+	#endif
+	for (int64_t ID=0; ID<(int64_t)imagePoints.size(); ++ID)
+		imagePoints[(IIndex)ID].Sort();
+	DEBUG_EXTRA("Image to points index computed: %u images, %u point views, %s (%s)",
+		imagePoints.size(), nPointViews, Util::formatBytes(nPointViews*sizeof(uint32_t)+imagePoints.size()*sizeof(IndexArr)).c_str(), TD_TIMER_GET_FMT().c_str());
+} // ComputeImagePoints
+
 // compute visibility for the reference image
 // and select the best views for reconstructing the dense point-cloud;
 // extract also all 3D points seen by the reference image;
 // (inspired by: "Multi-View Stereo for Community Photo Collections", Goesele, 2007)
 //  - nInsideROI: 0 - ignore ROI, 1 - weight more ROI points, 2 - consider only ROI points
-bool Scene::SelectNeighborViews(uint32_t ID, IndexArr& points, unsigned nMinViews, unsigned nMinPointViews, float fOptimAngle, unsigned nInsideROI)
+//  - pImagePoints: the points seen by the reference image, as in the image to points index (optional)
+bool Scene::SelectNeighborViews(uint32_t ID, IndexArr& points, unsigned nMinViews, unsigned nMinPointViews, float fOptimAngle, unsigned nInsideROI, const IndexArr* pImagePoints)
 {
 	ASSERT(points.empty());
 
@@ -856,11 +1016,14 @@ bool Scene::SelectNeighborViews(uint32_t ID, IndexArr& points, unsigned nMinView
 	const float sigmaAngleSmall(-1.f/(2.f*SQUARE(fOptimAngle*0.38f)));
 	const float sigmaAngleLarge(-1.f/(2.f*SQUARE(fOptimAngle*0.7f)));
 	const bool bCheckInsideROI(nInsideROI > 0 && IsBounded());
-	FOREACH(idx, pointcloud.points) {
+	const IDX nPointsScan(pImagePoints ? pImagePoints->size() : pointcloud.points.size());
+	for (IDX i=0; i<nPointsScan; ++i) {
+		const IDX idx(pImagePoints ? (IDX)(*pImagePoints)[(IndexArr::IDX)i] : i);
 		const PointCloud::ViewArr& views = pointcloud.pointViews[idx];
 		ASSERT(views.IsSorted());
-		if (views.FindFirst(ID) == PointCloud::ViewArr::NO_INDEX)
+		if (!pImagePoints && views.FindFirst(ID) == PointCloud::ViewArr::NO_INDEX)
 			continue;
+		ASSERT(views.FindFirst(ID) != PointCloud::ViewArr::NO_INDEX);
 		const PointCloud::Point& point = pointcloud.points[idx];
 		float wROI(1.f);
 		if (bCheckInsideROI && !obb.Intersects(point)) {
@@ -973,7 +1136,10 @@ bool Scene::SelectNeighborViews(uint32_t ID, IndexArr& points, unsigned nMinView
 
 void Scene::SelectNeighborViews(unsigned nMinViews, unsigned nMinPointViews, float fOptimAngle, unsigned nInsideROI)
 {
+	ImagePointsArr imagePoints;
+	ComputeImagePoints(imagePoints);
 	#ifdef SCENE_USE_OPENMP
+	#pragma omp parallel for schedule(dynamic)
 	for (int_t ID=0; ID<(int_t)images.size(); ++ID) {
 		const IIndex idxImage((IIndex)ID);
 	#else
@@ -981,7 +1147,7 @@ void Scene::SelectNeighborViews(unsigned nMinViews, unsigned nMinPointViews, flo
 	#endif
 		// select image neighbors
 		IndexArr points;
-		SelectNeighborViews(idxImage, points, nMinViews, nMinPointViews, fOptimAngle, nInsideROI);
+		SelectNeighborViews(idxImage, points, nMinViews, nMinPointViews, fOptimAngle, nInsideROI, &imagePoints[idxImage]);
 	}
 } // SelectNeighborViews
 /*----------------------------------------------------------------*/
@@ -63,6 +63,9 @@ public:
 
 	unsigned nMaxThreads; // maximum number of threads used to distribute the work load
 
+	// image to points inverted index: for each image, the indices of the points seen by it (ordered increasing)
+	typedef CLISTDEFIDX(IndexArr,IIndex) ImagePointsArr;
+
 public:
 	inline Scene(unsigned _nMaxThreads=0)
 		: obb(true), nMaxThreads(Thread::getMaxThreads(_nMaxThreads)) {}
@@ -91,11 +94,12 @@ public:
 	SCENE_TYPE Load(const String& fileName, bool bImport=false);
 	bool Save(const String& fileName, ARCHIVE_TYPE type=ARCHIVE_DEFAULT) const;
 
-	bool EstimateNeighborViewsPointCloud(unsigned maxResolution=16);
+	bool EstimateNeighborViewsPointCloud(unsigned maxResolution=16, unsigned maxPointsPair=64);
 	void SampleMeshWithVisibility(unsigned maxResolution=320);
 	bool ExportMeshToDepthMaps(const String& baseName);
 
-	bool SelectNeighborViews(uint32_t ID, IndexArr& points, unsigned nMinViews = 3, unsigned nMinPointViews = 2, float fOptimAngle = FD2R(12), unsigned nInsideROI = 1);
+	void ComputeImagePoints(ImagePointsArr& imagePoints) const;
+	bool SelectNeighborViews(uint32_t ID, IndexArr& points, unsigned nMinViews = 3, unsigned nMinPointViews = 2, float fOptimAngle = FD2R(12), unsigned nInsideROI = 1, const IndexArr* pImagePoints = NULL);
 	void SelectNeighborViews(unsigned nMinViews = 3, unsigned nMinPointViews = 2, float fOptimAngle = FD2R(12), unsigned nInsideROI = 1);
 	static bool FilterNeighborViews(ViewScoreArr& neighbors, float fMinArea=0.1f, float fMinScale=0.2f, float fMaxScale=2.4f, float fMinAngle=FD2R(3), float fMaxAngle=FD2R(45), unsigned nMaxViews=12);
 
@@ -135,7 +139,7 @@ public:
 	PointCloud BuildTowerMesh(const PointCloud& origPointCloud, const Point2f& centerPoint, const float fRadius, const float fROIRadius, const float zMin, const float zMax, const float minCamZ, bool bFixRadius = false);
 	
 	// Dense reconstruction
-    bool DenseReconstruction(int nFusionMode=0, bool bCrop2ROI=true, float fBorderROI=0, int indexPremiereImage=-1, int indexDerniereImage=-1, double profondeurMaximale=-1.0, double hauteurMaximale=-1.0);
+    bool DenseReconstruction(int nFusionMode=0, bool bCrop2ROI=true, float fBorderROI=0, int indexPremiereImage=-1, int indexDerniereImage=-1, double profondeurMaximale=-1.0, double hauteurMaximale=-1.0, const String& fileNameStreamPointCloud=String());
     bool ComputeDepthMaps(DenseDepthMapData& data, int indexPremiereImage, int indexDerniereImage, double profondeurMaximale, double hauteurMaximale);
 	void DenseReconstructionEstimate(void*);
     void DenseReconstructionFilter(void*, double profondeurMaximale=-1.0, double hauteurMaximale=-1.0);
@@ -146,11 +150,16 @@ public:
 						 float kSigma=2.f, float kQual=1.f, float kb=4.f,
 						 float kf=3.f, float kRel=0.1f/*max 0.3*/, float kAbs=1000.f/*min 500*/, float kOutl=400.f/*max 700.f*/,
 						 float kInf=(float)(INT_MAX/8));
+	bool ReconstructMeshBlocks(unsigned nMaxBlockPoints, float fBlockOverlap=0.1f, float distInsert=2, bool bUseFreeSpaceSupport=true, bool bUseOnlyROI=false, unsigned nItersFixNonManifold=4,
+							   float kSigma=2.f, float kQual=1.f, float kb=4.f,
+							   float kf=3.f, float kRel=0.1f/*max 0.3*/, float kAbs=1000.f/*min 500*/, float kOutl=400.f/*max 700.f*/,
+							   float kInf=(float)(INT_MAX/8));
+	void BenchmarkPointInsertion(float distInsert, unsigned nMaxThreads=0) const;
 
 	// Mesh refinement
 	bool RefineMesh(unsigned nResolutionLevel, unsigned nMinResolution, unsigned nMaxViews, float fDecimateMesh, unsigned nCloseHoles, unsigned nEnsureEdgeSize,
 		unsigned nMaxFaceArea, unsigned nScales, float fScaleStep, unsigned nAlternatePair, float fRegularityWeight, float fRatioRigidityElasticity, float fGradientStep,
-		float fThPlanarVertex=0.f, unsigned nReduceMemory=1);
+		float fThPlanarVertex=0.f, unsigned nReduceMemory=1, unsigned nMaxMemory=0);
 	#ifdef _USE_CUDA
 	bool RefineMeshCUDA(unsigned nResolutionLevel, unsigned nMinResolution, unsigned nMaxViews, float fDecimateMesh, unsigned nCloseHoles, unsigned nEnsureEdgeSize,
 		unsigned nMaxFaceArea, unsigned nScales, float fScaleStep, unsigned nAlternatePair, float fRegularityWeight, float fRatioRigidityElasticity, float fGradientStep);
@@ -159,7 +168,7 @@ public:
 	// Mesh texturing
 	bool TextureMesh(unsigned nResolutionLevel, unsigned nMinResolution, unsigned minCommonCameras=0, float fOutlierThreshold=0.f, float fRatioDataSmoothness=0.3f,
 		bool bGlobalSeamLeveling=true, bool bLocalSeamLeveling=true, unsigned nTextureSizeMultiple=0, unsigned nRectPackingHeuristic=3, Pixel8U colEmpty=Pixel8U(255,127,39),
-		float fSharpnessWeight=0.5f, int ignoreMaskLabel=-1, int maxTextureSize=0, const IIndexArr& views=IIndexArr());
+		float fSharpnessWeight=0.5f, int ignoreMaskLabel=-1, int maxTextureSize=0, const IIndexArr& views=IIndexArr(), unsigned nMaxMemory=0);
 
 	#ifdef _USE_BOOST
 	// implement BOOST serialization
@@ -176,6 +185,10 @@ public:
 };
 /*----------------------------------------------------------------*/
 
+MVS_API bool TestReconstructMeshBlocks(const Scene& scene, unsigned nMaxBlockPoints, float fBlockOverlap);
+MVS_API bool TestMeshRefineZNCC(int width, int height);
+/*----------------------------------------------------------------*/
+
 } // namespace MVS
 
 #endif // _MVS_SCENE_H_
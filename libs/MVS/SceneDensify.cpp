@@ -127,29 +127,201 @@ inline float Conf2Weight(float conf, Depth depth) {
 
 // S T R U C T S ///////////////////////////////////////////////////
 
+DepthEstimatorPool::DepthEstimatorPool()
+	:
+	nWorkers(0), fnStage(NULL), pEstimators(NULL),
+	timeWait(0), timeWork(0), nStages(0)
+{
+} // constructor
+
+DepthEstimatorPool::~DepthEstimatorPool()
+{
+	Release();
+} // destructor
+
+// create the working threads (the calling thread is also used)
+void DepthEstimatorPool::Init(unsigned nThreads)
+{
+	ASSERT(nThreads > 0);
+	if (GetSize() == nThreads)
+		return;
+	Release();
+	nWorkers = nThreads-1;
+	if (nWorkers == 0)
+		return;
+	workers = new Worker[nWorkers];
+	for (unsigned i=0; i<nWorkers; ++i) {
+		Worker& worker = workers[i];
+		worker.pPool = this;
+		worker.idx = i;
+		worker.timeIdle = worker.timeWork = 0;
+		worker.thread.start(WorkerTmp, &worker);
+	}
+} // Init
+
+// signal the working threads to close and wait for them
+void DepthEstimatorPool::Release()
+{
+	if (nWorkers == 0)
+		return;
+	fnStage = NULL;
+	for (unsigned i=0; i<nWorkers; ++i)
+		workers[i].start.Signal();
+	for (unsigned i=0; i<nWorkers; ++i)
+		workers[i].thread.join();
+	workers.Release();
+	nWorkers = 0;
+} // Release
+
+void DepthEstimatorPool::Run(FncStage _fnStage, DepthEstimatorArr& estimators)
+{
+	ASSERT(_fnStage != NULL && estimators.size() == GetSize());
+	fnStage = _fnStage;
+	pEstimators = estimators.data();
+	for (unsigned i=0; i<nWorkers; ++i)
+		workers[i].start.Signal();
+	const Timer::SysType tStart(Timer::GetSysTime());
+	fnStage(pEstimators+nWorkers);
+	const Timer::SysType tEnd(Timer::GetSysTime());
+	for (unsigned i=0; i<nWorkers; ++i)
+		done.Wait();
+	timeWork += tEnd-tStart;
+	timeWait += Timer::GetSysTime()-tEnd;
+	pEstimators = NULL;
+	++nStages;
+} // Run
+
+void* STCALL DepthEstimatorPool::WorkerTmp(void* arg)
+{
+	Worker& worker = *((Worker*)arg);
+	DepthEstimatorPool& pool = *worker.pPool;
+	while (true) {
+		const Timer::SysType tIdle(Timer::GetSysTime());
+		worker.start.Wait();
+		const Timer::SysType tStart(Timer::GetSysTime());
+		worker.timeIdle += tStart-tIdle;
+		if (pool.fnStage == NULL)
+			break;
+		pool.fnStage(pool.pEstimators+worker.idx);
+		worker.timeWork += Timer::GetSysTime()-tStart;
+		pool.done.Signal();
+	}
+	return NULL;
+} // WorkerTmp
+
+void DepthEstimatorPool::LogStats() const
+{
+	if (nStages == 0)
+		return;
+	Timer::SysType timeIdleWorkers(0), timeWorkWorkers(timeWork);
+	for (unsigned i=0; i<nWorkers; ++i) {
+		timeIdleWorkers += workers[i].timeIdle;
+		timeWorkWorkers += workers[i].timeWork;
+	}
+	const Timer::SysType timeTotal(MAXF(timeIdleWorkers+timeWorkWorkers, Timer::SysType(1)));
+	VERBOSE("Depth-map estimation threads: %u threads, %u stages, working %s (%.2f%%), idle %s (%.2f%%), waiting for stage end %s",
+		GetSize(), nStages,
+		Util::formatTime((int64_t)Timer::SysTime2TimeMs(timeWorkWorkers)).c_str(), 100.0*timeWorkWorkers/timeTotal,
+		Util::formatTime((int64_t)Timer::SysTime2TimeMs(timeIdleWorkers)).c_str(), 100.0*timeIdleWorkers/timeTotal,
+		Util::formatTime((int64_t)Timer::SysTime2TimeMs(timeWait)).c_str());
+} // LogStats
+/*----------------------------------------------------------------*/
+
 
 DepthMapsData::DepthMapsData(Scene& _scene)
 	:
 	scene(_scene),
-	arrDepthData(_scene.images.GetSize())
+	arrDepthData(_scene.images.GetSize()),
+	nContexts(0)
 {
 } // constructor
 
 DepthMapsData::~DepthMapsData()
 {
+	ReleaseEstimationContexts();
 } // destructor
 /*----------------------------------------------------------------*/
 
+// create the contexts used to estimate concurrently the given number of depth-maps,
+// the available threads being split evenly between them
+void DepthMapsData::InitEstimationContexts(unsigned nConcurrentImages, unsigned nMaxThreads)
+{
+	ASSERT(nConcurrentImages > 0 && nMaxThreads > 0);
+	ReleaseEstimationContexts();
+	nContexts = nConcurrentImages;
+	contexts = new EstimationContext[nContexts];
+	freeContexts.resize(nContexts);
+	const unsigned nThreadsPerContext(MAXF(nMaxThreads/nContexts, 1u));
+	for (unsigned i=0; i<nContexts; ++i) {
+		contexts[i].workers.Init(nThreadsPerContext);
+		freeContexts[i] = nContexts-1-i;
+	}
+} // InitEstimationContexts
+
+// release the estimation contexts and their working threads
+void DepthMapsData::ReleaseEstimationContexts()
+{
+	if (nContexts == 0)
+		return;
+	ASSERT(freeContexts.size() == nContexts);
+	for (unsigned i=0; i<nContexts; ++i)
+		contexts[i].workers.LogStats();
+	contexts.Release();
+	freeContexts.Release();
+	nContexts = 0;
+} // ReleaseEstimationContexts
+
+// estimate how many depth-maps should be estimated concurrently:
+// low resolution images do not have enough pixels to keep busy all threads,
+// so several images are processed at once, as long as the memory allows it
+unsigned DepthMapsData::ComputeNumConcurrentImages(const IIndexArr& images, unsigned nMaxThreads) const
+{
+	if (OPTDENSE::nConcurrentImages == 1 || nMaxThreads <= 1 || images.size() <= 1)
+		return 1;
+	#ifdef _USE_CUDA
+	if (pmCUDA)
+		return 1;
+	#endif // _USE_CUDA
+	// average image resolution
+	size_t resolution(0);
+	for (IIndex idxImage: images)
+		resolution += (size_t)scene.images[idxImage].width*scene.images[idxImage].height;
+	resolution /= images.size();
+	unsigned nConcurrentImages(OPTDENSE::nConcurrentImages);
+	if (nConcurrentImages == 0) {
+		// each thread should process enough pixels for the per-pixel parallelism to be efficient
+		const size_t nMinPixelsPerThread(256*1024);
+		const unsigned nThreadsPerImage(CLAMP((unsigned)(resolution/nMinPixelsPerThread), 1u, nMaxThreads));
+		nConcurrentImages = nMaxThreads/nThreadsPerImage;
+	}
+	// limit the number of images such that the estimation data fits in the available memory:
+	// reference and neighbor gray images, depth, normal and confidence maps, pixel weights and coordinates
+	const unsigned nViews((OPTDENSE::nNumViews ? OPTDENSE::nNumViews : OPTDENSE::nMaxViews)+1);
+	const size_t nBytesPerImage(resolution*(nViews*sizeof(float) + sizeof(Depth) + sizeof(Normal) + sizeof(float) +
+		#if DENSE_NCC == DENSE_NCC_WEIGHTED
+		sizeof(DepthEstimator::Weight) +
+		#else
+		sizeof(double) +
+		#endif
+		sizeof(DepthEstimator::MapRef)));
+	const Util::MemoryInfo memInfo(Util::GetMemoryInfo());
+	const size_t nAvailableMemory(memInfo.freePhysical/2); // keep half of the free memory for the rest of the process
+	const unsigned nMaxImagesMemory((unsigned)MINF(nAvailableMemory/MAXF(nBytesPerImage, size_t(1)), size_t(nMaxThreads)));
+	return CLAMP(MINF(nConcurrentImages, (unsigned)images.size()), 1u, MAXF(nMaxImagesMemory, 1u));
+} // ComputeNumConcurrentImages
+/*----------------------------------------------------------------*/
+
 // compute visibility for the reference image (the first image in "images")
 // and select the best views for reconstructing the depth-map;
 // extract also all 3D points seen by the reference image
-bool DepthMapsData::SelectViews(DepthData& depthData)
+// (optionally given by the image to points index)
+bool DepthMapsData::SelectViews(DepthData& depthData, const IndexArr* pImagePoints)
 {
 	// find and sort valid neighbor views
 	const IIndex idxImage((IIndex)(&depthData-arrDepthData.Begin()));
 	ASSERT(depthData.neighbors.IsEmpty());
 	if (scene.images[idxImage].neighbors.empty() &&
-		!scene.SelectNeighborViews(idxImage, depthData.points, OPTDENSE::nMinViews, OPTDENSE::nMinViewsTrustPoint>1?OPTDENSE::nMinViewsTrustPoint:2, FD2R(OPTDENSE::fOptimAngle), OPTDENSE::nPointInsideROI))
+		!scene.SelectNeighborViews(idxImage, depthData.points, OPTDENSE::nMinViews, OPTDENSE::nMinViewsTrustPoint>1?OPTDENSE::nMinViewsTrustPoint:2, FD2R(OPTDENSE::fOptimAngle), OPTDENSE::nPointInsideROI, pImagePoints))
 		return false;
 	depthData.neighbors.CopyOf(scene.images[idxImage].neighbors);
 
@@ -200,7 +372,7 @@ bool DepthMapsData::InitViews(DepthData& depthData, IIndex idxNeighbor, IIndex n
 				viewTrg.camera = viewTrg.pImageData->GetCamera(scene.platforms, viewTrg.image.size());
 		} else {
 			if (DepthData::ViewData::NeedScaleImage(viewTrg.scale))
-				viewTrg.camera = viewTrg.pImageData->GetCamera(scene.platforms, Image8U::computeResize(viewTrg.pImageData->image.size(), viewTrg.scale));
+				viewTrg.camera = viewTrg.pImageData->GetCamera(scene.platforms, Image8U::computeResize(viewTrg.pImageData->GetSize(), viewTrg.scale));
 		}
 		DEBUG_EXTRA("Reference image %3u paired with image %3u", idxImage, neighbor.ID);
 	} else {
@@ -220,7 +392,7 @@ bool DepthMapsData::InitViews(DepthData& depthData, IIndex idxNeighbor, IIndex n
 					viewTrg.camera = viewTrg.pImageData->GetCamera(scene.platforms, viewTrg.image.size());
 			} else {
 				if (DepthData::ViewData::NeedScaleImage(viewTrg.scale))
-					viewTrg.camera = viewTrg.pImageData->GetCamera(scene.platforms, Image8U::computeResize(viewTrg.pImageData->image.size(), viewTrg.scale));
+					viewTrg.camera = viewTrg.pImageData->GetCamera(scene.platforms, Image8U::computeResize(viewTrg.pImageData->GetSize(), viewTrg.scale));
 			}
 		}
 		#if TD_VERBOSE != TD_VERBOSE_OFF
@@ -246,7 +418,7 @@ bool DepthMapsData::InitViews(DepthData& depthData, IIndex idxNeighbor, IIndex n
 	viewRef.camera = viewRef.pImageData->camera;
 	if (loadImages)
 		viewRef.pImageData->image.toGray(viewRef.image, cv::COLOR_BGR2GRAY, true);
-	depthData.size = viewRef.pImageData->image.size();
+	depthData.size = viewRef.pImageData->GetSize();
 
 	// initialize views
 	for (IIndex i=1; i<depthData.images.size(); ++i) {
@@ -331,6 +503,29 @@ bool DepthMapsData::InitViews(DepthData& depthData, IIndex idxNeighbor, IIndex n
 	}
 	return true;
 } // InitViews
+
+// return the IDs of the images used by InitViews() for the given depth-map:
+// the reference image followed by the selected neighbor views
+IIndexArr DepthMapsData::GetInitViewIDs(const DepthData& depthData, IIndex idxNeighbor, IIndex numNeighbors) const
+{
+	const IIndex idxImage((IIndex)(&depthData-arrDepthData.Begin()));
+	IIndexArr viewIDs(0, depthData.neighbors.size()+1);
+	viewIDs.push_back(idxImage);
+	if (depthData.neighbors.empty())
+		return viewIDs;
+	if (idxNeighbor != NO_ID) {
+		viewIDs.push_back(depthData.neighbors[idxNeighbor].ID);
+		return viewIDs;
+	}
+	const float fMinScore(MAXF(depthData.neighbors.First().score*OPTDENSE::fViewMinScoreRatio, OPTDENSE::fViewMinScore));
+	for (const ViewScore& neighbor: depthData.neighbors) {
+		if ((numNeighbors && viewIDs.size() > numNeighbors) ||
+			(neighbor.score < fMinScore))
+			break;
+		viewIDs.push_back(neighbor.ID);
+	}
+	return viewIDs;
+} // GetInitViewIDs
 /*----------------------------------------------------------------*/
 
 // roughly estimate depth and normal maps by triangulating the sparse point-cloud
@@ -411,7 +606,7 @@ void* STCALL DepthMapsData::EndDepthMapTmp(void* arg)
 		float& conf = estimator.confMap0(x);
 		// check if the score is good enough
 		// and that the cross-estimates is close enough to the current estimate
-		if (depth <= 0 || conf >= OPTDENSE::fNCCThresholdKeep) {
+		if (depth <= 0 || conf >= estimator.thConfKeep) {
 			conf = 0;
 			depth = 0;
 			estimator.normalMap0(x) = Normal::ZERO;
@@ -498,17 +693,26 @@ bool DepthMapsData::EstimateDepthMap(IIndex idxImage, int nGeometricIter)
 
 	TD_TIMER_STARTD();
 
-	const unsigned nMaxThreads(scene.nMaxThreads);
+	// acquire one of the free estimation contexts
+	ASSERT(nContexts > 0);
+	IIndex idxContext; {
+		Lock l(csContexts);
+		ASSERT(!freeContexts.empty());
+		idxContext = freeContexts.back();
+		freeContexts.pop_back();
+	}
+	EstimationContext& context = contexts[idxContext];
+	DepthEstimatorPool& workers = context.workers;
+	DepthEstimator::MapRefArr& coords = context.coords;
+
+	const unsigned nMaxThreads(workers.GetSize());
 	const unsigned iterBegin(nGeometricIter < 0 ? 0u : OPTDENSE::nEstimationIters+(unsigned)nGeometricIter);
 	const unsigned iterEnd(nGeometricIter < 0 ? OPTDENSE::nEstimationIters : iterBegin+1);
 
-	// init threads
+	// init estimators, one for each working thread of this context
 	ASSERT(nMaxThreads > 0);
-	cList<DepthEstimator> estimators;
+	DepthEstimatorPool::DepthEstimatorArr estimators;
 	estimators.reserve(nMaxThreads);
-	cList<SEACAVE::Thread> threads;
-	if (nMaxThreads > 1)
-		threads.resize(nMaxThreads-1); // current thread is also used
 	volatile Thread::safe_t idxPixel;
 
 	// Multi-Resolution : 
@@ -550,7 +754,7 @@ bool DepthMapsData::EstimateDepthMap(IIndex idxImage, int nGeometricIter)
 		#else
 		cv::integral(image.image, imageSum0, CV_64F);
 		#endif
-		if (prevDepthMapSize != size || OPTDENSE::nIgnoreMaskLabel >= 0) {
+		if (context.prevDepthMapSize != size || OPTDENSE::nIgnoreMaskLabel >= 0) {
 			BitMatrix mask;
 			if (OPTDENSE::nIgnoreMaskLabel >= 0 && DepthEstimator::ImportIgnoreMask(*image.pImageData, depthData.depthMap.size(), (uint8_t)OPTDENSE::nIgnoreMaskLabel, mask))
 				depthData.ApplyIgnoreMask(mask);
@@ -563,12 +767,12 @@ bool DepthMapsData::EstimateDepthMap(IIndex idxImage, int nGeometricIter)
 				cmask(x.y, x.x) = 255;
 			cmask.Show("cmask");
 			#endif
-			prevDepthMapSize = size;
+			context.prevDepthMapSize = size;
 		}
 
 		// initialize the reference confidence map (NCC score map) with the score of the current estimates
 		{
-			// create working threads
+			// create an estimator for each working thread
 			idxPixel = -1;
 			ASSERT(estimators.empty());
 			while (estimators.size() < nMaxThreads) {
@@ -581,13 +785,7 @@ bool DepthMapsData::EstimateDepthMap(IIndex idxImage, int nGeometricIter)
 					coords);
 				estimators.Last().lowResDepthMap = currentSizeResDepthMap;
 			}
-			ASSERT(estimators.size() == threads.size()+1);
-			FOREACH(i, threads)
-				threads[i].start(ScoreDepthMapTmp, &estimators[i]);
-			ScoreDepthMapTmp(&estimators.back());
-			// wait for the working threads to close
-			FOREACHPTR(pThread, threads)
-				pThread->join();
+			workers.Run(ScoreDepthMapTmp, estimators);
 			estimators.clear();
 			#if TD_VERBOSE != TD_VERBOSE_OFF
 			// save rough depth map as image
@@ -601,7 +799,7 @@ bool DepthMapsData::EstimateDepthMap(IIndex idxImage, int nGeometricIter)
 
 		// run propagation and random refinement cycles on the reference data
 		for (unsigned iter=iterBegin; iter<iterEnd; ++iter) {
-			// create working threads
+			// create an estimator for each working thread
 			idxPixel = -1;
 			ASSERT(estimators.empty());
 			while (estimators.size() < nMaxThreads) {
@@ -614,13 +812,7 @@ bool DepthMapsData::EstimateDepthMap(IIndex idxImage, int nGeometricIter)
 					coords);
 				estimators.Last().lowResDepthMap = currentSizeResDepthMap;
 			}
-			ASSERT(estimators.size() == threads.size()+1);
-			FOREACH(i, threads)
-				threads[i].start(EstimateDepthMapTmp, &estimators[i]);
-			EstimateDepthMapTmp(&estimators.back());
-			// wait for the working threads to close
-			FOREACHPTR(pThread, threads)
-				pThread->join();
+			workers.Run(EstimateDepthMapTmp, estimators);
 			estimators.clear();
 			#if 1 && TD_VERBOSE != TD_VERBOSE_OFF
 			// save intermediate depth map as image
@@ -645,13 +837,13 @@ bool DepthMapsData::EstimateDepthMap(IIndex idxImage, int nGeometricIter)
 	DepthData& depthData(fullResDepthData);
 	// remove all estimates with too big score and invert confidence map
 	{
-		const float fNCCThresholdKeep(OPTDENSE::fNCCThresholdKeep);
-		if (nGeometricIter < 0 && OPTDENSE::nEstimationGeometricIters)
-			OPTDENSE::fNCCThresholdKeep *= 1.333f;
-		// create working threads
+		// relax the threshold if the geometric-consistent iterations follow
+		const float fNCCThresholdKeep(nGeometricIter < 0 && OPTDENSE::nEstimationGeometricIters ?
+			OPTDENSE::fNCCThresholdKeep*1.333f : OPTDENSE::fNCCThresholdKeep);
+		// create an estimator for each working thread
 		idxPixel = -1;
 		ASSERT(estimators.empty());
-		while (estimators.size() < nMaxThreads)
+		while (estimators.size() < nMaxThreads) {
 			estimators.emplace_back(0, depthData, idxPixel,
 				#if DENSE_NCC == DENSE_NCC_WEIGHTED
 				weightMap0,
@@ -659,15 +851,16 @@ bool DepthMapsData::EstimateDepthMap(IIndex idxImage, int nGeometricIter)
 				imageSum0,
 				#endif
 				coords);
-		ASSERT(estimators.size() == threads.size()+1);
-		FOREACH(i, threads)
-			threads[i].start(EndDepthMapTmp, &estimators[i]);
-		EndDepthMapTmp(&estimators.back());
-		// wait for the working threads to close
-		FOREACHPTR(pThread, threads)
-			pThread->join();
+			estimators.Last().thConfKeep = fNCCThresholdKeep;
+		}
+		workers.Run(EndDepthMapTmp, estimators);
 		estimators.clear();
-		OPTDENSE::fNCCThresholdKeep = fNCCThresholdKeep;
+	}
+
+	// release the estimation context
+	{
+		Lock l(csContexts);
+		freeContexts.push_back(idxContext);
 	}
 
 	DEBUG_EXTRA("Depth-map for image %3u %s: %dx%d (%s)", depthData.images.front().GetID(),
@@ -1314,8 +1507,8 @@ size_t GetAvailableMemory(const DepthDataArr& arrDepthData, const BoolArr& fused
 } // GetAvailableMemory
 
 // finds the best depth-map to fuse next that maximizes the number of neighbors already in cache
-std::tuple<unsigned, unsigned, unsigned> FetchBestNextDMapIndex(const DepthDataArr& arrDepthData, const DMapCache& cacheDMaps, const BoolArr& fusedDMaps) {
-	const IIndexArr cachedImages = cacheDMaps.GetCachedImageIndices(true);
+// (the cached images are given sorted)
+std::tuple<unsigned, unsigned, unsigned> FetchBestNextDMapIndex(const DepthDataArr& arrDepthData, const IIndexArr& cachedImages, const BoolArr& fusedDMaps) {
 	IIndex bestImageIdx = NO_ID;
 	unsigned bestImageScore = 0, bestImageSize = std::numeric_limits<unsigned>::max();
 	FOREACH(idxImage, arrDepthData) {
@@ -1345,10 +1538,65 @@ std::tuple<unsigned, unsigned, unsigned> FetchBestNextDMapIndex(const DepthDataA
 	return std::make_tuple(bestImageIdx, bestImageScore, static_cast<unsigned>(cachedImages.size()));
 } // FetchBestNextDMapIndex
 
+// predicts the next depth-maps to be fused, assuming each one gets cached together with its neighbors,
+// and lists them, each followed by its neighbors, in the order they are going to be needed
+IIndexArr PlanNextDMapIndices(const DepthDataArr& arrDepthData, IIndexArr cachedImages, BoolArr fusedDMaps, unsigned numDMaps) {
+	IIndexArr plannedImages;
+	while (numDMaps-- > 0) {
+		const IIndex idxImage(std::get<0>(FetchBestNextDMapIndex(arrDepthData, cachedImages, fusedDMaps)));
+		if (idxImage == NO_ID)
+			break;
+		fusedDMaps[idxImage] = true;
+		const DepthData& depthData = arrDepthData[idxImage];
+		IIndexArr images(0, depthData.neighbors.size()+1);
+		images.push_back(idxImage);
+		for (const ViewScore& neighbor: depthData.neighbors) {
+			if (!arrDepthData[neighbor.ID].IsValid())
+				continue;
+			images.push_back(neighbor.ID);
+			if (images.size() > OPTDENSE::nMaxViewsFuse)
+				break;
+		}
+		plannedImages.Join(images);
+		images.Sort();
+		IIndexArr cachedImagesNext;
+		std::set_union(cachedImages.begin(), cachedImages.end(),
+			images.begin(), images.end(),
+			std::back_inserter(cachedImagesNext));
+		cachedImages.swap(cachedImagesNext);
+	}
+	return plannedImages;
+} // PlanNextDMapIndices
+
+// select the neighbors the given depth-map is fused with, load them and pin them in cache,
+// so that they are neither ejected nor reloaded by the prefetch thread during the fusion;
+// return the neighbors loaded, in the order of their score
+IIndexArr LoadFuseNeighbors(const DepthDataArr& arrDepthData, IIndex idxImage, const DMapCache& cacheDMaps) {
+	IIndexArr neighbors(0, OPTDENSE::nMaxViewsFuse);
+	for (const ViewScore& neighbor: arrDepthData[idxImage].neighbors) {
+		if (neighbors.size()+1 >= OPTDENSE::nMaxViewsFuse)
+			break;
+		if (arrDepthData[neighbor.ID].IsValid())
+			neighbors.push_back(neighbor.ID);
+	}
+	#ifdef DENSE_USE_OPENMP
+	#pragma omp parallel for
+	for (int64_t i=0; i<(int64_t)neighbors.size(); ++i)
+		cacheDMaps.UseImage(neighbors[(IIndex)i], true);
+	#else
+	for (const IIndex idxImageB: neighbors)
+		cacheDMaps.UseImage(idxImageB, true);
+	#endif
+	RFOREACH(i, neighbors)
+		if (arrDepthData[neighbors[i]].IsEmpty())
+			neighbors.RemoveAtMove(i);
+	return neighbors;
+} // LoadFuseNeighbors
+
 // fuse all valid depth-maps in the same 3D point-cloud;
 // join points very likely to represent the same 3D point and
 // filter out points blocking the view
-void DepthMapsData::FuseDepthMaps(PointCloud& pointcloud, bool bEstimateColor, bool bEstimateNormal)
+void DepthMapsData::FuseDepthMaps(PointCloud& pointcloud, bool bEstimateColor, bool bEstimateNormal, PointCloudStreamWriter* pStreamWriter)
 {
 	TD_TIMER_STARTD();
 
@@ -1371,12 +1619,13 @@ void DepthMapsData::FuseDepthMaps(PointCloud& pointcloud, bool bEstimateColor, b
 	const unsigned nMinViewsFuse(MINF(OPTDENSE::nMinViewsFuse, arrDepthData.size()));
 	const float normalError(COS(FD2R(OPTDENSE::fNormalDiffThreshold)));
 	const IIndex numDMapsReserveFusion(10);
-	CLISTDEF0(Depth*) invalidDepths(0, 32);
 	size_t nDepths(0);
 	typedef TImage<cuint32_t> DepthIndex;
 	typedef cList<DepthIndex> DepthIndexArr;
 	DepthIndexArr arrDepthIdx(arrDepthData.size());
-	const size_t nPointsEstimate(arrDepthData.size() * 9000); //TODO: better estimate number of points
+	// if streaming, the points of each depth-map are written to disk once fused, so no need to reserve space for all of them
+	const size_t nPointsEstimate(pStreamWriter ? size_t(0) : arrDepthData.size() * 9000); //TODO: better estimate number of points
+	size_t nPointsStreamed(0);
 	ProjsArr projs(0, nPointsEstimate);
 	pointcloud.points.reserve(nPointsEstimate);
 	pointcloud.pointViews.reserve(nPointsEstimate);
@@ -1392,52 +1641,63 @@ void DepthMapsData::FuseDepthMaps(PointCloud& pointcloud, bool bEstimateColor, b
 	GET_LOGCONSOLE().Pause();
 	BoolArr fusedDMaps(arrDepthData.size());
 	fusedDMaps.Memset(0);
-	DMapCache cacheDMaps(arrDepthData, depthDataLoadFlags, GetAvailableMemory(arrDepthData, fusedDMaps, numDMapsReserveFusion));
+	DMapCache cacheDMaps(arrDepthData, depthDataLoadFlags, GetAvailableMemory(arrDepthData, fusedDMaps, numDMapsReserveFusion), OPTDENSE::bMapDmaps);
 	unsigned totalNumImageNeighborsInCache = 0, totalNumImagesInCache = 0;
+	// mark the given pixel of a neighbor depth-map as fused into the given point;
+	// when fusing in parallel the same pixel can be reached concurrently from different bands,
+	// so it is claimed atomically and only the first point to claim it gets it (as in the serial fusion)
+	const auto ClaimPixel = [](uint32_t& idxPixelPoint, uint32_t idxPoint) -> bool {
+		if (!OPTDENSE::bFuseParallel) {
+			idxPixelPoint = idxPoint;
+			return true;
+		}
+		return Thread::safeCompareExchange((volatile int32_t&)idxPixelPoint, (int32_t)NO_ID, (int32_t)idxPoint) == (int32_t)NO_ID;
+	};
+	const auto ReleasePixel = [](uint32_t& idxPixelPoint) {
+		if (!OPTDENSE::bFuseParallel)
+			idxPixelPoint = NO_ID;
+		else
+			Thread::safeExchange((volatile int32_t&)idxPixelPoint, (int32_t)NO_ID);
+	};
 	IIndex numDMapsFused = 0;
 	for (; numDMapsFused < arrDepthData.size(); ++numDMapsFused) {
 		TD_TIMER_STARTD();
 		// find the best depth-map to fuse next as the one with the most neighbors already in cache
-		const auto [idxImage, numImageNeighborsInCache, numImagesInCache] = FetchBestNextDMapIndex(arrDepthData, cacheDMaps, fusedDMaps);
+		const auto [idxImage, numImageNeighborsInCache, numImagesInCache] = FetchBestNextDMapIndex(arrDepthData, cacheDMaps.GetCachedImageIndices(true), fusedDMaps);
 		if (idxImage == NO_ID)
 			break; // no more depth-maps to fuse (only invalid depth-maps left)
 		totalNumImageNeighborsInCache += numImageNeighborsInCache;
 		totalNumImagesInCache += numImagesInCache;
 		// fuse depth-map
-		cacheDMaps.UseImage(idxImage);
-		cacheDMaps.SkipMemoryCheckIdxImage(idxImage);
+		cacheDMaps.UseImage(idxImage, true);
 		const DepthData& depthData(arrDepthData[idxImage]);
 		ASSERT(depthData.GetView().GetLocalID(scene.images) == idxImage);
 		ASSERT(!depthData.IsEmpty());
-		if (bEstimateNormal && depthData.normalMap.empty())
+		if (bEstimateNormal && depthData.normalMap.empty()) {
+			cacheDMaps.StopPrefetch();
 			EstimateNormalMaps();
+		}
 		ASSERT(!depthData.images.empty() && !depthData.neighbors.empty());
-		IIndex numNeighbors(0);
+		const IIndexArr neighborsFuse(LoadFuseNeighbors(arrDepthData, idxImage, cacheDMaps));
 		#ifdef DENSE_USE_OPENMP
 		#pragma omp parallel for
-		for (int64_t i=0; i<(int64_t)depthData.neighbors.size(); ++i) {
-			const ViewScore& neighbor = depthData.neighbors[(IIndex)i];
+		for (int64_t i=0; i<(int64_t)neighborsFuse.size(); ++i) {
+			const IIndex idxImageB(neighborsFuse[(IIndex)i]);
 		#else
-		for (const ViewScore& neighbor: depthData.neighbors) {
+		for (const IIndex idxImageB: neighborsFuse) {
 		#endif
-			const DepthData& depthDataB(arrDepthData[neighbor.ID]);
-			if (!depthDataB.IsValid())
-				continue;
-			cacheDMaps.UseImage(neighbor.ID);
-			if (depthDataB.IsEmpty())
-				continue;
-			if (++numNeighbors >= OPTDENSE::nMaxViewsFuse)
-				#ifdef DENSE_USE_OPENMP
-				continue;
-				#else
-				break;
-				#endif
-			DepthIndex& depthIdxs = arrDepthIdx[neighbor.ID];
+			DepthIndex& depthIdxs = arrDepthIdx[idxImageB];
 			if (!depthIdxs.empty())
 				continue;
-			depthIdxs.create(depthDataB.depthMap.size());
+			depthIdxs.create(arrDepthData[idxImageB].depthMap.size());
 			depthIdxs.memset((uint8_t)NO_ID);
 		}
+		if (OPTDENSE::nFusePrefetch > 0) {
+			// load in background the depth-maps likely to be fused next while this one is fused
+			BoolArr plannedDMaps(fusedDMaps);
+			plannedDMaps[idxImage] = true;
+			cacheDMaps.Prefetch(PlanNextDMapIndices(arrDepthData, cacheDMaps.GetCachedImageIndices(true), plannedDMaps, OPTDENSE::nFusePrefetch));
+		}
 		ASSERT(!depthData.IsEmpty());
 		const Image& imageData = *depthData.images.front().pImageData;
 		ASSERT(&imageData-scene.images.data() == idxImage);
@@ -1447,114 +1707,170 @@ void DepthMapsData::FuseDepthMaps(PointCloud& pointcloud, bool bEstimateColor, b
 			depthIdxs.create(depthData.size);
 			depthIdxs.memset((uint8_t)NO_ID);
 		}
-		const size_t nNumPointsPrev(pointcloud.points.size());
-		for (int i=0; i<depthData.size.height; ++i) {
-			for (int j=0; j<depthData.size.width; ++j) {
-				const ImageRef x(j,i);
-				const Depth depth(depthData.depthMap(x));
-				if (depth == 0)
-					continue;
-				++nDepths;
-				ASSERT(ISINSIDE(depth, depthData.dMin, depthData.dMax));
-				uint32_t& idxPoint = depthIdxs(x);
-				if (idxPoint != NO_ID)
-					continue;
-				// create the corresponding 3D point
-				idxPoint = (uint32_t)pointcloud.points.size();
-				PointCloud::Point& point = pointcloud.points.emplace_back();
-				point = imageData.camera.TransformPointI2W(Point3(Point2f(x),depth));
-				PointCloud::ViewArr& views = pointcloud.pointViews.emplace_back();
-				views.emplace_back(idxImage);
-				PointCloud::WeightArr& weights = pointcloud.pointWeights.emplace_back();
-				REAL confidence(weights.emplace_back(Conf2Weight(depthData.confMap.empty() ? 1.f : depthData.confMap(x),depth)));
-				ProjArr& pointProjs = projs.emplace_back();
-				pointProjs.emplace_back(Proj(x));
-				const PointCloud::Normal normal(!depthData.normalMap.empty() ? Cast<Normal::Type>(imageData.camera.R.t() * Cast<REAL>(depthData.normalMap(x))) : Normal(0, 0, -1));
-				ASSERT(ISEQUAL(norm(normal), 1.f), "Norm = ", norm(normal));
-				// check the projection in the neighbor depth-maps
-				Point3 X(point*confidence);
-				Pixel32F C(Cast<float>(imageData.image(x))*confidence);
-				PointCloud::Normal N(normal*confidence);
-				invalidDepths.clear();
-				for (const ViewScore& neighbor: depthData.neighbors) {
-					const IIndex idxImageB(neighbor.ID);
-					DepthData& depthDataB = arrDepthData[idxImageB];
-					if (depthDataB.IsEmpty())
-						continue;
-					const Image& imageDataB = scene.images[idxImageB];
-					const Point3f pt(imageDataB.camera.ProjectPointP3(point));
-					if (pt.z <= 0)
+		typedef CLISTDEF0(Depth*) DepthPtrArr;
+		// fuse the depths in the given band of rows of the reference depth-map into the given points;
+		// the neighbor depths disagreeing with the fused points are invalidated right away,
+		// or collected if the bands are fused concurrently, as the neighbor depth-maps are shared;
+		// return the number of valid depths
+		const auto FuseRows = [&](int rowStart, int rowEnd, PointCloud& fused, ProjsArr& fusedProjs, DepthPtrArr* pInvalidatedDepths) -> size_t {
+			DepthPtrArr invalidDepths(0, 32);
+			size_t numDepths(0);
+			for (int i=rowStart; i<rowEnd; ++i) {
+				for (int j=0; j<depthData.size.width; ++j) {
+					const ImageRef x(j,i);
+					const Depth depth(depthData.depthMap(x));
+					if (depth == 0)
 						continue;
-					const ImageRef xB(ROUND2INT(pt.x/pt.z), ROUND2INT(pt.y/pt.z));
-					DepthMap& depthMapB = depthDataB.depthMap;
-					if (!depthMapB.isInside(xB))
+					++numDepths;
+					ASSERT(ISINSIDE(depth, depthData.dMin, depthData.dMax));
+					uint32_t& idxPoint = depthIdxs(x);
+					if (idxPoint != NO_ID)
 						continue;
-					Depth& depthB = depthMapB(xB);
-					if (depthB == 0)
-						continue;
-					uint32_t& idxPointB = arrDepthIdx[idxImageB](xB);
-					if (idxPointB != NO_ID)
-						continue;
-					if (IsDepthSimilar(pt.z, depthB, OPTDENSE::fDepthDiffThreshold)) {
-						// check if normals agree
-						const PointCloud::Normal normalB(!depthData.normalMap.empty() ? Cast<Normal::Type>(imageDataB.camera.R.t() * Cast<REAL>(depthDataB.normalMap(xB))) : Normal(0, 0, -1));
-						ASSERT(ISEQUAL(norm(normalB), 1.f), "Norm = ", norm(normalB));
-						if (normal.dot(normalB) > normalError) {
-							// add view to the 3D point
-							ASSERT(views.FindFirst(idxImageB) == PointCloud::ViewArr::NO_INDEX);
-							const float confidenceB(Conf2Weight(depthDataB.confMap.empty() ? 1.f : depthDataB.confMap(xB),depthB));
-							const IIndex idx(views.InsertSort(idxImageB));
-							weights.InsertAt(idx, confidenceB);
-							pointProjs.InsertAt(idx, Proj(xB));
-							idxPointB = idxPoint;
-							X += imageDataB.camera.TransformPointI2W(Point3(Point2f(xB),depthB))*REAL(confidenceB);
-							if (bEstimateColor)
-								C += Cast<float>(imageDataB.image(xB))*confidenceB;
-							if (bEstimateNormal)
-								N += normalB*confidenceB;
-							confidence += confidenceB;
+					// create the corresponding 3D point
+					idxPoint = (uint32_t)fused.points.size();
+					PointCloud::Point& point = fused.points.emplace_back();
+					point = imageData.camera.TransformPointI2W(Point3(Point2f(x),depth));
+					PointCloud::ViewArr& views = fused.pointViews.emplace_back();
+					views.emplace_back(idxImage);
+					PointCloud::WeightArr& weights = fused.pointWeights.emplace_back();
+					REAL confidence(weights.emplace_back(Conf2Weight(depthData.confMap.empty() ? 1.f : depthData.confMap(x),depth)));
+					ProjArr& pointProjs = fusedProjs.emplace_back();
+					pointProjs.emplace_back(Proj(x));
+					const PointCloud::Normal normal(!depthData.normalMap.empty() ? Cast<Normal::Type>(imageData.camera.R.t() * Cast<REAL>(depthData.normalMap(x))) : Normal(0, 0, -1));
+					ASSERT(ISEQUAL(norm(normal), 1.f), "Norm = ", norm(normal));
+					// check the projection in the neighbor depth-maps
+					Point3 X(point*confidence);
+					Pixel32F C(Cast<float>(imageData.image(x))*confidence);
+					PointCloud::Normal N(normal*confidence);
+					invalidDepths.clear();
+					for (const IIndex idxImageB: neighborsFuse) {
+						DepthData& depthDataB = arrDepthData[idxImageB];
+						ASSERT(!depthDataB.IsEmpty() && !arrDepthIdx[idxImageB].empty());
+						const Image& imageDataB = scene.images[idxImageB];
+						const Point3f pt(imageDataB.camera.ProjectPointP3(point));
+						if (pt.z <= 0)
+							continue;
+						const ImageRef xB(ROUND2INT(pt.x/pt.z), ROUND2INT(pt.y/pt.z));
+						DepthMap& depthMapB = depthDataB.depthMap;
+						if (!depthMapB.isInside(xB))
+							continue;
+						Depth& depthB = depthMapB(xB);
+						if (depthB == 0)
+							continue;
+						uint32_t& idxPointB = arrDepthIdx[idxImageB](xB);
+						if (idxPointB != NO_ID)
 							continue;
+						if (IsDepthSimilar(pt.z, depthB, OPTDENSE::fDepthDiffThreshold)) {
+							// check if normals agree
+							const PointCloud::Normal normalB(!depthData.normalMap.empty() ? Cast<Normal::Type>(imageDataB.camera.R.t() * Cast<REAL>(depthDataB.normalMap(xB))) : Normal(0, 0, -1));
+							ASSERT(ISEQUAL(norm(normalB), 1.f), "Norm = ", norm(normalB));
+							if (normal.dot(normalB) > normalError) {
+								if (!ClaimPixel(idxPointB, idxPoint))
+									continue; // just fused in a point of another band
+								// add view to the 3D point
+								ASSERT(views.FindFirst(idxImageB) == PointCloud::ViewArr::NO_INDEX);
+								const float confidenceB(Conf2Weight(depthDataB.confMap.empty() ? 1.f : depthDataB.confMap(xB),depthB));
+								const IIndex idx(views.InsertSort(idxImageB));
+								weights.InsertAt(idx, confidenceB);
+								pointProjs.InsertAt(idx, Proj(xB));
+								X += imageDataB.camera.TransformPointI2W(Point3(Point2f(xB),depthB))*REAL(confidenceB);
+								if (bEstimateColor)
+									C += Cast<float>(imageDataB.image(xB))*confidenceB;
+								if (bEstimateNormal)
+									N += normalB*confidenceB;
+								confidence += confidenceB;
+								continue;
+							}
+						}
+						if (pt.z < depthB) {
+							// discard depth
+							invalidDepths.emplace_back(&depthB);
 						}
 					}
-					if (pt.z < depthB) {
-						// discard depth
-						invalidDepths.emplace_back(&depthB);
-					}
-				}
-				if (views.size() < nMinViewsFuse) {
-					// remove point
-					FOREACH(v, views) {
-						const IIndex idxImageB(views[v]);
-						const ImageRef x(pointProjs[v].GetCoord());
-						ASSERT(arrDepthIdx[idxImageB].isInside(x) && arrDepthIdx[idxImageB](x).idx != NO_ID);
-						arrDepthIdx[idxImageB](x).idx = NO_ID;
+					if (views.size() < nMinViewsFuse) {
+						// remove point
+						FOREACH(v, views) {
+							const IIndex idxImageB(views[v]);
+							const ImageRef x(pointProjs[v].GetCoord());
+							ASSERT(arrDepthIdx[idxImageB].isInside(x) && arrDepthIdx[idxImageB](x).idx != NO_ID);
+							ReleasePixel(arrDepthIdx[idxImageB](x).idx);
+						}
+						fusedProjs.pop_back();
+						fused.pointWeights.pop_back();
+						fused.pointViews.pop_back();
+						fused.points.pop_back();
+					} else {
+						// this point is valid, store it
+						const REAL nrm(REAL(1)/confidence);
+						point = X*nrm;
+						ASSERT(ISFINITE(point));
+						if (bEstimateColor)
+							fused.colors.emplace_back((C*(float)nrm).cast<uint8_t>());
+						if (bEstimateNormal)
+							fused.normals.emplace_back(normalized(N*(float)nrm));
+						// invalidate all neighbor depths that do not agree with it
+						if (pInvalidatedDepths)
+							pInvalidatedDepths->Join(invalidDepths);
+						else
+							for (Depth* pDepth: invalidDepths)
+								*pDepth = 0;
 					}
-					projs.pop_back();
-					pointcloud.pointWeights.pop_back();
-					pointcloud.pointViews.pop_back();
-					pointcloud.points.pop_back();
-				} else {
-					// this point is valid, store it
-					const REAL nrm(REAL(1)/confidence);
-					point = X*nrm;
-					ASSERT(ISFINITE(point));
-					if (bEstimateColor)
-						pointcloud.colors.emplace_back((C*(float)nrm).cast<uint8_t>());
-					if (bEstimateNormal)
-						pointcloud.normals.emplace_back(normalized(N*(float)nrm));
-					// invalidate all neighbor depths that do not agree with it
-					for (Depth* pDepth: invalidDepths)
-						*pDepth = 0;
 				}
 			}
+			return numDepths;
+		};
+		const size_t nNumPointsPrev(pointcloud.points.size());
+		if (!OPTDENSE::bFuseParallel) {
+			nDepths += FuseRows(0, depthData.size.height, pointcloud, projs, NULL);
+		} else {
+			// fuse concurrently bands of rows, each into its own points,
+			// and append them to the point-cloud in order
+			struct FusedBand {
+				PointCloud pointcloud;
+				ProjsArr projs;
+				DepthPtrArr invalidatedDepths;
+				size_t nDepths;
+			};
+			const int numBands(MINF((int)scene.nMaxThreads*4, depthData.size.height));
+			const int numRowsBand((depthData.size.height+numBands-1)/numBands);
+			cList<FusedBand> bands(numBands);
+			#ifdef DENSE_USE_OPENMP
+			#pragma omp parallel for schedule(dynamic)
+			#endif
+			for (int b=0; b<numBands; ++b) {
+				FusedBand& band = bands[b];
+				band.nDepths = FuseRows(b*numRowsBand, MINF((b+1)*numRowsBand, depthData.size.height), band.pointcloud, band.projs, &band.invalidatedDepths);
+			}
+			// invalidate the neighbor depths disagreeing with the fused points, once all bands are done
+			for (const FusedBand& band: bands)
+				for (Depth* pDepth: band.invalidatedDepths)
+					*pDepth = 0;
+			for (FusedBand& band: bands) {
+				pointcloud.points.JoinRemove(band.pointcloud.points);
+				pointcloud.pointViews.JoinRemove(band.pointcloud.pointViews);
+				pointcloud.pointWeights.JoinRemove(band.pointcloud.pointWeights);
+				pointcloud.colors.JoinRemove(band.pointcloud.colors);
+				pointcloud.normals.JoinRemove(band.pointcloud.normals);
+				projs.JoinRemove(band.projs);
+				nDepths += band.nDepths;
+			}
 		}
 		fusedDMaps[idxImage] = true;
 		ASSERT(pointcloud.points.size() == pointcloud.pointViews.size() && pointcloud.points.size() == pointcloud.pointWeights.size() && pointcloud.points.size() == projs.size());
 		DEBUG_ULTIMATE("Depth-map for reference image %3u fused using %u depth-maps: %u new points, %u/%u cached images (%s)",
 			idxImage, depthData.images.size()-1, pointcloud.points.size()-nNumPointsPrev, numImageNeighborsInCache, numImagesInCache, TD_TIMER_GET_FMT().c_str());
+		if (pStreamWriter) {
+			// the points seen by this depth-map are final (no other depth-map can fuse into them),
+			// so write them to disk and free the memory
+			if (!pStreamWriter->Write(pointcloud))
+				VERBOSE("error: failed writing the fused points");
+			nPointsStreamed += pointcloud.points.size();
+			pointcloud.Release();
+			projs.Release();
+		}
 		progress.display(numDMapsFused);
 		// ensure enough memory is available for the next depth-maps chunk
-		cacheDMaps.SkipMemoryCheckIdxImage();
+		cacheDMaps.UnpinImages();
 		if (numDMapsFused % numDMapsReserveFusion == 0)
 			cacheDMaps.SetMaxMemory(GetAvailableMemory(arrDepthData, fusedDMaps, numDMapsReserveFusion, cacheDMaps.GetUsedMemory()));
 	}
@@ -1563,10 +1879,14 @@ void DepthMapsData::FuseDepthMaps(PointCloud& pointcloud, bool bEstimateColor, b
 	arrDepthIdx.Release();
 	cacheDMaps.ClearCache();	
 
-	DEBUG_EXTRA("Depth-maps fused and filtered: %u depth-maps, %u depths, %u points (%d%%%%), %.2f hits in %.2f cached (%s)",
-		numDMapsFused, nDepths, pointcloud.points.size(), ROUND2INT((100.f*pointcloud.points.size())/nDepths),
+	const size_t nPointsFused(pStreamWriter ? nPointsStreamed : pointcloud.points.size());
+	DEBUG_EXTRA("Depth-maps fused and filtered: %u depth-maps, %u depths, %u points (%d%%%%)%s, %.2f hits in %.2f cached (%s)",
+		numDMapsFused, nDepths, nPointsFused, ROUND2INT((100.f*nPointsFused)/nDepths), pStreamWriter ? " streamed" : "",
 		static_cast<double>(totalNumImageNeighborsInCache) / numDMapsFused,
 		static_cast<double>(totalNumImagesInCache) / numDMapsFused, TD_TIMER_GET_FMT().c_str());
+	DEBUG_EXTRA("Depth-maps cache: %u hits, %u misses, %u prefetched, %s read%s",
+		cacheDMaps.GetNumImageHits(), cacheDMaps.GetNumImageReads(), cacheDMaps.GetNumImagePrefetches(),
+		Util::formatBytes(cacheDMaps.GetNumBytesRead()).c_str(), OPTDENSE::bMapDmaps ? " (mapped)" : "");
 
 	if (bEstimateNormal && !pointcloud.points.empty() && pointcloud.normals.empty()) {
 		// estimate normal also if requested (quite expensive if normal-maps not available)
@@ -1600,7 +1920,7 @@ void DepthMapsData::FuseDepthMaps(PointCloud& pointcloud, bool bEstimateColor, b
 // fuse all valid depth-maps in the same 3D point-cloud;
 // join points very likely to represent the same 3D point and
 // filter out points blocking the view
-void DepthMapsData::DenseFuseDepthMaps(PointCloud& pointcloud, bool bEstimateColor, bool _bEstimateNormal)
+void DepthMapsData::DenseFuseDepthMaps(PointCloud& pointcloud, bool bEstimateColor, bool _bEstimateNormal, PointCloudStreamWriter* pStreamWriter)
 {
 	TD_TIMER_STARTD();
 
@@ -1616,7 +1936,9 @@ void DepthMapsData::DenseFuseDepthMaps(PointCloud& pointcloud, bool bEstimateCol
 	const bool bEstimateNormal(true); // always estimate normals as they are needed for the fusion
 	size_t nDepths(0);
 	UseMaskArr arrUseMask(arrDepthData.size());
-	const size_t nPointsEstimate(arrDepthData.size() * 9000); //TODO: better estimate number of points
+	// if streaming, the points of each depth-map are written to disk once fused, so no need to reserve space for all of them
+	const size_t nPointsEstimate(pStreamWriter ? size_t(0) : arrDepthData.size() * 9000); //TODO: better estimate number of points
+	size_t nPointsStreamed(0);
 	pointcloud.points.reserve(nPointsEstimate);
 	pointcloud.pointViews.reserve(nPointsEstimate);
 	pointcloud.pointWeights.reserve(nPointsEstimate);
@@ -1631,7 +1953,7 @@ void DepthMapsData::DenseFuseDepthMaps(PointCloud& pointcloud, bool bEstimateCol
 	GET_LOGCONSOLE().Pause();
 	BoolArr fusedDMaps(arrDepthData.size());
 	fusedDMaps.Memset(0);
-	DMapCache cacheDMaps(arrDepthData, depthDataLoadFlags, GetAvailableMemory(arrDepthData, fusedDMaps, numDMapsReserveFusion));
+	DMapCache cacheDMaps(arrDepthData, depthDataLoadFlags, GetAvailableMemory(arrDepthData, fusedDMaps, numDMapsReserveFusion), OPTDENSE::bMapDmaps);
 	unsigned totalNumImageNeighborsInCache = 0, totalNumImagesInCache = 0;
 	BoolArr neighbors(arrDepthData.size());
 	PointCloud::Point refPoint;
@@ -1732,51 +2054,40 @@ void DepthMapsData::DenseFuseDepthMaps(PointCloud& pointcloud, bool bEstimateCol
 	while (true) {
 		TD_TIMER_STARTD();
 		// find the best depth-map to fuse next as the one with the most neighbors already in cache
-		const auto [idxImage, numImageNeighborsInCache, numImagesInCache] = FetchBestNextDMapIndex(arrDepthData, cacheDMaps, fusedDMaps);
+		const auto [idxImage, numImageNeighborsInCache, numImagesInCache] = FetchBestNextDMapIndex(arrDepthData, cacheDMaps.GetCachedImageIndices(true), fusedDMaps);
 		if (idxImage == NO_ID)
 			break; // no more depth-maps to fuse (only invalid depth-maps left)
 		totalNumImageNeighborsInCache += numImageNeighborsInCache;
 		totalNumImagesInCache += numImagesInCache;
 		++numDMapsFused;
 		// fuse depth-map
-		cacheDMaps.UseImage(idxImage);
-		cacheDMaps.SkipMemoryCheckIdxImage(idxImage);
+		cacheDMaps.UseImage(idxImage, true);
 		const DepthData& depthData(arrDepthData[idxImage]);
 		ASSERT(depthData.GetView().GetLocalID(scene.images) == idxImage);
 		ASSERT(!depthData.IsEmpty());
-		if (bEstimateNormal && depthData.normalMap.empty())
+		if (bEstimateNormal && depthData.normalMap.empty()) {
+			cacheDMaps.StopPrefetch();
 			EstimateNormalMaps();
+		}
 		// make sure all neighbors are cached
 		neighbors.Memset(0);
 		neighbors[idxImage] = true;
-		IIndex numNeighbors(0);
 		ASSERT(!depthData.images.empty() && !depthData.neighbors.empty());
-		#ifdef DENSE_USE_OPENMP
-		#pragma omp parallel for
-		for (int64_t i=0; i<(int64_t)depthData.neighbors.size(); ++i) {
-			const ViewScore& neighbor = depthData.neighbors[(IIndex)i];
-		#else
-		for (const ViewScore& neighbor: depthData.neighbors) {
-		#endif
-			const DepthData& depthDataB(arrDepthData[neighbor.ID]);
-			if (!depthDataB.IsValid())
-				continue;
-			cacheDMaps.UseImage(neighbor.ID);
-			if (depthDataB.IsEmpty())
-				continue;
-			neighbors[neighbor.ID] = true;
-			if (++numNeighbors >= OPTDENSE::nMaxViewsFuse)
-				#ifdef DENSE_USE_OPENMP
-				continue;
-				#else
-				break;
-				#endif
-			UseMask& useMask = arrUseMask[neighbor.ID];
+		const IIndexArr neighborsFuse(LoadFuseNeighbors(arrDepthData, idxImage, cacheDMaps));
+		for (const IIndex idxImageB: neighborsFuse) {
+			neighbors[idxImageB] = true;
+			UseMask& useMask = arrUseMask[idxImageB];
 			if (!useMask.empty())
 				continue;
-			useMask.create(depthDataB.depthMap.size());
+			useMask.create(arrDepthData[idxImageB].depthMap.size());
 			useMask.memset(0);
 		}
+		if (OPTDENSE::nFusePrefetch > 0) {
+			// load in background the depth-maps likely to be fused next while this one is fused
+			BoolArr plannedDMaps(fusedDMaps);
+			plannedDMaps[idxImage] = true;
+			cacheDMaps.Prefetch(PlanNextDMapIndices(arrDepthData, cacheDMaps.GetCachedImageIndices(true), plannedDMaps, OPTDENSE::nFusePrefetch));
+		}
 		ASSERT(!depthData.IsEmpty());
 		const Image& imageData = *depthData.images.front().pImageData;
 		ASSERT(&imageData-scene.images.data() == idxImage);
@@ -1824,9 +2135,16 @@ void DepthMapsData::DenseFuseDepthMaps(PointCloud& pointcloud, bool bEstimateCol
 		ASSERT(pointcloud.points.size() == pointcloud.pointViews.size() && pointcloud.points.size() == pointcloud.pointWeights.size());
 		DEBUG_ULTIMATE("Depth-map for reference image %3u fused using %u depth-maps: %u new points, %u/%u cached images (%s)",
 			idxImage, depthData.images.size() - 1, pointcloud.points.size() - nNumPointsPrev, numImageNeighborsInCache, numImagesInCache, TD_TIMER_GET_FMT().c_str());
+		if (pStreamWriter) {
+			// the points seen by this depth-map are final, so write them to disk and free the memory
+			if (!pStreamWriter->Write(pointcloud))
+				VERBOSE("error: failed writing the fused points");
+			nPointsStreamed += pointcloud.points.size();
+			pointcloud.Release();
+		}
 		progress.display(numDMapsFused);
 		// ensure enough memory is available for the next depth-maps chunk
-		cacheDMaps.SkipMemoryCheckIdxImage();
+		cacheDMaps.UnpinImages();
 		if (numDMapsFused % numDMapsReserveFusion == 0)
 			cacheDMaps.SetMaxMemory(GetAvailableMemory(arrDepthData, fusedDMaps, numDMapsReserveFusion, cacheDMaps.GetUsedMemory()));
 	}
@@ -1837,10 +2155,14 @@ void DepthMapsData::DenseFuseDepthMaps(PointCloud& pointcloud, bool bEstimateCol
 	if (!_bEstimateNormal)
 		pointcloud.normals.Release();
 
-	DEBUG_EXTRA("Depth-maps dense fused and filtered: %u depth-maps, %u depths, %u points (%d%%%%), %.2f hits in %.2f cached (%s)",
-		numDMapsFused, nDepths, pointcloud.points.size(), ROUND2INT((100.f*pointcloud.points.size())/nDepths),
+	const size_t nPointsFused(pStreamWriter ? nPointsStreamed : pointcloud.points.size());
+	DEBUG_EXTRA("Depth-maps dense fused and filtered: %u depth-maps, %u depths, %u points (%d%%%%)%s, %.2f hits in %.2f cached (%s)",
+		numDMapsFused, nDepths, nPointsFused, ROUND2INT((100.f*nPointsFused)/nDepths), pStreamWriter ? " streamed" : "",
 		static_cast<double>(totalNumImageNeighborsInCache) / numDMapsFused,
 		static_cast<double>(totalNumImagesInCache) / numDMapsFused, TD_TIMER_GET_FMT().c_str());
+	DEBUG_EXTRA("Depth-maps cache: %u hits, %u misses, %u prefetched, %s read%s",
+		cacheDMaps.GetNumImageHits(), cacheDMaps.GetNumImageReads(), cacheDMaps.GetNumImagePrefetches(),
+		Util::formatBytes(cacheDMaps.GetNumBytesRead()).c_str(), OPTDENSE::bMapDmaps ? " (mapped)" : "");
 } // DenseFuseDepthMaps
 /*----------------------------------------------------------------*/
 
@@ -1849,7 +2171,7 @@ void DepthMapsData::DenseFuseDepthMaps(PointCloud& pointcloud, bool bEstimateCol
 // S T R U C T S ///////////////////////////////////////////////////
 
 DenseDepthMapData::DenseDepthMapData(Scene& _scene, int _nFusionMode)
-	: scene(_scene), depthMaps(_scene), idxImage(0), sem(1), nEstimationGeometricIter(-1), nFusionMode(_nFusionMode)
+	: scene(_scene), depthMaps(_scene), idxImage(0), sem(1), nEstimationThreads(1), nEstimationGeometricIter(-1), nFusionMode(_nFusionMode)
 {
 	if (nFusionMode < 0) {
 		STEREO::SemiGlobalMatcher::CreateThreads(scene.nMaxThreads);
@@ -1872,13 +2194,209 @@ void DenseDepthMapData::SignalCompleteDepthmapFilter()
 /*----------------------------------------------------------------*/
 
 
+void DepthMapsImageLoader::Start(std::vector<IIndexArr>&& _viewIDs, unsigned _nWindow)
+{
+	Stop();
+	viewIDs = std::move(_viewIDs);
+	imageUses.resize(scene.images.size());
+	imageUses.Memset(0);
+	imageStates.resize(scene.images.size());
+	numImagesLoaded = 0;
+	FOREACH(idxImage, scene.images) {
+		imageStates[idxImage] = scene.images[idxImage].image.empty() ? NOT_LOADED : LOADED;
+		if (imageStates[idxImage] == LOADED)
+			++numImagesLoaded;
+	}
+	numImagesLoadedPeak = numImagesLoaded;
+	for (const IIndexArr& IDs: viewIDs)
+		for (IIndex idxImage: IDs)
+			++imageUses[idxImage];
+	depthMapsReleased.resize((IIndex)viewIDs.size());
+	depthMapsReleased.Memset(0);
+	idxFirstPending = idxNextAcquire = idxNextPrefetch = 0;
+	nWindow = MAXF(_nWindow, 1u);
+	bStop = false;
+	threadPrefetch = std::thread(&DepthMapsImageLoader::ThreadPrefetch, this);
+} // Start
+
+void DepthMapsImageLoader::Stop()
+{
+	if (threadPrefetch.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			bStop = true;
+		}
+		condition.notify_all();
+		threadPrefetch.join();
+	}
+	if (!IsActive())
+		return;
+	// release the images still loaded (if the estimation was interrupted)
+	FOREACH(idxImage, imageStates)
+		if (imageUses[idxImage] > 0 && imageStates[idxImage] == LOADED)
+			scene.images[idxImage].ReleaseImage();
+	DEBUG_EXTRA("Images loaded just-in-time for %u depth-maps: at most %u images (out of %u) loaded at the same time", viewIDs.size(), numImagesLoadedPeak, imageStates.size());
+	viewIDs.clear();
+	imageUses.Release();
+	imageStates.Release();
+	depthMapsReleased.Release();
+} // Stop
+/*----------------------------------------------------------------*/
+
+bool DepthMapsImageLoader::Acquire(IIndex idx)
+{
+	if (!IsActive())
+		return true;
+	std::unique_lock<std::mutex> lock(mutex);
+	if (idxNextAcquire <= idx) {
+		// advance the prefetch window
+		idxNextAcquire = idx+1;
+		condition.notify_all();
+	}
+	for (IIndex idxImage: viewIDs[idx])
+		if (!LoadImage(idxImage, lock))
+			return false;
+	return true;
+} // Acquire
+
+void DepthMapsImageLoader::Release(IIndex idx)
+{
+	if (!IsActive())
+		return;
+	std::lock_guard<std::mutex> lock(mutex);
+	ASSERT(!depthMapsReleased[idx]);
+	depthMapsReleased[idx] = true;
+	while (idxFirstPending < viewIDs.size() && depthMapsReleased[idxFirstPending])
+		++idxFirstPending;
+	for (IIndex idxImage: viewIDs[idx]) {
+		ASSERT(imageUses[idxImage] > 0);
+		--imageUses[idxImage];
+		if (imageStates[idxImage] == LOADED && !IsImageNeeded(idxImage)) {
+			scene.images[idxImage].ReleaseImage();
+			imageStates[idxImage] = NOT_LOADED;
+			--numImagesLoaded;
+		}
+	}
+} // Release
+
+bool DepthMapsImageLoader::GetImagePixels(IIndex idxImage, Image8U3& image)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!IsActive() || imageStates[idxImage] == LOADED)
+		image = scene.images[idxImage].image;
+	else
+		image.release();
+	return !image.empty();
+} // GetImagePixels
+/*----------------------------------------------------------------*/
+
+// load the pixels of the given image at the resolution set when the image header was read,
+// or wait for it if it is being loaded by another thread;
+// the lock is released while reading the image
+bool DepthMapsImageLoader::LoadImage(IIndex idxImage, std::unique_lock<std::mutex>& lock)
+{
+	condition.wait(lock, [&]() { return imageStates[idxImage] != LOADING; });
+	if (imageStates[idxImage] == LOADED)
+		return true;
+	if (imageUses[idxImage] == 0)
+		return false; // released meanwhile by the last depth-map using it
+	imageStates[idxImage] = LOADING;
+	lock.unlock();
+	Image& imageData = scene.images[idxImage];
+	const bool bLoaded(imageData.ReloadImage(MAXF(imageData.width, imageData.height)));
+	lock.lock();
+	if (bLoaded) {
+		imageStates[idxImage] = LOADED;
+		if (numImagesLoadedPeak < ++numImagesLoaded)
+			numImagesLoadedPeak = numImagesLoaded;
+	} else {
+		imageStates[idxImage] = NOT_LOADED;
+	}
+	condition.notify_all();
+	return bLoaded;
+} // LoadImage
+
+// check if the given image is needed by any depth-map in progress (acquired, but not yet released)
+// or inside the prefetch window; the images needed only by later depth-maps are reloaded when needed
+bool DepthMapsImageLoader::IsImageNeeded(IIndex idxImage) const
+{
+	if (imageUses[idxImage] == 0)
+		return false;
+	const IIndex idxEnd(MINF((IIndex)viewIDs.size(), idxNextAcquire+nWindow));
+	for (IIndex idx=idxFirstPending; idx<idxEnd; ++idx)
+		if (!depthMapsReleased[idx] && viewIDs[idx].Find(idxImage) != IIndexArr::NO_INDEX)
+			return true;
+	return false;
+} // IsImageNeeded
+
+// load in advance the images needed by the next depth-maps to be initialized
+void DepthMapsImageLoader::ThreadPrefetch()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		condition.wait(lock, [this]() {
+			return bStop || MAXF(idxNextPrefetch, idxNextAcquire) < MINF((IIndex)viewIDs.size(), idxNextAcquire+nWindow);
+		});
+		if (bStop)
+			break;
+		const IIndex idx(MAXF(idxNextPrefetch, idxNextAcquire));
+		idxNextPrefetch = idx+1;
+		for (IIndex idxImage: viewIDs[idx]) {
+			// skip the images not needed anymore (all depth-maps using it were initialized meanwhile);
+			// loading errors are reported when the image is acquired
+			if (bStop)
+				break;
+			if (imageUses[idxImage] > 0)
+				LoadImage(idxImage, lock);
+		}
+	}
+} // ThreadPrefetch
+/*----------------------------------------------------------------*/
+
+
 
 // S T R U C T S ///////////////////////////////////////////////////
 
 static void* DenseReconstructionEstimateTmp(void*);
 static void* DenseReconstructionFilterTmp(void*);
 
-bool Scene::DenseReconstruction(int nFusionMode, bool bCrop2ROI, float fBorderROI, int indexPremiereImage, int indexDerniereImage, double profondeurMaximale, double hauteurMaximale)
+// start loading just-in-time the images needed by the depth-maps estimated in the next pass
+static void StartDepthMapsImageLoader(DenseDepthMapData& data)
+{
+	std::vector<IIndexArr> viewIDs(data.images.size());
+	FOREACH(i, data.images) {
+		const IIndex idx(data.images[i]);
+		const DepthData& depthData(data.depthMaps.arrDepthData[idx]);
+		// same condition as in DenseReconstructionEstimate() for loading the images
+		const bool depthmapComputed(data.nEstimationGeometricIter < 0 && File::access(ComposeDepthFilePath(data.scene.images[idx].ID, "dmap")));
+		if (!depthmapComputed)
+			viewIDs[i] = data.depthMaps.GetInitViewIDs(depthData, data.neighborsMap.IsEmpty()?NO_ID:data.neighborsMap[i], OPTDENSE::nNumViews);
+	}
+	data.imageLoader.Start(std::move(viewIDs), data.nEstimationThreads);
+}
+
+// make sure the pixels of the given images are loaded
+// (needed by the fusion to estimate the point colors)
+static bool EnsureImagesLoaded(ImageArr& images, const IIndexArr& idxImages)
+{
+	TD_TIMER_STARTD();
+	bool bAbort(false);
+	#ifdef DENSE_USE_OPENMP
+	#pragma omp parallel for shared(bAbort) schedule(dynamic)
+	#endif
+	for (int_t i=0; i<(int_t)idxImages.size(); ++i) {
+		Image& imageData = images[idxImages[i]];
+		if (!imageData.image.empty() || imageData.ReloadImage(MAXF(imageData.width, imageData.height)))
+			continue;
+		bAbort = true;
+	}
+	if (bAbort)
+		return false;
+	DEBUG_EXTRA("Images loaded for fusion: %u images (%s)", idxImages.size(), TD_TIMER_GET_FMT().c_str());
+	return true;
+}
+
+bool Scene::DenseReconstruction(int nFusionMode, bool bCrop2ROI, float fBorderROI, int indexPremiereImage, int indexDerniereImage, double profondeurMaximale, double hauteurMaximale, const String& fileNameStreamPointCloud)
 {
 	DenseDepthMapData data(*this, nFusionMode);
 	
@@ -1891,8 +2409,27 @@ bool Scene::DenseReconstruction(int nFusionMode, bool bCrop2ROI, float fBorderRO
 	if (ABS(nFusionMode) == 1)
 		return true;
 
+	// load the images pixels released after the depth-map estimation, if the fusion needs the colors
+	if (OPTDENSE::nEstimateColors != 0 && !EnsureImagesLoaded(images, data.images)) {
+		VERBOSE("error: failed loading the images for the depth-map fusion");
+		return false;
+	}
+
 	// fuse all depth-maps
 	pointcloud.Release();
+	// optionally write the fused points directly to disk as soon as they are final,
+	// instead of keeping the entire point-cloud in memory
+	PointCloudStreamWriter streamWriter;
+	const OBB3f ROI(fBorderROI == 0 ? obb : (fBorderROI > 0 ? OBB3f(obb).EnlargePercent(fBorderROI) : OBB3f(obb).Enlarge(-fBorderROI)));
+	if (!fileNameStreamPointCloud.empty()) {
+		if (OPTDENSE::nEstimateColors == 1 || OPTDENSE::nEstimateNormals == 1)
+			DEBUG("warning: colors and normals can not be estimated after fusion when streaming the point-cloud; only the ones estimated during fusion are stored");
+		if (!streamWriter.Open(fileNameStreamPointCloud, OPTDENSE::nEstimateColors == 2, OPTDENSE::nEstimateNormals == 2, true))
+			return false;
+		if (bCrop2ROI && IsBounded())
+			streamWriter.SetROI(&ROI);
+	}
+	PointCloudStreamWriter* const pStreamWriter(streamWriter.IsOpen() ? &streamWriter : NULL);
 	switch (OPTDENSE::nFuseFilter) {
 	case OPTDENSE::FUSE_NOFILTER:
 		// merge depth-maps
@@ -1900,14 +2437,27 @@ bool Scene::DenseReconstruction(int nFusionMode, bool bCrop2ROI, float fBorderRO
 		break;
 	case OPTDENSE::FUSE_FILTER:
 		// fuse depth-maps
-		data.depthMaps.FuseDepthMaps(pointcloud, OPTDENSE::nEstimateColors == 2, OPTDENSE::nEstimateNormals == 2);
+		data.depthMaps.FuseDepthMaps(pointcloud, OPTDENSE::nEstimateColors == 2, OPTDENSE::nEstimateNormals == 2, pStreamWriter);
 		break;
 	case OPTDENSE::FUSE_DENSEFILTER:
 		// dense fuse depth-maps
-		data.depthMaps.DenseFuseDepthMaps(pointcloud, OPTDENSE::nEstimateColors == 2, OPTDENSE::nEstimateNormals == 2);
+		data.depthMaps.DenseFuseDepthMaps(pointcloud, OPTDENSE::nEstimateColors == 2, OPTDENSE::nEstimateNormals == 2, pStreamWriter);
+	}
+	if (pStreamWriter) {
+		// write any points still in memory (merging depth-maps does not stream)
+		if (!pointcloud.IsEmpty()) {
+			pStreamWriter->Write(pointcloud);
+			pointcloud.Release();
+		}
+		const size_t numPoints(pStreamWriter->GetNumPoints());
+		if (!streamWriter.Close()) {
+			VERBOSE("error: failed writing the dense point-cloud: '%s'", fileNameStreamPointCloud.c_str());
+			return false;
+		}
+		VERBOSE("Dense point-cloud streamed: %u points written to '%s'", numPoints, fileNameStreamPointCloud.c_str());
 	}
 	#if TD_VERBOSE != TD_VERBOSE_OFF
-	if (g_nVerbosityLevel > 2) {
+	if (g_nVerbosityLevel > 2 && !pStreamWriter) {
 		// print number of points with 3+ views
 		size_t nPoints1m(0), nPoints2(0), nPoints3p(0);
 		FOREACHPTR(pViews, pointcloud.pointViews) {
@@ -1932,7 +2482,6 @@ bool Scene::DenseReconstruction(int nFusionMode, bool bCrop2ROI, float fBorderRO
 		if (bCrop2ROI && IsBounded()) {
 			TD_TIMER_START();
 			const size_t numPoints = pointcloud.GetSize();
-			const OBB3f ROI(fBorderROI == 0 ? obb : (fBorderROI > 0 ? OBB3f(obb).EnlargePercent(fBorderROI) : OBB3f(obb).Enlarge(-fBorderROI)));
 			pointcloud.RemovePointsOutside(ROI);
 			VERBOSE("Point-cloud trimmed to ROI: %u points removed (%s)",
 				numPoints-pointcloud.GetSize(), TD_TIMER_GET_FMT().c_str());
@@ -1976,7 +2525,11 @@ bool Scene::ComputeDepthMaps(DenseDepthMapData& data, int indexPremiereImage, in
 	// maps global view indices to our list of views to be processed
 	IIndexArr imagesMap;
 
-	// prepare images for dense reconstruction (load if needed)
+	// prepare images for dense reconstruction:
+	// when estimating depth-maps only the image size is needed at this point, so read just the image headers,
+	// the pixels being loaded later just-in-time for each depth-map (see DepthMapsImageLoader);
+	// the semi-global matcher needs all the images loaded
+	const bool bLoadPixels(data.nFusionMode < 0);
 	{
 		TD_TIMER_START();
 		data.images.Reserve(images.GetSize());
@@ -2012,7 +2565,9 @@ bool Scene::ComputeDepthMaps(DenseDepthMapData& data, int indexPremiereImage, in
 			// reload image at the appropriate resolution
 			unsigned nResolutionLevel(OPTDENSE::nResolutionLevel);
 			const unsigned nMaxResolution(imageData.RecomputeMaxResolution(nResolutionLevel, OPTDENSE::nMinResolution, OPTDENSE::nMaxResolution));
-			if (!imageData.ReloadImage(nMaxResolution)) {
+			if (!bLoadPixels)
+				imageData.ReleaseImage();
+			if (!imageData.ReloadImage(nMaxResolution, bLoadPixels)) {
 				#ifdef DENSE_USE_OPENMP
 				bAbort = true;
 				#pragma omp flush (bAbort)
@@ -2041,6 +2596,16 @@ bool Scene::ComputeDepthMaps(DenseDepthMapData& data, int indexPremiereImage, in
 	// select images to be used for dense reconstruction
 	{
 		TD_TIMER_START();
+		// index the points seen by each image once, if the neighbor views need to be selected
+		ImagePointsArr imagePoints;
+		if (pointcloud.IsValid()) {
+			for (const IIndex idxImage: data.images) {
+				if (images[idxImage].neighbors.empty()) {
+					ComputeImagePoints(imagePoints);
+					break;
+				}
+			}
+		}
 		// for each image, find all useful neighbor views
 		IIndexArr invalidIDs;
 		#ifdef DENSE_USE_OPENMP
@@ -2053,7 +2618,7 @@ bool Scene::ComputeDepthMaps(DenseDepthMapData& data, int indexPremiereImage, in
 			const IIndex idxImage(data.images[idx]);
 			ASSERT(imagesMap[idxImage] != NO_ID);
 			DepthData& depthData(data.depthMaps.arrDepthData[idxImage]);
-			bool imageATraiter = data.depthMaps.SelectViews(depthData);
+			bool imageATraiter = data.depthMaps.SelectViews(depthData, imagePoints.empty() ? NULL : &imagePoints[idxImage]);
 			if (indexPremiereImage != -1 && ((int)idxImage < indexPremiereImage || (int)idxImage > indexDerniereImage))
 				imageATraiter = false;
 
@@ -2087,6 +2652,16 @@ bool Scene::ComputeDepthMaps(DenseDepthMapData& data, int indexPremiereImage, in
 	}
 	#endif // _USE_CUDA
 
+	// initialize the estimation contexts, as several depth-maps can be estimated concurrently
+	const unsigned nConcurrentImages(data.nFusionMode >= 0 ? data.depthMaps.ComputeNumConcurrentImages(data.images, nMaxThreads) : 1u);
+	if (data.nFusionMode >= 0)
+		data.depthMaps.InitEstimationContexts(nConcurrentImages, nMaxThreads);
+	data.sem.Clear(nConcurrentImages);
+	// one more thread prepares the next image and saves the estimated depth-maps
+	data.nEstimationThreads = (nMaxThreads > 1 ? nConcurrentImages+1 : 1);
+	if (nConcurrentImages > 1)
+		VERBOSE("Estimating %u depth-maps concurrently using %u threads each", nConcurrentImages, MAXF(nMaxThreads/nConcurrentImages, 1u));
+
 	// initialize the queue of images to be processed
 	const int nOptimize(OPTDENSE::nOptimize);
 	if (OPTDENSE::nEstimationGeometricIters && data.nFusionMode >= 0)
@@ -2094,12 +2669,14 @@ bool Scene::ComputeDepthMaps(DenseDepthMapData& data, int indexPremiereImage, in
 	data.idxImage = 0;
 	ASSERT(data.events.IsEmpty());
 	data.events.AddEvent(new EVTProcessImage(0));
+	if (!bLoadPixels)
+		StartDepthMapsImageLoader(data);
 	// start working threads
 	data.progress = new Util::Progress("Estimated depth-maps", data.images.GetSize());
 	GET_LOGCONSOLE().Pause();
 	if (nMaxThreads > 1) {
 		// multi-thread execution
-		cList<SEACAVE::Thread> threads(2);
+		cList<SEACAVE::Thread> threads(data.nEstimationThreads);
 		FOREACHPTR(pThread, threads)
 			pThread->start(DenseReconstructionEstimateTmp, (void*)&data);
 		FOREACHPTR(pThread, threads)
@@ -2109,6 +2686,7 @@ bool Scene::ComputeDepthMaps(DenseDepthMapData& data, int indexPremiereImage, in
 		DenseReconstructionEstimate((void*)&data);
 	}
 	GET_LOGCONSOLE().Play();
+	data.imageLoader.Stop();
 	if (!data.events.IsEmpty())
 		return false;
 	data.progress.Release();
@@ -2128,12 +2706,14 @@ bool Scene::ComputeDepthMaps(DenseDepthMapData& data, int indexPremiereImage, in
 			data.idxImage = 0;
 			ASSERT(data.events.IsEmpty());
 			data.events.AddEvent(new EVTProcessImage(0));
+			if (!bLoadPixels)
+				StartDepthMapsImageLoader(data);
 			// start working threads
 			data.progress = new Util::Progress("Geometric-consistent estimated depth-maps", data.images.GetSize());
 			GET_LOGCONSOLE().Pause();
 			if (nMaxThreads > 1) {
 				// multi-thread execution
-				cList<SEACAVE::Thread> threads(2);
+				cList<SEACAVE::Thread> threads(data.nEstimationThreads);
 				FOREACHPTR(pThread, threads)
 					pThread->start(DenseReconstructionEstimateTmp, (void*)&data);
 				FOREACHPTR(pThread, threads)
@@ -2143,6 +2723,7 @@ bool Scene::ComputeDepthMaps(DenseDepthMapData& data, int indexPremiereImage, in
 				DenseReconstructionEstimate((void*)&data);
 			}
 			GET_LOGCONSOLE().Play();
+			data.imageLoader.Stop();
 			if (!data.events.IsEmpty())
 				return false;
 			data.progress.Release();
@@ -2159,6 +2740,9 @@ bool Scene::ComputeDepthMaps(DenseDepthMapData& data, int indexPremiereImage, in
 		data.nEstimationGeometricIter = -1;
 	}
 
+	// release the depth-map estimation working threads
+	data.depthMaps.ReleaseEstimationContexts();
+
 	if ((OPTDENSE::nOptimize & (OPTDENSE::ADJUST_CONFIDENCE | OPTDENSE::ADJUST_CONFIDENCE_FAST)) != 0) {
 		// initialize the queue of depth-maps to be filtered
 		data.sem.Clear();
@@ -2205,10 +2789,9 @@ void Scene::DenseReconstructionEstimate(void* pData)
 		case EVT_PROCESSIMAGE: {
 			const EVTProcessImage& evtImage = *((EVTProcessImage*)(Event*)evt);
 			if (evtImage.idxImage >= data.images.size()) {
-				if (nMaxThreads > 1) {
-					// close working threads
+				// close the other working threads
+				for (unsigned i=1; i<data.nEstimationThreads; ++i)
 					data.events.AddEvent(new EVTClose);
-				}
 				return;
 			}
 			// select views to reconstruct the depth-map for this image
@@ -2217,7 +2800,13 @@ void Scene::DenseReconstructionEstimate(void* pData)
 			const bool depthmapComputed(data.nFusionMode < 0 || (data.nFusionMode >= 0 && data.nEstimationGeometricIter < 0 && File::access(ComposeDepthFilePath(data.scene.images[idx].ID, "dmap"))));
 			// initialize images pair: reference image and the best neighbor view
 			ASSERT(data.neighborsMap.IsEmpty() || data.neighborsMap[evtImage.idxImage] != NO_ID);
-			if (!data.depthMaps.InitViews(depthData, data.neighborsMap.IsEmpty()?NO_ID:data.neighborsMap[evtImage.idxImage], OPTDENSE::nNumViews, !depthmapComputed, depthmapComputed ? -1 : (data.nEstimationGeometricIter >= 0 ? 1 : 0))) {
+			if (!depthmapComputed && !data.imageLoader.Acquire(evtImage.idxImage)) {
+				VERBOSE("error: failed loading the images for depth-map %u", data.scene.images[idx].ID);
+				exit(EXIT_FAILURE);
+			}
+			const bool bInitViews(data.depthMaps.InitViews(depthData, data.neighborsMap.IsEmpty()?NO_ID:data.neighborsMap[evtImage.idxImage], OPTDENSE::nNumViews, !depthmapComputed, depthmapComputed ? -1 : (data.nEstimationGeometricIter >= 0 ? 1 : 0)));
+			data.imageLoader.Release(evtImage.idxImage);
+			if (!bInitViews) {
 				// process next image
 				data.events.AddEvent(new EVTProcessImage((IIndex)Thread::safeInc(data.idxImage)));
 				break;
@@ -2308,7 +2897,12 @@ void Scene::DenseReconstructionEstimate(void* pData)
 			if (g_nVerbosityLevel > 2) {
 				ExportDepthMap(ComposeDepthFilePath(depthData.GetView().GetID(), "png"), depthData.depthMap);
 				ExportConfidenceMap(ComposeDepthFilePath(depthData.GetView().GetID(), "conf.png"), depthData.confMap);
-				ExportPointCloud(ComposeDepthFilePath(depthData.GetView().GetID(), "ply"), *depthData.images.First().pImageData, depthData.depthMap, depthData.normalMap);
+				// the image pixels are used for the colors only if still loaded,
+				// as they can be released concurrently by the images loader
+				Image imageData;
+				imageData.camera = depthData.images.First().pImageData->camera;
+				data.imageLoader.GetImagePixels(depthData.GetView().GetLocalID(data.scene.images), imageData.image);
+				ExportPointCloud(ComposeDepthFilePath(depthData.GetView().GetID(), "ply"), imageData, depthData.depthMap, depthData.normalMap);
 				if (g_nVerbosityLevel > 4) {
 					ExportNormalMap(ComposeDepthFilePath(depthData.GetView().GetID(), "normal.png"), depthData.normalMap);
 					depthData.confMap.Save(ComposeDepthFilePath(depthData.GetView().GetID(), "conf.pfm"));
@@ -50,6 +50,53 @@ class PatchMatch;
 } // namespace CUDA
 #endif // _USE_CUDA
 
+// pool of persistent working threads used to run the depth-map estimation stages;
+// the threads are created once and reused for all images and iterations,
+// each thread processing the pixels of its own estimator
+// (the calling thread processes the last estimator)
+class MVS_API DepthEstimatorPool
+{
+public:
+	typedef void* (STCALL *FncStage)(void*);
+	typedef cList<DepthEstimator> DepthEstimatorArr;
+
+	DepthEstimatorPool();
+	~DepthEstimatorPool();
+
+	void Init(unsigned nThreads);
+	void Release();
+
+	// number of estimators processed in parallel (including the calling thread)
+	inline unsigned GetSize() const { return nWorkers+1; }
+
+	// run the given stage function on all estimators and wait for them to finish
+	void Run(FncStage fnStage, DepthEstimatorArr& estimators);
+
+	// print time spent by the working threads processing vs waiting for work
+	void LogStats() const;
+
+protected:
+	static void* STCALL WorkerTmp(void*);
+
+	struct Worker {
+		DepthEstimatorPool* pPool;
+		unsigned idx;
+		Thread thread;
+		Semaphore start; // signaled when a new stage is available
+		Timer::SysType timeIdle, timeWork;
+	};
+
+protected:
+	CAutoPtrArr<Worker> workers;
+	unsigned nWorkers;
+	Semaphore done; // signaled by each worker when finishing the current stage
+	FncStage fnStage; // current stage to be run (NULL to close the working threads)
+	DepthEstimator* pEstimators; // current estimators
+	Timer::SysType timeWait, timeWork; // time spent by the calling thread
+	unsigned nStages; // number of stages run
+};
+/*----------------------------------------------------------------*/
+
 // structure used to compute all depth-maps
 class MVS_API DepthMapsData
 {
@@ -57,10 +104,15 @@ public:
 	DepthMapsData(Scene& _scene);
 	~DepthMapsData();
 
-	bool SelectViews(DepthData& depthData);
+	bool SelectViews(DepthData& depthData, const IndexArr* pImagePoints=NULL);
 	bool InitViews(DepthData& depthData, IIndex idxNeighbor, IIndex numNeighbors, bool loadImages, int loadDepthMaps);
+	IIndexArr GetInitViewIDs(const DepthData& depthData, IIndex idxNeighbor, IIndex numNeighbors) const;
 	bool InitDepthMap(DepthData& depthData);
 	bool EstimateDepthMap(IIndex idxImage, int nGeometricIter);
+
+	void InitEstimationContexts(unsigned nConcurrentImages, unsigned nMaxThreads);
+	void ReleaseEstimationContexts();
+	unsigned ComputeNumConcurrentImages(const IIndexArr& images, unsigned nMaxThreads) const;
 	
 	bool RemoveSmallSegments(DepthData& depthData);
 	bool GapInterpolation(DepthData& depthData);
@@ -70,8 +122,8 @@ public:
 	bool AdjustConfidenceFast(DepthData& depthData, const IIndexArr& idxNeighbors, double profondeurMaximale, double hauteurMaximale);
 	bool AdjustConfidence(DepthData& depthDataRef, const IIndexArr& idxNeighbors, double profondeurMaximale, double hauteurMaximale);
 	void MergeDepthMaps(PointCloud& pointcloud, bool bEstimateColor, bool bEstimateNormal);
-	void FuseDepthMaps(PointCloud& pointcloud, bool bEstimateColor, bool bEstimateNormal);
-	void DenseFuseDepthMaps(PointCloud& pointcloud, bool bEstimateColor, bool bEstimateNormal);
+	void FuseDepthMaps(PointCloud& pointcloud, bool bEstimateColor, bool bEstimateNormal, PointCloudStreamWriter* pStreamWriter=NULL);
+	void DenseFuseDepthMaps(PointCloud& pointcloud, bool bEstimateColor, bool bEstimateNormal, PointCloudStreamWriter* pStreamWriter=NULL);
 
 	static DepthData ScaleDepthData(const DepthData& inputDeptData, float scale);
 
@@ -85,11 +137,17 @@ public:
 
 	DepthDataArr arrDepthData;
 
-	// used internally to estimate the depth-maps
-	Image8U::Size prevDepthMapSize; // remember the size of the last estimated depth-map
-	Image8U::Size prevDepthMapSizeTrg; // ... same for target image
-	DepthEstimator::MapRefArr coords; // map pixel index to zigzag matrix coordinates
-	DepthEstimator::MapRefArr coordsTrg; // ... same for target image
+	// used internally to estimate the depth-maps;
+	// one context is used by each of the depth-maps estimated concurrently
+	struct EstimationContext {
+		Image8U::Size prevDepthMapSize; // remember the size of the last estimated depth-map
+		DepthEstimator::MapRefArr coords; // map pixel index to zigzag matrix coordinates
+		DepthEstimatorPool workers; // persistent working threads used to estimate the depth-map
+	};
+	CAutoPtrArr<EstimationContext> contexts;
+	unsigned nContexts;
+	IIndexArr freeContexts; // indices of the contexts not currently in use
+	CriticalSection csContexts; // guard access to the free contexts
 
 	#ifdef _USE_CUDA
 	// used internally to estimate the depth-maps using CUDA
@@ -98,6 +156,57 @@ public:
 };
 /*----------------------------------------------------------------*/
 
+// loads the pixels of the scene images just-in-time for initializing the views of each depth-map:
+// a background thread loads in advance the images needed by a bounded window of upcoming depth-maps,
+// and each image is released as soon as none of the depth-maps in progress or inside the window needs it
+// (and reloaded if a later depth-map needs it again), so the memory used stays flat regardless of the number of images
+class MVS_API DepthMapsImageLoader
+{
+public:
+	explicit DepthMapsImageLoader(Scene& _scene) : scene(_scene), bStop(true) {}
+	~DepthMapsImageLoader() { Stop(); }
+
+	// start loading the images needed by each depth-map, in order
+	// (an empty list means the depth-map does not need any image pixels)
+	void Start(std::vector<IIndexArr>&& viewIDs, unsigned nWindow);
+	// stop the background thread and release all loaded images
+	void Stop();
+	bool IsActive() const { return !viewIDs.empty(); }
+
+	// make sure the images needed by the given depth-map are loaded
+	bool Acquire(IIndex idx);
+	// mark the images needed by the given depth-map as not needed anymore
+	void Release(IIndex idx);
+	// get the pixels of the given image, if loaded, sharing them so they stay valid
+	// even if the image is released meanwhile by the loader
+	bool GetImagePixels(IIndex idxImage, Image8U3& image);
+
+protected:
+	bool LoadImage(IIndex idxImage, std::unique_lock<std::mutex>& lock);
+	bool IsImageNeeded(IIndex idxImage) const;
+	void ThreadPrefetch();
+
+protected:
+	enum { NOT_LOADED = 0, LOADING, LOADED };
+
+	Scene& scene;
+	std::vector<IIndexArr> viewIDs; // images needed by each depth-map
+	CLISTDEF0IDX(uint32_t,IIndex) imageUses; // number of depth-maps still needing each image
+	CLISTDEF0IDX(uint8_t,IIndex) imageStates; // loading state of each image
+	BoolArr depthMapsReleased; // depth-maps already initialized and released
+	IIndex idxFirstPending; // first depth-map not yet released
+	IIndex idxNextAcquire; // first depth-map not yet initialized
+	IIndex numImagesLoaded; // number of images currently loaded
+	IIndex numImagesLoadedPeak; // maximum number of images loaded at the same time
+	IIndex idxNextPrefetch; // first depth-map not yet prefetched
+	unsigned nWindow; // how many depth-maps ahead to prefetch
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::thread threadPrefetch;
+	bool bStop;
+};
+/*----------------------------------------------------------------*/
+
 struct MVS_API DenseDepthMapData {
 	Scene& scene;
 	IIndexArr images;
@@ -106,10 +215,12 @@ struct MVS_API DenseDepthMapData {
 	volatile Thread::safe_t idxImage;
 	SEACAVE::EventQueue events; // internal events queue (processed by the working threads)
 	Semaphore sem;
+	unsigned nEstimationThreads; // number of threads processing the estimation events
 	CAutoPtr<Util::Progress> progress;
 	int nEstimationGeometricIter;
 	int nFusionMode;
 	STEREO::SemiGlobalMatcher sgm;
+	DepthMapsImageLoader imageLoader;
 
 	DenseDepthMapData(Scene& _scene, int _nFusionMode=0);
 	~DenseDepthMapData();
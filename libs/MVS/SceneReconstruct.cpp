@@ -31,6 +31,7 @@
 
 #include "Common.h"
 #include "Scene.h"
+#include "MaxFlow.h"
 // Delaunay: mesh reconstruction
 #include <CGAL/Exact_predicates_inexact_constructions_kernel.h>
 #include <CGAL/Delaunay_triangulation_3.h>
@@ -56,139 +57,9 @@ extern void outputLogSQL(std::string nature, std::string chaine1, std::string ch
 // uncomment to enable reconstruction algorithm of weakly supported surfaces
 #define DELAUNAY_WEAKSURF
 
-// uncomment to use IBFS algorithm for max-flow
-// (faster, but not clear license policy)
-#define DELAUNAY_MAXFLOW_IBFS
-
-
-// S T R U C T S ///////////////////////////////////////////////////
-
-#ifdef DELAUNAY_MAXFLOW_IBFS
-#include "../Math/IBFS/IBFS.h"
-template <typename NType, typename VType>
-class MaxFlow
-{
-public:
-	// Type-Definitions
-	typedef NType node_type;
-	typedef VType value_type;
-	typedef IBFS::IBFSGraph graph_type;
-
-public:
-	MaxFlow(size_t numNodes) {
-		graph.initSize((int)numNodes, (int)numNodes*2);
-	}
-
-	inline void AddNode(node_type n, value_type source, value_type sink) {
-		ASSERT(ISFINITE(source) && source >= 0 && ISFINITE(sink) && sink >= 0);
-		graph.addNode((int)n, source, sink);
-	}
-
-	inline void AddEdge(node_type n1, node_type n2, value_type capacity, value_type reverseCapacity) {
-		ASSERT(ISFINITE(capacity) && capacity >= 0 && ISFINITE(reverseCapacity) && reverseCapacity >= 0);
-		graph.addEdge((int)n1, (int)n2, capacity, reverseCapacity);
-	}
-
-	value_type ComputeMaxFlow() {
-		graph.initGraph();
-		return graph.computeMaxFlow();
-	}
-
-	inline bool IsNodeOnSrcSide(node_type n) const {
-		return graph.isNodeOnSrcSide((int)n);
-	}
-
-protected:
-	graph_type graph;
-};
-#else
-#include <boost/graph/graph_traits.hpp>
-#include <boost/graph/one_bit_color_map.hpp>
-#include <boost/property_map/property_map.hpp>
-#include <boost/graph/adjacency_list.hpp>
-#include <boost/graph/boykov_kolmogorov_max_flow.hpp>
-template <typename NType, typename VType>
-class MaxFlow
-{
-public:
-	// Type-Definitions
-	typedef NType node_type;
-	typedef VType value_type;
-	typedef boost::vecS out_edge_list_t;
-	typedef boost::vecS vertex_list_t;
-	typedef boost::adjacency_list_traits<out_edge_list_t, vertex_list_t, boost::directedS> graph_traits;
-	typedef typename graph_traits::edge_descriptor edge_descriptor;
-	typedef typename graph_traits::vertex_descriptor vertex_descriptor;
-	typedef typename graph_traits::vertices_size_type vertex_size_type;
-	struct Edge {
-		value_type capacity;
-		value_type residual;
-		edge_descriptor reverse;
-	};
-	typedef boost::adjacency_list<out_edge_list_t, vertex_list_t, boost::directedS, size_t, Edge> graph_type;
-	typedef typename boost::graph_traits<graph_type>::edge_iterator edge_iterator;
-	typedef typename boost::graph_traits<graph_type>::out_edge_iterator out_edge_iterator;
-
-public:
-	MaxFlow(size_t numNodes) : graph(numNodes+2), S(node_type(numNodes)), T(node_type(numNodes+1)) {}
-
-	void AddNode(node_type n, value_type source, value_type sink) {
-		ASSERT(ISFINITE(source) && source >= 0 && ISFINITE(sink) && sink >= 0);
-		if (source > 0) {
-			edge_descriptor e(boost::add_edge(S, n, graph).first);
-			edge_descriptor er(boost::add_edge(n, S, graph).first);
-			graph[e].capacity = source;
-			graph[e].reverse = er;
-			graph[er].reverse = e;
-		}
-		if (sink > 0) {
-			edge_descriptor e(boost::add_edge(n, T, graph).first);
-			edge_descriptor er(boost::add_edge(T, n, graph).first);
-			graph[e].capacity = sink;
-			graph[e].reverse = er;
-			graph[er].reverse = e;
-		}
-	}
-
-	void AddEdge(node_type n1, node_type n2, value_type capacity, value_type reverseCapacity) {
-		ASSERT(ISFINITE(capacity) && capacity >= 0 && ISFINITE(reverseCapacity) && reverseCapacity >= 0);
-		edge_descriptor e(boost::add_edge(n1, n2, graph).first);
-		edge_descriptor er(boost::add_edge(n2, n1, graph).first);
-		graph[e].capacity = capacity;
-		graph[er].capacity = reverseCapacity;
-		graph[e].reverse = er;
-		graph[er].reverse = e;
-	}
-
-	value_type ComputeMaxFlow() {
-		vertex_size_type n_verts(boost::num_vertices(graph));
-		color.resize(n_verts);
-		std::vector<edge_descriptor> pred(n_verts);
-		std::vector<vertex_size_type> dist(n_verts);
-		return boost::boykov_kolmogorov_max_flow(graph,
-			boost::get(&Edge::capacity, graph),
-			boost::get(&Edge::residual, graph),
-			boost::get(&Edge::reverse, graph),
-			&pred[0],
-			&color[0],
-			&dist[0],
-			boost::get(boost::vertex_index, graph),
-			S, T
-		);
-	}
-
-	inline bool IsNodeOnSrcSide(node_type n) const {
-		return (color[n] != boost::white_color);
-	}
-
-protected:
-	graph_type graph;
-	std::vector<boost::default_color_type> color;
-	const node_type S;
-	const node_type T;
-};
-#endif
-/*----------------------------------------------------------------*/
+// uncomment to store the facet weights in half precision
+// (reduces the memory used by the weighting stage, but the weights saturate at 65504)
+// #define DELAUNAY_HALF_WEIGHTS
 
 
 // S T R U C T S ///////////////////////////////////////////////////
@@ -210,9 +81,6 @@ typedef uint32_t cell_size_t;
 
 typedef float edge_cap_t;
 
-#ifdef DELAUNAY_WEAKSURF
-struct view_info_t;
-#endif
 struct vert_info_t {
 	typedef edge_cap_t Type;
 	struct view_t {
@@ -225,46 +93,66 @@ struct vert_info_t {
 	};
 	typedef SEACAVE::cList<view_t,const view_t&,0,4,uint32_t> view_vec_t;
 	view_vec_t views; // faces' weight from the cell outwards
-	#ifdef DELAUNAY_WEAKSURF
-	view_info_t* viewsInfo; // each view caches the two faces from the point towards the camera and the end (used only by the weakly supported surfaces)
-	inline vert_info_t() : viewsInfo(NULL) {}
-	~vert_info_t();
-	void AllocateInfo();
-	#else
 	inline vert_info_t() {}
-	#endif
 	void InsertViews(const PointCloud& pc, PointCloud::Index idxPoint) {
 		const PointCloud::ViewArr& _views = pc.pointViews[idxPoint];
 		ASSERT(!_views.IsEmpty());
 		const PointCloud::WeightArr* pweights(pc.pointWeights.IsEmpty() ? NULL : pc.pointWeights.Begin()+idxPoint);
 		ASSERT(pweights == NULL || _views.GetSize() == pweights->GetSize());
-		FOREACH(i, _views) {
-			const PointCloud::View viewID(_views[i]);
-			const PointCloud::Weight weight(pweights ? (*pweights)[i] : PointCloud::Weight(1));
-			// insert viewID in increasing order
-			const uint32_t idx(views.FindFirstEqlGreater(viewID));
-			if (idx < views.GetSize() && views[idx] == viewID) {
-				// the new view is already in the array
-				ASSERT(views.FindFirst(viewID) == idx);
-				// update point's weight
-				views[idx].weight += weight;
-			} else {
-				// the new view is not in the array,
-				// insert it
-				views.InsertAt(idx, view_t(viewID, weight));
-				ASSERT(views.IsSorted());
-			}
+		FOREACH(i, _views)
+			InsertView(_views[i], pweights ? (*pweights)[i] : PointCloud::Weight(1));
+	}
+	void InsertViews(const view_vec_t& _views) {
+		for (const view_t& view: _views)
+			InsertView(view.idxView, view.weight);
+	}
+	void InsertView(PointCloud::View viewID, Type weight) {
+		// insert viewID in increasing order
+		const uint32_t idx(views.FindFirstEqlGreater(viewID));
+		if (idx < views.GetSize() && views[idx] == viewID) {
+			// the new view is already in the array
+			ASSERT(views.FindFirst(viewID) == idx);
+			// update point's weight
+			views[idx].weight += weight;
+		} else {
+			// the new view is not in the array,
+			// insert it
+			views.InsertAt(idx, view_t(viewID, weight));
+			ASSERT(views.IsSorted());
 		}
 	}
 };
 
-struct cell_info_t {
-	typedef edge_cap_t Type;
-	Type f[4]; // faces' weight from the cell outwards
-	Type s; // cell's weight towards s-source
-	Type t; // cell's weight towards t-sink
-	inline const Type* ptr() const { return f; }
-	inline Type* ptr() { return f; }
+#ifdef DELAUNAY_HALF_WEIGHTS
+typedef hfloat facet_cap_t;
+#define DELAUNAY_MAX_FACET_CAP 65504.f
+#else
+typedef edge_cap_t facet_cap_t;
+#define DELAUNAY_MAX_FACET_CAP FLT_MAX
+#endif
+
+// weights of all cells, stored as structure-of-arrays
+// (and the facet weights optionally in half precision)
+struct cells_info_t {
+	std::vector<facet_cap_t> f; // faces' weight from the cell outwards (4 per cell)
+	std::vector<edge_cap_t> t; // cell's weight towards t-sink
+	std::vector<bool> s; // cell's weight towards s-source (infinite if set, 0 otherwise)
+	void Init(size_t numCells) {
+		f.assign(numCells*4, facet_cap_t(0));
+		t.assign(numCells, edge_cap_t(0));
+		s.assign(numCells, false);
+	}
+	void Release() {
+		std::vector<facet_cap_t>().swap(f);
+		std::vector<edge_cap_t>().swap(t);
+		std::vector<bool>().swap(s);
+	}
+	inline edge_cap_t GetFacet(cell_size_t c, int i) const { return (edge_cap_t)f[(size_t)c*4+i]; }
+	inline void AddFacet(cell_size_t c, int i, edge_cap_t w) {
+		facet_cap_t& fw(f[(size_t)c*4+i]);
+		fw = (facet_cap_t)MINF((edge_cap_t)fw + w, DELAUNAY_MAX_FACET_CAP);
+	}
+	inline size_t GetMemorySize() const { return sizeof(facet_cap_t)*f.size() + sizeof(edge_cap_t)*t.size() + s.size()/8; }
 };
 
 typedef CGAL::Triangulation_vertex_base_with_info_3<vert_info_t, kernel_t> vertex_base_t;
@@ -277,20 +165,13 @@ typedef delaunay_t::Facet facet_t;
 typedef delaunay_t::Edge edge_t;
 
 #ifdef DELAUNAY_WEAKSURF
+// each view of a vertex caches the two faces from the point towards the camera and the end
+// (used only by the weakly supported surfaces); the entries of all vertices are allocated
+// in a single array, the entries of a vertex starting at its offset
 struct view_info_t {
 	cell_handle_t cell2Cam;
 	cell_handle_t cell2End;
 };
-vert_info_t::~vert_info_t() {
-	delete[] viewsInfo;
-}
-void vert_info_t::AllocateInfo() {
-	ASSERT(!views.IsEmpty());
-	viewsInfo = new view_info_t[views.GetSize()];
-	#ifndef _RELEASE
-	memset(viewsInfo, 0, sizeof(view_info_t)*views.GetSize());
-	#endif
-}
 #endif
 
 struct camera_cell_t {
@@ -678,14 +559,14 @@ inline bool intersectFace(const delaunay_t& Tr, const segment_t& seg, const vert
 
 
 // Given a cell, compute the free-space support for it
-edge_cap_t freeSpaceSupport(const delaunay_t& Tr, const std::vector<cell_info_t>& infoCells, const cell_handle_t& cell)
+edge_cap_t freeSpaceSupport(const delaunay_t& Tr, const cells_info_t& infoCells, const cell_handle_t& cell)
 {
 	// sum up all 4 incoming weights
 	// (corresponding to the 4 facets of the neighbor cells)
 	edge_cap_t wf(0);
 	for (int i=0; i<4; ++i) {
 		const facet_t& mfacet(Tr.mirror_facet(facet_t(cell, i)));
-		wf += infoCells[mfacet.first->info()].f[mfacet.second];
+		wf += infoCells.GetFacet(mfacet.first->info(), mfacet.second);
 	}
 	return wf;
 }
@@ -757,129 +638,240 @@ float computePlaneSphereAngle(const delaunay_t& Tr, const facet_t& facet)
 	// compute the angle between the two vectors
 	return CLAMP((fn.dot(ct))/SQRT(fnLenSq*ctLenSq), -1.f, 1.f);
 }
-} // namespace DELAUNAY
 
-// First, iteratively create a Delaunay triangulation of the existing point-cloud by inserting point by point,
-// iif the point to be inserted is not closer than distInsert pixels in at least one of its views to
-// the projection of any of already inserted points.
-// Next, the score is computed for all the edges of the directed graph composed of points as vertices.
-// Finally, graph-cut algorithm is used to split the tetrahedrons in inside and outside,
-// and the surface is such extracted.
-bool Scene::ReconstructMesh(float distInsert, bool bUseFreeSpaceSupport, bool bUseOnlyROI, unsigned nItersFixNonManifold,
-							float kSigma, float kQual, float kb,
-							float kf, float kRel, float kAbs, float kOutl,
-							float kInf
-)
+// Fetch the points to be triangulated (optionally only the ones inside the given OBB)
+// and sort them spatially (along a space filling curve)
+void fetchPoints(const PointCloud& pointcloud, const OBB3f* pOBB, std::vector<point_t>& vertices, std::vector<std::ptrdiff_t>& indices)
+{
+	vertices.resize(pointcloud.points.size());
+	indices.clear();
+	indices.reserve(pointcloud.points.size());
+	FOREACH(i, pointcloud.points) {
+		const PointCloud::Point& X(pointcloud.points[i]);
+		if (pOBB && !pOBB->Intersects(X))
+			continue;
+		vertices[i] = point_t(X.x, X.y, X.z);
+		indices.push_back(i);
+	}
+	typedef CGAL::Spatial_sort_traits_adapter_3<delaunay_t::Geom_traits, point_t*> Search_traits;
+	CGAL::spatial_sort(indices.begin(), indices.end(), Search_traits(vertices.data(), delaunay_t::Geom_traits()));
+}
+
+// Insert the given point in the triangulation iif it is not closer than distInsert pixels
+// in at least one of its views to the projection of the nearest already inserted point;
+// return the vertex the point was inserted as, or the existing vertex it was merged into
+template <typename VIEWS>
+vertex_handle_t insertPoint(delaunay_t& delaunay, const ImageArr& images, const point_t& p, const PointCloud::Point& point, const VIEWS& views, float distInsertSq, vertex_handle_t hint)
+{
+	ASSERT(!views.IsEmpty());
+	if (hint == vertex_handle_t()) {
+		// this is the first point,
+		// insert it
+		hint = delaunay.insert(p);
+		ASSERT(hint != vertex_handle_t());
+		return hint;
+	}
+	if (distInsertSq <= 0) {
+		// insert all points
+		hint = delaunay.insert(p, hint);
+		ASSERT(hint != vertex_handle_t());
+		return hint;
+	}
+	// locate cell containing this point
+	delaunay_t::Locate_type lt;
+	int li, lj;
+	const cell_handle_t c(delaunay.locate(p, lt, li, lj, hint->cell()));
+	if (lt == delaunay_t::VERTEX) {
+		// duplicate point, nothing to insert,
+		// just update its visibility info
+		hint = c->vertex(li);
+		ASSERT(hint != delaunay.infinite_vertex());
+		return hint;
+	}
+	// locate the nearest vertex
+	vertex_handle_t nearest;
+	if (delaunay.dimension() < 3) {
+		// use a brute-force algorithm if dimension < 3
+		delaunay_t::Finite_vertices_iterator vit = delaunay.finite_vertices_begin();
+		nearest = vit;
+		++vit;
+		adjacent_vertex_back_inserter_t inserter(delaunay, p, nearest);
+		for (delaunay_t::Finite_vertices_iterator end = delaunay.finite_vertices_end(); vit != end; ++vit)
+			inserter = vit;
+	} else {
+		// - start with the closest vertex from the located cell
+		// - repeatedly take the nearest of its incident vertices if any
+		// - if not, we're done
+		ASSERT(c != cell_handle_t());
+		nearest = delaunay.nearest_vertex_in_cell(p, c);
+		while (true) {
+			const vertex_handle_t v(nearest);
+			delaunay.adjacent_vertices(nearest, adjacent_vertex_back_inserter_t(delaunay, p, nearest));
+			if (v == nearest)
+				break;
+		}
+	}
+	ASSERT(nearest == delaunay.nearest_vertex(p, hint->cell()));
+	// check if point is far enough to all existing points
+	for (const auto& viewID: views) {
+		const Image& imageData = images[(PointCloud::View)viewID];
+		const Point3f pn(imageData.camera.ProjectPointP3(point));
+		const Point3f pe(imageData.camera.ProjectPointP3(CGAL2MVS<float>(nearest->point())));
+		if (!IsDepthSimilar(pn.z, pe.z) || normSq(Point2f(pn)-Point2f(pe)) > distInsertSq) {
+			// point far enough to an existing point,
+			// insert as a new point
+			hint = delaunay.insert(p, lt, c, li, lj);
+			ASSERT(hint != vertex_handle_t());
+			return hint;
+		}
+	}
+	return nearest;
+}
+
+// Split the given range of points in the given number of spatially compact blocks of similar size,
+// by recursively dividing them along the longest axis of their bounding box (as in a kd-tree);
+// store the beginning of each block in the reordered indices
+void splitPointsBlocks(const std::vector<point_t>& vertices, std::vector<std::ptrdiff_t>& indices, size_t idxBegin, size_t idxEnd, size_t numBlocks, std::vector<size_t>& blockBegins)
+{
+	if (numBlocks <= 1) {
+		blockBegins.push_back(idxBegin);
+		return;
+	}
+	double ptMin[3] = {DBL_MAX, DBL_MAX, DBL_MAX}, ptMax[3] = {-DBL_MAX, -DBL_MAX, -DBL_MAX};
+	for (size_t i=idxBegin; i<idxEnd; ++i) {
+		const point_t& p(vertices[indices[i]]);
+		for (int k=0; k<3; ++k) {
+			if (ptMin[k] > p[k]) ptMin[k] = p[k];
+			if (ptMax[k] < p[k]) ptMax[k] = p[k];
+		}
+	}
+	int axis(0);
+	for (int k=1; k<3; ++k)
+		if (ptMax[k]-ptMin[k] > ptMax[axis]-ptMin[axis])
+			axis = k;
+	const size_t numBlocksLeft(numBlocks/2);
+	const size_t idxSplit(idxBegin+(idxEnd-idxBegin)*numBlocksLeft/numBlocks);
+	std::nth_element(indices.begin()+idxBegin, indices.begin()+idxSplit, indices.begin()+idxEnd,
+		[&vertices, axis](std::ptrdiff_t a, std::ptrdiff_t b) { return vertices[a][axis] < vertices[b][axis]; });
+	splitPointsBlocks(vertices, indices, idxBegin, idxSplit, numBlocksLeft, blockBegins);
+	splitPointsBlocks(vertices, indices, idxSplit, idxEnd, numBlocks-numBlocksLeft, blockBegins);
+}
+
+// Decimate the given points as in insertPoint(), inserting them in spatial order in a local triangulation,
+// and store the kept vertices with the visibility of the points merged into them
+struct kept_point_t {
+	point_t p;
+	vert_info_t::view_vec_t views;
+};
+void decimatePoints(const ImageArr& images, const PointCloud& pointcloud, const std::vector<point_t>& vertices,
+	std::ptrdiff_t* idxBegin, std::ptrdiff_t* idxEnd, float distInsertSq, std::vector<kept_point_t>& keptPoints, Util::Progress& progress)
+{
+	typedef CGAL::Spatial_sort_traits_adapter_3<delaunay_t::Geom_traits, const point_t*> Search_traits;
+	CGAL::spatial_sort(idxBegin, idxEnd, Search_traits(vertices.data(), delaunay_t::Geom_traits()));
+	delaunay_t delaunay;
+	vertex_handle_t hint;
+	for (const std::ptrdiff_t* pIdx=idxBegin; pIdx!=idxEnd; ++pIdx) {
+		const std::ptrdiff_t idx(*pIdx);
+		hint = insertPoint(delaunay, images, vertices[idx], pointcloud.points[idx], pointcloud.pointViews[idx], distInsertSq, hint);
+		hint->info().InsertViews(pointcloud, idx);
+		++progress;
+	}
+	keptPoints.reserve(delaunay.number_of_vertices());
+	for (delaunay_t::Finite_vertices_iterator vit=delaunay.finite_vertices_begin(), evit=delaunay.finite_vertices_end(); vit!=evit; ++vit)
+		keptPoints.push_back(kept_point_t{vit->point(), std::move(vit->info().views)});
+}
+
+// Insert the given spatially sorted points in the triangulation, decimating them as in insertPoint();
+// if more threads are used, the points are split in spatially compact blocks (see splitPointsBlocks())
+// that are decimated in parallel, each in its own local triangulation, and only the vertices kept
+// by each block, with the visibility of the points merged into them, are inserted next in the global
+// triangulation, decimated again, so that the points kept by two blocks along their common border
+// are merged if closer than distInsert
+void insertPoints(delaunay_t& delaunay, const ImageArr& images, const PointCloud& pointcloud,
+	const std::vector<point_t>& vertices, const std::vector<std::ptrdiff_t>& indices, float distInsert, unsigned nThreads)
+{
+	Util::Progress progress(_T("Points inserted"), indices.size());
+	const float distInsertSq(distInsert > 0 ? SQUARE(distInsert) : 0.f);
+	#ifdef DELAUNAY_USE_OPENMP
+	// each block should contain enough points for the decimation to be effective
+	const size_t nMinPointsBlock(256*1024);
+	if (nThreads > 1 && distInsert > 0 && indices.size() >= nMinPointsBlock*2) {
+		const size_t numBlocks(MINF(indices.size()/nMinPointsBlock, (size_t)nThreads*4));
+		std::vector<std::ptrdiff_t> blockIndices(indices);
+		std::vector<size_t> blockBegins;
+		blockBegins.reserve(numBlocks+1);
+		splitPointsBlocks(vertices, blockIndices, 0, blockIndices.size(), numBlocks, blockBegins);
+		blockBegins.push_back(blockIndices.size());
+		std::vector<std::vector<kept_point_t>> blocksPoints(numBlocks);
+		#pragma omp parallel for num_threads(nThreads) schedule(dynamic)
+		for (int_t b=0; b<(int_t)numBlocks; ++b) {
+			decimatePoints(images, pointcloud, vertices, blockIndices.data()+blockBegins[b], blockIndices.data()+blockBegins[b+1], distInsertSq, blocksPoints[b], progress);
+			#pragma omp critical(LogInsertPoints)
+			outputLogSQL("ETAT","EXEC","DENSE",int(100.f*(float)progress.processed/(float)progress.total),progress.msg,false);
+		}
+		progress.close();
+		// insert the kept points in the global triangulation, in spatial order
+		std::vector<point_t> keptVertices;
+		std::vector<const vert_info_t::view_vec_t*> keptViews;
+		for (const std::vector<kept_point_t>& keptPoints: blocksPoints) {
+			for (const kept_point_t& keptPoint: keptPoints) {
+				keptVertices.push_back(keptPoint.p);
+				keptViews.push_back(&keptPoint.views);
+			}
+		}
+		std::vector<std::ptrdiff_t> keptIndices(keptVertices.size());
+		std::iota(keptIndices.begin(), keptIndices.end(), std::ptrdiff_t(0));
+		typedef CGAL::Spatial_sort_traits_adapter_3<delaunay_t::Geom_traits, point_t*> Search_traits;
+		CGAL::spatial_sort(keptIndices.begin(), keptIndices.end(), Search_traits(keptVertices.data(), delaunay.geom_traits()));
+		vertex_handle_t hint;
+		for (const std::ptrdiff_t idx: keptIndices) {
+			const point_t& p(keptVertices[idx]);
+			hint = insertPoint(delaunay, images, p, CGAL2MVS<float>(p), *keptViews[idx], distInsertSq, hint);
+			hint->info().InsertViews(*keptViews[idx]);
+		}
+		DEBUG_EXTRA("Points decimated in %u blocks: %u points -> %u points -> %u points", numBlocks, indices.size(), keptVertices.size(), delaunay.number_of_vertices());
+		return;
+	}
+	#endif
+	vertex_handle_t hint;
+	for (const std::ptrdiff_t idx: indices) {
+		hint = insertPoint(delaunay, images, vertices[idx], pointcloud.points[idx], pointcloud.pointViews[idx], distInsertSq, hint);
+		// update point visibility info
+		hint->info().InsertViews(pointcloud, idx);
+		outputLogSQL("ETAT","EXEC","DENSE",int(100.f*(float)progress.processed/(float)progress.total),progress.msg,false);
+		++progress;
+	}
+	progress.close();
+}
+
+// Reconstruct the mesh of the given point-cloud (optionally only the points inside the given OBB)
+// seen by the given images, as described in Scene::ReconstructMesh(); the point-cloud is released
+bool reconstructMesh(const ImageArr& images, PointCloud& pointcloud, const OBB3f* pOBB, Mesh& mesh,
+	float distInsert, bool bUseFreeSpaceSupport, unsigned nItersFixNonManifold,
+	float kSigma, float kQual, float kb, float kf, float kRel, float kAbs, float kOutl, float kInf)
 {
-	using namespace DELAUNAY;
 	ASSERT(!pointcloud.IsEmpty());
 	mesh.Release();
 
 	// create the Delaunay triangulation
 	delaunay_t delaunay;
-	std::vector<cell_info_t> infoCells;
+	cells_info_t infoCells;
 	std::vector<camera_cell_t> camCells;
 	std::vector<facet_t> hullFacets;
 	{
 		TD_TIMER_STARTD();
 
-		std::vector<point_t> vertices(pointcloud.points.GetSize());
-		std::vector<std::ptrdiff_t> indices(pointcloud.points.GetSize());
-		// fetch points
-		if (bUseOnlyROI && !IsBounded())
-			bUseOnlyROI = false;
-		FOREACH(i, pointcloud.points) {
-			const PointCloud::Point& X(pointcloud.points[i]);
-			if (bUseOnlyROI && !obb.Intersects(X))
-				continue;
-			vertices[i] = point_t(X.x, X.y, X.z);
-			indices[i] = i;
-		}
-		// sort vertices
-		typedef CGAL::Spatial_sort_traits_adapter_3<delaunay_t::Geom_traits, point_t*> Search_traits;
-		CGAL::spatial_sort(indices.begin(), indices.end(), Search_traits(&vertices[0], delaunay.geom_traits()));
+		// fetch and sort points
+		std::vector<point_t> vertices;
+		std::vector<std::ptrdiff_t> indices;
+		fetchPoints(pointcloud, pOBB, vertices, indices);
 		// insert vertices
-		Util::Progress progress(_T("Points inserted"), indices.size());
-		const float distInsertSq(SQUARE(distInsert));
-		vertex_handle_t hint;
-		delaunay_t::Locate_type lt;
-		int li, lj;
-		std::for_each(indices.cbegin(), indices.cend(), [&](size_t idx) {
-			const point_t& p = vertices[idx];
-			const PointCloud::Point& point = pointcloud.points[idx];
-			const PointCloud::ViewArr& views = pointcloud.pointViews[idx];
-			ASSERT(!views.IsEmpty());
-			if (hint == vertex_handle_t()) {
-				// this is the first point,
-				// insert it
-				hint = delaunay.insert(p);
-				ASSERT(hint != vertex_handle_t());
-			} else
-			if (distInsert <= 0) {
-				// insert all points
-				hint = delaunay.insert(p, hint);
-				ASSERT(hint != vertex_handle_t());
-			} else {
-				// locate cell containing this point
-				const cell_handle_t c(delaunay.locate(p, lt, li, lj, hint->cell()));
-				if (lt == delaunay_t::VERTEX) {
-					// duplicate point, nothing to insert,
-					// just update its visibility info
-					hint = c->vertex(li);
-					ASSERT(hint != delaunay.infinite_vertex());
-				} else {
-					// locate the nearest vertex
-					vertex_handle_t nearest;
-					if (delaunay.dimension() < 3) {
-						// use a brute-force algorithm if dimension < 3
-						delaunay_t::Finite_vertices_iterator vit = delaunay.finite_vertices_begin();
-						nearest = vit;
-						++vit;
-						adjacent_vertex_back_inserter_t inserter(delaunay, p, nearest);
-						for (delaunay_t::Finite_vertices_iterator end = delaunay.finite_vertices_end(); vit != end; ++vit)
-							inserter = vit;
-					} else {
-						// - start with the closest vertex from the located cell
-						// - repeatedly take the nearest of its incident vertices if any
-						// - if not, we're done
-						ASSERT(c != cell_handle_t());
-						nearest = delaunay.nearest_vertex_in_cell(p, c);
-						while (true) {
-							const vertex_handle_t v(nearest);
-							delaunay.adjacent_vertices(nearest, adjacent_vertex_back_inserter_t(delaunay, p, nearest));
-							if (v == nearest)
-								break;
-						}
-					}
-					ASSERT(nearest == delaunay.nearest_vertex(p, hint->cell()));
-					hint = nearest;
-					// check if point is far enough to all existing points
-					FOREACHPTR(pViewID, views) {
-						const Image& imageData = images[*pViewID];
-						const Point3f pn(imageData.camera.ProjectPointP3(point));
-						const Point3f pe(imageData.camera.ProjectPointP3(CGAL2MVS<float>(nearest->point())));
-						if (!IsDepthSimilar(pn.z, pe.z) || normSq(Point2f(pn)-Point2f(pe)) > distInsertSq) {
-							// point far enough to an existing point,
-							// insert as a new point
-							hint = delaunay.insert(p, lt, c, li, lj);
-							ASSERT(hint != vertex_handle_t());
-							break;
-						}
-					}
-				}
-			}
-			// update point visibility info
-			hint->info().InsertViews(pointcloud, idx);
-			outputLogSQL("ETAT","EXEC","DENSE",int(100.f*(float)progress.processed/(float)progress.total),progress.msg,false);
-			++progress;
-		});
-		progress.close();
+		insertPoints(delaunay, images, pointcloud, vertices, indices, distInsert, Thread::getMaxThreads(OPTMESH::nInsertThreads));
 		pointcloud.Release();
 		// init cells weights and
 		// loop over all cells and store the finite facet of the infinite cells
 		const size_t numNodes(delaunay.number_of_cells());
-		infoCells.resize(numNodes);
-		memset(&infoCells[0], 0, sizeof(cell_info_t)*numNodes);
+		infoCells.Init(numNodes);
 		cell_size_t ciID(0);
 		for (delaunay_t::All_cells_iterator ci=delaunay.all_cells_begin(), eci=delaunay.all_cells_end(); ci!=eci; ++ci, ++ciID) {
 			ci->info() = ciID;
@@ -909,10 +901,11 @@ bool Scene::ReconstructMesh(float distInsert, bool bUseFreeSpaceSupport, bool bU
 			fetchCellFacets<CGAL::POSITIVE>(delaunay, hullFacets, camCell.cell, imageData, camCell.facets);
 			// link all cells contained by the camera to the source
 			for (const facet_t& f: camCell.facets)
-				infoCells[f.first->info()].s = kInf;
+				infoCells.s[f.first->info()] = true;
 		}
 
 		DEBUG_EXTRA("Delaunay tetrahedralization completed: %u points -> %u vertices, %u (+%u) cells, %u (+%u) faces (%s)", indices.size(), delaunay.number_of_vertices(), delaunay.number_of_finite_cells(), delaunay.number_of_cells()-delaunay.number_of_finite_cells(), delaunay.number_of_finite_facets(), delaunay.number_of_facets()-delaunay.number_of_finite_facets(), TD_TIMER_GET_FMT().c_str());
+		DEBUG_ULTIMATE("\tcells weights allocated: %s", Util::formatBytes((int64_t)infoCells.GetMemorySize()).c_str());
 	}
 
 	// for every camera-point ray intersect it with the tetrahedrons and
@@ -932,26 +925,77 @@ bool Scene::ReconstructMesh(float distInsert, bool bUseFreeSpaceSupport, bool bU
 
 		std::vector<facet_t> facets;
 
+		// collect the vertices seen by at least one view in an indexable array,
+		// so that they can be distributed in chunks among the threads
+		const Timer::SysType timeStart(Timer::GetSysTime());
+		std::vector<vertex_handle_t> vertices;
+		vertices.reserve(delaunay.number_of_vertices());
+		for (delaunay_t::Vertex_iterator vi=delaunay.vertices_begin(), vie=delaunay.vertices_end(); vi!=vie; ++vi)
+			if (!vi->info().views.IsEmpty())
+				vertices.emplace_back(vi);
+		const int64_t nVerts((int64_t)vertices.size());
+		#ifdef DELAUNAY_WEAKSURF
+		// allocate the views info of all vertices at once (needed only by the free-space support)
+		std::vector<view_info_t> viewsInfo;
+		std::vector<size_t> viewsInfoOffsets;
+		if (bUseFreeSpaceSupport) {
+			viewsInfoOffsets.resize(vertices.size()+1);
+			viewsInfoOffsets[0] = 0;
+			for (size_t i=0; i<vertices.size(); ++i)
+				viewsInfoOffsets[i+1] = viewsInfoOffsets[i] + vertices[i]->info().views.size();
+			viewsInfo.resize(viewsInfoOffsets.back(), view_info_t{cell_handle_t(), cell_handle_t()});
+		}
+		#endif
+		const Timer::SysType timeCollect(Timer::GetSysTime());
+		const int nVertsChunk(256);
+
 		// compute the weights for each edge
 		{
 		TD_TIMER_STARTD();
-		Util::Progress progress(_T("Points weighted"), delaunay.number_of_vertices());
+		// the weights of the intersected facets (and end cells) are accumulated first in a buffer per thread,
+		// and added to the cells only once the buffer is full or at the end,
+		// avoiding an atomic update of the shared cells for each intersection
+		struct WeightEntry {
+			cell_size_t idxCell; // cell index
+			uint32_t idxWeight; // weight index in the cell info (0-3 facets, 4 t-edge)
+			edge_cap_t w; // weight to be added
+			inline bool operator<(const WeightEntry& e) const { return idxCell < e.idxCell || (idxCell == e.idxCell && idxWeight < e.idxWeight); }
+		};
+		typedef std::vector<WeightEntry> WeightBuffer;
+		const size_t maxWeightBufferSize(1024*1024);
+		const auto FlushWeights = [&infoCells](WeightBuffer& weights) {
+			// sort the entries to add them in memory order,
+			// summing first the entries of the same weight
+			std::sort(weights.begin(), weights.end());
+			for (auto it=weights.cbegin(), ite=weights.cend(); it!=ite; ) {
+				const WeightEntry& e(*it);
+				edge_cap_t w(e.w);
+				while (++it != ite && it->idxCell == e.idxCell && it->idxWeight == e.idxWeight)
+					w += it->w;
+				if (e.idxWeight < 4)
+					infoCells.AddFacet(e.idxCell, (int)e.idxWeight, w);
+				else
+					infoCells.t[e.idxCell] += w;
+			}
+			weights.clear();
+		};
+		Timer::SysType timeRays(timeCollect);
+		Util::Progress progress(_T("Points weighted"), vertices.size());
 		#ifdef DELAUNAY_USE_OPENMP
-		delaunay_t::Vertex_iterator vertexIter(delaunay.vertices_begin());
-		const int64_t nVerts(delaunay.number_of_vertices()+1);
-		#pragma omp parallel for private(facets)
-		for (int64_t i=0; i<nVerts; ++i) {
-			delaunay_t::Vertex_iterator vi;
-			#pragma omp critical
-			vi = vertexIter++;
-		#else
-		for (delaunay_t::Vertex_iterator vi=delaunay.vertices_begin(), vie=delaunay.vertices_end(); vi!=vie; ++vi) {
+		#pragma omp parallel private(facets)
 		#endif
+		{
+		WeightBuffer weights;
+		weights.reserve(maxWeightBufferSize);
+		#ifdef DELAUNAY_USE_OPENMP
+		#pragma omp for schedule(dynamic, nVertsChunk)
+		#endif
+		for (int64_t i=0; i<nVerts; ++i) {
+			const vertex_handle_t& vi(vertices[(size_t)i]);
 			vert_info_t& vert(vi->info());
-			if (vert.views.IsEmpty())
-				continue;
+			ASSERT(!vert.views.IsEmpty());
 			#ifdef DELAUNAY_WEAKSURF
-			vert.AllocateInfo();
+			view_info_t* const vertViewsInfo(bUseFreeSpaceSupport ? viewsInfo.data()+viewsInfoOffsets[(size_t)i] : NULL);
 			#endif
 			const point_t& p(vi->point());
 			const Point3 pt(CGAL2MVS<REAL>(p));
@@ -974,16 +1018,14 @@ bool Scene::ReconstructMesh(float distInsert, bool bUseFreeSpaceSupport, bool bU
 				do {
 					// assign score, weighted by the distance from the point to the intersection
 					const edge_cap_t w(alpha_vis*(1.f-EXP(-SQUARE((float)inter.dist)*inv2SigmaSq)));
-					edge_cap_t& f(infoCells[inter.facet.first->info()].f[inter.facet.second]);
-					#ifdef DELAUNAY_USE_OPENMP
-					#pragma omp atomic
-					#endif
-					f += w;
+					weights.push_back({inter.facet.first->info(), (uint32_t)inter.facet.second, w});
 				} while (intersect(delaunay, segCamPoint, facets, facets, inter));
 				ASSERT(facets.empty() && inter.type == intersection_t::VERTEX && inter.v1 == vi);
 				#ifdef DELAUNAY_WEAKSURF
-				ASSERT(vert.viewsInfo[v].cell2Cam == NULL);
-				vert.viewsInfo[v].cell2Cam = inter.facet.first;
+				if (vertViewsInfo) {
+					ASSERT(vertViewsInfo[v].cell2Cam == cell_handle_t());
+					vertViewsInfo[v].cell2Cam = inter.facet.first;
+				}
 				#endif
 				// find faces intersected by the endpoint-point segment
 				inter.dist = FLT_MAX; inter.bigger = false;
@@ -992,32 +1034,46 @@ bool Scene::ReconstructMesh(float distInsert, bool bUseFreeSpaceSupport, bool bU
 				const cell_handle_t endCell(delaunay.locate(segEndPoint.source(), vi->cell()));
 				ASSERT(endCell != cell_handle_t());
 				fetchCellFacets<CGAL::NEGATIVE>(delaunay, hullFacets, endCell, imageData, facets);
-				edge_cap_t& t(infoCells[endCell->info()].t);
-				#ifdef DELAUNAY_USE_OPENMP
-				#pragma omp atomic
-				#endif
-				t += alpha_vis;
+				weights.push_back({endCell->info(), 4u, alpha_vis});
 				while (intersect(delaunay, segEndPoint, facets, facets, inter)) {
 					// assign score, weighted by the distance from the point to the intersection
 					const facet_t& mf(delaunay.mirror_facet(inter.facet));
 					const edge_cap_t w(alpha_vis*(1.f-EXP(-SQUARE((float)inter.dist)*inv2SigmaSq)));
-					edge_cap_t& f(infoCells[mf.first->info()].f[mf.second]);
-					#ifdef DELAUNAY_USE_OPENMP
-					#pragma omp atomic
-					#endif
-					f += w;
+					weights.push_back({mf.first->info(), (uint32_t)mf.second, w});
 				}
 				ASSERT(facets.empty() && inter.type == intersection_t::VERTEX && inter.v1 == vi);
 				#ifdef DELAUNAY_WEAKSURF
-				ASSERT(vert.viewsInfo[v].cell2End == NULL);
-				vert.viewsInfo[v].cell2End = inter.facet.first;
+				if (vertViewsInfo) {
+					ASSERT(vertViewsInfo[v].cell2End == cell_handle_t());
+					vertViewsInfo[v].cell2End = inter.facet.first;
+				}
+				#endif
+			}
+			if (weights.size() >= maxWeightBufferSize) {
+				#ifdef DELAUNAY_USE_OPENMP
+				#pragma omp critical(FlushWeights)
 				#endif
+				FlushWeights(weights);
 			}
 			outputLogSQL("ETAT","EXEC","DENSE",int(100.f*(float)progress.processed/(float)progress.total),progress.msg,false);
 			++progress;
 		}
+		// reduce the remaining weights of each thread
+		#ifdef DELAUNAY_USE_OPENMP
+		#pragma omp master
+		#endif
+		timeRays = Timer::GetSysTime();
+		#ifdef DELAUNAY_USE_OPENMP
+		#pragma omp critical(FlushWeights)
+		#endif
+		FlushWeights(weights);
+		}
 		progress.close();
-		DEBUG_ULTIMATE("\tweighting completed in %s", TD_TIMER_GET_FMT().c_str());
+		const Timer::SysType timeReduce(Timer::GetSysTime());
+		DEBUG_ULTIMATE("\tweighting completed in %s (collect vertices %s, ray-casting %s, reduce weights %s)", TD_TIMER_GET_FMT().c_str(),
+			Util::formatTime((int64_t)Timer::SysTime2TimeMs(timeCollect-timeStart)).c_str(),
+			Util::formatTime((int64_t)Timer::SysTime2TimeMs(timeRays-timeCollect)).c_str(),
+			Util::formatTime((int64_t)Timer::SysTime2TimeMs(timeReduce-timeRays)).c_str());
 		}
 		camCells.clear();
 
@@ -1026,19 +1082,13 @@ bool Scene::ReconstructMesh(float distInsert, bool bUseFreeSpaceSupport, bool bU
 		if (bUseFreeSpaceSupport) {
 		TD_TIMER_STARTD();
 		#ifdef DELAUNAY_USE_OPENMP
-		delaunay_t::Vertex_iterator vertexIter(delaunay.vertices_begin());
-		const int64_t nVerts(delaunay.number_of_vertices()+1);
-		#pragma omp parallel for private(facets)
-		for (int64_t i=0; i<nVerts; ++i) {
-			delaunay_t::Vertex_iterator vi;
-			#pragma omp critical
-			vi = vertexIter++;
-		#else
-		for (delaunay_t::Vertex_iterator vi=delaunay.vertices_begin(), vie=delaunay.vertices_end(); vi!=vie; ++vi) {
+		#pragma omp parallel for private(facets) schedule(dynamic, nVertsChunk)
 		#endif
+		for (int64_t i=0; i<nVerts; ++i) {
+			const vertex_handle_t& vi(vertices[(size_t)i]);
 			const vert_info_t& vert(vi->info());
-			if (vert.views.IsEmpty())
-				continue;
+			ASSERT(!vert.views.IsEmpty());
+			const view_info_t* const vertViewsInfo(viewsInfo.data()+viewsInfoOffsets[(size_t)i]);
 			const point_t& p(vi->point());
 			const Point3f pt(CGAL2MVS<float>(p));
 			FOREACH(v, vert.views) {
@@ -1053,7 +1103,7 @@ bool Scene::ReconstructMesh(float distInsert, bool bUseFreeSpaceSupport, bool bU
 				const Point3f bgnPoint(pt-vecCamPoint*(invLenCamPoint*sigma*kf));
 				const segment_t segPointBgn(p, MVS2CGAL(bgnPoint));
 				intersection_t inter;
-				if (!intersectFace(delaunay, segPointBgn, vi, vert.viewsInfo[v].cell2Cam, facets, inter))
+				if (!intersectFace(delaunay, segPointBgn, vi, vertViewsInfo[v].cell2Cam, facets, inter))
 					continue;
 				edge_cap_t beta(0);
 				do {
@@ -1064,7 +1114,7 @@ bool Scene::ReconstructMesh(float distInsert, bool bUseFreeSpaceSupport, bool bU
 				// find faces intersected by the point-endpoint segment
 				const Point3f endPoint(pt+vecCamPoint*(invLenCamPoint*sigma*kb));
 				const segment_t segPointEnd(p, MVS2CGAL(endPoint));
-				if (!intersectFace(delaunay, segPointEnd, vi, vert.viewsInfo[v].cell2End, facets, inter))
+				if (!intersectFace(delaunay, segPointEnd, vi, vertViewsInfo[v].cell2End, facets, inter))
 					continue;
 				edge_cap_t gammaMin(FLT_MAX), gammaMax(0);
 				do {
@@ -1080,7 +1130,7 @@ bool Scene::ReconstructMesh(float distInsert, bool bUseFreeSpaceSupport, bool bU
 				const edge_cap_t epsAbs(beta-gamma);
 				const edge_cap_t epsRel(gamma/beta);
 				if (epsRel < kRel && epsAbs > kAbs && gamma < kOutl) {
-					edge_cap_t& t(infoCells[inter.ncell->info()].t);
+					edge_cap_t& t(infoCells.t[inter.ncell->info()]);
 					#ifdef DELAUNAY_USE_OPENMP
 					#pragma omp atomic
 					#endif
@@ -1099,27 +1149,38 @@ bool Scene::ReconstructMesh(float distInsert, bool bUseFreeSpaceSupport, bool bU
 	{
 		TD_TIMER_STARTD();
 
-		// create graph
-		MaxFlow<cell_size_t,edge_cap_t> graph(delaunay.number_of_cells());
-		// set weights
+		// create graph and set weights
 		constexpr edge_cap_t maxCap(3.402823466e+34f/*FLT_MAX*0.0001f*/);
-		for (delaunay_t::All_cells_iterator ci=delaunay.all_cells_begin(), ce=delaunay.all_cells_end(); ci!=ce; ++ci) {
-			const cell_size_t ciID(ci->info());
-			const cell_info_t& ciInfo(infoCells[ciID]);
-			graph.AddNode(ciID, ciInfo.s, MINF(ciInfo.t, maxCap));
-			for (int i=0; i<4; ++i) {
-				const cell_handle_t cj(ci->neighbor(i));
-				const cell_size_t cjID(cj->info());
-				if (cjID < ciID) continue;
-				const cell_info_t& cjInfo(infoCells[cjID]);
-				const int j(cj->index(ci));
-				const edge_cap_t q((1.f - MINF(computePlaneSphereAngle(delaunay, facet_t(ci,i)), computePlaneSphereAngle(delaunay, facet_t(cj,j))))*kQual);
-				graph.AddEdge(ciID, cjID, ciInfo.f[i]+q, cjInfo.f[j]+q);
+		const auto buildGraph = [&](auto& graph) {
+			for (delaunay_t::All_cells_iterator ci=delaunay.all_cells_begin(), ce=delaunay.all_cells_end(); ci!=ce; ++ci) {
+				const cell_size_t ciID(ci->info());
+				graph.AddNode(ciID, infoCells.s[ciID] ? kInf : edge_cap_t(0), MINF(infoCells.t[ciID], maxCap));
+				for (int i=0; i<4; ++i) {
+					const cell_handle_t cj(ci->neighbor(i));
+					const cell_size_t cjID(cj->info());
+					if (cjID < ciID) continue;
+					const int j(cj->index(ci));
+					const edge_cap_t q((1.f - MINF(computePlaneSphereAngle(delaunay, facet_t(ci,i)), computePlaneSphereAngle(delaunay, facet_t(cj,j))))*kQual);
+					graph.AddEdge(ciID, cjID, infoCells.GetFacet(ciID, i)+q, infoCells.GetFacet(cjID, j)+q);
+				}
 			}
+		};
+		// save the graph to be replayed later on the max-flow algorithms (see BenchmarkMaxFlow)
+		if (!OPTMESH::strExportGraphFileName.empty()) {
+			MaxFlowGraph<cell_size_t,edge_cap_t> graph(delaunay.number_of_cells());
+			buildGraph(graph);
+			if (!graph.Save(OPTMESH::strExportGraphFileName))
+				VERBOSE("error: failed saving graph '%s'", OPTMESH::strExportGraphFileName.c_str());
+			else
+				DEBUG_EXTRA("Graph saved: %u nodes, %u edges", graph.GetNumNodes(), graph.GetNumEdges());
 		}
-		infoCells.clear();
 		// find graph-cut solution
-		const float maxflow(graph.ComputeMaxFlow());
+		std::vector<bool> labels;
+		// (each cell is linked to its four neighbors, so there are two edges per cell)
+		const float maxflow(ComputeMaxFlow<cell_size_t,edge_cap_t>(OPTMESH::nMaxFlowType, delaunay.number_of_cells(), delaunay.number_of_cells()*2, [&](auto& graph) {
+			buildGraph(graph);
+			infoCells.Release();
+		}, labels));
 		// extract surface formed by the facets between inside/outside cells
 		const size_t nEstimatedNumVerts(delaunay.number_of_vertices());
 		std::unordered_map<void*,Mesh::VIndex> mapVertices;
@@ -1135,8 +1196,8 @@ bool Scene::ReconstructMesh(float distInsert, bool bUseFreeSpaceSupport, bool bU
 				const cell_handle_t cj(ci->neighbor(i));
 				const cell_size_t cjID(cj->info());
 				if (ciID < cjID) continue;
-				const bool ciType(graph.IsNodeOnSrcSide(ciID));
-				if (ciType == graph.IsNodeOnSrcSide(cjID)) continue;
+				const bool ciType(labels[ciID]);
+				if (ciType == labels[cjID]) continue;
 				Mesh::Face& face = mesh.faces.AddEmpty();
 				const triangle_vhandles_t tri(getTriangle(ci, i));
 				for (int v=0; v<3; ++v) {
@@ -1162,4 +1223,360 @@ bool Scene::ReconstructMesh(float distInsert, bool bUseFreeSpaceSupport, bool bU
 	mesh.FixNonManifold();
 	return true;
 }
-/*----------------------------------------------------------------*/
\ No newline at end of file
+// block used to reconstruct the mesh piece-wise
+struct mesh_block_t {
+	AABB3f box; // block bounds: [ptMin, ptMax) (the blocks tile the entire space)
+	size_t idxBegin, idxEnd; // range of the points inside the block
+	bool IsInside(const Mesh::Vertex& X) const {
+		return box.ptMin.x() <= X.x && X.x < box.ptMax.x() &&
+			box.ptMin.y() <= X.y && X.y < box.ptMax.y() &&
+			box.ptMin.z() <= X.z && X.z < box.ptMax.z();
+	}
+};
+typedef std::vector<mesh_block_t> mesh_blocks_t;
+
+// fetch the points to be meshed (only the ones inside the OBB, if given) and split them
+// recursively at the median of the longest axis till each block contains at most nMaxBlockPoints points;
+// returns the bounding box of all the blocks
+AABB3f splitMeshBlocks(const PointCloud& pointcloud, const OBB3f* pOBB, unsigned nMaxBlockPoints, std::vector<std::ptrdiff_t>& indices, mesh_blocks_t& blocks)
+{
+	indices.clear();
+	indices.reserve(pointcloud.GetSize());
+	AABB3f aabb(true);
+	FOREACH(i, pointcloud.points) {
+		const PointCloud::Point& X(pointcloud.points[i]);
+		if (pOBB && !pOBB->Intersects(X))
+			continue;
+		indices.push_back(i);
+		aabb.InsertFull(AABB3f::POINT(X.x, X.y, X.z));
+	}
+	blocks.clear();
+	if (indices.empty())
+		return aabb;
+	// make sure all points are strictly inside the box (the block boxes are half-open)
+	aabb.Enlarge(aabb.GetSize().maxCoeff()*0.001f);
+	mesh_blocks_t stack{mesh_block_t{aabb, 0, indices.size()}};
+	while (!stack.empty()) {
+		const mesh_block_t block(stack.back());
+		stack.pop_back();
+		if (block.idxEnd-block.idxBegin <= nMaxBlockPoints) {
+			if (block.idxEnd > block.idxBegin)
+				blocks.push_back(block);
+			continue;
+		}
+		int axis;
+		block.box.GetSize().maxCoeff(&axis);
+		const size_t idxMid((block.idxBegin+block.idxEnd)/2);
+		std::nth_element(indices.begin()+block.idxBegin, indices.begin()+idxMid, indices.begin()+block.idxEnd,
+			[&](std::ptrdiff_t i, std::ptrdiff_t j) { return pointcloud.points[i](axis) < pointcloud.points[j](axis); });
+		const float split(pointcloud.points[indices[idxMid]](axis));
+		mesh_block_t left(block), right(block);
+		left.box.ptMax[axis] = right.box.ptMin[axis] = split;
+		left.idxEnd = right.idxBegin = idxMid;
+		stack.push_back(left);
+		stack.push_back(right);
+	}
+	return aabb;
+}
+
+// list the regions around the seams between the blocks: for each block face inside the bounding box,
+// a slab of the width of the overlap used when reconstructing the block
+// (every seam is the upper face of at least one block, so only those are listed)
+void listSeamRegions(const mesh_blocks_t& blocks, const AABB3f& aabb, float fBlockOverlap, std::vector<Mesh::Box>& regions)
+{
+	regions.clear();
+	for (const mesh_block_t& block: blocks) {
+		const AABB3f::POINT overlap(block.box.GetSize()*fBlockOverlap);
+		for (int axis=0; axis<3; ++axis) {
+			if (block.box.ptMax[axis] >= aabb.ptMax[axis])
+				continue;
+			Mesh::Box region(block.box);
+			region.ptMin[axis] = region.ptMax[axis];
+			region.ptMin -= overlap;
+			region.ptMax += overlap;
+			regions.emplace_back(region);
+		}
+	}
+}
+} // namespace DELAUNAY
+
+// First, iteratively create a Delaunay triangulation of the existing point-cloud by inserting point by point,
+// iif the point to be inserted is not closer than distInsert pixels in at least one of its views to
+// the projection of any of already inserted points.
+// Next, the score is computed for all the edges of the directed graph composed of points as vertices.
+// Finally, graph-cut algorithm is used to split the tetrahedrons in inside and outside,
+// and the surface is such extracted.
+bool Scene::ReconstructMesh(float distInsert, bool bUseFreeSpaceSupport, bool bUseOnlyROI, unsigned nItersFixNonManifold,
+							float kSigma, float kQual, float kb,
+							float kf, float kRel, float kAbs, float kOutl,
+							float kInf
+)
+{
+	return DELAUNAY::reconstructMesh(images, pointcloud, bUseOnlyROI && IsBounded() ? &obb : NULL, mesh,
+		distInsert, bUseFreeSpaceSupport, nItersFixNonManifold, kSigma, kQual, kb, kf, kRel, kAbs, kOutl, kInf);
+}
+/*----------------------------------------------------------------*/
+
+// Reconstruct the mesh block-wise, bounding the memory used by the Delaunay triangulation and graph-cut:
+// the point-cloud is split recursively at the median of the longest axis till each block contains
+// at most nMaxBlockPoints points; the points are first decimated once, block by block, so that all blocks
+// share next exactly the same vertices; each block, enlarged by the given overlap ratio, is reconstructed
+// independently (several in parallel, as many as fit in the available memory), only the faces with
+// the centroid inside the block are kept (the block boxes are half-open, so each face is owned by exactly
+// one block), and the block meshes are stitched along the seams by merging their common vertices
+// and closing the small holes left along the seams where the surfaces of two neighbor blocks do not agree
+bool Scene::ReconstructMeshBlocks(unsigned nMaxBlockPoints, float fBlockOverlap, float distInsert, bool bUseFreeSpaceSupport, bool bUseOnlyROI, unsigned nItersFixNonManifold,
+								  float kSigma, float kQual, float kb,
+								  float kf, float kRel, float kAbs, float kOutl,
+								  float kInf)
+{
+	using namespace DELAUNAY;
+	ASSERT(!pointcloud.IsEmpty());
+	if (nMaxBlockPoints == 0 || pointcloud.GetSize() <= nMaxBlockPoints)
+		return ReconstructMesh(distInsert, bUseFreeSpaceSupport, bUseOnlyROI, nItersFixNonManifold, kSigma, kQual, kb, kf, kRel, kAbs, kOutl, kInf);
+	TD_TIMER_START();
+	mesh.Release();
+
+	// fetch the points to be meshed and split them in blocks
+	typedef AABB3f::POINT BoxPoint;
+	const auto toBoxPoint = [](const PointCloud::Point& X) { return BoxPoint(X.x, X.y, X.z); };
+	if (bUseOnlyROI && !IsBounded())
+		bUseOnlyROI = false;
+	std::vector<std::ptrdiff_t> indices;
+	mesh_blocks_t blocks;
+	const AABB3f aabb(splitMeshBlocks(pointcloud, bUseOnlyROI ? &obb : NULL, nMaxBlockPoints, indices, blocks));
+	if (blocks.size() <= 1)
+		return ReconstructMesh(distInsert, bUseFreeSpaceSupport, bUseOnlyROI, nItersFixNonManifold, kSigma, kQual, kb, kf, kRel, kAbs, kOutl, kInf);
+	// the graph-cuts of the blocks can not be all exported to the same file
+	if (!OPTMESH::strExportGraphFileName.empty()) {
+		VERBOSE("warning: the graph-cut is not exported when reconstructing the mesh block-wise");
+		OPTMESH::strExportGraphFileName.clear();
+	}
+
+	// process the blocks in parallel, as many as fit in the available memory
+	const size_t nBytesPerPoint(1024); // rough memory used by the triangulation and graph-cut per point
+	const Util::MemoryInfo memInfo(Util::GetMemoryInfo());
+	const unsigned nConcurrentBlocks(CLAMP((unsigned)MINF(memInfo.freePhysical/2/(size_t(nMaxBlockPoints)*nBytesPerPoint), (size_t)nMaxThreads), 1u, (unsigned)blocks.size()));
+	VERBOSE("Reconstructing the mesh in %u blocks of at most %u points (%u in parallel)", blocks.size(), nMaxBlockPoints, nConcurrentBlocks);
+
+	// decimate the points once, each block independently, and replace them by the kept ones;
+	// this way the blocks overlapping the same region insert next exactly the same vertices
+	PointCloud pointcloudBlocks;
+	if (distInsert > 0) {
+		std::vector<point_t> vertices(pointcloud.GetSize());
+		for (const std::ptrdiff_t idx: indices) {
+			const PointCloud::Point& X(pointcloud.points[idx]);
+			vertices[idx] = point_t(X.x, X.y, X.z);
+		}
+		std::vector<std::vector<kept_point_t>> blocksPoints(blocks.size());
+		Util::Progress progress(_T("Points decimated"), indices.size());
+		#ifdef DELAUNAY_USE_OPENMP
+		#pragma omp parallel for num_threads(nConcurrentBlocks) schedule(dynamic)
+		#endif
+		for (int_t b=0; b<(int_t)blocks.size(); ++b)
+			decimatePoints(images, pointcloud, vertices, indices.data()+blocks[b].idxBegin, indices.data()+blocks[b].idxEnd, SQUARE(distInsert), blocksPoints[b], progress);
+		progress.close();
+		FOREACH(b, blocks) {
+			mesh_block_t& block = blocks[b];
+			block.idxBegin = pointcloudBlocks.GetSize();
+			for (const kept_point_t& keptPoint: blocksPoints[b]) {
+				pointcloudBlocks.points.emplace_back(CGAL2MVS<float>(keptPoint.p));
+				PointCloud::ViewArr& views = pointcloudBlocks.pointViews.emplace_back();
+				PointCloud::WeightArr& weights = pointcloudBlocks.pointWeights.emplace_back();
+				for (const vert_info_t::view_t& view: keptPoint.views) {
+					views.emplace_back(view.idxView);
+					weights.emplace_back(view.weight);
+				}
+			}
+			block.idxEnd = pointcloudBlocks.GetSize();
+			std::vector<kept_point_t>().swap(blocksPoints[b]);
+		}
+		pointcloud.Release();
+		indices.resize(pointcloudBlocks.GetSize());
+		std::iota(indices.begin(), indices.end(), std::ptrdiff_t(0));
+		DEBUG_EXTRA("Points decimated in %u blocks: %u points", blocks.size(), pointcloudBlocks.GetSize());
+	} else {
+		pointcloudBlocks.Swap(pointcloud);
+	}
+
+	// reconstruct the blocks
+	struct VertexHash {
+		size_t operator()(const Mesh::Vertex& v) const {
+			return std::hash<float>()(v.x) ^ (std::hash<float>()(v.y) << 1) ^ (std::hash<float>()(v.z) << 2);
+		}
+	};
+	std::unordered_map<Mesh::Vertex, Mesh::VIndex, VertexHash> mapVertices;
+	bool bAbort(false);
+	#ifdef DELAUNAY_USE_OPENMP
+	#pragma omp parallel for num_threads(nConcurrentBlocks) schedule(dynamic)
+	#endif
+	for (int_t b=0; b<(int_t)blocks.size(); ++b) {
+		#ifdef DELAUNAY_USE_OPENMP
+		#pragma omp flush (bAbort)
+		#endif
+		if (bAbort)
+			continue;
+		const mesh_block_t& block = blocks[b];
+		// collect the points inside the enlarged block: its own points
+		// plus the points of the neighbor blocks inside the overlap
+		AABB3f boxOverlap(block.box);
+		boxOverlap.ptMin -= block.box.GetSize()*fBlockOverlap;
+		boxOverlap.ptMax += block.box.GetSize()*fBlockOverlap;
+		PointCloud blockPointcloud;
+		const auto InsertPoint = [&](std::ptrdiff_t idx) {
+			blockPointcloud.points.emplace_back(pointcloudBlocks.points[idx]);
+			blockPointcloud.pointViews.emplace_back(pointcloudBlocks.pointViews[idx]);
+			if (!pointcloudBlocks.pointWeights.empty())
+				blockPointcloud.pointWeights.emplace_back(pointcloudBlocks.pointWeights[idx]);
+		};
+		for (const mesh_block_t& blockNeighbor: blocks) {
+			if (&blockNeighbor == &block) {
+				for (size_t i=block.idxBegin; i<block.idxEnd; ++i)
+					InsertPoint(indices[i]);
+				continue;
+			}
+			if (!boxOverlap.Intersects(blockNeighbor.box))
+				continue;
+			for (size_t i=blockNeighbor.idxBegin; i<blockNeighbor.idxEnd; ++i) {
+				const std::ptrdiff_t idx(indices[i]);
+				if (boxOverlap.Intersects(toBoxPoint(pointcloudBlocks.points[idx])))
+					InsertPoint(idx);
+			}
+		}
+		if (blockPointcloud.GetSize() < 4)
+			continue;
+		// the points are already decimated, insert them all
+		const PointCloud::Index numPoints(blockPointcloud.GetSize());
+		Mesh blockMesh;
+		if (!reconstructMesh(images, blockPointcloud, NULL, blockMesh, 0.f, bUseFreeSpaceSupport, nItersFixNonManifold, kSigma, kQual, kb, kf, kRel, kAbs, kOutl, kInf)) {
+			bAbort = true;
+			#ifdef DELAUNAY_USE_OPENMP
+			#pragma omp flush (bAbort)
+			#endif
+			continue;
+		}
+		// keep only the faces with the centroid inside the block and add them to the global mesh
+		#ifdef DELAUNAY_USE_OPENMP
+		#pragma omp critical(MergeBlockMesh)
+		#endif
+		{
+			for (const Mesh::Face& face: blockMesh.faces) {
+				const Mesh::Vertex centroid((blockMesh.vertices[face[0]]+blockMesh.vertices[face[1]]+blockMesh.vertices[face[2]])/3.f);
+				if (!block.IsInside(centroid))
+					continue;
+				Mesh::Face& newFace = mesh.faces.emplace_back();
+				for (int v=0; v<3; ++v) {
+					const Mesh::Vertex& X = blockMesh.vertices[face[v]];
+					const auto itVertex(mapVertices.emplace(X, mesh.vertices.size()));
+					if (itVertex.second)
+						mesh.vertices.emplace_back(X);
+					newFace[v] = itVertex.first->second;
+				}
+			}
+			DEBUG_EXTRA("Block %u reconstructed: %u points -> %u faces (%u faces in total)", (unsigned)b, numPoints, blockMesh.faces.size(), mesh.faces.size());
+		}
+	}
+	if (bAbort)
+		return false;
+	pointcloudBlocks.Release();
+	pointcloud.Release();
+
+	// fix the non-manifold vertices and edges introduced along the seams,
+	// and close the small holes left where the surfaces of the neighbor blocks differ
+	// (only the holes touching the seams, the rest of the surface is left as reconstructed)
+	mesh.FixNonManifold();
+	std::vector<Mesh::Box> seamRegions;
+	listSeamRegions(blocks, aabb, fBlockOverlap, seamRegions);
+	const unsigned numHoles(mesh.CloseHoles(30, seamRegions));
+	mesh.ReleaseExtra();
+	DEBUG_EXTRA("Mesh reconstructed in %u blocks: %u vertices, %u faces, %u seam holes closed (%s)", blocks.size(), mesh.vertices.size(), mesh.faces.size(), numHoles, TD_TIMER_GET_FMT().c_str());
+	return true;
+} // ReconstructMeshBlocks
+
+// Reconstruct the mesh of the given scene both at once and block-wise, and check the blocks are stitched
+// without opening any holes along the seams: both meshes are post-processed the same way
+// and the border edges inside the block overlap regions are counted
+bool MVS::TestReconstructMeshBlocks(const Scene& scene, unsigned nMaxBlockPoints, float fBlockOverlap)
+{
+	using namespace DELAUNAY;
+	std::vector<std::ptrdiff_t> indices;
+	mesh_blocks_t blocks;
+	const AABB3f aabb(splitMeshBlocks(scene.pointcloud, NULL, nMaxBlockPoints, indices, blocks));
+	if (blocks.size() < 2) {
+		VERBOSE("error: the point-cloud is not split in blocks");
+		return false;
+	}
+	std::vector<Mesh::Box> seamRegions;
+	listSeamRegions(blocks, aabb, fBlockOverlap, seamRegions);
+	const auto CountSeamBorderEdges = [&seamRegions](Mesh& mesh) {
+		mesh.ListIncidentFaces();
+		size_t numBorderEdges(0);
+		Mesh::FaceIdxArr adjFaces;
+		for (const Mesh::Face& face: mesh.faces) {
+			for (int v=0; v<3; ++v) {
+				adjFaces.Empty();
+				mesh.GetAdjVertexFaces(face[v], face[(v+1)%3], adjFaces);
+				if (adjFaces.size() != 1)
+					continue;
+				const Mesh::Vertex X((mesh.vertices[face[v]]+mesh.vertices[face[(v+1)%3]])*0.5f);
+				for (const Mesh::Box& region: seamRegions) {
+					if (region.Intersects(X)) {
+						++numBorderEdges;
+						break;
+					}
+				}
+			}
+		}
+		mesh.ReleaseExtra();
+		return numBorderEdges;
+	};
+	Scene sceneOnce, sceneBlocks;
+	sceneOnce.platforms = sceneBlocks.platforms = scene.platforms;
+	sceneOnce.images = sceneBlocks.images = scene.images;
+	sceneOnce.pointcloud = sceneBlocks.pointcloud = scene.pointcloud;
+	if (!sceneOnce.ReconstructMesh() || !sceneBlocks.ReconstructMeshBlocks(nMaxBlockPoints, fBlockOverlap)) {
+		VERBOSE("error: reconstructing the mesh failed");
+		return false;
+	}
+	// same post-processing as the block-wise reconstruction
+	sceneOnce.mesh.FixNonManifold();
+	sceneOnce.mesh.CloseHoles(30, seamRegions);
+	const size_t numBorderEdgesOnce(CountSeamBorderEdges(sceneOnce.mesh));
+	const size_t numBorderEdgesBlocks(CountSeamBorderEdges(sceneBlocks.mesh));
+	if (numBorderEdgesBlocks > numBorderEdgesOnce) {
+		VERBOSE("error: the block-wise mesh has %u border edges along the seams, while the mesh reconstructed at once has %u", numBorderEdgesBlocks, numBorderEdgesOnce);
+		return false;
+	}
+	DEBUG("Mesh reconstructed in %u blocks: %u faces, %u border edges along the seams (%u faces, %u border edges at once)",
+		blocks.size(), sceneBlocks.mesh.faces.size(), numBorderEdgesBlocks, sceneOnce.mesh.faces.size(), numBorderEdgesOnce);
+	return true;
+} // TestReconstructMeshBlocks
+/*----------------------------------------------------------------*/
+
+// Benchmark the insertion of the point-cloud in the Delaunay triangulation
+// for an increasing number of threads (1, 2, 4, ... up to nMaxThreads),
+// logging the time, speedup and number of vertices inserted in each case
+void Scene::BenchmarkPointInsertion(float distInsert, unsigned nMaxThreads) const
+{
+	using namespace DELAUNAY;
+	ASSERT(!pointcloud.IsEmpty());
+	std::vector<point_t> vertices;
+	std::vector<std::ptrdiff_t> indices;
+	fetchPoints(pointcloud, NULL, vertices, indices);
+	nMaxThreads = Thread::getMaxThreads(nMaxThreads);
+	Timer::Type timeSequential(0);
+	for (unsigned nThreads=1; ; nThreads=MINF(nThreads*2, nMaxThreads)) {
+		const Timer::SysType timeStart(Timer::GetSysTime());
+		delaunay_t delaunay;
+		insertPoints(delaunay, images, pointcloud, vertices, indices, distInsert, nThreads);
+		const Timer::Type time(Timer::SysTime2TimeMs(Timer::GetSysTime()-timeStart));
+		if (nThreads == 1)
+			timeSequential = time;
+		VERBOSE("Points insertion benchmark: %u threads: %u points -> %u vertices, %u cells (%s, %.2fx speedup)",
+			nThreads, indices.size(), delaunay.number_of_vertices(), delaunay.number_of_finite_cells(),
+			Util::formatTime((int64_t)time).c_str(), time > 0 ? (float)timeSequential/(float)time : 1.f);
+		if (nThreads == nMaxThreads)
+			break;
+	}
+} // BenchmarkPointInsertion
+/*----------------------------------------------------------------*/
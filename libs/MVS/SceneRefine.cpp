@@ -45,8 +45,21 @@ using namespace MVS;
 // (should be enough, as the numerical error does not depend on the depth)
 #define MESHOPT_DEPTHCONSTBIAS 0.05f
 
+// uncomment to re-rasterize at each iteration only the image tiles covered by the faces
+// that moved more than the given threshold (pixels) since their last rasterization
+// (the full rasterization is still done at each scale and mesh topology change)
+#define MESHOPT_INCREMENTALRASTER 0.1f
+
+// uncomment to warp the image and compute the ZNCC and its gradient in a single pass
+// (instead of separate full-image passes for warping, local variance and ZNCC)
+#define MESHOPT_FUSEDZNCC
+
+// uncomment to compare the single pass ZNCC against the separate passes on the actual image pairs
+// (slow, use only for validation; the same comparison on a synthetic pair is done by TestMeshRefineZNCC())
+// #define MESHOPT_FUSEDZNCC_CHECK
+
 // uncomment to enable memory pool
-// (should reduce the allocation times for frequent used images)
+// (per-thread scratch images reused across pairs and iterations, avoiding the allocations)
 #define MESHOPT_TYPEPOOL
 
 // uncomment to enable CERES optimization module
@@ -56,13 +69,13 @@ using namespace MVS;
 #endif
 
 #ifdef MESHOPT_TYPEPOOL
-#define DEC_BitMatrix(var)		BitMatrix& var = *BitMatrixPool()
-#define DEC_Image(type, var)	TImage<type>& var = *ImagePool<type>()
-#define DST_BitMatrix(var)		BitMatrixPool(&(var))
-#define DST_Image(var)			ImagePool(&(var))
+#define DEC_BitMatrix(var, size)		BitMatrix& var = *TypePool<BitMatrix>::Acquire(size)
+#define DEC_Image(type, var, size)	TImage<type>& var = *TypePool< TImage<type> >::Acquire(size)
+#define DST_BitMatrix(var)				TypePool<BitMatrix>::Release(&(var))
+#define DST_Image(var)					TypePool<typename std::remove_reference<decltype(var)>::type>::Release(&(var))
 #else
-#define DEC_BitMatrix(var)		BitMatrix var;
-#define DEC_Image(type, var)	TImage<type> var;
+#define DEC_BitMatrix(var, size)		BitMatrix var;
+#define DEC_Image(type, var, size)	TImage<type> var;
 #define DST_BitMatrix(var)
 #define DST_Image(var)
 #endif
@@ -95,6 +108,17 @@ public:
 		FaceMap faceMap; // remember for each pixel what face projects there
 		DepthMap depthMap; // depth-map
 		BaryMap baryMap; // barycentric coordinates
+		Mesh::FaceIdxArr cameraFaces; // faces inside the view frustum at the last ListCameraFaces() call
+		uint32_t lastUsed; // when the view data was last requested (used to release the least recently used views)
+		View() : lastUsed(0) {}
+		bool IsLoaded(bool bRaster) const { return !image.empty() && (!bRaster || !depthMap.empty()); }
+		void ReleaseRaster() { faceMap.release(); depthMap.release(); baryMap.release(); }
+		void Release() { image.release(); imageGrad.release(); imageMean.release(); imageVar.release(); ReleaseRaster(); }
+		size_t GetMemorySize() const {
+			return image.total()*image.elemSize() + imageGrad.total()*imageGrad.elemSize() +
+				imageMean.total()*imageMean.elemSize() + imageVar.total()*imageVar.elemSize() +
+				faceMap.total()*faceMap.elemSize() + depthMap.total()*depthMap.elemSize() + baryMap.total()*baryMap.elemSize();
+		}
 	};
 	typedef CLISTDEF2(View) ViewsArr;
 
@@ -104,14 +128,47 @@ public:
 		FaceMap& faceMap;
 		BaryMap& baryMap;
 		FIndex idxFace;
+		const BitMatrix* pTiles; // if set, rasterize only the pixels inside the marked tiles
 		RasterMesh(const Mesh::VertexArr& _vertices, const Camera& _camera, DepthMap& _depthMap, FaceMap& _faceMap, BaryMap& _baryMap)
-			: Base(_vertices, _camera, _depthMap), faceMap(_faceMap), baryMap(_baryMap) {}
+			: Base(_vertices, _camera, _depthMap), faceMap(_faceMap), baryMap(_baryMap), pTiles(NULL) {}
 		void Clear() {
 			Base::Clear();
 			faceMap.memset((uint8_t)NO_ID);
 			baryMap.memset(0);
 		}
+		// clear only the given tile
+		void ClearTile(int tr, int tc) {
+			const int rEnd(MINF((tr+1)*RasterTileSize, depthMap.rows));
+			const int c(tc*RasterTileSize), cEnd(MINF(c+RasterTileSize, depthMap.cols));
+			for (int r=tr*RasterTileSize; r<rEnd; ++r) {
+				std::fill(depthMap.ptr<Depth>(r)+c, depthMap.ptr<Depth>(r)+cEnd, Depth(0));
+				std::fill(faceMap.ptr<FaceMap::Type>(r)+c, faceMap.ptr<FaceMap::Type>(r)+cEnd, (FaceMap::Type)NO_ID);
+				std::fill(baryMap.ptr<BaryMap::Type>(r)+c, baryMap.ptr<BaryMap::Type>(r)+cEnd, BaryMap::Type(0,0,0));
+			}
+		}
+		// same as Project(), but skip the face if it does not overlap any of the marked tiles
+		void ProjectTiles(const Face& facet, TriangleRasterizer& tr) {
+			ASSERT(pTiles != NULL);
+			for (int v=0; v<3; ++v) {
+				if (!ProjectVertex(vertices[facet[v]], v, tr.triangle))
+					return;
+			}
+			const Point2f* const pti(tr.triangle.pti);
+			const int tcBegin(FLOOR2INT(MINF3(pti[0].x, pti[1].x, pti[2].x))/RasterTileSize);
+			const int tcEnd(FLOOR2INT(MAXF3(pti[0].x, pti[1].x, pti[2].x))/RasterTileSize);
+			const int trBegin(FLOOR2INT(MINF3(pti[0].y, pti[1].y, pti[2].y))/RasterTileSize);
+			const int trEnd(FLOOR2INT(MAXF3(pti[0].y, pti[1].y, pti[2].y))/RasterTileSize);
+			for (int r=trBegin; r<=trEnd; ++r)
+				for (int c=tcBegin; c<=tcEnd; ++c)
+					if (pTiles->isSet(r,c))
+						goto RasterFace;
+			return;
+			RasterFace:
+			Image8U3::RasterizeTriangleBary(pti[0], pti[1], pti[2], tr);
+		}
 		void Raster(const ImageRef& pt, const Triangle& t, const Point3f& bary) {
+			if (pTiles != NULL && !pTiles->isSet(pt.y/RasterTileSize, pt.x/RasterTileSize))
+				return;
 			const Point3f pbary(PerspectiveCorrectBarycentricCoordinates(t, bary));
 			const Depth z(ComputeDepth(t, pbary));
 			ASSERT(z > Depth(0));
@@ -126,7 +183,7 @@ public:
 
 
 public:
-	MeshRefine(Scene& _scene, unsigned _nReduceMemory, unsigned _nAlternatePair=true, Real _weightRegularity=1.5f, Real _ratioRigidityElasticity=0.8f, unsigned _nResolutionLevel=0, unsigned _nMinResolution=640, unsigned nMaxViews=8, unsigned nMaxThreads=1);
+	MeshRefine(Scene& _scene, unsigned _nReduceMemory, unsigned _nAlternatePair=true, Real _weightRegularity=1.5f, Real _ratioRigidityElasticity=0.8f, unsigned _nResolutionLevel=0, unsigned _nMinResolution=640, unsigned nMaxViews=8, unsigned nMaxThreads=1, size_t _nMaxMemory=0);
 	~MeshRefine();
 
 	bool IsValid() const { return !pairs.IsEmpty(); }
@@ -140,6 +197,10 @@ public:
 	void ListFaceAreas(Mesh::AreaArr& maxAreas);
 	void SubdivideMesh(uint32_t maxArea, float fDecimate=1.f, unsigned nCloseHoles=15, unsigned nEnsureEdgeSize=1);
 
+	void OrderPairs();
+	size_t EstimateViewMemory(uint32_t idxImage) const;
+	void LoadViews(const IndexArr& idxImages, bool bRaster);
+
 	double ScoreMesh(double* gradients);
 
 	// given a vertex position and a projection camera, compute the projected position and its derivative
@@ -162,6 +223,16 @@ public:
 		const Image32F& imageA, const TImage<Real>& imageMeanA, const TImage<Real>& imageVarA,
 		const Image32F& imageB, const TImage<Real>& imageMeanB, const TImage<Real>& imageVarB,
 		const BitMatrix& mask, TImage<Real>& imageZNCC, TImage<Real>& imageDZNCC);
+	static float ComputeWarpZNCCPasses(
+		const DepthMap& depthMapA, const Camera& cameraA, const Image32F& imageA,
+		const TImage<Real>* imageMeanA, const TImage<Real>* imageVarA,
+		const DepthMap& depthMapB, const Camera& cameraB, const Image32F& imageB,
+		BitMatrix& mask, TImage<Real>& imageDZNCC);
+	static float ComputeWarpZNCC(
+		const DepthMap& depthMapA, const Camera& cameraA, const Image32F& imageA,
+		const TImage<Real>* imageMeanA, const TImage<Real>* imageVarA,
+		const DepthMap& depthMapB, const Camera& cameraB, const Image32F& imageB,
+		BitMatrix& mask, TImage<Real>& imageDZNCC);
 	static void ComputePhotometricGradient(
 		const Mesh::FaceArr& faces, const Mesh::NormalArr& normals,
 		const DepthMap& depthMapA, const FaceMap& faceMapA, const BaryMap& baryMapA, const Camera& cameraA,
@@ -173,18 +244,28 @@ public:
 	static void ComputeSmoothnessGradient2(
 		const GradArr& smoothGrad1, const Mesh::VertexVerticesArr& vertexVertices, const BoolArr& vertexBoundary,
 		GradArr& smoothGrad2, VIndex idxStart, VIndex idxEnd);
+
+	// scratch objects (images, bit-matrices) pool, see TypePool
 	template<typename TYPE>
-	static TYPE* TypePool(TYPE* = NULL);
-	template<typename TYPE>
-	static inline TImage<TYPE>* ImagePool(TImage<TYPE>* pImage = NULL) { return TypePool< TImage<TYPE> >(pImage); }
-	static inline BitMatrix* BitMatrixPool(BitMatrix* pMask = NULL) { return TypePool<BitMatrix>(pMask); }
+	class TypePool;
+	struct ScratchStats {
+		volatile int32_t nAcquired; // number of scratch objects requested
+		volatile int32_t nAllocated; // number of requests that needed a (re)allocation
+		volatile int32_t nEpoch; // incremented to release the buffers no longer needed (ex. when the images scale changes)
+		void Reset() { nAcquired = nAllocated = 0; }
+	};
+	static ScratchStats scratchStats;
 
 	static void* ThreadWorkerTmp(void*);
 	void ThreadWorker();
 	void WaitThreadWorkers(size_t nJobs);
 	void ThSelectNeighbors(uint32_t idxImage, std::unordered_set<uint64_t>& mapPairs, unsigned nMaxViews);
 	void ThInitImage(uint32_t idxImage, Real scale, Real sigma);
+	void ThLoadView(uint32_t idxImage, bool bRaster);
 	void ThProjectMesh(uint32_t idxImage, const Mesh::FaceIdxArr& cameraFaces);
+	#ifdef MESHOPT_INCREMENTALRASTER
+	void ThProjectMeshTiles(uint32_t idxImage, const Mesh::VertexIdxArr& movedVertices);
+	#endif
 	void ThProcessPair(uint32_t idxImageA, uint32_t idxImageB);
 	void ThSmoothVertices1(VIndex idxStart, VIndex idxEnd);
 	void ThSmoothVertices2(VIndex idxStart, VIndex idxEnd);
@@ -211,6 +292,13 @@ public:
 
 	// valid after ListCameraFaces()
 	Mesh::NormalArr& faceNormals; // normals corresponding to each face
+	float ratioRasterTiles; // fraction of the image tiles rasterized by the last ListCameraFaces() call
+	#ifdef MESHOPT_INCREMENTALRASTER
+	Mesh::VertexArr verticesRaster; // vertex positions at their last rasterization
+	FloatArr vertexRasterTh; // for each vertex, the displacement above which it needs to be rasterized again
+	size_t numRasterTiles; // number of image tiles rasterized by the last ListCameraFaces() call
+	bool bRasterInvalid; // the images or the mesh topology changed since the last rasterization
+	#endif
 
 	// valid the entire time, but changes
 	Mesh::VertexArr& vertices;
@@ -224,6 +312,14 @@ public:
 	ViewsArr views; // views' data
 	PairIdxArr pairs; // image pairs used to refine the mesh
 
+	// views memory management related
+	const size_t nMaxMemory; // maximum memory used by the views' data (0 - unlimited, all views are kept loaded)
+	Real viewsScale, viewsSigma; // parameters used to load the views' images at the current scale
+	uint32_t viewsStamp; // incremented each time views' data are requested
+	size_t viewsMemory; // memory used currently by the views' data
+	size_t viewsMemoryPeak; // maximum memory used by the views' data
+	size_t processMemoryPeak; // maximum memory used by the process, as measured after loading the views
+
 	// multi-threading
 	static SEACAVE::EventQueue events; // internal events queue (processed by the working threads)
 	static SEACAVE::cList<SEACAVE::Thread> threads; // worker threads
@@ -231,29 +327,69 @@ public:
 	static Semaphore sem; // signal job end
 
 	enum { HalfSize = 3 }; // half window size used to compute ZNCC
+	enum { RasterTileSize = 32 }; // size of the image tiles rasterized incrementally
 };
 
-// call with empty parameter to get an unused image;
-// call with an image pointer retrieved earlier to signal that is not needed anymore
+// per-thread pool of scratch objects: each thread keeps the objects it released,
+// together with their buffers, so no lock is needed; an object already of the requested size
+// is preferred, or else a new one is created (up to a limit), so that no reallocation is needed
+// once the sizes repeat across pairs and iterations
 template<typename TYPE>
-TYPE* MeshRefine::TypePool(TYPE* pObj)
+class MeshRefine::TypePool
 {
-	typedef CAutoPtr<TYPE> TypePtr;
-	static CriticalSection cs;
-	static cList<TypePtr,TYPE*> objects;
-	static cList<TYPE*,TYPE*,0> unused;
-	Lock l(cs);
-	if (pObj == NULL) {
-		if (unused.IsEmpty())
-			return objects.AddConstruct(new TYPE);
-		return unused.RemoveTail();
-	} else {
-		ASSERT(objects.Find(pObj) != NO_IDX);
-		ASSERT(unused.Find(pObj) == NO_IDX);
-		unused.Insert(pObj);
-		return NULL;
+public:
+	enum { maxObjects = 64 }; // maximum number of objects kept by each thread
+
+	// get an unused object, preferably already of the given size
+	static TYPE* Acquire(const cv::Size& size) {
+		TypePool& pool(GetInstance());
+		pool.CheckEpoch();
+		Thread::safeInc(scratchStats.nAcquired);
+		// search an unused object of the same size (most recently released first)
+		for (size_t i=pool.unused.size(); i-- > 0; ) {
+			TYPE* const pObj(pool.unused[i]);
+			if (pObj->rows == size.height && pObj->cols == size.width) {
+				pool.unused.erase(pool.unused.begin()+i);
+				return pObj;
+			}
+		}
+		Thread::safeInc(scratchStats.nAllocated);
+		// create a new object, or reuse the least recently released one if too many
+		if (pool.objects.size() < maxObjects || pool.unused.empty()) {
+			pool.objects.emplace_back(new TYPE);
+			return pool.objects.back().get();
+		}
+		TYPE* const pObj(pool.unused.front());
+		pool.unused.erase(pool.unused.begin());
+		return pObj;
+	}
+	// signal that the given object, retrieved earlier by this thread, is not needed anymore
+	static void Release(TYPE* pObj) {
+		TypePool& pool(GetInstance());
+		ASSERT(std::find(pool.unused.cbegin(), pool.unused.cend(), pObj) == pool.unused.cend());
+		pool.unused.push_back(pObj);
+	}
+
+protected:
+	static TypePool& GetInstance() {
+		static thread_local TypePool pool;
+		return pool;
+	}
+	// destroy the unused objects if requested since the last call
+	void CheckEpoch() {
+		if (epoch == scratchStats.nEpoch)
+			return;
+		epoch = scratchStats.nEpoch;
+		for (TYPE* pObj: unused)
+			objects.erase(std::find_if(objects.begin(), objects.end(), [pObj](const std::unique_ptr<TYPE>& obj) { return obj.get() == pObj; }));
+		unused.clear();
 	}
-}
+
+protected:
+	std::vector< std::unique_ptr<TYPE> > objects; // all objects created by this thread
+	std::vector<TYPE*> unused; // objects not in use, in the order they were released
+	int32_t epoch = 0;
+};
 
 
 enum EVENT_TYPE {
@@ -289,6 +425,17 @@ public:
 	}
 	EVTInitImage(uint32_t _idxImage, Real _scale, Real _sigma) : Event(EVT_JOB), idxImage(_idxImage), scale(_scale), sigma(_sigma) {}
 };
+class EVTLoadView : public Event
+{
+public:
+	uint32_t idxImage;
+	bool bRaster;
+	bool Run(void* pArgs) {
+		((MeshRefine*)pArgs)->ThLoadView(idxImage, bRaster);
+		return true;
+	}
+	EVTLoadView(uint32_t _idxImage, bool _bRaster) : Event(EVT_JOB), idxImage(_idxImage), bRaster(_bRaster) {}
+};
 class EVTProjectMesh : public Event
 {
 public:
@@ -300,6 +447,19 @@ public:
 	}
 	EVTProjectMesh(uint32_t _idxImage, const Mesh::FaceIdxArr& _cameraFaces) : Event(EVT_JOB), idxImage(_idxImage), cameraFaces(_cameraFaces) {}
 };
+#ifdef MESHOPT_INCREMENTALRASTER
+class EVTProjectMeshTiles : public Event
+{
+public:
+	uint32_t idxImage;
+	const Mesh::VertexIdxArr& movedVertices;
+	bool Run(void* pArgs) {
+		((MeshRefine*)pArgs)->ThProjectMeshTiles(idxImage, movedVertices);
+		return true;
+	}
+	EVTProjectMeshTiles(uint32_t _idxImage, const Mesh::VertexIdxArr& _movedVertices) : Event(EVT_JOB), idxImage(_idxImage), movedVertices(_movedVertices) {}
+};
+#endif
 class EVTProcessPair : public Event
 {
 public:
@@ -335,8 +495,9 @@ SEACAVE::EventQueue MeshRefine::events;
 SEACAVE::cList<SEACAVE::Thread> MeshRefine::threads;
 CriticalSection MeshRefine::cs;
 Semaphore MeshRefine::sem;
+MeshRefine::ScratchStats MeshRefine::scratchStats = {0, 0, 0};
 
-MeshRefine::MeshRefine(Scene& _scene, unsigned _nReduceMemory, unsigned _nAlternatePair, Real _weightRegularity, Real _ratioRigidityElasticity, unsigned _nResolutionLevel, unsigned _nMinResolution, unsigned nMaxViews, unsigned nMaxThreads)
+MeshRefine::MeshRefine(Scene& _scene, unsigned _nReduceMemory, unsigned _nAlternatePair, Real _weightRegularity, Real _ratioRigidityElasticity, unsigned _nResolutionLevel, unsigned _nMinResolution, unsigned nMaxViews, unsigned nMaxThreads, size_t _nMaxMemory)
 	:
 	weightRegularity(_weightRegularity),
 	ratioRigidityElasticity(_ratioRigidityElasticity),
@@ -346,12 +507,20 @@ MeshRefine::MeshRefine(Scene& _scene, unsigned _nReduceMemory, unsigned _nAltern
 	nAlternatePair(_nAlternatePair),
 	scene(_scene),
 	faceNormals(_scene.mesh.faceNormals),
+	ratioRasterTiles(0),
+	#ifdef MESHOPT_INCREMENTALRASTER
+	bRasterInvalid(true),
+	#endif
 	vertices(_scene.mesh.vertices),
 	faces(_scene.mesh.faces),
 	vertexVertices(_scene.mesh.vertexVertices),
 	vertexFaces(_scene.mesh.vertexFaces),
 	vertexBoundary(_scene.mesh.vertexBoundary),
-	images(_scene.images)
+	images(_scene.images),
+	nMaxMemory(_nMaxMemory),
+	viewsScale(1), viewsSigma(0),
+	viewsStamp(0),
+	viewsMemory(0), viewsMemoryPeak(0), processMemoryPeak(0)
 {
 	// start worker threads
 	ASSERT(nMaxThreads > 0);
@@ -369,6 +538,8 @@ MeshRefine::MeshRefine(Scene& _scene, unsigned _nReduceMemory, unsigned _nAltern
 	pairs.Reserve(mapPairs.size());
 	for (uint64_t pair: mapPairs)
 		pairs.AddConstruct(pair);
+	if (nMaxMemory > 0)
+		OrderPairs();
 }
 MeshRefine::~MeshRefine()
 {
@@ -386,11 +557,48 @@ MeshRefine::~MeshRefine()
 bool MeshRefine::InitImages(Real scale, Real sigma)
 {
 	views.Resize(images.GetSize());
-	ASSERT(events.IsEmpty());
-	FOREACH(idxImage, images)
-		events.AddEvent(new EVTInitImage(idxImage, scale, sigma));
-	WaitThreadWorkers(images.GetSize());
+	viewsScale = scale;
+	viewsSigma = sigma;
+	if (nMaxMemory > 0) {
+		// release all views and load them again at this scale in batches fitting the memory budget,
+		// in order to update the cameras; the images are loaded again later, only when needed
+		for (View& view: views)
+			view.Release();
+		viewsMemory = 0;
+		IndexArr batch;
+		size_t batchMemory(0);
+		FOREACH(idxImage, images) {
+			const Image& imageData = images[idxImage];
+			if (!imageData.IsValid())
+				continue;
+			// estimate the view size at this scale (the cameras are not updated yet)
+			unsigned level(nResolutionLevel);
+			const unsigned imageSize(imageData.RecomputeMaxResolution(level, nMinResolution));
+			const double imageScale(scale*imageSize/MAXF(imageData.width, imageData.height));
+			const size_t memory((size_t)((double)EstimateViewMemory(idxImage)*SQUARE(imageScale)));
+			if (!batch.IsEmpty() && batchMemory+memory > nMaxMemory) {
+				LoadViews(batch, false);
+				batch.Empty();
+				batchMemory = 0;
+			}
+			batch.Insert(idxImage);
+			batchMemory += memory;
+		}
+		if (!batch.IsEmpty())
+			LoadViews(batch, false);
+	} else {
+		ASSERT(events.IsEmpty());
+		FOREACH(idxImage, images)
+			events.AddEvent(new EVTInitImage(idxImage, scale, sigma));
+		WaitThreadWorkers(images.GetSize());
+	}
 	iteration = 0;
+	#ifdef MESHOPT_INCREMENTALRASTER
+	bRasterInvalid = true;
+	#endif
+	// the scratch buffers of the previous scale are not needed anymore
+	Thread::safeInc(scratchStats.nEpoch);
+	scratchStats.Reset();
 	return true;
 }
 
@@ -400,36 +608,92 @@ void MeshRefine::ListVertexFacesPre()
 {
 	scene.mesh.EmptyExtra();
 	scene.mesh.ListIncidentFaces();
+	#ifdef MESHOPT_INCREMENTALRASTER
+	bRasterInvalid = true;
+	#endif
 }
 void MeshRefine::ListVertexFacesPost()
 {
 	scene.mesh.ListIncidentVertices();
 	scene.mesh.ListBoundaryVertices();
+	#ifdef MESHOPT_INCREMENTALRASTER
+	bRasterInvalid = true;
+	#endif
 }
 
 // extract array of faces viewed by each image
 void MeshRefine::ListCameraFaces()
 {
+	#ifdef MESHOPT_INCREMENTALRASTER
+	if (nMaxMemory == 0 && !bRasterInvalid && verticesRaster.GetSize() == vertices.GetSize() && vertexFaces.GetSize() == vertices.GetSize()) {
+		// collect the vertices that moved enough since their last rasterization
+		Mesh::VertexIdxArr movedVertices;
+		FOREACH(idxVert, vertices)
+			if (normSq(vertices[idxVert]-verticesRaster[idxVert]) > SQUARE(vertexRasterTh[idxVert]))
+				movedVertices.Insert(idxVert);
+		// rasterize again only the image tiles covered by the faces incident to these vertices
+		size_t numTiles(0);
+		numRasterTiles = 0;
+		FOREACH(idxImage, images) {
+			const View& view = views[idxImage];
+			numTiles += ((view.depthMap.rows+RasterTileSize-1)/RasterTileSize)*((view.depthMap.cols+RasterTileSize-1)/RasterTileSize);
+		}
+		if (!movedVertices.IsEmpty()) {
+			ASSERT(events.IsEmpty());
+			FOREACH(idxImage, images)
+				events.AddEvent(new EVTProjectMeshTiles(idxImage, movedVertices));
+			WaitThreadWorkers(images.GetSize());
+			for (VIndex idxVert: movedVertices)
+				verticesRaster[idxVert] = vertices[idxVert];
+		}
+		ratioRasterTiles = numTiles ? (float)numRasterTiles/numTiles : 0.f;
+		return;
+	}
+	#endif
+
 	// extract array of faces viewed by each camera
-	typedef CLISTDEF2(Mesh::FaceIdxArr) CameraFacesArr;
-	CameraFacesArr arrCameraFaces(images.GetSize()); {
+	{
 		Mesh::Octree octree;
 		Mesh::FacesInserter::CreateOctree(octree, scene.mesh);
 		FOREACH(ID, images) {
 			const Image& imageData = images[ID];
 			if (!imageData.IsValid())
 				continue;
+			Mesh::FaceIdxArr& cameraFaces = views[ID].cameraFaces;
+			cameraFaces.Empty();
 			const TFrustum<float,5> frustum(Matrix3x4f(imageData.camera.P), (float)imageData.width, (float)imageData.height);
-			Mesh::FacesInserter inserter(arrCameraFaces[ID]);
+			Mesh::FacesInserter inserter(cameraFaces);
 			octree.Traverse(frustum, inserter);
 		}
 	}
+	ratioRasterTiles = 1.f;
+
+	if (nMaxMemory > 0) {
+		// the mesh is projected later on each camera plane, only when the view is needed
+		for (View& view: views) {
+			const size_t memory(view.GetMemorySize());
+			view.ReleaseRaster();
+			viewsMemory -= memory-view.GetMemorySize();
+		}
+		return;
+	}
 
 	// project mesh to each camera plane
+	#ifdef MESHOPT_INCREMENTALRASTER
+	// (the vertex thresholds are reduced by each view over its faces)
+	vertexRasterTh.Resize(vertices.GetSize());
+	vertexRasterTh.MemsetValue(FLT_MAX);
+	#endif
 	ASSERT(events.IsEmpty());
 	FOREACH(idxImage, images)
-		events.AddEvent(new EVTProjectMesh(idxImage, arrCameraFaces[idxImage]));
+		events.AddEvent(new EVTProjectMesh(idxImage, views[idxImage].cameraFaces));
 	WaitThreadWorkers(images.GetSize());
+
+	#ifdef MESHOPT_INCREMENTALRASTER
+	// store the rasterized vertex positions
+	verticesRaster.CopyOf(vertices);
+	bRasterInvalid = false;
+	#endif
 }
 
 // compute for each face the projection area as the maximum area in both images of a pair
@@ -447,6 +711,11 @@ void MeshRefine::ListFaceAreas(Mesh::AreaArr& maxAreas)
 		Mesh::AreaArr& areas = viewAreas[idxImage];
 		areas.Resize(faces.GetSize());
 		areas.Memset(0);
+		if (nMaxMemory > 0) {
+			IndexArr idxImages;
+			idxImages.Insert(idxImage);
+			LoadViews(idxImages, true);
+		}
 		const FaceMap& faceMap = views[idxImage].faceMap;
 		// compute area covered by all vertices (incident faces) viewed by this image
 		for (int j=0; j<faceMap.rows; ++j) {
@@ -475,6 +744,111 @@ void MeshRefine::ListFaceAreas(Mesh::AreaArr& maxAreas)
 	}
 }
 
+// order the image pairs such that consecutive pairs share their views as much as possible:
+// the views are ordered using Cuthill-McKee (breadth-first traversal of the pairs graph, visiting
+// the neighbors in increasing degree order), and the pairs sorted by their last view in this order;
+// this way the views needed at any time are close in the order, limiting the views loaded at once
+void MeshRefine::OrderPairs()
+{
+	typedef cList<IndexArr> ViewNeighborsArr;
+	ViewNeighborsArr neighbors(images.GetSize());
+	for (const PairIdx& pair: pairs) {
+		neighbors[pair.i].Insert(pair.j);
+		neighbors[pair.j].Insert(pair.i);
+	}
+	IndexArr order(images.GetSize());
+	order.MemsetValue(NO_ID);
+	IndexArr queue;
+	queue.Reserve(images.GetSize());
+	while (true) {
+		// start a new connected component from the unvisited view with the smallest degree
+		uint32_t idxStart(NO_ID);
+		FOREACH(idxImage, neighbors)
+			if (order[idxImage] == NO_ID && !neighbors[idxImage].IsEmpty() &&
+				(idxStart == NO_ID || neighbors[idxStart].GetSize() > neighbors[idxImage].GetSize()))
+				idxStart = idxImage;
+		if (idxStart == NO_ID)
+			break;
+		order[idxStart] = queue.GetSize();
+		queue.Insert(idxStart);
+		for (IndexArr::IDX q=order[idxStart]; q<queue.GetSize(); ++q) {
+			IndexArr& viewNeighbors = neighbors[queue[q]];
+			viewNeighbors.Sort([&neighbors](uint32_t i, uint32_t j) { return neighbors[i].GetSize() < neighbors[j].GetSize(); });
+			for (uint32_t idxImage: viewNeighbors) {
+				if (order[idxImage] != NO_ID)
+					continue;
+				order[idxImage] = queue.GetSize();
+				queue.Insert(idxImage);
+			}
+		}
+	}
+	pairs.Sort([&order](const PairIdx& a, const PairIdx& b) {
+		const uint32_t aMax(MAXF(order[a.i], order[a.j])), bMax(MAXF(order[b.i], order[b.j]));
+		return aMax < bMax || (aMax == bMax && MINF(order[a.i], order[a.j]) < MINF(order[b.i], order[b.j]));
+	});
+}
+
+// estimate the memory needed by the view data at the current image size
+size_t MeshRefine::EstimateViewMemory(uint32_t idxImage) const
+{
+	const Image& imageData = images[idxImage];
+	const size_t bytesPerPixel(
+		sizeof(Image32F::Type) + sizeof(View::ImageGrad::Type) + (nReduceMemory ? 0 : 2*sizeof(Real)) +
+		sizeof(FaceMap::Type) + sizeof(DepthMap::Type) + sizeof(BaryMap::Type));
+	return (size_t)imageData.width*imageData.height*bytesPerPixel;
+}
+
+// make sure the data of the given views is loaded (including the projected mesh if requested),
+// releasing first the least recently used views not in the given list, as needed to fit in the memory budget;
+// the released views are loaded again (from the image cache if enabled) and the mesh projected again when needed
+void MeshRefine::LoadViews(const IndexArr& idxImages, bool bRaster)
+{
+	++viewsStamp;
+	size_t memoryNeeded(0);
+	IndexArr idxLoad;
+	for (uint32_t idxImage: idxImages) {
+		View& view = views[idxImage];
+		view.lastUsed = viewsStamp;
+		if (view.IsLoaded(bRaster))
+			continue;
+		const size_t memory(EstimateViewMemory(idxImage));
+		const size_t memoryLoaded(view.GetMemorySize());
+		if (memory > memoryLoaded)
+			memoryNeeded += memory-memoryLoaded;
+		idxLoad.Insert(idxImage);
+	}
+	if (idxLoad.IsEmpty())
+		return;
+	while (viewsMemory+memoryNeeded > nMaxMemory) {
+		uint32_t idxRelease(NO_ID);
+		FOREACH(idxImage, views) {
+			const View& view = views[idxImage];
+			if (view.lastUsed < viewsStamp && !view.image.empty() &&
+				(idxRelease == NO_ID || views[idxRelease].lastUsed > view.lastUsed))
+				idxRelease = idxImage;
+		}
+		if (idxRelease == NO_ID) {
+			DEBUG_ULTIMATE("warning: the memory budget is too small for %u views (%s needed)", idxImages.GetSize(), Util::formatBytes((int64_t)(viewsMemory+memoryNeeded)).c_str());
+			break;
+		}
+		View& view = views[idxRelease];
+		viewsMemory -= view.GetMemorySize();
+		view.Release();
+	}
+	ASSERT(events.IsEmpty());
+	for (uint32_t idxImage: idxLoad)
+		events.AddEvent(new EVTLoadView(idxImage, bRaster));
+	WaitThreadWorkers(idxLoad.GetSize());
+	viewsMemory = 0;
+	for (const View& view: views)
+		viewsMemory += view.GetMemorySize();
+	if (viewsMemoryPeak < viewsMemory)
+		viewsMemoryPeak = viewsMemory;
+	const size_t processMemory(Util::GetProcessMemory());
+	if (processMemoryPeak < processMemory)
+		processMemoryPeak = processMemory;
+}
+
 // decimate or subdivide mesh such that for each face there is no image pair in which
 // its projection area is bigger than the given number of pixels in both images
 void MeshRefine::SubdivideMesh(uint32_t maxArea, float fDecimate, unsigned nCloseHoles, unsigned nEnsureEdgeSize)
@@ -591,25 +965,64 @@ double MeshRefine::ScoreMesh(double* gradients)
 		ASSERT(vertexDepth.GetSize() == vertices.GetSize());
 		vertexDepth.MemsetValue(FLT_MAX);
 	}
-	ASSERT(events.IsEmpty());
-	FOREACHPTR(pPair, pairs) {
-		ASSERT(pPair->i < pPair->j);
+	const auto AddPairEvents = [this](const PairIdx& pair) -> size_t {
+		ASSERT(pair.i < pair.j);
 		switch (nAlternatePair) {
 		case 1:
-			events.AddEvent(iteration%2 ? new EVTProcessPair(pPair->j,pPair->i) : new EVTProcessPair(pPair->i,pPair->j));
-			break;
+			events.AddEvent(iteration%2 ? new EVTProcessPair(pair.j,pair.i) : new EVTProcessPair(pair.i,pair.j));
+			return 1;
 		case 2:
-			events.AddEvent(new EVTProcessPair(pPair->i, pPair->j));
-			break;
+			events.AddEvent(new EVTProcessPair(pair.i, pair.j));
+			return 1;
 		case 3:
-			events.AddEvent(new EVTProcessPair(pPair->j, pPair->i));
-			break;
+			events.AddEvent(new EVTProcessPair(pair.j, pair.i));
+			return 1;
 		default:
 			for (int ip=0; ip<2; ++ip)
-				events.AddEvent(ip ? new EVTProcessPair(pPair->j,pPair->i) : new EVTProcessPair(pPair->i,pPair->j));
+				events.AddEvent(ip ? new EVTProcessPair(pair.j,pair.i) : new EVTProcessPair(pair.i,pair.j));
+			return 2;
 		}
+	};
+	ASSERT(events.IsEmpty());
+	if (nMaxMemory > 0) {
+		// process the (ordered) pairs in batches whose views fit in the memory budget
+		IndexArr batchViews;
+		size_t batchMemory(0);
+		PairIdxArr::IDX idxPairBegin(0);
+		const auto ProcessBatch = [&](PairIdxArr::IDX idxPairEnd) {
+			LoadViews(batchViews, true);
+			size_t numEvents(0);
+			for (PairIdxArr::IDX idxPair=idxPairBegin; idxPair<idxPairEnd; ++idxPair)
+				numEvents += AddPairEvents(pairs[idxPair]);
+			WaitThreadWorkers(numEvents);
+			batchViews.Empty();
+			batchMemory = 0;
+			idxPairBegin = idxPairEnd;
+		};
+		FOREACH(idxPair, pairs) {
+			const PairIdx& pair = pairs[idxPair];
+			size_t pairMemory(0);
+			if (batchViews.Find(pair.i) == IndexArr::NO_INDEX)
+				pairMemory += EstimateViewMemory(pair.i);
+			if (batchViews.Find(pair.j) == IndexArr::NO_INDEX)
+				pairMemory += EstimateViewMemory(pair.j);
+			if (idxPairBegin < idxPair && batchMemory+pairMemory > nMaxMemory)
+				ProcessBatch(idxPair);
+			for (uint32_t idxImage: {pair.i, pair.j}) {
+				if (batchViews.Find(idxImage) == IndexArr::NO_INDEX) {
+					batchViews.Insert(idxImage);
+					batchMemory += EstimateViewMemory(idxImage);
+				}
+			}
+		}
+		if (idxPairBegin < pairs.GetSize())
+			ProcessBatch(pairs.GetSize());
+	} else {
+		size_t numEvents(0);
+		for (const PairIdx& pair: pairs)
+			numEvents += AddPairEvents(pair);
+		WaitThreadWorkers(numEvents);
 	}
-	WaitThreadWorkers(nAlternatePair ? pairs.GetSize() : pairs.GetSize()*2);
 
 	// loop through all vertices and compute the smoothing score
 	scoreSmooth = 0;
@@ -784,8 +1197,8 @@ void MeshRefine::ComputeLocalVariance(const Image32F& image, const BitMatrix& ma
 	const int RowsEnd(image.rows-HalfSize);
 	const int ColsEnd(image.cols-HalfSize);
 	const int n(SQUARE(HalfSize*2+1));
-	DEC_Image(double, imageSum);
-	DEC_Image(double, imageSumSq);
+	DEC_Image(double, imageSum, image.size()+cv::Size(1,1));
+	DEC_Image(double, imageSumSq, image.size()+cv::Size(1,1));
 	#if CV_MAJOR_VERSION > 2
 	cv::integral(image, imageSum, imageSumSq, CV_64F, CV_64F);
 	#else
@@ -832,14 +1245,14 @@ float MeshRefine::ComputeLocalZNCC(
 	const int ColsEnd(mask.cols-HalfSize);
 	const int n(SQUARE(HalfSize*2+1));
 	imageZNCC.memset(0);
-	DEC_Image(double, imageABSum);
+	DEC_Image(double, imageABSum, mask.size()+cv::Size(1,1));
 	{
-		DEC_Image(float, imageAB);
+		DEC_Image(float, imageAB, mask.size());
 		cv::multiply(imageA, imageB, imageAB);
 		cv::integral(imageAB, imageABSum, CV_64F);
 		DST_Image(imageAB);
 	}
-	DEC_Image(Real, imageInvSqrtVAVB);
+	DEC_Image(Real, imageInvSqrtVAVB, mask.size());
 	imageInvSqrtVAVB.create(mask.size());
 	for (int r=HalfSize; r<RowsEnd; ++r) {
 		for (int c=HalfSize; c<ColsEnd; ++c) {
@@ -898,6 +1311,206 @@ float MeshRefine::ComputeLocalZNCC(
 	return score;
 }
 
+// warp imageB to imageA using the mesh and compute the local ZNCC and its gradient,
+// each as a separate full-image pass;
+// the mean and variance of imageA are computed too if not given
+float MeshRefine::ComputeWarpZNCCPasses(
+	const DepthMap& depthMapA, const Camera& cameraA, const Image32F& imageA,
+	const TImage<Real>* imageMeanA, const TImage<Real>* imageVarA,
+	const DepthMap& depthMapB, const Camera& cameraB, const Image32F& imageB,
+	BitMatrix& mask, TImage<Real>& imageDZNCC)
+{
+	DEC_Image(float, imageAB, imageA.size());
+	imageA.copyTo(imageAB);
+	ImageMeshWarp(depthMapA, cameraA, depthMapB, cameraB, imageB, imageAB, mask);
+	const bool bComputeVarA(imageMeanA == NULL);
+	if (bComputeVarA) {
+		DEC_Image(Real, _imageMeanA, imageA.size());
+		DEC_Image(Real, _imageVarA, imageA.size());
+		ComputeLocalVariance(imageA, mask, _imageMeanA, _imageVarA);
+		imageMeanA = &_imageMeanA;
+		imageVarA = &_imageVarA;
+	}
+	DEC_Image(Real, imageMeanAB, imageA.size());
+	DEC_Image(Real, imageVarAB, imageA.size());
+	ComputeLocalVariance(imageAB, mask, imageMeanAB, imageVarAB);
+	DEC_Image(Real, imageZNCC, imageA.size());
+	const float score(ComputeLocalZNCC(imageA, *imageMeanA, *imageVarA, imageAB, imageMeanAB, imageVarAB, mask, imageZNCC, imageDZNCC));
+	#ifdef MESHOPT_TYPEPOOL
+	DST_Image(imageZNCC);
+	DST_Image(imageVarAB);
+	DST_Image(imageMeanAB);
+	if (bComputeVarA) {
+		DST_Image(*((TImage<Real>*)imageMeanA));
+		DST_Image(*((TImage<Real>*)imageVarA));
+	}
+	DST_Image(imageAB);
+	#endif
+	return score;
+}
+
+// same as above, but in a single pass over the image rows:
+// each row of imageB is warped only once in a ring buffer holding the last window rows,
+// from which the window sums (box filter) needed by the local mean, variance and ZNCC are computed
+// in float (vectorized), while the ring buffer and the sums stay in cache
+float MeshRefine::ComputeWarpZNCC(
+	const DepthMap& depthMapA, const Camera& cameraA, const Image32F& imageA,
+	const TImage<Real>* imageMeanA, const TImage<Real>* imageVarA,
+	const DepthMap& depthMapB, const Camera& cameraB, const Image32F& imageB,
+	BitMatrix& mask, TImage<Real>& imageDZNCC)
+{
+	ASSERT(depthMapA.size() == imageA.size() && !imageA.empty());
+	ASSERT(imageMeanA == NULL || (imageMeanA->size() == imageA.size() && imageVarA->size() == imageA.size()));
+	enum { WindowSize = HalfSize*2+1 };
+	typedef Sampler::Linear<float> Sampler;
+	const Sampler sampler;
+	const int rows(imageA.rows), cols(imageA.cols);
+	mask.create(imageA.size());
+	mask.memset(0);
+	imageDZNCC.create(imageA.size());
+	imageDZNCC.memset(0);
+	if (rows < WindowSize || cols < WindowSize)
+		return 0;
+	// transform a pixel of image A with the given depth directly to the camera B space:
+	//   X = depth * H * [x y 1] + t
+	// expressed relative to the camera A center in order to keep the float precision
+	const Matrix3x3 H(cameraB.R*cameraA.R.t()*cameraA.GetInvK());
+	const Point3f Hx((float)H(0,0), (float)H(1,0), (float)H(2,0));
+	const Point3f Hy((float)H(0,1), (float)H(1,1), (float)H(2,1));
+	const Point3f Hz((float)H(0,2), (float)H(1,2), (float)H(2,2));
+	const Point3f t(Cast<float>(cameraB.TransformPointW2C(cameraA.C)));
+	const bool bComputeVarA(imageMeanA == NULL);
+	enum { SUM_B=0, SUM_BB, SUM_AB, SUM_A, SUM_AA, SUM_NUM };
+	const int numSums(bComputeVarA ? SUM_NUM : SUM_A);
+	DEC_Image(float, ringAB, cv::Size(cols, WindowSize)); // last window rows of the warped image
+	DEC_Image(float, colSums, cv::Size(cols, SUM_NUM)); // vertical window sums for each column
+	DEC_Image(float, boxSums, cv::Size(cols, SUM_NUM)); // window sums for each pixel of the current row
+	ringAB.create(WindowSize, cols);
+	colSums.create(SUM_NUM, cols);
+	boxSums.create(SUM_NUM, cols);
+	// warp the given row of imageB and store it in the ring buffer
+	const auto WarpRow = [&](int j) {
+		float* const rowAB(ringAB.ptr<float>(j%WindowSize));
+		memcpy(rowAB, imageA.ptr<const float>(j), sizeof(float)*cols);
+		const Depth* const rowDepthA(depthMapA.ptr<const Depth>(j));
+		const Point3f rayRow(Hy*(float)j+Hz);
+		for (int i=0; i<cols; ++i) {
+			const Depth depthA(rowDepthA[i]);
+			if (depthA <= 0)
+				continue;
+			const Point3f ptC((rayRow+Hx*(float)i)*depthA+t);
+			const Point2f pt(cameraB.TransformPointC2I(ptC));
+			if (!IsDepthSimilar(depthMapB, pt, ptC.z))
+				continue;
+			rowAB[i] = imageB.sample<Sampler,Sampler::Type>(sampler, pt);
+			mask.set(j,i);
+		}
+	};
+	for (int j=0; j<WindowSize-1; ++j)
+		WarpRow(j);
+	const float invN(1.f/(float)SQUARE(WindowSize));
+	float score(0);
+	for (int r=HalfSize; r<rows-HalfSize; ++r) {
+		WarpRow(r+HalfSize);
+		// sum each column over the window rows
+		const float* rowsAB[WindowSize];
+		const float* rowsA[WindowSize];
+		for (int k=0; k<WindowSize; ++k) {
+			rowsAB[k] = ringAB.ptr<const float>((r-HalfSize+k)%WindowSize);
+			rowsA[k] = imageA.ptr<const float>(r-HalfSize+k);
+		}
+		float* const colB(colSums.ptr<float>(SUM_B));
+		float* const colBB(colSums.ptr<float>(SUM_BB));
+		float* const colAB(colSums.ptr<float>(SUM_AB));
+		float* const colA(colSums.ptr<float>(SUM_A));
+		float* const colAA(colSums.ptr<float>(SUM_AA));
+		int c(0);
+		#ifdef _USE_SSE
+		for (; c+4<=cols; c+=4) {
+			__m128 sB(_mm_setzero_ps()), sBB(_mm_setzero_ps()), sAB(_mm_setzero_ps());
+			__m128 sA(_mm_setzero_ps()), sAA(_mm_setzero_ps());
+			for (int k=0; k<WindowSize; ++k) {
+				const __m128 b(_mm_loadu_ps(rowsAB[k]+c));
+				const __m128 a(_mm_loadu_ps(rowsA[k]+c));
+				sB = _mm_add_ps(sB, b);
+				sBB = _mm_add_ps(sBB, _mm_mul_ps(b, b));
+				sAB = _mm_add_ps(sAB, _mm_mul_ps(a, b));
+				sA = _mm_add_ps(sA, a);
+				sAA = _mm_add_ps(sAA, _mm_mul_ps(a, a));
+			}
+			_mm_storeu_ps(colB+c, sB);
+			_mm_storeu_ps(colBB+c, sBB);
+			_mm_storeu_ps(colAB+c, sAB);
+			_mm_storeu_ps(colA+c, sA);
+			_mm_storeu_ps(colAA+c, sAA);
+		}
+		#endif
+		for (; c<cols; ++c) {
+			float sB(0), sBB(0), sAB(0), sA(0), sAA(0);
+			for (int k=0; k<WindowSize; ++k) {
+				const float b(rowsAB[k][c]);
+				const float a(rowsA[k][c]);
+				sB += b;
+				sBB += b*b;
+				sAB += a*b;
+				sA += a;
+				sAA += a*a;
+			}
+			colB[c] = sB;
+			colBB[c] = sBB;
+			colAB[c] = sAB;
+			colA[c] = sA;
+			colAA[c] = sAA;
+		}
+		// sum the column sums over the window columns
+		for (int s=0; s<numSums; ++s) {
+			const float* const col(colSums.ptr<const float>(s));
+			float* const box(boxSums.ptr<float>(s));
+			for (int c=HalfSize; c<cols-HalfSize; ++c) {
+				float sum(0);
+				for (int k=-HalfSize; k<=HalfSize; ++k)
+					sum += col[c+k];
+				box[c] = sum;
+			}
+		}
+		// compute ZNCC and its gradient
+		const float* const rowA(rowsA[HalfSize]);
+		const float* const rowAB(rowsAB[HalfSize]);
+		const float* const boxB(boxSums.ptr<const float>(SUM_B));
+		const float* const boxBB(boxSums.ptr<const float>(SUM_BB));
+		const float* const boxAB(boxSums.ptr<const float>(SUM_AB));
+		const float* const boxA(boxSums.ptr<const float>(SUM_A));
+		const float* const boxAA(boxSums.ptr<const float>(SUM_AA));
+		Real* const rowDZNCC(imageDZNCC.ptr<Real>(r));
+		for (int c=HalfSize; c<cols-HalfSize; ++c) {
+			if (!mask(r,c))
+				continue;
+			const Real meanB(boxB[c]*invN);
+			const Real varB(MAXF(boxBB[c]*invN-SQUARE(meanB), Real(0.0001)));
+			Real meanA, varA;
+			if (bComputeVarA) {
+				meanA = boxA[c]*invN;
+				varA = MAXF(boxAA[c]*invN-SQUARE(meanA), Real(0.0001));
+			} else {
+				meanA = (*imageMeanA)(r,c);
+				varA = (*imageVarA)(r,c);
+			}
+			const Real invSqrtVAVB(Real(1)/SQRT(varA*varB));
+			const Real ZNCC((boxAB[c]*invN - meanA*meanB) * invSqrtVAVB);
+			const Real ZNCCinvVB(ZNCC/varB);
+			const Real dZNCC((Real)rowA[c]*invSqrtVAVB - (Real)rowAB[c]*ZNCCinvVB + meanB*ZNCCinvVB - meanA*invSqrtVAVB);
+			const Real minVAVB(MINF(varA,varB));
+			const Real ReliabilityFactor(minVAVB/(minVAVB+Real(0.0015)));
+			rowDZNCC[c] = -ReliabilityFactor*dZNCC;
+			score += (float)(ReliabilityFactor*(Real(1)-ZNCC));
+		}
+	}
+	DST_Image(boxSums);
+	DST_Image(colSums);
+	DST_Image(ringAB);
+	return score;
+}
+
 // compute the photometric gradient for all vertices seen by an image pair
 void MeshRefine::ComputePhotometricGradient(
 	const Mesh::FaceArr& faces, const Mesh::NormalArr& normals,
@@ -1070,12 +1683,24 @@ void MeshRefine::ThInitImage(uint32_t idxImage, Real scale, Real sigma)
 	// load and init image
 	unsigned level(nResolutionLevel);
 	const unsigned imageSize(imageData.RecomputeMaxResolution(level, nMinResolution));
-	if ((imageData.image.empty() || MAXF(imageData.width,imageData.height) != imageSize) && !imageData.ReloadImage(imageSize))
-		ABORT("can not load image");
 	View& view = views[idxImage];
 	Image32F& img = view.image;
-	imageData.image.toGray(img, cv::COLOR_BGR2GRAY, true);
-	imageData.image.release();
+	cv::Size originalSize;
+	if (ImageCache::Load(imageData.name, imageSize, img, CV_32FC1, originalSize)) {
+		// gray image found in the cache
+		imageData.image.release();
+		imageData.scale = imageData.ResizeImage(originalSize, imageSize);
+	} else {
+		if ((imageData.image.empty() || MAXF(imageData.width,imageData.height) != imageSize) && !imageData.ReloadImage(imageSize))
+			ABORT("can not load image");
+		imageData.image.toGray(img, cv::COLOR_BGR2GRAY, true);
+		imageData.image.release();
+		if (ImageCache::IsEnabled()) {
+			const IMAGEPTR pImage(Image::ReadImageHeader(imageData.name));
+			if (pImage != NULL)
+				ImageCache::Save(imageData.name, imageSize, img, cv::Size(pImage->GetWidth(), pImage->GetHeight()));
+		}
+	}
 	if (sigma > 0)
 		cv::GaussianBlur(img, img, cv::Size(), sigma);
 	if (scale < 1.0) {
@@ -1104,6 +1729,14 @@ void MeshRefine::ThInitImage(uint32_t idxImage, Real scale, Real sigma)
 	#endif
 	cv::merge(grad, 2, view.imageGrad);
 }
+void MeshRefine::ThLoadView(uint32_t idxImage, bool bRaster)
+{
+	View& view = views[idxImage];
+	if (view.image.empty())
+		ThInitImage(idxImage, viewsScale, viewsSigma);
+	if (bRaster && view.depthMap.empty())
+		ThProjectMesh(idxImage, view.cameraFaces);
+}
 void MeshRefine::ThProjectMesh(uint32_t idxImage, const Mesh::FaceIdxArr& cameraFaces)
 {
 	const Image& imageData = images[idxImage];
@@ -1113,7 +1746,94 @@ void MeshRefine::ThProjectMesh(uint32_t idxImage, const Mesh::FaceIdxArr& camera
 	View& view = views[idxImage];
 	ProjectMesh(vertices, faces, cameraFaces, imageData.camera, view.image.size(),
 				view.depthMap, view.faceMap, view.baryMap);
+	#ifdef MESHOPT_INCREMENTALRASTER
+	if (nMaxMemory > 0)
+		return;
+	// convert the pixel threshold to a displacement for each vertex of the faces seen by this view,
+	// keeping for each vertex the smallest one, from the view where it appears the largest
+	const Camera& camera = imageData.camera;
+	const REAL thDepth(REAL(MESHOPT_INCREMENTALRASTER)/camera.GetFocalLength());
+	typedef std::pair<VIndex,float> VertexTh;
+	std::vector<VertexTh> vertexThs;
+	vertexThs.reserve(cameraFaces.GetSize()*3);
+	for (FIndex idxFace: cameraFaces) {
+		const Face& face = faces[idxFace];
+		for (int v=0; v<3; ++v) {
+			const REAL depth(camera.PointDepth(Cast<REAL>(vertices[face[v]])));
+			if (depth > 0)
+				vertexThs.emplace_back(face[v], (float)(depth*thDepth));
+		}
+	}
+	Lock l(cs);
+	for (const VertexTh& vertexTh: vertexThs) {
+		float& th = vertexRasterTh[vertexTh.first];
+		th = MINF(th, vertexTh.second);
+	}
+	#endif
+}
+#ifdef MESHOPT_INCREMENTALRASTER
+void MeshRefine::ThProjectMeshTiles(uint32_t idxImage, const Mesh::VertexIdxArr& movedVertices)
+{
+	const Image& imageData = images[idxImage];
+	if (!imageData.IsValid())
+		return;
+	View& view = views[idxImage];
+	const Camera& camera = imageData.camera;
+	const int rows(view.depthMap.rows), cols(view.depthMap.cols);
+	ASSERT(view.faceMap.size() == view.depthMap.size() && view.baryMap.size() == view.depthMap.size());
+	// mark the tiles covered by the faces incident to the moved vertices,
+	// both at their previous and current position
+	BitMatrix tiles((rows+RasterTileSize-1)/RasterTileSize, (cols+RasterTileSize-1)/RasterTileSize);
+	tiles.memset(0);
+	const auto MarkTiles = [&](const Mesh::VertexArr& verts, const Face& face) {
+		Point2f ptMin(FLT_MAX, FLT_MAX), ptMax(-FLT_MAX, -FLT_MAX);
+		for (int v=0; v<3; ++v) {
+			const Point3 X(camera.TransformPointW2C(Cast<REAL>(verts[face[v]])));
+			if (X.z <= 0)
+				return; // not rasterized
+			const Point2f x(camera.TransformPointC2I(X));
+			ptMin.x = MINF(ptMin.x, x.x); ptMax.x = MAXF(ptMax.x, x.x);
+			ptMin.y = MINF(ptMin.y, x.y); ptMax.y = MAXF(ptMax.y, x.y);
+		}
+		if (ptMax.x < 0 || ptMax.y < 0 || ptMin.x >= cols || ptMin.y >= rows)
+			return;
+		const int tcBegin(MAXF(FLOOR2INT(ptMin.x), 0)/RasterTileSize), tcEnd(MINF(FLOOR2INT(ptMax.x), cols-1)/RasterTileSize);
+		const int trBegin(MAXF(FLOOR2INT(ptMin.y), 0)/RasterTileSize), trEnd(MINF(FLOOR2INT(ptMax.y), rows-1)/RasterTileSize);
+		for (int r=trBegin; r<=trEnd; ++r)
+			for (int c=tcBegin; c<=tcEnd; ++c)
+				tiles.set(r,c);
+	};
+	for (VIndex idxVert: movedVertices) {
+		for (FIndex idxFace: vertexFaces[idxVert]) {
+			const Face& face = faces[idxFace];
+			MarkTiles(verticesRaster, face);
+			MarkTiles(vertices, face);
+		}
+	}
+	// clear the marked tiles and rasterize again the faces overlapping them
+	RasterMesh rasterer(vertices, camera, view.depthMap, view.faceMap, view.baryMap);
+	size_t numTiles(0);
+	for (int r=0; r<tiles.rows; ++r) {
+		for (int c=0; c<tiles.cols; ++c) {
+			if (!tiles.isSet(r,c))
+				continue;
+			rasterer.ClearTile(r, c);
+			++numTiles;
+		}
+	}
+	if (numTiles == 0)
+		return;
+	rasterer.pTiles = &tiles;
+	RasterMesh::Triangle triangle;
+	RasterMesh::TriangleRasterizer triangleRasterizer(triangle, rasterer);
+	for (FIndex idxFace: view.cameraFaces) {
+		rasterer.idxFace = idxFace;
+		rasterer.ProjectTiles(faces[idxFace], triangleRasterizer);
+	}
+	Lock l(cs);
+	numRasterTiles += numTiles;
 }
+#endif
 void MeshRefine::ThProcessPair(uint32_t idxImageA, uint32_t idxImageB)
 {
 	// fetch view A data
@@ -1132,38 +1852,42 @@ void MeshRefine::ThProcessPair(uint32_t idxImageA, uint32_t idxImageB)
 	const DepthMap& depthMapB = viewB.depthMap;
 	const Image32F& imageB = viewB.image;
 	const Camera& cameraB = imageDataB.camera;
-	// warp imageB to imageA using the mesh
-	DEC_BitMatrix(mask);
-	DEC_Image(float, imageAB);
-	imageA.copyTo(imageAB);
-	ImageMeshWarp(depthMapA, cameraA, depthMapB, cameraB, imageB, imageAB, mask);
-	// compute ZNCC and its gradient
-	const TImage<Real> *imageMeanA, *imageVarA;
-	if (nReduceMemory) {
-		DEC_Image(Real, _imageMeanA);
-		DEC_Image(Real, _imageVarA);
-		ComputeLocalVariance(viewA.image, mask, _imageMeanA, _imageVarA);
-		imageMeanA = &_imageMeanA;
-		imageVarA = &_imageVarA;
-	} else {
-		imageMeanA = &viewA.imageMean;
-		imageVarA = &viewA.imageVar;
-	}
-	DEC_Image(Real, imageMeanAB);
-	DEC_Image(Real, imageVarAB);
-	ComputeLocalVariance(imageAB, mask, imageMeanAB, imageVarAB);
-	DEC_Image(Real, imageZNCC);
-	DEC_Image(Real, imageDZNCC);
-	const float score(ComputeLocalZNCC(imageA, *imageMeanA, *imageVarA, imageAB, imageMeanAB, imageVarAB, mask, imageZNCC, imageDZNCC));
-	#ifdef MESHOPT_TYPEPOOL
-	DST_Image(imageZNCC);
-	DST_Image(imageVarAB);
-	DST_Image(imageMeanAB);
-	if (nReduceMemory) {
-		DST_Image(*((TImage<Real>*)imageMeanA));
-		DST_Image(*((TImage<Real>*)imageVarA));
+	// warp imageB to imageA using the mesh and compute ZNCC and its gradient
+	const TImage<Real>* const imageMeanA(nReduceMemory ? NULL : &viewA.imageMean);
+	const TImage<Real>* const imageVarA(nReduceMemory ? NULL : &viewA.imageVar);
+	DEC_BitMatrix(mask, imageA.size());
+	DEC_Image(Real, imageDZNCC, imageA.size());
+	#ifdef MESHOPT_FUSEDZNCC
+	const float score(ComputeWarpZNCC(depthMapA, cameraA, imageA, imageMeanA, imageVarA, depthMapB, cameraB, imageB, mask, imageDZNCC));
+	#ifdef MESHOPT_FUSEDZNCC_CHECK
+	{
+		DEC_BitMatrix(maskPasses, imageA.size());
+		DEC_Image(Real, imageDZNCCPasses, imageA.size());
+		const float scorePasses(ComputeWarpZNCCPasses(depthMapA, cameraA, imageA, imageMeanA, imageVarA, depthMapB, cameraB, imageB, maskPasses, imageDZNCCPasses));
+		unsigned numMask(0), numMaskDiff(0);
+		Real maxDZNCCDiff(0);
+		for (int r=0; r<mask.rows; ++r) {
+			for (int c=0; c<mask.cols; ++c) {
+				if (mask(r,c) != maskPasses(r,c)) {
+					++numMaskDiff;
+					continue;
+				}
+				if (!mask(r,c))
+					continue;
+				++numMask;
+				const Real diff(ABS(imageDZNCC(r,c)-imageDZNCCPasses(r,c)));
+				if (maxDZNCCDiff < diff)
+					maxDZNCCDiff = diff;
+			}
+		}
+		VERBOSE("ZNCC check for pair %u-%u: score %g vs %g; %u pixels, %u mask differences, %g max gradient difference",
+			idxImageA, idxImageB, score, scorePasses, numMask, numMaskDiff, maxDZNCCDiff);
+		DST_Image(imageDZNCCPasses);
+		DST_BitMatrix(maskPasses);
 	}
-	DST_Image(imageAB);
+	#endif
+	#else
+	const float score(ComputeWarpZNCCPasses(depthMapA, cameraA, imageA, imageMeanA, imageVarA, depthMapB, cameraB, imageB, mask, imageDZNCC));
 	#endif
 	// compute field gradient
 	GradArr _photoGrad(photoGrad.GetSize());
@@ -1281,12 +2005,13 @@ protected:
 bool Scene::RefineMesh(unsigned nResolutionLevel, unsigned nMinResolution, unsigned nMaxViews,
 					   float fDecimateMesh, unsigned nCloseHoles, unsigned nEnsureEdgeSize, unsigned nMaxFaceArea,
 					   unsigned nScales, float fScaleStep,
-					   unsigned nAlternatePair, float fRegularityWeight, float fRatioRigidityElasticity, float fGradientStep, float fThPlanarVertex, unsigned nReduceMemory)
+					   unsigned nAlternatePair, float fRegularityWeight, float fRatioRigidityElasticity, float fGradientStep, float fThPlanarVertex, unsigned nReduceMemory,
+					   unsigned nMaxMemory)
 {
 	if (pointcloud.IsEmpty() && !ImagesHaveNeighbors())
 		SampleMeshWithVisibility();
 
-	MeshRefine refine(*this, nReduceMemory, nAlternatePair, fRegularityWeight, fRatioRigidityElasticity, nResolutionLevel, nMinResolution, nMaxViews, nMaxThreads);
+	MeshRefine refine(*this, nReduceMemory, nAlternatePair, fRegularityWeight, fRatioRigidityElasticity, nResolutionLevel, nMinResolution, nMaxViews, nMaxThreads, (size_t)nMaxMemory*(1024*1024));
 	if (!refine.IsValid())
 		return false;
 
@@ -1409,7 +2134,12 @@ bool Scene::RefineMesh(unsigned nResolutionLevel, unsigned nMinResolution, unsig
 						gv += norm(grad);
 					}
 				}
-				DEBUG_EXTRA("\t%2d. f: %.5f (%.4e)\tg: %.5f (%.4e - %.4e)\ts: %.3f\tv: %5u", iter+1, cost, cost/refine.vertices.GetSize(), gradients.norm(), gradients.norm()/refine.vertices.GetSize(), gv/refine.vertices.GetSize(), gstep, numVertsRemoved);
+				#ifdef MESHOPT_TYPEPOOL
+				DEBUG_EXTRA("\t%2d. f: %.5f (%.4e)\tg: %.5f (%.4e - %.4e)\ts: %.3f\tv: %5u\tr: %.3f\ta: %u/%u", iter+1, cost, cost/refine.vertices.GetSize(), gradients.norm(), gradients.norm()/refine.vertices.GetSize(), gv/refine.vertices.GetSize(), gstep, numVertsRemoved, refine.ratioRasterTiles, MeshRefine::scratchStats.nAllocated, MeshRefine::scratchStats.nAcquired);
+				MeshRefine::scratchStats.Reset();
+				#else
+				DEBUG_EXTRA("\t%2d. f: %.5f (%.4e)\tg: %.5f (%.4e - %.4e)\ts: %.3f\tv: %5u\tr: %.3f", iter+1, cost, cost/refine.vertices.GetSize(), gradients.norm(), gradients.norm()/refine.vertices.GetSize(), gv/refine.vertices.GetSize(), gstep, numVertsRemoved, refine.ratioRasterTiles);
+				#endif
 				gstep *= 0.98;
 				progress.display(iter);
 			}
@@ -1423,6 +2153,85 @@ bool Scene::RefineMesh(unsigned nResolutionLevel, unsigned nMinResolution, unsig
 		#endif
 	}
 
+	if (nMaxMemory > 0)
+		VERBOSE("Mesh refinement memory: views peak %s, process peak %s (budget %s)",
+			Util::formatBytes((int64_t)refine.viewsMemoryPeak).c_str(),
+			Util::formatBytes((int64_t)refine.processMemoryPeak).c_str(),
+			Util::formatBytes((int64_t)nMaxMemory*(1024*1024)).c_str());
+
 	return true;
 } // RefineMesh
 /*----------------------------------------------------------------*/
+
+// Compare the single pass warp and ZNCC against the separate passes on a synthetic image pair:
+// a textured slanted plane seen by two cameras, with a hole in the depth-map of the first one;
+// the masks must be identical, while the score and gradient may differ only by the rounding
+// of the float window sums used by the single pass instead of the double integral images
+// (expected on this pair: ~4e-8 mean score difference per pixel and ~1e-4 relative gradient difference)
+bool MVS::TestMeshRefineZNCC(int width, int height)
+{
+	// plane Z = 2 + 0.3*X + 0.1*Y, textured in world coordinates
+	const auto Texture = [](double X, double Y) {
+		return 0.5 + 0.2*SIN(40*X+3)*COS(35*Y) + 0.1*SIN(97*X+61*Y);
+	};
+	const auto PlaneDepth = [](const Point3& ray, const Point3& C) {
+		return (2 + 0.3*C.x + 0.1*C.y - C.z) / (1 - 0.3*ray.x - 0.1*ray.y);
+	};
+	Matrix3x3 K(Matrix3x3::IDENTITY);
+	K(0,0) = K(1,1) = width*0.9;
+	K(0,2) = (width-1)*0.5;
+	K(1,2) = (height-1)*0.5;
+	// the second camera is translated along a generic direction,
+	// so the warped pixels do not fall exactly on the pixel grid
+	const Camera cameraA(K, Matrix3x3::IDENTITY, Point3(0,0,0));
+	const Camera cameraB(K, Matrix3x3::IDENTITY, Point3(0.15,0.037,0.02));
+	DepthMap depthMapA(height, width), depthMapB(height, width);
+	Image32F imageA(height, width), imageB(height, width);
+	for (int r=0; r<height; ++r) {
+		for (int c=0; c<width; ++c) {
+			const Point3 ray(cameraA.TransformPointI2C(Point2(c,r)));
+			const double depthA(PlaneDepth(ray, cameraA.C));
+			imageA(r,c) = (float)Texture(ray.x*depthA, ray.y*depthA);
+			depthMapA(r,c) = SQUARE(c-width/3)+SQUARE(r-height/2) < SQUARE(height/8) ? Depth(0) : (Depth)depthA;
+			const double depthB(PlaneDepth(ray, cameraB.C));
+			const Point3 X(cameraB.TransformPointC2W(Point3(ray*depthB)));
+			// the second image sees the texture with a different contrast and an additional pattern
+			depthMapB(r,c) = (Depth)depthB;
+			imageB(r,c) = (float)(0.8*Texture(X.x, X.y) + 0.1 + 0.04*SIN(0.9*c+0.3)*COS(0.7*r));
+		}
+	}
+	TImage<Real> imageMeanA, imageVarA;
+	MeshRefine::ComputeLocalVariance(imageA, BitMatrix(imageA.size(), 0xFF), imageMeanA, imageVarA);
+	for (int bComputeVarA=0; bComputeVarA<2; ++bComputeVarA) {
+		const TImage<Real>* const pImageMeanA(bComputeVarA ? NULL : &imageMeanA);
+		const TImage<Real>* const pImageVarA(bComputeVarA ? NULL : &imageVarA);
+		BitMatrix mask, maskPasses;
+		TImage<Real> imageDZNCC, imageDZNCCPasses;
+		const float score(MeshRefine::ComputeWarpZNCC(depthMapA, cameraA, imageA, pImageMeanA, pImageVarA, depthMapB, cameraB, imageB, mask, imageDZNCC));
+		const float scorePasses(MeshRefine::ComputeWarpZNCCPasses(depthMapA, cameraA, imageA, pImageMeanA, pImageVarA, depthMapB, cameraB, imageB, maskPasses, imageDZNCCPasses));
+		unsigned numMask(0), numMaskDiff(0);
+		Real maxDZNCC(0), maxDZNCCDiff(0);
+		for (int r=0; r<mask.rows; ++r) {
+			for (int c=0; c<mask.cols; ++c) {
+				if (mask(r,c) != maskPasses(r,c)) {
+					++numMaskDiff;
+					continue;
+				}
+				if (!mask(r,c))
+					continue;
+				++numMask;
+				maxDZNCC = MAXF(maxDZNCC, ABS(imageDZNCCPasses(r,c)));
+				maxDZNCCDiff = MAXF(maxDZNCCDiff, ABS(imageDZNCC(r,c)-imageDZNCCPasses(r,c)));
+			}
+		}
+		DEBUG("ZNCC check (%s variance): score %g vs %g; %u pixels, %u mask differences, %g max gradient difference (max gradient %g)",
+			bComputeVarA ? "computed" : "given", score, scorePasses, numMask, numMaskDiff, maxDZNCCDiff, maxDZNCC);
+		// the hole and the parts of the image not seen by the second camera must be masked out
+		if (numMaskDiff != 0 || numMask == 0 || numMask == (unsigned)(width*height))
+			return false;
+		if (ABS(score-scorePasses) > 1e-5f*numMask || maxDZNCCDiff > Real(1e-3)*maxDZNCC)
+			return false;
+	}
+	return true;
+}
+/*----------------------------------------------------------------*/
@@ -153,6 +153,16 @@ struct MeshTexture {
 	};
 	typedef cList<TexturePatch,const TexturePatch&,1,1024,FIndex> TexturePatchArr;
 
+	// the region of a view image covering all its texture patches
+	// (the entire image if the images are kept in memory)
+	struct PatchesImage {
+		Image8U3 image; // the pixels inside the region
+		cv::Rect rect; // the region in the view image
+		inline cv::Mat operator()(const cv::Rect& r) const { return image(r-rect.tl()); }
+		inline TexCoord Offset() const { return TexCoord(rect.tl()); }
+	};
+	typedef CLISTDEF2IDX(PatchesImage,IIndex) PatchesImageArr;
+
 	// used to optimize texture patches
 	struct SeamVertex {
 		struct Patch {
@@ -273,7 +283,7 @@ struct MeshTexture {
 
 
 public:
-	MeshTexture(Scene& _scene, unsigned _nResolutionLevel=0, unsigned _nMinResolution=640);
+	MeshTexture(Scene& _scene, unsigned _nResolutionLevel=0, unsigned _nMinResolution=640, size_t _nMaxMemory=0);
 	~MeshTexture();
 
 	void ListVertexFaces();
@@ -290,9 +300,10 @@ public:
 	bool FaceViewSelection(unsigned minCommonCameras, float fOutlierThreshold, float fRatioDataSmoothness, int nIgnoreMaskLabel, const IIndexArr& views);
 	
 	void CreateSeamVertices();
+	bool ListPatchesImages();
 	void GlobalSeamLeveling();
 	void LocalSeamLeveling();
-	void GenerateTexture(bool bGlobalSeamLeveling, bool bLocalSeamLeveling, unsigned nTextureSizeMultiple, unsigned nRectPackingHeuristic, Pixel8U colEmpty, float fSharpnessWeight, int maxTextureSize);
+	bool GenerateTexture(bool bGlobalSeamLeveling, bool bLocalSeamLeveling, unsigned nTextureSizeMultiple, unsigned nRectPackingHeuristic, Pixel8U colEmpty, float fSharpnessWeight, int maxTextureSize);
 
 	template <typename PIXEL>
 	static inline PIXEL RGB2YCBCR(const PIXEL& v) {
@@ -324,9 +335,11 @@ protected:
 public:
 	const unsigned nResolutionLevel; // how many times to scale down the images before mesh optimization
 	const unsigned nMinResolution; // how many times to scale down the images before mesh optimization
+	const size_t nMaxMemory; // maximum memory used by the images loaded at once (0 - unlimited, all images are kept in memory)
 
 	// store found texture patches
 	TexturePatchArr texturePatches;
+	PatchesImageArr patchesImages; // for each view, the image region covering its texture patches
 
 	// used to compute the seam leveling
 	PairIdxArr seamEdges; // the (face-face) edges connecting different texture patches
@@ -381,10 +394,11 @@ static Image8U DetectInvalidImageRegions(const Image8U3& image)
 	return mask;
 }
 
-MeshTexture::MeshTexture(Scene& _scene, unsigned _nResolutionLevel, unsigned _nMinResolution)
+MeshTexture::MeshTexture(Scene& _scene, unsigned _nResolutionLevel, unsigned _nMinResolution, size_t _nMaxMemory)
 	:
 	nResolutionLevel(_nResolutionLevel),
 	nMinResolution(_nMinResolution),
+	nMaxMemory(_nMaxMemory),
 	vertexFaces(_scene.mesh.vertexFaces),
 	vertexBoundary(_scene.mesh.vertexBoundary),
 	faceFaces(_scene.mesh.faceFaces),
@@ -435,8 +449,18 @@ bool MeshTexture::ListCameraFaces(FaceDataViewArr& facesDatas, float fOutlierThr
 	FaceMap faceMap;
 	DepthMap depthMap;
 	#ifdef TEXOPT_USE_OPENMP
+	int numThreads(omp_get_max_threads());
+	if (nMaxMemory > 0) {
+		// limit the number of views processed at once to fit the memory budget
+		// (the current image size is an upper bound, as the images are only scaled down)
+		const size_t bytesPerPixel(sizeof(Pixel8U) + sizeof(real)*3 + sizeof(FaceMap::Type) + sizeof(DepthMap::Type) + sizeof(uint8_t));
+		size_t maxViewMemory(1);
+		for (IIndex idxView: views)
+			maxViewMemory = MAXF(maxViewMemory, (size_t)images[idxView].width*images[idxView].height*bytesPerPixel);
+		numThreads = CLAMP((int)(nMaxMemory/maxViewMemory), 1, numThreads);
+	}
 	bool bAbort(false);
-	#pragma omp parallel for private(imageGradMag, mGrad, faceMap, depthMap)
+	#pragma omp parallel for private(imageGradMag, mGrad, faceMap, depthMap) num_threads(numThreads)
 	for (int_t idx=0; idx<(int_t)views.size(); ++idx) {
 		#pragma omp flush (bAbort)
 		if (bAbort) {
@@ -589,11 +613,18 @@ bool MeshTexture::ListCameraFaces(FaceDataViewArr& facesDatas, float fOutlierThr
 		}
 		#endif
 		}
+		// the image is loaded again later, only if needed for texturing
+		if (nMaxMemory > 0)
+			imageData.ReleaseImage();
 		++progress;
 	}
 	#ifdef TEXOPT_USE_OPENMP
 	if (bAbort)
 		return false;
+	// the views are added to each face in the order they were processed,
+	// so sort them to make the texture independent of the number of threads (ex. limited by the memory budget)
+	for (FaceDataArr& faceDatas: facesDatas)
+		std::sort(faceDatas.begin(), faceDatas.end(), [](const FaceData& a, const FaceData& b) { return a.idxView < b.idxView; });
 	#endif
 	progress.close();
 
@@ -1446,13 +1477,15 @@ void MeshTexture::GlobalSeamLeveling()
 		FOREACH(i, indices) {
 			const SeamVertex::Patch& patch0 = seamVertex.patches[indices[i]];
 			ASSERT(patch0.idxPatch < numPatches);
-			SampleImage sampler(images[texturePatches[patch0.idxPatch].label].image);
+			const PatchesImage& patchesImage = patchesImages[texturePatches[patch0.idxPatch].label];
+			const TexCoord offset(patchesImage.Offset());
+			SampleImage sampler(patchesImage.image);
 			for (const SeamVertex::Patch::Edge& edge: patch0.edges) {
 				const SeamVertex& seamVertex1 = seamVertices[edge.idxSeamVertex];
 				const SeamVertex::Patches::IDX idxPatch1(seamVertex1.patches.Find(patch0.idxPatch));
 				ASSERT(idxPatch1 != SeamVertex::Patches::NO_INDEX);
 				const SeamVertex::Patch& patch1 = seamVertex1.patches[idxPatch1];
-				sampler.AddEdge(patch0.proj, patch1.proj);
+				sampler.AddEdge(patch0.proj-offset, patch1.proj-offset);
 			}
 			vertexColors[i] = sampler.GetColor();
 		}
@@ -1548,7 +1581,7 @@ void MeshTexture::GlobalSeamLeveling()
 		// dilate with one pixel width, in order to make sure patch border smooths out a little
 		imageAdj.DilateMean<1>(imageAdj, Color::ZERO);
 		// apply color correction to the patch image
-		cv::Mat image(images[texturePatch.label].image(texturePatch.rect));
+		cv::Mat image(patchesImages[texturePatch.label](texturePatch.rect));
 		for (int r=0; r<image.rows; ++r) {
 			for (int c=0; c<image.cols; ++c) {
 				const Color& a = imageAdj(r,c);
@@ -1864,9 +1897,9 @@ void MeshTexture::LocalSeamLeveling()
 		const uint32_t idxPatch((uint32_t)i);
 		const TexturePatch& texturePatch = texturePatches[idxPatch];
 		// extract image
-		const Image8U3& image0(images[texturePatch.label].image);
+		const PatchesImage& patchesImage0(patchesImages[texturePatch.label]);
 		Image32F3 image, imageOrg;
-		image0(texturePatch.rect).convertTo(image, CV_32FC3, 1.0/255.0);
+		patchesImage0(texturePatch.rect).convertTo(image, CV_32FC3, 1.0/255.0);
 		image.copyTo(imageOrg);
 		// render patch coverage
 		Image8U mask(image.size()); {
@@ -1910,15 +1943,17 @@ void MeshTexture::LocalSeamLeveling()
 					const uint32_t idxEdge1(patch1.edges.Find(edge0.idxSeamVertex));
 					if (idxEdge1 == SeamVertex::Patch::Edges::NO_INDEX)
 						continue;
-					const TexCoord& p1(patch1.proj);
+					const PatchesImage& patchesImage1(patchesImages[texturePatches[patch1.idxPatch].label]);
+					const TexCoord offset1(patchesImage1.Offset());
+					const TexCoord p1(patch1.proj-offset1);
 					// select the same edge belonging to the second patch leaving from the adjacent vertex
 					const uint32_t idxVertPatch1Adj(seamVertex1.patches.Find(patch1.idxPatch));
 					ASSERT(idxVertPatch1Adj != SeamVertex::Patches::NO_INDEX);
 					const SeamVertex::Patch& patch1Adj = seamVertex1.patches[idxVertPatch1Adj];
-					const TexCoord& p1Adj(patch1Adj.proj);
+					const TexCoord p1Adj(patch1Adj.proj-offset1);
 					// this is an edge separating two (valid) patches;
 					// draw it on this patch as the mean color of the two patches
-					const Image8U3& image1(images[texturePatches[patch1.idxPatch].label].image);
+					const Image8U3& image1(patchesImage1.image);
 					struct RasterPatch {
 						Image32F3& image;
 						Image8U& mask;
@@ -1955,8 +1990,8 @@ void MeshTexture::LocalSeamLeveling()
 			// for each patch...
 			for (const SeamVertex::Patch& patch: seamVertex0.patches) {
 				// add its view to the vertex mean color
-				const Image8U3& img(images[texturePatches[patch.idxPatch].label].image);
-				accumColor.Add(img.sample<Sampler,Color>(sampler, patch.proj)/255.f, 1.f);
+				const PatchesImage& patchesImage(patchesImages[texturePatches[patch.idxPatch].label]);
+				accumColor.Add(patchesImage.image.sample<Sampler,Color>(sampler, patch.proj-patchesImage.Offset())/255.f, 1.f);
 			}
 			const ImageRef pt(ROUND2INT(patch0.proj-offset));
 			image(pt) = accumColor.Normalized();
@@ -1968,7 +2003,7 @@ void MeshTexture::LocalSeamLeveling()
 		// compute texture patch blending
 		PoissonBlending(imageOrg, image, mask);
 		// apply color correction to the patch image
-		cv::Mat imagePatch(image0(texturePatch.rect));
+		cv::Mat imagePatch(patchesImage0(texturePatch.rect));
 		for (int r=0; r<image.rows; ++r) {
 			for (int c=0; c<image.cols; ++c) {
 				if (mask(r,c) == empty)
@@ -1982,7 +2017,94 @@ void MeshTexture::LocalSeamLeveling()
 	}
 }
 
-void MeshTexture::GenerateTexture(bool bGlobalSeamLeveling, bool bLocalSeamLeveling, unsigned nTextureSizeMultiple, unsigned nRectPackingHeuristic, Pixel8U colEmpty, float fSharpnessWeight, int maxTextureSize)
+// extract for each view the image region covering all its texture patches;
+// if the images are not kept in memory, they are loaded in batches fitting the memory budget
+// and only the regions covered by the patches are kept,
+// on which the seam leveling and the texture generation operate exactly as on the entire images
+bool MeshTexture::ListPatchesImages()
+{
+	patchesImages.Release();
+	patchesImages.resize(images.size());
+	for (const TexturePatch* pTexturePatch=texturePatches.Begin(), *pTexturePatchEnd=texturePatches.End()-1; pTexturePatch<pTexturePatchEnd; ++pTexturePatch) {
+		cv::Rect& rect = patchesImages[pTexturePatch->label].rect;
+		rect = (rect.area() > 0 ? rect | pTexturePatch->rect : pTexturePatch->rect);
+	}
+	if (nMaxMemory == 0) {
+		// use the entire images already loaded
+		FOREACH(idxView, patchesImages) {
+			PatchesImage& patchesImage = patchesImages[idxView];
+			if (patchesImage.rect.area() == 0)
+				continue;
+			const Image& imageData = images[idxView];
+			ASSERT(!imageData.image.empty());
+			patchesImage.image = imageData.image;
+			patchesImage.rect = cv::Rect(cv::Point(0,0), imageData.image.size());
+		}
+		return true;
+	}
+	// load the views in batches fitting the memory budget and extract the patches region
+	IIndexArr batch;
+	size_t batchMemory(0);
+	unsigned numBatches(0);
+	const auto LoadBatch = [&]() -> bool {
+		bool bAbort(false);
+		#ifdef TEXOPT_USE_OPENMP
+		#pragma omp parallel for schedule(dynamic)
+		for (int_t i=0; i<(int_t)batch.size(); ++i) {
+			#pragma omp flush (bAbort)
+			if (bAbort)
+				continue;
+			const IIndex idxView(batch[(IIndex)i]);
+		#else
+		for (IIndex idxView: batch) {
+		#endif
+			Image& imageData = images[idxView];
+			unsigned level(nResolutionLevel);
+			const unsigned imageSize(imageData.RecomputeMaxResolution(level, nMinResolution));
+			if ((imageData.image.empty() || MAXF(imageData.width,imageData.height) != imageSize) && !imageData.ReloadImage(imageSize)) {
+				bAbort = true;
+				#ifdef TEXOPT_USE_OPENMP
+				#pragma omp flush (bAbort)
+				continue;
+				#else
+				break;
+				#endif
+			}
+			PatchesImage& patchesImage = patchesImages[idxView];
+			ASSERT(imageData.image.isInside(patchesImage.rect.tl()) && imageData.image.isInside(patchesImage.rect.br()-cv::Point(1,1)));
+			patchesImage.image = imageData.image(patchesImage.rect).clone();
+			imageData.ReleaseImage();
+		}
+		batch.clear();
+		batchMemory = 0;
+		++numBatches;
+		return !bAbort;
+	};
+	// the extracted regions stay in memory together till the texture is generated,
+	// as needed by the seam leveling, so the budget bounds only the entire images loaded at once
+	size_t patchesMemory(0);
+	for (const PatchesImage& patchesImage: patchesImages)
+		patchesMemory += (size_t)patchesImage.rect.area()*sizeof(Pixel8U);
+	if (patchesMemory > nMaxMemory)
+		DEBUG("warning: the texture patches need %s, exceeding the memory budget of %s", Util::formatBytes((int64_t)patchesMemory).c_str(), Util::formatBytes((int64_t)nMaxMemory).c_str());
+	FOREACH(idxView, patchesImages) {
+		const PatchesImage& patchesImage = patchesImages[idxView];
+		if (patchesImage.rect.area() == 0)
+			continue;
+		const Image& imageData = images[idxView];
+		const size_t memory((size_t)imageData.width*imageData.height*sizeof(Pixel8U));
+		if (!batch.empty() && batchMemory+memory > nMaxMemory && !LoadBatch())
+			return false;
+		batch.emplace_back(idxView);
+		batchMemory += memory;
+	}
+	if (!batch.empty() && !LoadBatch())
+		return false;
+	DEBUG_ULTIMATE("\tpatches images extracted: %u batches, %s (budget %s)", numBatches, Util::formatBytes((int64_t)patchesMemory).c_str(), Util::formatBytes((int64_t)nMaxMemory).c_str());
+	return true;
+}
+
+bool MeshTexture::GenerateTexture(bool bGlobalSeamLeveling, bool bLocalSeamLeveling, unsigned nTextureSizeMultiple, unsigned nRectPackingHeuristic, Pixel8U colEmpty, float fSharpnessWeight, int maxTextureSize)
 {
 	// project patches in the corresponding view and compute texture-coordinates and bounding-box
 	const int border(2);
@@ -2004,19 +2126,19 @@ void MeshTexture::GenerateTexture(bool bGlobalSeamLeveling, bool bLocalSeamLevel
 			TexCoord* texcoords = faceTexcoords.data()+idxFace*3;
 			for (int i=0; i<3; ++i) {
 				texcoords[i] = imageData.camera.ProjectPointP(vertices[face[i]]);
-				ASSERT(imageData.image.isInsideWithBorder(texcoords[i], border));
+				ASSERT(Image8U3::isInside(Point2f(texcoords[i])-Point2f(border,border), imageData.GetSize()-cv::Size(border*2+1,border*2+1)));
 				aabb.InsertFull(texcoords[i]);
 			}
 		}
 		// compute relative texture coordinates
-		ASSERT(imageData.image.isInside(Point2f(aabb.ptMin)));
-		ASSERT(imageData.image.isInside(Point2f(aabb.ptMax)));
+		ASSERT(Image8U3::isInside(Point2f(aabb.ptMin), imageData.GetSize()));
+		ASSERT(Image8U3::isInside(Point2f(aabb.ptMax), imageData.GetSize()));
 		texturePatch.rect.x = FLOOR2INT(aabb.ptMin[0])-border;
 		texturePatch.rect.y = FLOOR2INT(aabb.ptMin[1])-border;
 		texturePatch.rect.width = CEIL2INT(aabb.ptMax[0]-aabb.ptMin[0])+border*2;
 		texturePatch.rect.height = CEIL2INT(aabb.ptMax[1]-aabb.ptMin[1])+border*2;
-		ASSERT(imageData.image.isInside(texturePatch.rect.tl()));
-		ASSERT(imageData.image.isInside(texturePatch.rect.br()));
+		ASSERT(Image8U3::isInside(texturePatch.rect.tl(), imageData.GetSize()));
+		ASSERT(Image8U3::isInside(texturePatch.rect.br(), imageData.GetSize()));
 		const TexCoord offset(texturePatch.rect.tl());
 		for (const FIndex idxFace: texturePatch.faces) {
 			TexCoord* texcoords = faceTexcoords.data()+idxFace*3;
@@ -2036,6 +2158,10 @@ void MeshTexture::GenerateTexture(bool bGlobalSeamLeveling, bool bLocalSeamLevel
 		}
 	}
 
+	// extract the image regions covered by the texture patches
+	if (!ListPatchesImages())
+		return false;
+
 	// perform seam leveling
 	if (texturePatches.size() > 2 && (bGlobalSeamLeveling || bLocalSeamLeveling)) {
 		// create seam vertices and edges
@@ -2159,8 +2285,7 @@ void MeshTexture::GenerateTexture(bool bGlobalSeamLeveling, bool bLocalSeamLevel
 					(rect.height == texturePatch.rect.width && rect.width == texturePatch.rect.height));
 				int x(0), y(1);
 				if (texturePatch.label != NO_ID) {
-					const Image& imageData = images[texturePatch.label];
-					cv::Mat patch(imageData.image(texturePatch.rect));
+					cv::Mat patch(patchesImages[texturePatch.label](texturePatch.rect));
 					if (rect.width != texturePatch.rect.width) {
 						// flip patch and texture-coordinates
 						patch = patch.t();
@@ -2185,6 +2310,7 @@ void MeshTexture::GenerateTexture(bool bGlobalSeamLeveling, bool bLocalSeamLevel
 		}
 		if (texturesDiffuse.size() == 1)
 			faceTexindices.Release();
+		patchesImages.Release();
 		// apply some sharpening
 		if (fSharpnessWeight > 0) {
 			constexpr double sigma = 1.5;
@@ -2195,6 +2321,7 @@ void MeshTexture::GenerateTexture(bool bGlobalSeamLeveling, bool bLocalSeamLevel
 			}
 		}
 	}
+	return true;
 }
 
 // texture mesh
@@ -2203,9 +2330,9 @@ void MeshTexture::GenerateTexture(bool bGlobalSeamLeveling, bool bLocalSeamLevel
 //  - nIgnoreMaskLabel: label value to ignore in the image mask, stored in the MVS scene or next to each image with '.mask.png' extension (-1 - auto estimate mask for lens distortion, -2 - disabled)
 bool Scene::TextureMesh(unsigned nResolutionLevel, unsigned nMinResolution, unsigned minCommonCameras, float fOutlierThreshold, float fRatioDataSmoothness,
 	bool bGlobalSeamLeveling, bool bLocalSeamLeveling, unsigned nTextureSizeMultiple, unsigned nRectPackingHeuristic, Pixel8U colEmpty, float fSharpnessWeight,
-	int nIgnoreMaskLabel, int maxTextureSize, const IIndexArr& views)
+	int nIgnoreMaskLabel, int maxTextureSize, const IIndexArr& views, unsigned nMaxMemory)
 {
-	MeshTexture texture(*this, nResolutionLevel, nMinResolution);
+	MeshTexture texture(*this, nResolutionLevel, nMinResolution, (size_t)nMaxMemory*(1024*1024));
 
 	// assign the best view to each face
 	{
@@ -2218,7 +2345,8 @@ bool Scene::TextureMesh(unsigned nResolutionLevel, unsigned nMinResolution, unsi
 	// generate the texture image and atlas
 	{
 		TD_TIMER_STARTD();
-		texture.GenerateTexture(bGlobalSeamLeveling, bLocalSeamLeveling, nTextureSizeMultiple, nRectPackingHeuristic, colEmpty, fSharpnessWeight, maxTextureSize);
+		if (!texture.GenerateTexture(bGlobalSeamLeveling, bLocalSeamLeveling, nTextureSizeMultiple, nRectPackingHeuristic, colEmpty, fSharpnessWeight, maxTextureSize))
+			return false;
 		DEBUG_EXTRA("Generating texture atlas and image completed: %u patches, %u image size, %u textures (%s)", texture.texturePatches.size(), mesh.texturesDiffuse[0].width(), mesh.texturesDiffuse.size(), TD_TIMER_GET_FMT().c_str());
 	}
 
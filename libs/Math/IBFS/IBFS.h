@@ -196,6 +196,9 @@ public:
 		return arcEnd-arcs;
 	}
 	bool isNodeOnSrcSide(int nodeIndex) const;
+	// residual capacities after computing the max-flow
+	void getNodeResiduals(int nodeIndex, EdgeCap& capacityFromSource, EdgeCap& capacityToSink) const;
+	bool getEdgeResiduals(int nodeIndexFrom, int nodeIndexTo, EdgeCap& capacity, EdgeCap& reverseCapacity) const;
 
 private:
 	struct Node;
@@ -444,6 +447,32 @@ inline bool IBFSGraph::isNodeOnSrcSide(int nodeIndex) const
 	return (nodes[nodeIndex].label > 0);
 }
 
+inline void IBFSGraph::getNodeResiduals(int nodeIndex, EdgeCap& capacityFromSource, EdgeCap& capacityToSink) const
+{
+	const EdgeCap excess(nodes[nodeIndex].excess);
+	if (excess > 0) {
+		capacityFromSource = excess;
+		capacityToSink = 0;
+	} else {
+		capacityFromSource = 0;
+		capacityToSink = -excess;
+	}
+}
+
+inline bool IBFSGraph::getEdgeResiduals(int nodeIndexFrom, int nodeIndexTo, EdgeCap& capacity, EdgeCap& reverseCapacity) const
+{
+	const Node* x = nodes+nodeIndexFrom;
+	const Node* y = nodes+nodeIndexTo;
+	for (const Arc* a=x->firstArc; a != (x+1)->firstArc; a++) {
+		if (a->head == y) {
+			capacity = a->rCap;
+			reverseCapacity = a->rev->rCap;
+			return true;
+		}
+	}
+	return false;
+}
+
 } // namespace IBFS
 
 #endif